@@ -30,13 +30,10 @@
 
 #include <cassert>
 #include <vector>
-#include <ext/hash_map>
 #include <stdint.h>
-
-struct AHash64 {
-	size_t operator()(const uint64_t &x) const
-	{ return (size_t)(x); }
-};
+#include <stdio.h>
+#include <stdlib.h>
+#include "AStarOpenClosedIndex.h"
 
 enum dataLocation {
 	kOpenList,
@@ -52,6 +49,10 @@ public:
 	AStarOpenClosedData() {}
 	AStarOpenClosedData(const state &theData, double gCost, double hCost, uint64_t parent, uint64_t openLoc, dataLocation location)
 	:data(theData), g(gCost), h(hCost), parentID(parent), openLocation(openLoc), where(location) { reopened = false; }
+	/** An openLocation that is never a real one */
+	static const uint64_t kNoOpenLocation = ~0ull;
+	/** Whether an element id and open list position can be stored */
+	static bool Fits(uint64_t, uint64_t) { return true; }
 	state data;
 	double g;
 	double h;
@@ -61,12 +62,64 @@ public:
 	dataLocation where;
 };
 
-template<typename state, typename CmpKey, class dataStructure = AStarOpenClosedData<state> >
+/**
+ * A smaller node record for searches that run out of memory before time:
+ * 16 bytes plus the state instead of 40. Costs are stored as floats, which
+ * are exact for integer costs below 2^24; fractional (e.g. octile) costs
+ * lose precision as g grows. Ids are 32 bits and open list positions 29
+ * bits, the remaining bits hold the list location and reopened flag.
+ * Fields have the same names as AStarOpenClosedData, so either can be
+ * used as the dataStructure of an open/closed list. The lists stop the
+ * program rather than store an id or position that doesn't fit.
+ *
+ * This record can't be used with HDAStar, which stores the 64-bit hash of
+ * the parent in parentID.
+ */
+template<typename state>
+class AStarOpenClosedCompactData {
+public:
+	AStarOpenClosedCompactData() {}
+	AStarOpenClosedCompactData(const state &theData, double gCost, double hCost, uint64_t parent, uint64_t openLoc, dataLocation location)
+	:data(theData), g(gCost), h(hCost), parentID(parent), openLocation(openLoc), where(location), reopened(false) {}
+	/** An openLocation that is never a real one; it fits in the field */
+	static const uint32_t kNoOpenLocation = (1u<<29)-1;
+	static bool Fits(uint64_t id, uint64_t openLoc)
+	{ return id <= 0xFFFFFFFFull && openLoc < kNoOpenLocation; }
+	state data;
+	float g;
+	float h;
+	uint32_t parentID;
+	uint32_t openLocation:29;
+	dataLocation where:2;
+	bool reopened:1;
+};
+
+/**
+ * Stops the program if element id or open list position openLoc doesn't
+ * fit in a node record, instead of letting it be truncated.
+ */
+template<class dataStructure>
+inline void CheckRecordFits(uint64_t id, uint64_t openLoc)
+{
+	if (!dataStructure::Fits(id, openLoc))
+	{
+		fprintf(stderr, "Error: node %llu at open list position %llu doesn't fit in the node record\n",
+				(unsigned long long)id, (unsigned long long)openLoc);
+		exit(1);
+	}
+}
+
+/**
+ * The index table maps state hashes to element ids; see AStarOpenClosedIndex.h
+ * for the available tables.
+ */
+template<typename state, typename CmpKey, class dataStructure = AStarOpenClosedData<state>, class indexTable = HashMapIndexTable >
 class AStarOpenClosed {
 public:
 	AStarOpenClosed();
 	~AStarOpenClosed();
 	void Reset();
+	void Reserve(size_t expectedNodes);
 	uint64_t AddOpenNode(const state &val, uint64_t hash, double g, double h, uint64_t parent=kTAStarNoNode);
 	uint64_t AddClosedNode(state &val, uint64_t hash, double g, double h, uint64_t parent=kTAStarNoNode);
 	void KeyChanged(uint64_t objKey);
@@ -82,6 +135,8 @@ public:
 	size_t OpenSize() const { return theHeap.size(); }
 	size_t ClosedSize() const { return size()-OpenSize(); }
 	size_t size() const { return elements.size(); }
+	size_t MemoryUsage() const;
+	typedef dataStructure dataType;
 	//	void verifyData();
 private:
 	bool HeapifyUp(unsigned int index);
@@ -89,49 +144,70 @@ private:
 
 	std::vector<uint64_t> theHeap;
 	// storing the element id; looking up with...hash?
-	typedef __gnu_cxx::hash_map<uint64_t, uint64_t, AHash64> IndexTable;
-	IndexTable table;
+	indexTable table;
 	std::vector<dataStructure > elements;
 };
 
 
-template<typename state, typename CmpKey, class dataStructure>
-AStarOpenClosed<state, CmpKey, dataStructure>::AStarOpenClosed()
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::AStarOpenClosed()
 {
 }
 
-template<typename state, typename CmpKey, class dataStructure>
-AStarOpenClosed<state, CmpKey, dataStructure>::~AStarOpenClosed()
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::~AStarOpenClosed()
 {
 }
 
 /**
  * Remove all objects from queue.
  */
-template<typename state, typename CmpKey, class dataStructure>
-void AStarOpenClosed<state, CmpKey, dataStructure>::Reset()
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::Reset()
 {
-	table.clear();
+	table.Clear();
 	elements.clear();
 	theHeap.resize(0);
 }
 
+/**
+ * Pre-size the element list and index for the expected number of nodes.
+ * Storage is kept across calls to Reset().
+ */
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::Reserve(size_t expectedNodes)
+{
+	elements.reserve(expectedNodes);
+	table.Reserve(expectedNodes);
+}
+
+/**
+ * Bytes allocated for node records, the heap and the index.
+ */
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+size_t AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::MemoryUsage() const
+{
+	return elements.capacity()*sizeof(dataStructure)+theHeap.capacity()*sizeof(uint64_t)+table.MemoryUsage();
+}
+
 /**
  * Add object into open list.
  */
-template<typename state, typename CmpKey, class dataStructure>
-uint64_t AStarOpenClosed<state, CmpKey, dataStructure>::AddOpenNode(const state &val, uint64_t hash, double g, double h, uint64_t parent)
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+uint64_t AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::AddOpenNode(const state &val, uint64_t hash, double g, double h, uint64_t parent)
 {
 	// should do lookup here...
-	if (table.find(hash) != table.end())
+	uint64_t existing;
+	if (table.Find(hash, existing))
 	{
 		//return -1; // TODO: find correct id and return
 		assert(false);
 	}
+	CheckRecordFits<dataStructure>(elements.size(), theHeap.size());
 	elements.push_back(dataStructure(val, g, h, parent, theHeap.size(), kOpenList));
 	if (parent == kTAStarNoNode)
 		elements.back().parentID = elements.size()-1;
-	table[hash] = elements.size()-1; // hashing to element list location
+	table.Insert(hash, elements.size()-1); // hashing to element list location
 	theHeap.push_back(elements.size()-1); // adding element id to back of heap
 	HeapifyUp(theHeap.size()-1); // heapify from back of the heap
 	return elements.size()-1;
@@ -140,23 +216,25 @@ uint64_t AStarOpenClosed<state, CmpKey, dataStructure>::AddOpenNode(const state
 /**
  * Add object into closed list.
  */
-template<typename state, typename CmpKey, class dataStructure>
-uint64_t AStarOpenClosed<state, CmpKey, dataStructure>::AddClosedNode(state &val, uint64_t hash, double g, double h, uint64_t parent)
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+uint64_t AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::AddClosedNode(state &val, uint64_t hash, double g, double h, uint64_t parent)
 {
 	// should do lookup here...
-	assert(table.find(hash) == table.end());
+	uint64_t existing;
+	assert(!table.Find(hash, existing));
+	CheckRecordFits<dataStructure>(elements.size(), 0);
 	elements.push_back(dataStructure(val, g, h, parent, 0, kClosedList));
 	if (parent == kTAStarNoNode)
 		elements.back().parentID = elements.size()-1;
-	table[hash] = elements.size(); // hashing to element list location
+	table.Insert(hash, elements.size()-1); // hashing to element list location
 	return elements.size()-1;
 }
 
 /**
  * Indicate that the key for a particular object has changed.
  */
-template<typename state, typename CmpKey, class dataStructure>
-void AStarOpenClosed<state, CmpKey, dataStructure>::KeyChanged(uint64_t val)
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::KeyChanged(uint64_t val)
 {
 //	EqKey eq;
 //	assert(eq(theHeap[table[val]], val));
@@ -169,8 +247,8 @@ void AStarOpenClosed<state, CmpKey, dataStructure>::KeyChanged(uint64_t val)
 ///**
 // * Indicate that the key for a particular object has increased.
 // */
-//template<typename state, typename CmpKey, class dataStructure>
-//void AStarOpenClosed<state, CmpKey, dataStructure>::IncreaseKey(uint64_t val)
+//template<typename state, typename CmpKey, class dataStructure, class indexTable>
+//void AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::IncreaseKey(uint64_t val)
 //{
 ////	EqKey eq;
 ////	assert(eq(theHeap[table[val]], val));
@@ -181,16 +259,11 @@ void AStarOpenClosed<state, CmpKey, dataStructure>::KeyChanged(uint64_t val)
 /**
  * Returns location of object as well as object key.
  */
-template<typename state, typename CmpKey, class dataStructure>
-dataLocation AStarOpenClosed<state, CmpKey, dataStructure>::Lookup(uint64_t hashKey, uint64_t &objKey) const
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+dataLocation AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::Lookup(uint64_t hashKey, uint64_t &objKey) const
 {
-	typename IndexTable::const_iterator it;
-	it = table.find(hashKey);
-	if (it != table.end())
-	{
-		objKey = (*it).second;
+	if (table.Find(hashKey, objKey))
 		return elements[objKey].where;
-	}
 	return kNotFound;
 }
 
@@ -198,8 +271,8 @@ dataLocation AStarOpenClosed<state, CmpKey, dataStructure>::Lookup(uint64_t hash
 /**
  * Peek at the next item to be expanded.
  */
-template<typename state, typename CmpKey, class dataStructure>
-uint64_t AStarOpenClosed<state, CmpKey, dataStructure>::Peek() const
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+uint64_t AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::Peek() const
 {
 	assert(OpenSize() != 0);
 	
@@ -209,8 +282,8 @@ uint64_t AStarOpenClosed<state, CmpKey, dataStructure>::Peek() const
 /**
  * Move the best item to the closed list and return key.
  */
-template<typename state, typename CmpKey, class dataStructure>
-uint64_t AStarOpenClosed<state, CmpKey, dataStructure>::Close()
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+uint64_t AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::Close()
 {
 	assert(OpenSize() != 0);
 
@@ -227,8 +300,8 @@ uint64_t AStarOpenClosed<state, CmpKey, dataStructure>::Close()
 /**
  * Move item off the closed list and back onto the open list.
  */
-template<typename state, typename CmpKey, class dataStructure>
-void AStarOpenClosed<state, CmpKey, dataStructure>::Reopen(uint64_t objKey)
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::Reopen(uint64_t objKey)
 {
 	assert(elements[objKey].where == kClosedList);
 	elements[objKey].reopened = true;
@@ -242,8 +315,8 @@ void AStarOpenClosed<state, CmpKey, dataStructure>::Reopen(uint64_t objKey)
 ///**
 // * find this object in the Heap and return
 // */
-//template<typename state, typename CmpKey, class dataStructure>
-//OBJ AStarOpenClosed<state, CmpKey, dataStructure>::find(OBJ val)
+//template<typename state, typename CmpKey, class dataStructure, class indexTable>
+//OBJ AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::find(OBJ val)
 //{
 //	if (!IsIn(val))
 //		return OBJ();
@@ -253,8 +326,8 @@ void AStarOpenClosed<state, CmpKey, dataStructure>::Reopen(uint64_t objKey)
 ///**
 // * Returns true if no items are in the AStarOpenClosed.
 // */
-//template<typename state, typename CmpKey, class dataStructure>
-//bool AStarOpenClosed<state, CmpKey, dataStructure>::Empty()
+//template<typename state, typename CmpKey, class dataStructure, class indexTable>
+//bool AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::Empty()
 //{
 //	return theHeap.size() == 0;
 //}
@@ -262,8 +335,8 @@ void AStarOpenClosed<state, CmpKey, dataStructure>::Reopen(uint64_t objKey)
 ///**
 //* Verify that the Heap is internally consistent. Fails assertion if not.
 // */
-//template<typename state, typename CmpKey, class dataStructure>
-//void AStarOpenClosed<state, CmpKey, dataStructure>::verifyData()
+//template<typename state, typename CmpKey, class dataStructure, class indexTable>
+//void AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::verifyData()
 //{
 //	assert(theHeap.size() == table.size());
 //	AStarOpenClosed::IndexTable::iterator iter;
@@ -277,8 +350,8 @@ void AStarOpenClosed<state, CmpKey, dataStructure>::Reopen(uint64_t objKey)
 /**
  * Moves a node up the heap. Returns true if the node was moved, false otherwise.
  */
-template<typename state, typename CmpKey, class dataStructure>
-bool AStarOpenClosed<state, CmpKey, dataStructure>::HeapifyUp(unsigned int index)
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+bool AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::HeapifyUp(unsigned int index)
 {
 	if (index == 0) return false;
 	int parent = (index-1)/2;
@@ -297,8 +370,8 @@ bool AStarOpenClosed<state, CmpKey, dataStructure>::HeapifyUp(unsigned int index
 	return false;
 }
 
-template<typename state, typename CmpKey, class dataStructure>
-void AStarOpenClosed<state, CmpKey, dataStructure>::HeapifyDown(unsigned int index)
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void AStarOpenClosed<state, CmpKey, dataStructure, indexTable>::HeapifyDown(unsigned int index)
 {
 	CmpKey compare;
 	unsigned int child1 = index*2+1;
@@ -0,0 +1,186 @@
+//
+//  AStarOpenClosedIndex.h
+//  hog2 glut
+//
+//  Index tables mapping a state hash to its id in the open/closed element list.
+//  AStarOpenClosed is templated on the table so that the hash_map can be
+//  swapped for the flat table below.
+//
+
+#ifndef ASTAROPENCLOSEDINDEX_H
+#define ASTAROPENCLOSEDINDEX_H
+
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include <ext/hash_map>
+#include <stdint.h>
+#include <stddef.h>
+
+struct AHash64 {
+	size_t operator()(const uint64_t &x) const
+	{ return (size_t)(x); }
+};
+
+/**
+ * The original node-based index. Each entry is a separately allocated
+ * hash_map bucket node.
+ */
+class HashMapIndexTable {
+public:
+	void Clear() { table.clear(); }
+	void Reserve(size_t count) { table.resize(count); }
+	inline bool Find(uint64_t key, uint64_t &value) const
+	{
+		IndexTable::const_iterator it = table.find(key);
+		if (it == table.end())
+			return false;
+		value = (*it).second;
+		return true;
+	}
+	inline void Insert(uint64_t key, uint64_t value) { table[key] = value; }
+	size_t size() const { return table.size(); }
+	/** Approximate; assumes one bucket pointer plus one 32-byte node per entry */
+	size_t MemoryUsage() const { return table.bucket_count()*sizeof(void*)+table.size()*32; }
+private:
+	typedef __gnu_cxx::hash_map<uint64_t, uint64_t, AHash64> IndexTable;
+	IndexTable table;
+};
+
+const uint64_t kFlatIndexEmptyKey = 0xFFFFFFFFFFFFFFFFull;
+const size_t kFlatIndexMinCapacity = 1024;
+
+/**
+ * Open-addressing index with linear probing. Keys and values live in
+ * separate flat arrays (SoA) so that probing only walks the key array; a
+ * successful lookup touches one line of each. The table keeps its capacity
+ * across Clear() calls, so a search that is pre-sized with Reserve() never
+ * rehashes or allocates.
+ */
+class FlatIndexTable {
+public:
+	FlatIndexTable() :count(0), shift(64), haveEmptyKey(false), emptyKeyValue(0) {}
+	void Clear();
+	void Reserve(size_t entries);
+	inline bool Find(uint64_t key, uint64_t &value) const;
+	inline void Insert(uint64_t key, uint64_t value);
+	size_t size() const { return count; }
+	size_t MemoryUsage() const { return keys.size()*(sizeof(uint64_t)+sizeof(uint64_t)); }
+private:
+	// Fibonacci hashing; the top bits of the product are well mixed even
+	// when the incoming hashes are dense ranks or x+y*width grid offsets
+	inline size_t Slot(uint64_t key) const
+	{ return (size_t)((key*0x9E3779B97F4A7C15ull)>>shift); }
+	void Rehash(size_t newCapacity);
+
+	std::vector<uint64_t> keys;
+	std::vector<uint64_t> values;
+	size_t count;
+	int shift;
+	// kFlatIndexEmptyKey is a legal hash value, so it is stored out of band
+	bool haveEmptyKey;
+	uint64_t emptyKeyValue;
+};
+
+inline void FlatIndexTable::Clear()
+{
+	if (count > 0)
+		std::fill(keys.begin(), keys.end(), kFlatIndexEmptyKey);
+	count = 0;
+	haveEmptyKey = false;
+}
+
+/**
+ * Size the table so that the given number of entries can be stored without rehashing.
+ */
+inline void FlatIndexTable::Reserve(size_t entries)
+{
+	size_t needed = kFlatIndexMinCapacity;
+	// keep the load factor at or below 1/2
+	while (needed < entries*2)
+		needed <<= 1;
+	if (needed > keys.size())
+		Rehash(needed);
+}
+
+inline bool FlatIndexTable::Find(uint64_t key, uint64_t &value) const
+{
+	if (key == kFlatIndexEmptyKey)
+	{
+		value = emptyKeyValue;
+		return haveEmptyKey;
+	}
+	if (keys.size() == 0)
+		return false;
+	size_t mask = keys.size()-1;
+	for (size_t slot = Slot(key); ; slot = (slot+1)&mask)
+	{
+		uint64_t k = keys[slot];
+		if (k == key)
+		{
+			value = values[slot];
+			return true;
+		}
+		if (k == kFlatIndexEmptyKey)
+			return false;
+	}
+}
+
+/**
+ * Insert key->value, overwriting the value if key is already present.
+ */
+inline void FlatIndexTable::Insert(uint64_t key, uint64_t value)
+{
+	if (key == kFlatIndexEmptyKey)
+	{
+		if (!haveEmptyKey)
+			count++;
+		haveEmptyKey = true;
+		emptyKeyValue = value;
+		return;
+	}
+	if ((count+1)*2 > keys.size())
+		Rehash(keys.size() == 0 ? kFlatIndexMinCapacity : keys.size()*2);
+	size_t mask = keys.size()-1;
+	for (size_t slot = Slot(key); ; slot = (slot+1)&mask)
+	{
+		if (keys[slot] == key)
+		{
+			values[slot] = value;
+			return;
+		}
+		if (keys[slot] == kFlatIndexEmptyKey)
+		{
+			keys[slot] = key;
+			values[slot] = value;
+			count++;
+			return;
+		}
+	}
+}
+
+inline void FlatIndexTable::Rehash(size_t newCapacity)
+{
+	assert((newCapacity&(newCapacity-1)) == 0);
+	std::vector<uint64_t> oldKeys, oldValues;
+	oldKeys.swap(keys);
+	oldValues.swap(values);
+	keys.assign(newCapacity, kFlatIndexEmptyKey);
+	values.resize(newCapacity);
+	shift = 64;
+	for (size_t c = newCapacity; c > 1; c >>= 1)
+		shift--;
+	size_t mask = newCapacity-1;
+	for (size_t x = 0; x < oldKeys.size(); x++)
+	{
+		if (oldKeys[x] == kFlatIndexEmptyKey)
+			continue;
+		size_t slot = Slot(oldKeys[x]);
+		while (keys[slot] != kFlatIndexEmptyKey)
+			slot = (slot+1)&mask;
+		keys[slot] = oldKeys[x];
+		values[slot] = oldValues[x];
+	}
+}
+
+#endif
@@ -10,348 +10,445 @@
 #define hog2_glut_BucketOpenClosed_h
 
 #include "AStarOpenClosed.h"
-#include <list>
+#include <algorithm>
 
-template<typename state, typename CmpKey, class dataStructure = AStarOpenClosedData<state> >
+/**
+ * An open/closed list with the AStarOpenClosed interface whose open list is
+ * an array of buckets indexed by integer f-cost. Costs are mapped to buckets
+ * by round(f*scale); the default scale of 1 suits unit and integer-cost
+ * domains (STP, pancake, Rubik's cube). For octile maps a scale such as 2
+ * or 10 gives finer buckets.
+ *
+ * Only the bucket with the lowest f is kept ordered. It is ordered with
+ * CmpKey, so ties (and any f-cost differences hidden by the scaling) are
+ * broken exactly as the heap-based list would break them. Other buckets
+ * are appended to and ordered once when they become the lowest bucket. In
+ * unit-cost domains children arrive in g order, so that costs a reversal
+ * at most and every operation is O(1) amortized.
+ *
+ * openLocation holds the bucket of an open node. Entries for nodes whose
+ * key moved to another bucket are left behind and skipped lazily.
+ */
+template<typename state, typename CmpKey, class dataStructure = AStarOpenClosedData<state>, class indexTable = HashMapIndexTable >
 class BucketOpenClosed {
 public:
 	BucketOpenClosed();
 	~BucketOpenClosed();
 	void Reset();
+	void Reserve(size_t expectedNodes);
 	uint64_t AddOpenNode(const state &val, uint64_t hash, double g, double h, uint64_t parent=kTAStarNoNode);
 	uint64_t AddClosedNode(state &val, uint64_t hash, double g, double h, uint64_t parent=kTAStarNoNode);
 	void KeyChanged(uint64_t objKey);
-	//void IncreaseKey(uint64_t objKey);
 	dataLocation Lookup(uint64_t hashKey, uint64_t &objKey) const;
 	inline dataStructure &Lookup(uint64_t objKey) { return elements[objKey]; }
 	inline const dataStructure &Lookat(uint64_t objKey) const { return elements[objKey]; }
 	uint64_t Peek() const;
 	uint64_t Close();
 	void Reopen(uint64_t objKey);
-	
-	uint64_t GetOpenItem(unsigned int which);
+
+	/** Set the multiplier applied to f-costs before they are rounded to a bucket */
+	void SetCostScale(double scale) { assert(OpenSize() == 0); costScale = scale; }
+	double GetCostScale() const { return costScale; }
+
+	uint64_t GetOpenItem(unsigned int which) const;
 	size_t OpenSize() const { return openCount; }
 	size_t ClosedSize() const { return size()-OpenSize(); }
 	size_t size() const { return elements.size(); }
-	//	void verifyData();
-	void Print();
+	size_t MemoryUsage() const;
+	typedef dataStructure dataType;
+	void Print() const;
 private:
-	void FindNewMin();
-	uint64_t Add(uint64_t key, uint64_t fCost);
-	void Remove(uint64_t key, uint64_t fCost);
-	int openCount;
-	int minBucket, minSubBucket;
-	struct qData {
-		qData() { fCost = -1; }
+	struct bucket {
+		bucket() :bestAtBack(true), bestAtFront(true) {}
 		std::vector<uint64_t> entries;
-		int fCost;
+		// whether the appended entries happen to already be in order
+		bool bestAtBack, bestAtFront;
+	};
+	// orders ids so that the best node is last
+	struct idCompare {
+		idCompare(const std::vector<dataStructure> &e) :elts(e) {}
+		bool operator()(uint64_t a, uint64_t b) const { return compare(elts[a], elts[b]); }
+		const std::vector<dataStructure> &elts;
+		CmpKey compare;
 	};
-	std::vector<qData> pQueue;
-	// storing the element id; looking up with...hash?
-	typedef __gnu_cxx::hash_map<uint64_t, uint64_t, AHash64> IndexTable;
-	IndexTable table;
-	std::vector<dataStructure > elements;
+	size_t GetBucket(uint64_t objKey) const;
+	inline bool IsStale(uint64_t objKey, size_t whichBucket) const
+	{ return elements[objKey].where != kOpenList || elements[objKey].openLocation != whichBucket; }
+	void Add(uint64_t objKey);
+	void Append(size_t whichBucket, uint64_t objKey);
+	void InsertOrdered(uint64_t objKey);
+	void RemoveFromMin(uint64_t objKey);
+	void PrepareMin();
+	void FindNewMin();
+
+	static const size_t kNoBucket = ~(size_t)0;
+	size_t openCount;
+	size_t minBucket;
+	// true once the buckets[minBucket] entries are cleaned and fully ordered
+	bool minReady;
+	size_t maxUsedBucket;
+	double costScale;
+	std::vector<bucket> buckets;
+	indexTable table;
+	std::vector<dataStructure> elements;
 };
 
-template<typename state, typename CmpKey, class dataStructure>
-BucketOpenClosed<state, CmpKey, dataStructure>::BucketOpenClosed()
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::BucketOpenClosed()
 {
 	openCount = 0;
-	minBucket = -1;
+	minBucket = kNoBucket;
+	minReady = false;
+	maxUsedBucket = 0;
+	costScale = 1.0;
 }
 
-template<typename state, typename CmpKey, class dataStructure>
-BucketOpenClosed<state, CmpKey, dataStructure>::~BucketOpenClosed()
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::~BucketOpenClosed()
 {
 }
 
 /**
- * Remove all objects from queue.
+ * Remove all objects from queue. Bucket storage is kept for the next search.
  */
-template<typename state, typename CmpKey, class dataStructure>
-void BucketOpenClosed<state, CmpKey, dataStructure>::Reset()
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::Reset()
 {
 	openCount = 0;
-	minBucket = -1;
-	table.clear();
+	minBucket = kNoBucket;
+	minReady = false;
+	for (size_t x = 0; x < buckets.size() && x <= maxUsedBucket; x++)
+	{
+		buckets[x].entries.resize(0);
+		buckets[x].bestAtBack = buckets[x].bestAtFront = true;
+	}
+	maxUsedBucket = 0;
+	table.Clear();
 	elements.clear();
-	pQueue.resize(0);
-	pQueue.resize(3);
 }
 
-//inline uint64_t compactGH(uint64_t g, uint64_t h)
-//{
-//	return (g<<32)|h;
-//}
-//
-//inline uint64_t extractG(uint64_t value)
-//{
-//	return value>>32;
-//}
-//
-//inline uint64_t extractH(uint64_t value)
-//{
-//	return (value)&0xFFFFFFFF;
-//}
+/**
+ * Pre-size the element list and index for the expected number of nodes.
+ */
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::Reserve(size_t expectedNodes)
+{
+	elements.reserve(expectedNodes);
+	table.Reserve(expectedNodes);
+}
 
 /**
  * Add object into open list.
  */
-template<typename state, typename CmpKey, class dataStructure>
-uint64_t BucketOpenClosed<state, CmpKey, dataStructure>::AddOpenNode(const state &val, uint64_t hash, double g, double h, uint64_t parent)
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+uint64_t BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::AddOpenNode(const state &val, uint64_t hash, double g, double h, uint64_t parent)
 {
-	// should do lookup here...
-	if (table.find(hash) != table.end())
+	uint64_t existing;
+	if (table.Find(hash, existing))
 	{
-		//return -1; // TODO: find correct id and return
 		assert(false);
 	}
-	openCount++;
-	uint64_t newg = g;
-	uint64_t newh = h;
-	uint64_t loc = Add(elements.size(), newg+newh);
-	elements.push_back(dataStructure(val, g, h, parent, loc, kOpenList));
+	CheckRecordFits<dataStructure>(elements.size(), 0);
+	elements.push_back(dataStructure(val, g, h, parent, 0, kOpenList));
+	uint64_t id = elements.size()-1;
 	if (parent == kTAStarNoNode)
-		elements.back().parentID = elements.size()-1;
-	table[hash] = elements.size()-1; // hashing to element list location
+		elements.back().parentID = id;
+	table.Insert(hash, id);
+	openCount++;
+	Add(id);
 	FindNewMin();
-	//printf("Added node to buckets %llu/%llu\n", newg+newh, newh);
-	return elements.size()-1;
+	return id;
 }
 
 /**
  * Add object into closed list.
  */
-template<typename state, typename CmpKey, class dataStructure>
-uint64_t BucketOpenClosed<state, CmpKey, dataStructure>::AddClosedNode(state &val, uint64_t hash, double g, double h, uint64_t parent)
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+uint64_t BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::AddClosedNode(state &val, uint64_t hash, double g, double h, uint64_t parent)
 {
-	// should do lookup here...
-	assert(table.find(hash) == table.end());
+	uint64_t existing;
+	assert(!table.Find(hash, existing));
+	CheckRecordFits<dataStructure>(elements.size(), 0);
 	elements.push_back(dataStructure(val, g, h, parent, 0, kClosedList));
 	if (parent == kTAStarNoNode)
 		elements.back().parentID = elements.size()-1;
-	table[hash] = elements.size(); // hashing to element list location
+	table.Insert(hash, elements.size()-1);
 	return elements.size()-1;
 }
 
 /**
  * Indicate that the key for a particular object has changed.
  */
-template<typename state, typename CmpKey, class dataStructure>
-void BucketOpenClosed<state, CmpKey, dataStructure>::KeyChanged(uint64_t val)
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::KeyChanged(uint64_t val)
 {
-//	uint64_t g, h;
-//	g = extractG(elements[val].openLocation);
-//	h = extractH(elements[val].openLocation);
-	//printf("-----\nChanging key of [%llu][%llu] to [%1.0f][%1.0f]\n", g+h, h, elements[val].g+elements[val].h, elements[val].h);
-	//Print();
-	Remove(val, elements[val].openLocation);
-//	int len = pQueue[g+h][0].size();
-//	pQueue[g+h][0].remove(val);
-//	assert(pQueue[g+h][0].size() == len-1);
-//	int len = pQueue[g+h][h].size();
-//	pQueue[g+h][h].remove(val);
-//	assert(pQueue[g+h][h].size() == len-1);
-	
-//	g = elements[val].g;
-//	h = elements[val].h;
-//	elements[val].openLocation = compactGH(g, h);
-//	if (pQueue.size() < (g+h+1))
-//		pQueue.resize((int)(g+h+1));
-//	if (pQueue[g+h].size() < /*h+*/1)
-//		pQueue[g+h].resize((int)/*h+*/1);
-//	pQueue[g+h][0].push_back(val);
-	elements[val].openLocation = Add(val, elements[val].g+elements[val].h);
-	//pQueue[g+h][h].push_back(val);
-	//printf("Removed and re-added node to buckets %llu/%llu\n", g+h, h);
-
-//	FindNewMin();
-	//Print();
+	assert(elements[val].where == kOpenList);
+	size_t oldBucket = elements[val].openLocation;
+	if (oldBucket == minBucket && minReady)
+	{
+		RemoveFromMin(val);
+		Add(val);
+	}
+	else if (GetBucket(val) == oldBucket)
+	{
+		// the old entry is still valid, but the bucket may be out of order
+		buckets[oldBucket].bestAtBack = buckets[oldBucket].bestAtFront = false;
+	}
+	else {
+		Add(val);
+	}
+	FindNewMin();
 }
 
 /**
  * Returns location of object as well as object key.
  */
-template<typename state, typename CmpKey, class dataStructure>
-dataLocation BucketOpenClosed<state, CmpKey, dataStructure>::Lookup(uint64_t hashKey, uint64_t &objKey) const
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+dataLocation BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::Lookup(uint64_t hashKey, uint64_t &objKey) const
 {
-	typename IndexTable::const_iterator it;
-	it = table.find(hashKey);
-	if (it != table.end())
-	{
-		objKey = (*it).second;
+	if (table.Find(hashKey, objKey))
 		return elements[objKey].where;
-	}
 	return kNotFound;
 }
 
-
 /**
  * Peek at the next item to be expanded.
  */
-template<typename state, typename CmpKey, class dataStructure>
-uint64_t BucketOpenClosed<state, CmpKey, dataStructure>::Peek() const
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+uint64_t BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::Peek() const
 {
 	assert(OpenSize() != 0);
-
-	assert(pQueue[minBucket].entries.size() > 0);
-	return pQueue[minBucket].entries.back();
-//	assert(pQueue[minBucket][minSubBucket].size() > 0);
-//	return pQueue[minBucket][minSubBucket].front();
-//	return theHeap[0];
+	assert(minReady && buckets[minBucket].entries.size() > 0);
+	return buckets[minBucket].entries.back();
 }
 
 /**
  * Move the best item to the closed list and return key.
  */
-template<typename state, typename CmpKey, class dataStructure>
-uint64_t BucketOpenClosed<state, CmpKey, dataStructure>::Close()
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+uint64_t BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::Close()
 {
 	assert(OpenSize() != 0);
-	assert(pQueue[minBucket].entries.size() > 0);
-	openCount--;
-	
-	uint64_t ans = pQueue[minBucket].entries.back();
-	pQueue[minBucket].entries.pop_back();
-	if (pQueue[minBucket].entries.size() == 0)
-		pQueue[minBucket].fCost = -1;
+	assert(minReady && buckets[minBucket].entries.size() > 0);
+	uint64_t ans = buckets[minBucket].entries.back();
+	buckets[minBucket].entries.pop_back();
 	elements[ans].where = kClosedList;
-	//printf("Removed item from %llu/%llu\n", minBucket, minSubBucket);
+	openCount--;
 	FindNewMin();
-	
 	return ans;
 }
 
 /**
  * Move item off the closed list and back onto the open list.
  */
-template<typename state, typename CmpKey, class dataStructure>
-void BucketOpenClosed<state, CmpKey, dataStructure>::Reopen(uint64_t objKey)
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::Reopen(uint64_t objKey)
 {
-	openCount++;
-	uint64_t g, h;
-	g = elements[objKey].g;
-	h = elements[objKey].h;
 	assert(elements[objKey].where == kClosedList);
 	elements[objKey].reopened = true;
 	elements[objKey].where = kOpenList;
-	elements[objKey].openLocation = Add(objKey, g+h);
+	openCount++;
+	Add(objKey);
+	FindNewMin();
 }
 
-template<typename state, typename CmpKey, class dataStructure>
-void BucketOpenClosed<state, CmpKey, dataStructure>::FindNewMin()
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+size_t BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::GetBucket(uint64_t objKey) const
 {
-	//assert(OpenSize() > 0);
-	if (OpenSize() == 0)
-	{ minBucket = -1; return; }
+	double f = (elements[objKey].g+elements[objKey].h)*costScale;
+	if (f <= 0)
+		return 0;
+	return (size_t)(f+0.5);
+}
+
+/**
+ * Put an open node into the bucket for its current f-cost.
+ */
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::Add(uint64_t objKey)
+{
+	size_t which = GetBucket(objKey);
+	CheckRecordFits<dataStructure>(objKey, which);
+	elements[objKey].openLocation = which;
+	if (which >= buckets.size())
+		buckets.resize(std::max(which+1, buckets.size()*2));
+	maxUsedBucket = std::max(maxUsedBucket, which);
 
-	minBucket = -1;
-	for (int x = 0; x < pQueue.size(); x++)
+	if (which == minBucket && minReady)
 	{
-		while (pQueue[x].entries.size() > 0 && pQueue[x].entries.back() == -1)
-		{
-			pQueue[x].entries.pop_back();
-		}
-		if (pQueue[x].entries.size() == 0)
+		InsertOrdered(objKey);
+		return;
+	}
+	if (minBucket == kNoBucket || which < minBucket)
+	{
+		minBucket = which;
+		minReady = false;
+	}
+	Append(which, objKey);
+}
+
+/**
+ * Append to a bucket that isn't being expanded yet, tracking whether the
+ * entries are still monotone so that ordering them later is cheap.
+ */
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::Append(size_t which, uint64_t objKey)
+{
+	bucket &b = buckets[which];
+	if (b.entries.size() > 0)
+	{
+		uint64_t last = b.entries.back();
+		if (IsStale(last, which))
 		{
-			pQueue[x].fCost = -1;
+			b.bestAtBack = b.bestAtFront = false;
 		}
 		else {
-			if (minBucket == -1)
-			{
-				minBucket = x;
-				continue;
-			}
-			else {
-				if (pQueue[x].fCost < pQueue[minBucket].fCost)
-					minBucket = x;
-			}
+			CmpKey compare;
+			if (compare(elements[objKey], elements[last])) // new node is worse
+				b.bestAtBack = false;
+			if (compare(elements[last], elements[objKey])) // new node is better
+				b.bestAtFront = false;
 		}
 	}
+	b.entries.push_back(objKey);
 }
 
-template<typename state, typename CmpKey, class dataStructure>
-uint64_t BucketOpenClosed<state, CmpKey, dataStructure>::GetOpenItem(unsigned int which)
+/**
+ * Insert into the bucket being expanded, keeping it ordered. Children that
+ * are at least as good as the current best are simply pushed on the back.
+ */
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::InsertOrdered(uint64_t objKey)
 {
-	for (unsigned int x = 0; x < elements.size(); x++)
+	std::vector<uint64_t> &e = buckets[minBucket].entries;
+	idCompare compare(elements);
+	if (e.size() == 0 || !compare(objKey, e.back()))
 	{
-		if (elements[x].where == kOpenList)
-		{
-			if (which == 0)
-				return x;
-			which--;
-		}
-		return -1;
+		e.push_back(objKey);
+		return;
 	}
-	return -1;
+	e.insert(std::upper_bound(e.begin(), e.end(), objKey, compare), objKey);
 }
 
-template<typename state, typename CmpKey, class dataStructure>
-void BucketOpenClosed<state, CmpKey, dataStructure>::Print()
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::RemoveFromMin(uint64_t objKey)
 {
-	int cnt = 0;
-	printf("**pQueue[%d] items [%d, %d]:\n", OpenSize(), minBucket, minSubBucket);
-	for (unsigned int x = 0; x < pQueue.size(); x++)
+	std::vector<uint64_t> &e = buckets[minBucket].entries;
+	for (size_t x = e.size(); x > 0; x--)
 	{
-		for (unsigned int y = 0; y < pQueue[x].size(); y++)
+		if (e[x-1] == objKey)
 		{
-			if (pQueue[x][y].size() > 0)
-				printf("**[%d][%d] has %d elements\n", x, y, pQueue[x][y].size());
-			cnt += pQueue[x][y].size();
+			e.erase(e.begin()+x-1);
+			return;
 		}
 	}
-	if (cnt != OpenSize())
-	{
-		assert(!"ERROR; sizes inconsistent");
-	}
+	assert(!"Element not found to remove");
 }
 
-template<typename state, typename CmpKey, class dataStructure>
-uint64_t BucketOpenClosed<state, CmpKey, dataStructure>::Add(uint64_t key, uint64_t fCost)
+/**
+ * Drop stale and duplicate entries from the lowest bucket and order it for
+ * expansion. (A node whose key moves away from a bucket and back again has
+ * two valid entries there.)
+ */
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::PrepareMin()
 {
-	for (int x = 0; x < pQueue.size(); x++)
+	bucket &b = buckets[minBucket];
+	size_t next = 0;
+	bool sawStale = false;
+	for (size_t x = 0; x < b.entries.size(); x++)
 	{
-		if (pQueue[x].fCost == fCost)
+		if (IsStale(b.entries[x], minBucket))
 		{
-			pQueue[x].entries.push_back(key);
-			FindNewMin();
-			return pQueue[x].entries.size()-1;
+			sawStale = true;
+			continue;
 		}
+		// mark as seen so that later copies look stale
+		elements[b.entries[x]].openLocation = dataStructure::kNoOpenLocation;
+		b.entries[next++] = b.entries[x];
 	}
-	for (int x = 0; x < pQueue.size(); x++)
+	b.entries.resize(next);
+	for (size_t x = 0; x < b.entries.size(); x++)
+		elements[b.entries[x]].openLocation = minBucket;
+	// with entries removed the monotone flags can't be trusted
+	if (sawStale || (!b.bestAtBack && !b.bestAtFront))
+		std::sort(b.entries.begin(), b.entries.end(), idCompare(elements));
+	else if (!b.bestAtBack)
+		std::reverse(b.entries.begin(), b.entries.end());
+	b.bestAtBack = true;
+	b.bestAtFront = false;
+	minReady = true;
+}
+
+/**
+ * Advance minBucket to the first bucket holding an open node and order it.
+ */
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::FindNewMin()
+{
+	if (openCount == 0)
 	{
-		if (pQueue[x].fCost == -1)
-		{
-			pQueue[x].fCost = fCost;
-			pQueue[x].entries.push_back(key);
-			FindNewMin();
-			return pQueue[x].entries.size()-1;
-		}
+		minBucket = kNoBucket;
+		minReady = false;
+		return;
+	}
+	while (true)
+	{
+		assert(minBucket < buckets.size());
+		if (!minReady)
+			PrepareMin();
+		if (buckets[minBucket].entries.size() > 0)
+			return;
+		buckets[minBucket].bestAtBack = buckets[minBucket].bestAtFront = true;
+		minBucket++;
+		minReady = false;
 	}
-	assert(!"No space found to insert element");
 }
 
-template<typename state, typename CmpKey, class dataStructure>
-void BucketOpenClosed<state, CmpKey, dataStructure>::Remove(uint64_t key, uint64_t location)
+/**
+ * Bytes allocated for node records, buckets and the index.
+ */
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+size_t BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::MemoryUsage() const
+{
+	size_t total = elements.capacity()*sizeof(dataStructure)+buckets.capacity()*sizeof(bucket)+table.MemoryUsage();
+	for (size_t x = 0; x < buckets.size(); x++)
+		total += buckets[x].entries.capacity()*sizeof(uint64_t);
+	return total;
+}
+
+/**
+ * Returns the id of the which-th open node. This walks all nodes and is
+ * only meant for drawing and debugging.
+ */
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+uint64_t BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::GetOpenItem(unsigned int which) const
 {
-	for (int x = 0; x < pQueue.size(); x++)
+	for (uint64_t x = 0; x < elements.size(); x++)
 	{
-		if (pQueue[x].entries.size() > location && pQueue[x].entries[location] == key)
+		if (elements[x].where == kOpenList)
 		{
-			if (location == pQueue[x].entries.size()-1)
-			{
-				pQueue[x].entries.pop_back();
-			}
-			else {
-				pQueue[x].entries[location] = -1;
-				if (pQueue[x].entries.size() == 1)
-					pQueue[x].fCost = -1;
-			}
-			FindNewMin();
-			return;
+			if (which == 0)
+				return x;
+			which--;
 		}
 	}
-	assert(!"Element not found to remove");
+	return kTAStarNoNode;
+}
+
+template<typename state, typename CmpKey, class dataStructure, class indexTable>
+void BucketOpenClosed<state, CmpKey, dataStructure, indexTable>::Print() const
+{
+	printf("**%llu open items, lowest bucket %llu:\n", (unsigned long long)OpenSize(), (unsigned long long)minBucket);
+	for (size_t x = 0; x < buckets.size() && x <= maxUsedBucket; x++)
+	{
+		size_t valid = 0;
+		for (size_t y = 0; y < buckets[x].entries.size(); y++)
+			if (!IsStale(buckets[x].entries[y], x))
+				valid++;
+		if (valid > 0)
+			printf("**[%llu] has %llu elements\n", (unsigned long long)x, (unsigned long long)valid);
+	}
 }
 
 #endif
@@ -0,0 +1,253 @@
+//
+//  DAryOpenClosed.h
+//  hog2 glut
+//
+//  An open/closed list with the same interface as AStarOpenClosed, but
+//  whose open list is a d-ary heap. Each heap entry carries a copy of the
+//  f- and g-cost of its node, so sifting compares entries in the heap array
+//  instead of dereferencing the element list at every level.
+//
+//  Nodes are ordered as in AStarCompare: lowest f first, ties broken
+//  towards the larger g. Because the keys are copies, KeyChanged() must be
+//  called after modifying g or h of a node that is on open (TemplateAStar
+//  already does this).
+//
+
+#ifndef DARYOPENCLOSED_H
+#define DARYOPENCLOSED_H
+
+#include "AStarOpenClosed.h"
+#include "FPUtil.h"
+
+template<typename state, int arity = 4, class dataStructure = AStarOpenClosedData<state>, class indexTable = HashMapIndexTable >
+class DAryOpenClosed {
+public:
+	DAryOpenClosed() {}
+	~DAryOpenClosed() {}
+	void Reset();
+	void Reserve(size_t expectedNodes);
+	uint64_t AddOpenNode(const state &val, uint64_t hash, double g, double h, uint64_t parent=kTAStarNoNode);
+	uint64_t AddClosedNode(state &val, uint64_t hash, double g, double h, uint64_t parent=kTAStarNoNode);
+	void KeyChanged(uint64_t objKey);
+	dataLocation Lookup(uint64_t hashKey, uint64_t &objKey) const;
+	inline dataStructure &Lookup(uint64_t objKey) { return elements[objKey]; }
+	inline const dataStructure &Lookat(uint64_t objKey) const { return elements[objKey]; }
+	uint64_t Peek() const;
+	uint64_t Close();
+	void Reopen(uint64_t objKey);
+
+	uint64_t GetOpenItem(unsigned int which) { return theHeap[which].id; }
+	size_t OpenSize() const { return theHeap.size(); }
+	size_t ClosedSize() const { return size()-OpenSize(); }
+	size_t size() const { return elements.size(); }
+	size_t MemoryUsage() const
+	{ return elements.capacity()*sizeof(dataStructure)+theHeap.capacity()*sizeof(heapEntry)+table.MemoryUsage(); }
+	typedef dataStructure dataType;
+private:
+	struct heapEntry {
+		double f;
+		double g;
+		uint64_t id;
+	};
+	// true if a should be expanded before b
+	static inline bool Before(const heapEntry &a, const heapEntry &b)
+	{
+		if (fequal(a.f, b.f))
+			return fgreater(a.g, b.g);
+		return fless(a.f, b.f);
+	}
+	inline heapEntry MakeEntry(uint64_t objKey) const
+	{
+		heapEntry e;
+		e.g = elements[objKey].g;
+		e.f = e.g+elements[objKey].h;
+		e.id = objKey;
+		return e;
+	}
+	inline void Place(size_t index, const heapEntry &e)
+	{
+		theHeap[index] = e;
+		elements[e.id].openLocation = index;
+	}
+	bool HeapifyUp(size_t index);
+	void HeapifyDown(size_t index);
+
+	std::vector<heapEntry> theHeap;
+	indexTable table;
+	std::vector<dataStructure> elements;
+};
+
+/**
+ * Remove all objects from queue.
+ */
+template<typename state, int arity, class dataStructure, class indexTable>
+void DAryOpenClosed<state, arity, dataStructure, indexTable>::Reset()
+{
+	table.Clear();
+	elements.clear();
+	theHeap.resize(0);
+}
+
+/**
+ * Pre-size the element list and index for the expected number of nodes.
+ */
+template<typename state, int arity, class dataStructure, class indexTable>
+void DAryOpenClosed<state, arity, dataStructure, indexTable>::Reserve(size_t expectedNodes)
+{
+	elements.reserve(expectedNodes);
+	table.Reserve(expectedNodes);
+}
+
+/**
+ * Add object into open list.
+ */
+template<typename state, int arity, class dataStructure, class indexTable>
+uint64_t DAryOpenClosed<state, arity, dataStructure, indexTable>::AddOpenNode(const state &val, uint64_t hash, double g, double h, uint64_t parent)
+{
+	uint64_t existing;
+	if (table.Find(hash, existing))
+	{
+		assert(false);
+	}
+	CheckRecordFits<dataStructure>(elements.size(), theHeap.size());
+	elements.push_back(dataStructure(val, g, h, parent, theHeap.size(), kOpenList));
+	uint64_t id = elements.size()-1;
+	if (parent == kTAStarNoNode)
+		elements.back().parentID = id;
+	table.Insert(hash, id);
+	theHeap.push_back(MakeEntry(id));
+	HeapifyUp(theHeap.size()-1);
+	return id;
+}
+
+/**
+ * Add object into closed list.
+ */
+template<typename state, int arity, class dataStructure, class indexTable>
+uint64_t DAryOpenClosed<state, arity, dataStructure, indexTable>::AddClosedNode(state &val, uint64_t hash, double g, double h, uint64_t parent)
+{
+	uint64_t existing;
+	assert(!table.Find(hash, existing));
+	CheckRecordFits<dataStructure>(elements.size(), 0);
+	elements.push_back(dataStructure(val, g, h, parent, 0, kClosedList));
+	if (parent == kTAStarNoNode)
+		elements.back().parentID = elements.size()-1;
+	table.Insert(hash, elements.size()-1);
+	return elements.size()-1;
+}
+
+/**
+ * Indicate that the key for a particular object has changed. The cached
+ * heap key is refreshed from the element.
+ */
+template<typename state, int arity, class dataStructure, class indexTable>
+void DAryOpenClosed<state, arity, dataStructure, indexTable>::KeyChanged(uint64_t val)
+{
+	size_t loc = elements[val].openLocation;
+	assert(theHeap[loc].id == val);
+	theHeap[loc] = MakeEntry(val);
+	if (!HeapifyUp(loc))
+		HeapifyDown(loc);
+}
+
+/**
+ * Returns location of object as well as object key.
+ */
+template<typename state, int arity, class dataStructure, class indexTable>
+dataLocation DAryOpenClosed<state, arity, dataStructure, indexTable>::Lookup(uint64_t hashKey, uint64_t &objKey) const
+{
+	if (table.Find(hashKey, objKey))
+		return elements[objKey].where;
+	return kNotFound;
+}
+
+/**
+ * Peek at the next item to be expanded.
+ */
+template<typename state, int arity, class dataStructure, class indexTable>
+uint64_t DAryOpenClosed<state, arity, dataStructure, indexTable>::Peek() const
+{
+	assert(OpenSize() != 0);
+	return theHeap[0].id;
+}
+
+/**
+ * Move the best item to the closed list and return key.
+ */
+template<typename state, int arity, class dataStructure, class indexTable>
+uint64_t DAryOpenClosed<state, arity, dataStructure, indexTable>::Close()
+{
+	assert(OpenSize() != 0);
+	uint64_t ans = theHeap[0].id;
+	elements[ans].where = kClosedList;
+	Place(0, theHeap.back());
+	theHeap.pop_back();
+	if (theHeap.size() > 0)
+		HeapifyDown(0);
+	return ans;
+}
+
+/**
+ * Move item off the closed list and back onto the open list.
+ */
+template<typename state, int arity, class dataStructure, class indexTable>
+void DAryOpenClosed<state, arity, dataStructure, indexTable>::Reopen(uint64_t objKey)
+{
+	assert(elements[objKey].where == kClosedList);
+	elements[objKey].reopened = true;
+	elements[objKey].where = kOpenList;
+	elements[objKey].openLocation = theHeap.size();
+	theHeap.push_back(MakeEntry(objKey));
+	HeapifyUp(theHeap.size()-1);
+}
+
+/**
+ * Moves a node up the heap. Returns true if the node was moved, false otherwise.
+ * The moving entry is held aside and written once at its final location.
+ */
+template<typename state, int arity, class dataStructure, class indexTable>
+bool DAryOpenClosed<state, arity, dataStructure, indexTable>::HeapifyUp(size_t index)
+{
+	heapEntry e = theHeap[index];
+	size_t start = index;
+	while (index > 0)
+	{
+		size_t parent = (index-1)/arity;
+		if (!Before(e, theHeap[parent]))
+			break;
+		Place(index, theHeap[parent]);
+		index = parent;
+	}
+	if (index == start)
+		return false;
+	Place(index, e);
+	return true;
+}
+
+template<typename state, int arity, class dataStructure, class indexTable>
+void DAryOpenClosed<state, arity, dataStructure, indexTable>::HeapifyDown(size_t index)
+{
+	heapEntry e = theHeap[index];
+	size_t count = theHeap.size();
+	while (true)
+	{
+		size_t first = index*arity+1;
+		if (first >= count)
+			break;
+		size_t last = std::min(first+arity, count);
+		// find best child
+		size_t which = first;
+		for (size_t c = first+1; c < last; c++)
+		{
+			if (Before(theHeap[c], theHeap[which]))
+				which = c;
+		}
+		if (!Before(theHeap[which], e))
+			break;
+		Place(index, theHeap[which]);
+		index = which;
+	}
+	Place(index, e);
+}
+
+#endif
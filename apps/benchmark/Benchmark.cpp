@@ -0,0 +1,514 @@
+//
+//  Benchmark.cpp
+//  hog2
+//
+//  Headless benchmark runner for grid pathfinding scenarios. Runs one
+//  algorithm over every experiment of a list of scenario files with a pool
+//  of threads and writes the result of each experiment, and percentiles for
+//  each bucket, as CSV or JSON. It never opens a window.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include "Benchmark.h"
+#include "Timer.h"
+#include "TemplateAStar.h"
+#include "Map2DEnvironment.h"
+#include "CanonicalGrid.h"
+#include "JPSGrid.h"
+#include "MapCliqueAbstraction.h"
+#include "ClusterAbstraction.h"
+#include "HPAStar.h"
+#include "PRAStar.h"
+
+/** The algorithms MakeGridSearcher() knows */
+static const int kNumAlgorithms = 6;
+static const std::string kAlgorithms[kNumAlgorithms] = {"astar", "canonical", "jps", "jps+", "hpa", "pra"};
+/** Size of the HPA* clusters */
+const int kBenchmarkClusterSize = 10;
+
+// Loading maps and building abstractions isn't known to be thread safe
+static std::mutex buildLock;
+
+#ifdef NO_OPENGL
+// The stub GLUT main loop calls this; the benchmark never starts it, and
+// doesn't link the GUI, which defines it.
+void renderScene() {}
+#endif
+
+static double GetThreadCPUTime()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+	return t.tv_sec+t.tv_nsec/1000000000.0;
+}
+
+/** Runs TemplateAStar on a grid environment */
+template <class state, class action, class environment>
+class TemplateAStarSearcher : public GridSearcher {
+public:
+	TemplateAStarSearcher(Map *m, environment *e) :m(m), env(e) {}
+	~TemplateAStarSearcher() { delete env; delete m; }
+	void Solve(const Experiment &e, BenchmarkResult &result)
+	{
+		state s(e.GetStartX(), e.GetStartY()), g(e.GetGoalX(), e.GetGoalY());
+		env->StoreGoal(g);
+		Timer t;
+		double cpu = GetThreadCPUTime();
+		t.StartTimer();
+		search.GetPath(env, s, g, path);
+		result.wallTime = t.EndTimer();
+		result.cpuTime = GetThreadCPUTime()-cpu;
+		result.solved = (path.size() > 0);
+		result.expanded = search.GetNodesExpanded();
+		result.touched = search.GetNodesTouched();
+		result.length = env->GetPathLength(path);
+	}
+private:
+	Map *m;
+	environment *env;
+	TemplateAStar<state, action, environment> search;
+	std::vector<state> path;
+};
+
+/** Runs a SearchAlgorithm, such as HPA* or PRA*, on a map abstraction */
+class AbstractionSearcher : public GridSearcher {
+public:
+	AbstractionSearcher(MapAbstraction *abs, SearchAlgorithm *alg) :abs(abs), alg(alg) {}
+	// the abstraction deletes the map
+	~AbstractionSearcher() { delete alg; delete abs; }
+	void Solve(const Experiment &e, BenchmarkResult &result)
+	{
+		node *from = abs->GetNodeFromMap(e.GetStartX(), e.GetStartY());
+		node *to = abs->GetNodeFromMap(e.GetGoalX(), e.GetGoalY());
+		Timer t;
+		double cpu = GetThreadCPUTime();
+		t.StartTimer();
+		path *p = alg->GetPath(abs, from, to);
+		result.wallTime = t.EndTimer();
+		result.cpuTime = GetThreadCPUTime()-cpu;
+		result.solved = (p != 0) || (from == to && from != 0);
+		result.expanded = alg->GetNodesExpanded();
+		result.touched = alg->GetNodesTouched();
+		result.length = abs->distance(p);
+		delete p;
+	}
+private:
+	MapAbstraction *abs;
+	SearchAlgorithm *alg;
+};
+
+GridSearcher *MakeGridSearcher(const std::string &algorithm, Map *m)
+{
+	if (algorithm == "astar")
+		return new TemplateAStarSearcher<xyLoc, tDirection, MapEnvironment>(m, new MapEnvironment(m));
+	if (algorithm == "canonical")
+		return new TemplateAStarSearcher<CanonicalGrid::xyLoc, CanonicalGrid::tDirection, CanonicalGrid::CanonicalGrid>(m, new CanonicalGrid::CanonicalGrid(m));
+	if (algorithm == "jps")
+		return new TemplateAStarSearcher<CanonicalGrid::xyLoc, CanonicalGrid::tDirection, CanonicalGrid::JPSGrid>(m, new CanonicalGrid::JPSGrid(m));
+	if (algorithm == "jps+")
+	{
+		std::string jumpFile = std::string(m->GetMapName())+".jps";
+		return new TemplateAStarSearcher<CanonicalGrid::xyLoc, CanonicalGrid::tDirection, CanonicalGrid::JPSPlusGrid>(m, new CanonicalGrid::JPSPlusGrid(m, jumpFile.c_str()));
+	}
+	if (algorithm == "hpa")
+	{
+		ClusterAbstraction *abs = new ClusterAbstraction(m, kBenchmarkClusterSize);
+		hpaStar *alg = new hpaStar();
+		alg->setAbstraction(abs);
+		return new AbstractionSearcher(abs, alg);
+	}
+	if (algorithm == "pra")
+		return new AbstractionSearcher(new MapCliqueAbstraction(m), new praStar());
+	return 0;
+}
+
+void LoadScenarios(const std::vector<std::string> &scenarios, std::vector<BenchmarkInstance> &instances)
+{
+	for (unsigned int x = 0; x < scenarios.size(); x++)
+	{
+		ScenarioLoader sl(scenarios[x].c_str());
+		if (sl.GetNumExperiments() == 0)
+			fprintf(stderr, "No experiments in '%s'\n", scenarios[x].c_str());
+		for (int y = 0; y < sl.GetNumExperiments(); y++)
+			instances.push_back(BenchmarkInstance(x, y, sl.GetNthExperiment(y)));
+	}
+}
+
+/** Returns the seconds taken to load a scenario and each of its maps */
+static double TimeScenarioLoad(const char *scenario)
+{
+	Timer t;
+	t.StartTimer();
+	ScenarioLoader sl(scenario);
+	std::string last;
+	for (int x = 0; x < sl.GetNumExperiments(); x++)
+	{
+		Experiment e = sl.GetNthExperiment(x);
+		if (last == e.GetMapName())
+			continue;
+		last = e.GetMapName();
+		Map m(last.c_str());
+	}
+	return t.EndTimer();
+}
+
+void ConvertScenarios(const std::vector<std::string> &scenarios)
+{
+	// maps already converted, and whether that worked
+	std::map<std::string, bool> converted;
+	for (unsigned int x = 0; x < scenarios.size(); x++)
+	{
+		ScenarioLoader sl(scenarios[x].c_str());
+		ScenarioLoader binary;
+		for (int y = 0; y < sl.GetNumExperiments(); y++)
+		{
+			Experiment e = sl.GetNthExperiment(y);
+			std::string mapName = e.GetMapName();
+			std::string binaryName = mapName+".bin";
+			if (converted.find(mapName) == converted.end())
+			{
+				Map m(mapName.c_str());
+				converted[mapName] = (m.GetMapType() == kOctile && m.SaveBinary(binaryName.c_str()));
+				if (!converted[mapName])
+					printf("Unable to convert '%s'; the scenario will use the text map\n", mapName.c_str());
+			}
+			if (!converted[mapName])
+				binaryName = mapName;
+			binary.AddExperiment(Experiment(e.GetStartX(), e.GetStartY(), e.GetGoalX(), e.GetGoalY(),
+											e.GetXScale(), e.GetYScale(), e.GetBucket(), e.GetDistance(), binaryName));
+		}
+		std::string binaryScenario = scenarios[x]+".bin";
+		if (!binary.SaveBinary(binaryScenario.c_str()))
+		{
+			printf("Unable to write '%s'\n", binaryScenario.c_str());
+			continue;
+		}
+		double textTime = TimeScenarioLoad(scenarios[x].c_str());
+		double binaryTime = TimeScenarioLoad(binaryScenario.c_str());
+		printf("%s: %d experiments; text load %1.4fs, binary load %1.4fs\n", binaryScenario.c_str(),
+			   sl.GetNumExperiments(), textTime, binaryTime);
+	}
+}
+
+/**
+ * Each thread takes the next experiment from a shared counter. Experiments
+ * are in scenario order, so a thread keeps its searcher until it reaches
+ * an experiment on a different map.
+ */
+static void BenchmarkWorker(const std::string &algorithm, const std::vector<BenchmarkInstance> &instances,
+							std::atomic<uint64_t> &next, std::vector<BenchmarkResult> &results)
+{
+	GridSearcher *searcher = 0;
+	std::string mapName;
+	while (true)
+	{
+		uint64_t which = next.fetch_add(1);
+		if (which >= instances.size())
+			break;
+		const Experiment &e = instances[which].experiment;
+		if (searcher == 0 || mapName != e.GetMapName())
+		{
+			delete searcher;
+			mapName = e.GetMapName();
+			std::lock_guard<std::mutex> guard(buildLock);
+			searcher = MakeGridSearcher(algorithm, new Map(mapName.c_str()));
+		}
+		searcher->Solve(e, results[which]);
+	}
+	delete searcher;
+}
+
+void RunBenchmark(const std::string &algorithm, const std::vector<BenchmarkInstance> &instances,
+				  int numThreads, std::vector<BenchmarkResult> &results)
+{
+	results.assign(instances.size(), BenchmarkResult());
+	std::atomic<uint64_t> next(0);
+	std::vector<std::thread*> threads(numThreads);
+	for (int x = 0; x < numThreads; x++)
+		threads[x] = new std::thread(BenchmarkWorker, std::cref(algorithm), std::cref(instances), std::ref(next), std::ref(results));
+	for (int x = 0; x < numThreads; x++)
+	{
+		threads[x]->join();
+		delete threads[x];
+	}
+}
+
+/** Nearest-rank percentile of sorted values */
+template <class value>
+static value GetPercentile(const std::vector<value> &sorted, double percent)
+{
+	if (sorted.size() == 0)
+		return 0;
+	size_t rank = (size_t)ceil(percent/100.0*sorted.size());
+	return sorted[std::max(rank, (size_t)1)-1];
+}
+
+/** Statistics of the experiments of one bucket */
+struct BucketSummary {
+	BucketSummary() :count(0), solved(0), suboptimal(0), totalRatio(0), maxRatio(0) {}
+	void Add(const Experiment &e, const BenchmarkResult &r)
+	{
+		count++;
+		if (!r.solved)
+			return;
+		solved++;
+		expanded.push_back(r.expanded);
+		wallTime.push_back(r.wallTime*1000);
+		cpuTime.push_back(r.cpuTime*1000);
+		double ratio = (e.GetDistance() > 0)?r.length/e.GetDistance():1.0;
+		totalRatio += ratio;
+		maxRatio = std::max(maxRatio, ratio);
+		// scenario distances are rounded, so allow for that
+		if (r.length > e.GetDistance()+0.01)
+			suboptimal++;
+	}
+	void Sort()
+	{
+		std::sort(expanded.begin(), expanded.end());
+		std::sort(wallTime.begin(), wallTime.end());
+		std::sort(cpuTime.begin(), cpuTime.end());
+	}
+	int count, solved, suboptimal;
+	double totalRatio, maxRatio;
+	std::vector<uint64_t> expanded;
+	std::vector<double> wallTime, cpuTime;
+};
+
+static const double kPercentiles[3] = {50, 90, 99};
+
+static void WriteBucketsCSV(FILE *f, const std::string &algorithm, std::map<int, BucketSummary> &buckets)
+{
+	fprintf(f, "algorithm,bucket,count,solved,suboptimal,mean_ratio,max_ratio");
+	const char *names[3] = {"expanded", "wall_ms", "cpu_ms"};
+	for (int x = 0; x < 3; x++)
+		fprintf(f, ",%s_p50,%s_p90,%s_p99,%s_max", names[x], names[x], names[x], names[x]);
+	fprintf(f, "\n");
+	for (std::map<int, BucketSummary>::iterator i = buckets.begin(); i != buckets.end(); i++)
+	{
+		BucketSummary &b = i->second;
+		fprintf(f, "%s,%d,%d,%d,%d,%1.6f,%1.6f", algorithm.c_str(), i->first, b.count, b.solved, b.suboptimal,
+				b.solved?b.totalRatio/b.solved:0.0, b.maxRatio);
+		for (int x = 0; x < 3; x++)
+			fprintf(f, ",%llu", (unsigned long long)GetPercentile(b.expanded, kPercentiles[x]));
+		fprintf(f, ",%llu", (unsigned long long)GetPercentile(b.expanded, 100));
+		for (int x = 0; x < 3; x++)
+			fprintf(f, ",%1.4f", GetPercentile(b.wallTime, kPercentiles[x]));
+		fprintf(f, ",%1.4f", GetPercentile(b.wallTime, 100));
+		for (int x = 0; x < 3; x++)
+			fprintf(f, ",%1.4f", GetPercentile(b.cpuTime, kPercentiles[x]));
+		fprintf(f, ",%1.4f\n", GetPercentile(b.cpuTime, 100));
+	}
+}
+
+static void WriteBucketsJSON(FILE *f, std::map<int, BucketSummary> &buckets)
+{
+	fprintf(f, "\"buckets\":[\n");
+	for (std::map<int, BucketSummary>::iterator i = buckets.begin(); i != buckets.end(); i++)
+	{
+		BucketSummary &b = i->second;
+		fprintf(f, "%s{\"bucket\":%d,\"count\":%d,\"solved\":%d,\"suboptimal\":%d,\"mean_ratio\":%1.6f,\"max_ratio\":%1.6f",
+				(i == buckets.begin())?"":",\n", i->first, b.count, b.solved, b.suboptimal, b.solved?b.totalRatio/b.solved:0.0, b.maxRatio);
+		fprintf(f, ",\"expanded\":{\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"max\":%llu}",
+				(unsigned long long)GetPercentile(b.expanded, 50), (unsigned long long)GetPercentile(b.expanded, 90),
+				(unsigned long long)GetPercentile(b.expanded, 99), (unsigned long long)GetPercentile(b.expanded, 100));
+		fprintf(f, ",\"wall_ms\":{\"p50\":%1.4f,\"p90\":%1.4f,\"p99\":%1.4f,\"max\":%1.4f}",
+				GetPercentile(b.wallTime, 50), GetPercentile(b.wallTime, 90), GetPercentile(b.wallTime, 99), GetPercentile(b.wallTime, 100));
+		fprintf(f, ",\"cpu_ms\":{\"p50\":%1.4f,\"p90\":%1.4f,\"p99\":%1.4f,\"max\":%1.4f}}",
+				GetPercentile(b.cpuTime, 50), GetPercentile(b.cpuTime, 90), GetPercentile(b.cpuTime, 99), GetPercentile(b.cpuTime, 100));
+	}
+	fprintf(f, "\n]");
+}
+
+/** Writes s as a JSON string; paths are the only strings written */
+static void WriteJSONString(FILE *f, const char *s)
+{
+	fputc('"', f);
+	for (; *s; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			fputc('\\', f);
+		fputc(*s, f);
+	}
+	fputc('"', f);
+}
+
+void WriteResults(FILE *f, bool json, const std::string &algorithm, const std::vector<std::string> &scenarios,
+				  const std::vector<BenchmarkInstance> &instances, const std::vector<BenchmarkResult> &results,
+				  FILE *summary)
+{
+	std::map<int, BucketSummary> buckets;
+	if (json)
+	{
+		fprintf(f, "{\"algorithm\":");
+		WriteJSONString(f, algorithm.c_str());
+		fprintf(f, ",\n\"instances\":[\n");
+	}
+	else {
+		fprintf(f, "scenario,map,experiment,bucket,algorithm,solved,expanded,touched,length,optimal,ratio,wall_ms,cpu_ms\n");
+	}
+	for (unsigned int x = 0; x < instances.size(); x++)
+	{
+		const Experiment &e = instances[x].experiment;
+		const BenchmarkResult &r = results[x];
+		buckets[e.GetBucket()].Add(e, r);
+		double ratio = (r.solved && e.GetDistance() > 0)?r.length/e.GetDistance():0.0;
+		if (json)
+		{
+			fprintf(f, "%s{\"scenario\":", (x == 0)?"":",\n");
+			WriteJSONString(f, scenarios[instances[x].scenario].c_str());
+			fprintf(f, ",\"map\":");
+			WriteJSONString(f, e.GetMapName());
+			fprintf(f, ",\"experiment\":%d,\"bucket\":%d,\"solved\":%s,\"expanded\":%llu,\"touched\":%llu,\"length\":%1.6f,\"optimal\":%1.6f,\"ratio\":%1.6f,\"wall_ms\":%1.4f,\"cpu_ms\":%1.4f}",
+					instances[x].id, e.GetBucket(), r.solved?"true":"false", (unsigned long long)r.expanded, (unsigned long long)r.touched,
+					r.length, e.GetDistance(), ratio, r.wallTime*1000, r.cpuTime*1000);
+		}
+		else {
+			fprintf(f, "%s,%s,%d,%d,%s,%d,%llu,%llu,%1.6f,%1.6f,%1.6f,%1.4f,%1.4f\n",
+					scenarios[instances[x].scenario].c_str(), e.GetMapName(), instances[x].id, e.GetBucket(), algorithm.c_str(),
+					r.solved?1:0, (unsigned long long)r.expanded, (unsigned long long)r.touched,
+					r.length, e.GetDistance(), ratio, r.wallTime*1000, r.cpuTime*1000);
+		}
+	}
+	for (std::map<int, BucketSummary>::iterator i = buckets.begin(); i != buckets.end(); i++)
+		i->second.Sort();
+	if (json)
+	{
+		fprintf(f, "\n],\n");
+		WriteBucketsJSON(f, buckets);
+		fprintf(f, "}\n");
+	}
+	if (summary)
+		WriteBucketsCSV(summary, algorithm, buckets);
+
+	// a readable summary, which doesn't mix with the results on stdout
+	fprintf(stderr, "%-6s %6s %6s %6s %9s %9s %10s %10s %10s %10s\n", "bucket", "count", "solved", "subopt",
+			"meanRatio", "maxRatio", "exp p50", "exp p99", "ms p50", "ms p99");
+	for (std::map<int, BucketSummary>::iterator i = buckets.begin(); i != buckets.end(); i++)
+	{
+		BucketSummary &b = i->second;
+		fprintf(stderr, "%-6d %6d %6d %6d %9.4f %9.4f %10llu %10llu %10.3f %10.3f\n", i->first, b.count, b.solved,
+				b.suboptimal, b.solved?b.totalRatio/b.solved:0.0, b.maxRatio,
+				(unsigned long long)GetPercentile(b.expanded, 50), (unsigned long long)GetPercentile(b.expanded, 99),
+				GetPercentile(b.wallTime, 50), GetPercentile(b.wallTime, 99));
+	}
+}
+
+static void PrintUsage(const char *name)
+{
+	printf("Usage: %s [options] scenario [scenario ...]\n", name);
+	printf("Solves every experiment of the scenarios and writes the result of each.\n");
+	printf("  -alg <astar|canonical|jps|jps+|hpa|pra>  Algorithm (default astar)\n");
+	printf("  -threads <n>                             Number of threads (default: one per core)\n");
+	printf("  -list <file>                             Read more scenario files from file, one per line\n");
+	printf("  -format <csv|json>                       Output format (default csv)\n");
+	printf("  -out <file>                              Write the results to file instead of stdout\n");
+	printf("  -summary <file>                          Write the per-bucket percentiles as CSV to file;\n");
+	printf("                                           JSON output includes them\n");
+	printf("  -convert                                 Write a binary copy of each scenario and its maps,\n");
+	printf("                                           named <file>.bin, instead of running them\n");
+}
+
+int main(int argc, char* argv[])
+{
+	std::string algorithm = "astar";
+	int numThreads = std::max(1u, std::thread::hardware_concurrency());
+	bool json = false, convert = false;
+	const char *outFile = 0, *summaryFile = 0;
+	std::vector<std::string> scenarios;
+	for (int x = 1; x < argc; x++)
+	{
+		bool hasValue = (x+1 < argc);
+		if (strcmp(argv[x], "-alg") == 0 && hasValue)
+			algorithm = argv[++x];
+		else if (strcmp(argv[x], "-threads") == 0 && hasValue)
+			numThreads = std::max(1, atoi(argv[++x]));
+		else if (strcmp(argv[x], "-format") == 0 && hasValue)
+			json = (strcmp(argv[++x], "json") == 0);
+		else if (strcmp(argv[x], "-out") == 0 && hasValue)
+			outFile = argv[++x];
+		else if (strcmp(argv[x], "-summary") == 0 && hasValue)
+			summaryFile = argv[++x];
+		else if (strcmp(argv[x], "-convert") == 0)
+			convert = true;
+		else if (strcmp(argv[x], "-list") == 0 && hasValue)
+		{
+			FILE *f = fopen(argv[++x], "r");
+			if (f == 0)
+			{
+				printf("Unable to open list '%s'\n", argv[x]);
+				exit(1);
+			}
+			char line[1024];
+			while (fgets(line, sizeof(line), f) != 0)
+			{
+				char *end = line+strlen(line);
+				while (end > line && (end[-1] == '\n' || end[-1] == '\r' || end[-1] == ' '))
+					*(--end) = 0;
+				if (line[0] != 0)
+					scenarios.push_back(line);
+			}
+			fclose(f);
+		}
+		else if (argv[x][0] == '-')
+		{
+			PrintUsage(argv[0]);
+			exit(1);
+		}
+		else
+			scenarios.push_back(argv[x]);
+	}
+	if (scenarios.size() == 0)
+	{
+		PrintUsage(argv[0]);
+		exit(1);
+	}
+	if (convert)
+	{
+		ConvertScenarios(scenarios);
+		return 0;
+	}
+	if (std::find(kAlgorithms, kAlgorithms+kNumAlgorithms, algorithm) == kAlgorithms+kNumAlgorithms)
+	{
+		printf("Unknown algorithm '%s'\n", algorithm.c_str());
+		PrintUsage(argv[0]);
+		exit(1);
+	}
+
+	std::vector<BenchmarkInstance> instances;
+	Timer t;
+	t.StartTimer();
+	LoadScenarios(scenarios, instances);
+	fprintf(stderr, "Loaded %llu experiments in %1.3fs\n", (unsigned long long)instances.size(), t.EndTimer());
+	std::vector<BenchmarkResult> results;
+	t.StartTimer();
+	RunBenchmark(algorithm, instances, numThreads, results);
+	fprintf(stderr, "%s: %llu experiments from %llu scenarios with %d threads in %1.3fs\n", algorithm.c_str(),
+			(unsigned long long)instances.size(), (unsigned long long)scenarios.size(), numThreads, t.EndTimer());
+
+	FILE *out = stdout, *summary = 0;
+	if (outFile != 0 && (out = fopen(outFile, "w")) == 0)
+	{
+		printf("Unable to write '%s'\n", outFile);
+		exit(1);
+	}
+	if (summaryFile != 0 && (summary = fopen(summaryFile, "w")) == 0)
+	{
+		printf("Unable to write '%s'\n", summaryFile);
+		exit(1);
+	}
+	WriteResults(out, json, algorithm, scenarios, instances, results, summary);
+	if (out != stdout)
+		fclose(out);
+	if (summary)
+		fclose(summary);
+	return 0;
+}
@@ -0,0 +1,62 @@
+//
+//  Benchmark.h
+//  hog2
+//
+//  Headless benchmark runner for grid pathfinding scenarios.
+//
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <string>
+#include "ScenarioLoader.h"
+#include "Map.h"
+
+/** The result of solving one experiment */
+struct BenchmarkResult {
+	BenchmarkResult() :solved(false), expanded(0), touched(0), length(0), wallTime(0), cpuTime(0) {}
+	bool solved;
+	uint64_t expanded, touched;
+	double length;
+	// seconds
+	double wallTime, cpuTime;
+};
+
+/**
+ * Solves experiments on one map with one algorithm. Each thread has its
+ * own, with its own copy of the map, so nothing is shared between threads.
+ */
+class GridSearcher {
+public:
+	virtual ~GridSearcher() {}
+	virtual void Solve(const Experiment &e, BenchmarkResult &result) = 0;
+};
+
+/** Returns a searcher that owns m, or null if the algorithm is unknown */
+GridSearcher *MakeGridSearcher(const std::string &algorithm, Map *m);
+
+/** An experiment to run, and the scenario file it came from */
+struct BenchmarkInstance {
+	BenchmarkInstance(int scenario, int id, const Experiment &e) :scenario(scenario), id(id), experiment(e) {}
+	int scenario;
+	int id;
+	Experiment experiment;
+};
+
+/**
+ * Writes <scenario>.bin for each scenario and <map>.bin for each of their
+ * octile maps, which ScenarioLoader and Map load by mapping the file, and
+ * prints how long each takes to load compared to the text files.
+ */
+void ConvertScenarios(const std::vector<std::string> &scenarios);
+void LoadScenarios(const std::vector<std::string> &scenarios, std::vector<BenchmarkInstance> &instances);
+void RunBenchmark(const std::string &algorithm, const std::vector<BenchmarkInstance> &instances,
+				  int numThreads, std::vector<BenchmarkResult> &results);
+void WriteResults(FILE *f, bool json, const std::string &algorithm, const std::vector<std::string> &scenarios,
+				  const std::vector<BenchmarkInstance> &instances, const std::vector<BenchmarkResult> &results,
+				  FILE *summary);
+
+#endif
@@ -43,6 +43,7 @@
 #include "MapGenerators.h"
 #include "FPUtil.h"
 #include "CanonicalGrid.h"
+#include "JPSGrid.h"
 
 bool mouseTracking = false;
 bool runningSearch1 = false;
@@ -149,6 +150,7 @@ void InstallHandlers()
 	InstallKeyboardHandler(MyRandomUnitKeyHandler, "Add simple Unit", "Deploys a right-hand-rule unit", kControlDown, '1');
 	
 	InstallCommandLineHandler(MyCLHandler, "-map", "-map filename", "Selects the default map to be loaded.");
+	InstallCommandLineHandler(MyCLHandler, "-compareJPS", "-compareJPS scenario", "Solve a scenario with A*, canonical A*, JPS and JPS+ and compare them, then exits. The JPS+ jump distances are kept in the map's name followed by .jps");
 
 	InstallWindowHandler(MyWindowHandler);
 	
@@ -298,9 +300,80 @@ int MyCLHandler(char *argument[], int maxNumArgs)
 		strncpy(gDefaultMap, argument[1], 1024);
 		return 2;
 	}
+	else if (strcmp(argument[0], "-compareJPS") == 0)
+	{
+		if (maxNumArgs <= 1)
+			return 0;
+		CompareJPS(argument[1]);
+		exit(0);
+	}
 	return 0;
 }
 
+/**
+ * Solves every experiment in the scenario with the given environment and
+ * reports the nodes expanded and time. Returns the total path length.
+ */
+template <class state, class action, class environment>
+double TimeGridSearch(const char *name, ScenarioLoader &sl, environment *env)
+{
+	TemplateAStar<state, action, environment> search;
+	std::vector<state> thePath;
+	double totalTime = 0, totalLength = 0;
+	uint64_t totalExpanded = 0, totalTouched = 0;
+	Timer t;
+	for (int x = 0; x < sl.GetNumExperiments(); x++)
+	{
+		Experiment e = sl.GetNthExperiment(x);
+		state s(e.GetStartX(), e.GetStartY()), g(e.GetGoalX(), e.GetGoalY());
+		env->StoreGoal(g);
+		t.StartTimer();
+		search.GetPath(env, s, g, thePath);
+		totalTime += t.EndTimer();
+		totalExpanded += search.GetNodesExpanded();
+		totalTouched += search.GetNodesTouched();
+		totalLength += env->GetPathLength(thePath);
+	}
+	printf("%-12s %10llu nodes expanded %10llu touched in %1.3fs; total length %1.2f\n", name,
+		   (unsigned long long)totalExpanded, (unsigned long long)totalTouched, totalTime, totalLength);
+	return totalLength;
+}
+
+/**
+ * Solves a scenario with A*, with A* on the canonical grid, with JPS and
+ * with JPS+, and checks that they find paths of the same length.
+ */
+void CompareJPS(const char *scenario)
+{
+	ScenarioLoader sl(scenario);
+	if (sl.GetNumExperiments() == 0)
+	{
+		printf("No experiments in '%s'\n", scenario);
+		return;
+	}
+	Map *m = new Map(sl.GetNthExperiment(0).GetMapName());
+	MapEnvironment me(m);
+	CanonicalGrid::CanonicalGrid cg(m);
+	CanonicalGrid::JPSGrid jps(m);
+	std::string jumpFile = std::string(sl.GetNthExperiment(0).GetMapName())+".jps";
+	Timer t;
+	t.StartTimer();
+	CanonicalGrid::JPSPlusGrid jpsPlus(m, jumpFile.c_str());
+	printf("JPS+ jump distances %s in %1.3fs\n", jpsPlus.LoadedFromFile()?"loaded":"computed", t.EndTimer());
+
+	std::vector<double> lengths;
+	lengths.push_back(TimeGridSearch<xyLoc, tDirection>("A*", sl, &me));
+	lengths.push_back(TimeGridSearch<CanonicalGrid::xyLoc, CanonicalGrid::tDirection>("Canonical A*", sl, &cg));
+	lengths.push_back(TimeGridSearch<CanonicalGrid::xyLoc, CanonicalGrid::tDirection>("JPS", sl, &jps));
+	lengths.push_back(TimeGridSearch<CanonicalGrid::xyLoc, CanonicalGrid::tDirection>("JPS+", sl, &jpsPlus));
+	for (unsigned int x = 1; x < lengths.size(); x++)
+	{
+		if (!fequal(lengths[0], lengths[x]))
+			printf("Error: total path length differs (%f vs %f)\n", lengths[0], lengths[x]);
+	}
+	delete m;
+}
+
 void MyDisplayHandler(unsigned long windowID, tKeyboardModifier mod, char key)
 {
 	switch (key)
@@ -826,19 +826,22 @@ pthread_mutex_t writeLock = PTHREAD_MUTEX_INITIALIZER;
 int64_t solvable;
 int64_t uniqueSolvable;
 
+/**
+ * Marks the boards with currSize pieces that are solvable, and uniquely
+ * solvable, from the tables for fewer pieces. Threads take every THREADS'th
+ * rank and set their bits in the shared tables atomically, so the lock is
+ * only taken to add up the counts at the end.
+ */
 void *ThreadedWorker(void *arg)
 {
 	int id = (long)arg;
 	int64_t solved = 0;
 	int64_t uniqueSolved = 0;
+	int64_t lastUnique = -1;
 	FlingBoard currState, tmp;
 	std::vector<FlingBoard> succ;
 	std::vector<FlingMove> acts;
 
-	std::vector<int64_t> buffer;
-	std::vector<int64_t> uniqueBuffer;
-	buffer.reserve(4*1024+100);
-	uniqueBuffer.reserve(4*1024+100);
 	for (int64_t val = id; val < f.getMaxSinglePlayerRank(56, currSize); val+=THREADS)
 	{
 		f.unrankPlayer(val, currSize, currState);
@@ -848,9 +851,9 @@ void *ThreadedWorker(void *arg)
 		{
 			if (acts.size() > 0)
 			{
-				buffer.push_back(val);
-				uniqueBuffer.push_back(val);
-				//table[currSize][val] = true;
+				table[currSize]->AtomicSetTrue(val);
+				unique[currSize]->AtomicSetTrue(val);
+				lastUnique = val;
 				solved++;
 				uniqueSolved++;
 			}
@@ -872,12 +875,13 @@ void *ThreadedWorker(void *arg)
 				}
 			}
 			if (cnt > 0) {
-				buffer.push_back(val);
+				table[currSize]->AtomicSetTrue(val);
 				solved++;
 			}
 			if (cnt == 1 && uniqueCnt == 1)
 			{
-				uniqueBuffer.push_back(val);
+				unique[currSize]->AtomicSetTrue(val);
+				lastUnique = val;
 				uniqueSolved++;
 //				pthread_mutex_lock (&writeLock);
 //				std::cout << currState << std::endl;
@@ -887,39 +891,11 @@ void *ThreadedWorker(void *arg)
 //				pthread_mutex_unlock(&writeLock);
 			}
 		}
-		// flush buffer
-		if (buffer.size() > 4*1024)
-		{
-			pthread_mutex_lock (&writeLock);
-			while (buffer.size() > 0)
-			{
-				table[currSize]->Set(buffer.back(), true);// = true;
-				buffer.pop_back();
-			}
-			while (uniqueBuffer.size() > 0)
-			{
-				unique[currSize]->Set(uniqueBuffer.back(), true);// = true;
-				uniqueBuffer.pop_back();
-			}
-			pthread_mutex_unlock(&writeLock);
-		}
 	}
 
 	pthread_mutex_lock (&writeLock);
-	while (buffer.size() > 0)
-	{
-		table[currSize]->Set(buffer.back(), true);
-		buffer.pop_back();
-	}
-	while (uniqueBuffer.size() > 0)
-	{
-		unique[currSize]->Set(uniqueBuffer.back(), true);// = true;
-		if (uniqueBuffer.size() == 1)
-		{
-			f.unrankPlayer(uniqueBuffer.back(), currSize, b);
-		}
-		uniqueBuffer.pop_back();
-	}
+	if (lastUnique != -1)
+		f.unrankPlayer(lastUnique, currSize, b);
 	solvable += solved;
 	uniqueSolvable += uniqueSolved;
 	pthread_mutex_unlock(&writeLock);
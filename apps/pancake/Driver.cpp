@@ -32,10 +32,12 @@
 #include "Plot2D.h"
 #include "RandomUnit.h"
 #include "PancakePuzzle.h"
+#include "FixedPancakePuzzle.h"
 #include "IDAStar.h"
 #include "Timer.h"
 
 void CompareToMinCompression();
+void ComparePackedPDB(const char *dir);
 void CompareToSmallerPDB();
 
 void BuildTS_PDB(unsigned long windowID, tKeyboardModifier , char);
@@ -95,6 +97,7 @@ void InstallHandlers()
 	InstallKeyboardHandler(BuildTS_PDB, "Build TS PDBs", "Build PDBs for the TS", kNoModifier, 'a');
 
 	InstallCommandLineHandler(MyCLHandler, "-run", "-run", "Runs pre-set experiments.");
+	InstallCommandLineHandler(MyCLHandler, "-comparePackedPDB", "-comparePackedPDB [dir]", "Compare 8, 4 and 2-bit 14-pancake PDBs (written to dir) in size and IDA* speed.");
 	
 	InstallWindowHandler(MyWindowHandler);
 
@@ -141,6 +144,11 @@ void MyFrameHandler(unsigned long windowID, unsigned int viewport, void *)
 
 int MyCLHandler(char *argument[], int maxNumArgs)
 {
+	if (strcmp(argument[0], "-comparePackedPDB") == 0)
+	{
+		ComparePackedPDB((maxNumArgs > 1)?argument[1]:".");
+		exit(0);
+	}
 	BuildTS_PDB(0, kNoModifier, 'a');
 	exit(0);
 	return 2;
@@ -989,3 +997,78 @@ PancakePuzzleState GetInstance(int which)
 	return s;
 }
 
+/**
+ * Builds the same 14-pancake PDB with 8, 4 and 2-bit entries, checks that
+ * the packed entries match the 8-bit ones, and times IDA* with each.
+ */
+void ComparePackedPDB(const char *dir)
+{
+	const int N = 14;
+	typedef FixedPancakePuzzleState<N> PancakeState;
+	std::vector<int> pattern = {0, 1, 2, 3, 4, 5, 6};
+	const int bits[3] = {8, 4, 2};
+	FixedPancakePuzzle<N> pancake[3];
+	PancakeState g;
+	for (int x = 0; x < 3; x++)
+	{
+		char name[255];
+		sprintf(name, "%s/pancake_%dbit.pdb", dir, bits[x]);
+		PancakeState start(g);
+		Timer t;
+		t.StartTimer();
+		pancake[x].Build_PDB(start, pattern, name, 1, false, bits[x]);
+		t.EndTimer();
+		// reload, so that the lookups below are on the mapped file
+		pancake[x].ClearPDBs();
+		pancake[x].Load_Regular_PDB(name, g, false);
+		printf("%d-bit PDB: %llu bytes, built in %1.2fs, checksum %s\n", bits[x],
+			   (unsigned long long)pancake[x].PDB[0].Bytes(), t.GetElapsedTime(),
+			   pancake[x].Check_PDB_File(name)?"ok":"failed");
+	}
+	
+	const PDBEntries &full = pancake[0].PDB[0];
+	for (uint64_t x = 0; x < full.size(); x++)
+	{
+		if (pancake[1].PDB[0].Get(x) != std::min(full[x], (uint8_t)15) ||
+			pancake[2].PDB[0].Get(x) != full[x]%3)
+		{
+			printf("Error: packed entry %llu differs\n", (unsigned long long)x);
+			break;
+		}
+	}
+	
+	srandom(14);
+	std::vector<PancakeState> instances(25);
+	for (unsigned int x = 0; x < instances.size(); x++)
+	{
+		std::vector<int> p = FixedPancakePuzzle<N>::Get_Random_Permutation(N);
+		for (int y = 0; y < N; y++)
+			instances[x].puzzle[y] = p[y];
+		uint64_t rank = pancake[0].GetPDBHash(instances[x], pattern);
+		if (pancake[2].GetMod3PDBValue(0, instances[x]) != full[rank])
+			printf("Error: instance %d decodes to %1.0f instead of %d\n", x,
+				   pancake[2].GetMod3PDBValue(0, instances[x]), full[rank]);
+	}
+	
+	std::vector<size_t> length(instances.size());
+	for (int x = 0; x < 3; x++)
+	{
+		IDAStar<PancakeState, PancakePuzzleAction> ida;
+		std::vector<PancakeState> path;
+		uint64_t nodes = 0;
+		Timer t;
+		t.StartTimer();
+		for (unsigned int y = 0; y < instances.size(); y++)
+		{
+			ida.GetPath(&pancake[x], instances[y], g, path);
+			nodes += ida.GetNodesExpanded();
+			if (x == 0)
+				length[y] = path.size();
+			else if (path.size() != length[y])
+				printf("Error: instance %d solution differs\n", y);
+		}
+		t.EndTimer();
+		printf("%d-bit IDA* %llu nodes expanded, %1.3fs (%1.0f nodes/sec)\n", bits[x], (unsigned long long)nodes,
+			   t.GetElapsedTime(), nodes/t.GetElapsedTime());
+	}
+}
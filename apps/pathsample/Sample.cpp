@@ -33,10 +33,14 @@
 #include "RandomUnits.h"
 #include "AStar.h"
 #include "TemplateAStar.h"
+#include "DAryOpenClosed.h"
 #include "GraphEnvironment.h"
 #include "MapSectorAbstraction.h"
 //#include "ContractionHierarchy.h"
 #include "MapGenerators.h"
+#include "ScenarioLoader.h"
+#include "Timer.h"
+#include "GridDifferentialHeuristic.h"
 
 bool mouseTracking = false;
 bool runningSearch1 = false;
@@ -118,6 +122,9 @@ void InstallHandlers()
 	InstallCommandLineHandler(MyCLHandler, "-map", "-map filename", "Selects the default map to be loaded.");
 	InstallCommandLineHandler(MyCLHandler, "-convert", "-map file1 file2", "Converts a map and saves as file2, then exits");
 	InstallCommandLineHandler(MyCLHandler, "-size", "-batch integer", "If size is set, we create a square maze with the x and y dimensions specified.");
+	InstallCommandLineHandler(MyCLHandler, "-compareOpenClosed", "-compareOpenClosed scenario", "Time A* with each open/closed list implementation on a scenario, then exits");
+	InstallCommandLineHandler(MyCLHandler, "-compareSuccessors", "-compareSuccessors scenario", "Check and time successor generation with and without the bit grid on a scenario, then exits");
+	InstallCommandLineHandler(MyCLHandler, "-compareDH", "-compareDH scenario [pivots] [threads]", "Compare A* with the octile and a differential heuristic (default 16 pivots) on a scenario, then exits");
 
 	
 	InstallWindowHandler(MyWindowHandler);
@@ -287,9 +294,250 @@ int MyCLHandler(char *argument[], int maxNumArgs)
 		assert( mazeSize > 0 );
 		return 2;
 	}
+	else if (strcmp(argument[0], "-compareOpenClosed") == 0)
+	{
+		if (maxNumArgs <= 1)
+			return 0;
+		CompareOpenClosed(argument[1]);
+		exit(0);
+	}
+	else if (strcmp(argument[0], "-compareSuccessors") == 0)
+	{
+		if (maxNumArgs <= 1)
+			return 0;
+		CompareSuccessors(argument[1]);
+		exit(0);
+	}
+	else if (strcmp(argument[0], "-compareDH") == 0)
+	{
+		if (maxNumArgs <= 1)
+			return 0;
+		int pivots = (maxNumArgs > 2)?atoi(argument[2]):16;
+		int threads = (maxNumArgs > 3)?atoi(argument[3]):std::thread::hardware_concurrency();
+		CompareDifferentialHeuristic(argument[1], pivots, threads);
+		exit(0);
+	}
 	return 2; //ignore typos
 }
 
+/**
+ * Solves every experiment in the scenario with the given open list and
+ * reports the total time and expansion rate. Returns the total path length
+ * so that the variants can be checked against each other.
+ */
+template <class openList>
+double TimeOpenClosed(const char *name, ScenarioLoader &sl, MapEnvironment *env, size_t expectedNodes)
+{
+	TemplateAStar<xyLoc, tDirection, MapEnvironment, openList> astar;
+	astar.SetExpectedNodeCount(expectedNodes);
+	std::vector<xyLoc> thePath;
+	double totalTime = 0, totalLength = 0;
+	uint64_t totalNodes = 0;
+	Timer t;
+	for (int x = 0; x < sl.GetNumExperiments(); x++)
+	{
+		Experiment e = sl.GetNthExperiment(x);
+		xyLoc s1(e.GetStartX(), e.GetStartY());
+		xyLoc g1(e.GetGoalX(), e.GetGoalY());
+
+		t.StartTimer();
+		astar.GetPath(env, s1, g1, thePath);
+		totalTime += t.EndTimer();
+		totalNodes += astar.GetNodesExpanded();
+		totalLength += env->GetPathLength(thePath);
+	}
+	printf("%-20s %llu nodes expanded in %1.3fs (%1.0f nodes/sec); %d-byte records, %lluKB allocated\n", name,
+		   (unsigned long long)totalNodes, totalTime, totalNodes/totalTime,
+		   (int)sizeof(typename openList::dataType), (unsigned long long)astar.GetMemoryBytes()/1024);
+	return totalLength;
+}
+
+/**
+ * Runs every experiment in the scenario with each of the open/closed list
+ * implementations and reports the time for each.
+ */
+void CompareOpenClosed(const char *scenario)
+{
+	ScenarioLoader sl(scenario);
+	if (sl.GetNumExperiments() == 0)
+	{
+		printf("No experiments in '%s'\n", scenario);
+		return;
+	}
+	Map *m = new Map(sl.GetNthExperiment(0).GetMapName());
+	MapEnvironment env(m);
+	// one search can touch at most every cell
+	size_t cells = m->GetMapWidth()*m->GetMapHeight();
+
+	std::vector<double> lengths;
+	lengths.push_back(TimeOpenClosed<AStarOpenClosed<xyLoc, AStarCompare<xyLoc> > >("binary/hash_map", sl, &env, cells));
+	lengths.push_back(TimeOpenClosed<AStarOpenClosed<xyLoc, AStarCompare<xyLoc>, AStarOpenClosedData<xyLoc>, FlatIndexTable> >("binary/flat", sl, &env, cells));
+	lengths.push_back(TimeOpenClosed<DAryOpenClosed<xyLoc, 2, AStarOpenClosedData<xyLoc>, FlatIndexTable> >("2-ary keyed/flat", sl, &env, cells));
+	lengths.push_back(TimeOpenClosed<DAryOpenClosed<xyLoc, 4, AStarOpenClosedData<xyLoc>, FlatIndexTable> >("4-ary keyed/flat", sl, &env, cells));
+	lengths.push_back(TimeOpenClosed<DAryOpenClosed<xyLoc, 8, AStarOpenClosedData<xyLoc>, FlatIndexTable> >("8-ary keyed/flat", sl, &env, cells));
+	lengths.push_back(TimeOpenClosed<BucketOpenClosed<xyLoc, AStarCompare<xyLoc>, AStarOpenClosedData<xyLoc>, FlatIndexTable> >("bucket/flat", sl, &env, cells));
+	lengths.push_back(TimeOpenClosed<AStarOpenClosed<xyLoc, AStarCompare<xyLoc>, AStarOpenClosedCompactData<xyLoc>, FlatIndexTable> >("binary/flat compact", sl, &env, cells));
+	lengths.push_back(TimeOpenClosed<BucketOpenClosed<xyLoc, AStarCompare<xyLoc>, AStarOpenClosedCompactData<xyLoc>, FlatIndexTable> >("bucket/flat compact", sl, &env, cells));
+	for (unsigned int x = 1; x < lengths.size(); x++)
+	{
+		if (!fequal(lengths[0], lengths[x]))
+			printf("Error: total path length differs (%f vs %f)\n", lengths[0], lengths[x]);
+	}
+	delete m;
+}
+
+/**
+ * Checks that MapEnvironment generates the same successors and actions, in
+ * the same order, for every cell of the scenario's map with and without the
+ * bit grid, then times generating the successors of every cell and solving
+ * the scenario each way.
+ */
+void CompareSuccessors(const char *scenario)
+{
+	ScenarioLoader sl(scenario);
+	if (sl.GetNumExperiments() == 0)
+	{
+		printf("No experiments in '%s'\n", scenario);
+		return;
+	}
+	Map *m = new Map(sl.GetNthExperiment(0).GetMapName());
+	MapEnvironment env(m);
+	std::vector<xyLoc> grid, plain;
+	std::vector<tDirection> gridActs, plainActs;
+	int errors = 0;
+	for (int conn = 0; conn < 2; conn++)
+	{
+		if (conn == 0)
+			env.SetEightConnected();
+		else
+			env.SetFourConnected();
+		for (long y = 0; y < m->GetMapHeight(); y++)
+		{
+			for (long x = 0; x < m->GetMapWidth(); x++)
+			{
+				xyLoc l(x, y);
+				env.SetUseBitGrid(true);
+				env.GetSuccessors(l, grid);
+				gridActs.resize(0);
+				env.GetActions(l, gridActs);
+				env.SetUseBitGrid(false);
+				env.GetSuccessors(l, plain);
+				plainActs.resize(0);
+				env.GetActions(l, plainActs);
+				if (grid != plain || gridActs != plainActs)
+				{
+					if (errors < 10)
+						printf("Error: successors of (%ld, %ld) differ\n", x, y);
+					errors++;
+				}
+			}
+		}
+	}
+	env.SetEightConnected();
+	printf("%d cells with different successors\n", errors);
+
+	size_t cells = m->GetMapWidth()*m->GetMapHeight();
+	std::vector<double> lengths;
+	Timer t;
+	for (int useGrid = 0; useGrid < 2; useGrid++)
+	{
+		env.SetUseBitGrid(useGrid);
+		uint64_t total = 0;
+		t.StartTimer();
+		for (int rep = 0; rep < 10; rep++)
+		{
+			for (long y = 0; y < m->GetMapHeight(); y++)
+			{
+				for (long x = 0; x < m->GetMapWidth(); x++)
+				{
+					env.GetSuccessors(xyLoc(x, y), grid);
+					total += grid.size();
+				}
+			}
+		}
+		double elapsed = t.EndTimer();
+		printf("%-20s %llu successors in %1.3fs (%1.0f cells/sec)\n", useGrid?"bit grid":"CanStep",
+			   (unsigned long long)total, elapsed, 10*cells/elapsed);
+		lengths.push_back(TimeOpenClosed<AStarOpenClosed<xyLoc, AStarCompare<xyLoc>, AStarOpenClosedData<xyLoc>, FlatIndexTable> >(useGrid?"A* bit grid":"A* CanStep", sl, &env, cells));
+	}
+	if (!fequal(lengths[0], lengths[1]))
+		printf("Error: total path length differs (%f vs %f)\n", lengths[0], lengths[1]);
+	delete m;
+}
+
+/**
+ * Builds a GridDifferentialHeuristic for the scenario's map, times its
+ * lookups, then solves the scenario with it and with the octile heuristic
+ * and checks that the path lengths match.
+ */
+void CompareDifferentialHeuristic(const char *scenario, int numPivots, int numThreads)
+{
+	ScenarioLoader sl(scenario);
+	if (sl.GetNumExperiments() == 0)
+	{
+		printf("No experiments in '%s'\n", scenario);
+		return;
+	}
+	Map *m = new Map(sl.GetNthExperiment(0).GetMapName());
+	MapEnvironment env(m);
+	Timer t;
+	t.StartTimer();
+	GridDifferentialHeuristic dh(&env, numPivots, numThreads);
+	printf("Built %d pivots with %d threads in %1.3fs; %lluKB, step %f\n", dh.GetNumPivots(), numThreads,
+		   t.EndTimer(), (unsigned long long)dh.GetMemoryUsage()/1024, dh.GetScale());
+
+	// lookups between the starts and goals of the scenario
+	double total = 0;
+	const int kRepetitions = 1000;
+	t.StartTimer();
+	for (int rep = 0; rep < kRepetitions; rep++)
+	{
+		for (int x = 0; x < sl.GetNumExperiments(); x++)
+		{
+			Experiment e = sl.GetNthExperiment(x);
+			total += dh.GetDifferentialHCost(xyLoc(e.GetStartX(), e.GetStartY()), xyLoc(e.GetGoalX(), e.GetGoalY()));
+		}
+	}
+	double elapsed = t.EndTimer();
+	printf("%1.0f lookups/sec (mean h %f)\n", kRepetitions*sl.GetNumExperiments()/elapsed,
+		   total/(kRepetitions*sl.GetNumExperiments()));
+
+	TemplateAStar<xyLoc, tDirection, MapEnvironment> astar;
+	// the quantized heuristic can be slightly inconsistent
+	astar.SetReopenNodes(true);
+	std::vector<xyLoc> thePath;
+	std::vector<double> lengths[2];
+	for (int useDH = 0; useDH < 2; useDH++)
+	{
+		astar.SetHeuristic(useDH?(Heuristic<xyLoc> *)&dh:&env);
+		uint64_t totalNodes = 0;
+		double totalTime = 0;
+		for (int x = 0; x < sl.GetNumExperiments(); x++)
+		{
+			Experiment e = sl.GetNthExperiment(x);
+			t.StartTimer();
+			astar.GetPath(&env, xyLoc(e.GetStartX(), e.GetStartY()), xyLoc(e.GetGoalX(), e.GetGoalY()), thePath);
+			totalTime += t.EndTimer();
+			totalNodes += astar.GetNodesExpanded();
+			lengths[useDH].push_back(env.GetPathLength(thePath));
+		}
+		printf("%-20s %llu nodes expanded in %1.3fs\n", useDH?"A* differential":"A* octile",
+			   (unsigned long long)totalNodes, totalTime);
+	}
+	int errors = 0;
+	for (unsigned int x = 0; x < lengths[0].size(); x++)
+	{
+		if (!fequal(lengths[0][x], lengths[1][x]))
+		{
+			if (errors < 10)
+				printf("Error: experiment %d path length differs (%f vs %f)\n", x, lengths[0][x], lengths[1][x]);
+			errors++;
+		}
+	}
+	printf("%d experiments with different path lengths\n", errors);
+	delete m;
+}
+
 void MyDisplayHandler(unsigned long windowID, tKeyboardModifier mod, char key)
 {
 	switch (key)
@@ -33,3 +33,6 @@ void MyRandomUnitKeyHandler(unsigned long windowID, tKeyboardModifier, char key)
 int MyCLHandler(char *argument[], int maxNumArgs);
 bool MyClickHandler(unsigned long windowID, int x, int y, point3d loc, tButtonType, tMouseEventType);
 void InstallHandlers();
+void CompareOpenClosed(const char *scenario);
+void CompareSuccessors(const char *scenario);
+void CompareDifferentialHeuristic(const char *scenario, int numPivots, int numThreads);
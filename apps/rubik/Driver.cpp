@@ -45,6 +45,11 @@
 #include <string>
 #include "BitVector.h"
 #include "MinBloom.h"
+#include "BlockedBloom.h"
+#include "RubikPDBBuilder.h"
+#include <random>
+#include <thread>
+#include <mutex>
 #include <deque>
 
 RubiksCube c;
@@ -106,6 +111,11 @@ void InstallHandlers()
 	InstallCommandLineHandler(MyCLHandler, "-testCompression", "-testCompression <factor> <type> <edgepdb> <cornerpdb>", "");
 	InstallCommandLineHandler(MyCLHandler, "-compress", "-compress <type [corner,n-edge,edge]> <input> <factor> <output>", "Compress provided pdb by a factor of <factor>");
 	InstallCommandLineHandler(MyCLHandler, "-pdb", "-pdb <edge> <corner>", "Run tests using edge and corner pdbs");
+	InstallCommandLineHandler(MyCLHandler, "-compareBloom", "-compareBloom <#items> <bits/item> <#hash>", "Compare the false positive rate and speed of the Bloom filters and the blocked Bloom filters");
+	InstallCommandLineHandler(MyCLHandler, "-testAtomicArrays", "-testAtomicArrays <#threads>", "Check and time lock-free updates to a FourBitArray and BitVector from many threads");
+	InstallCommandLineHandler(MyCLHandler, "-buildPDB", "-buildPDB <corner|edge7|edge> <factor> <min|interleave> <#threads> <output>", "Build a pdb with many threads, compressing it by <factor> as it is built");
+	InstallCommandLineHandler(MyCLHandler, "-testHCostCache", "-testHCostCache <cornerpdb> <walk length> <cache bits>", "Check the cube symmetries and time IDA* with and without the HCost cache");
+	InstallCommandLineHandler(MyCLHandler, "-testDiskIO", "-testDiskIO <prefix>", "Time scans of disk bucket files with synchronous and asynchronous I/O");
 	
 	InstallWindowHandler(MyWindowHandler);
 
@@ -206,6 +216,11 @@ void BuildDepthBloomFilter(int size, float space, int numHash, const char *dataL
 void GetBloomStats(uint64_t size, int hash, const char *prefix);
 void BuildMinBloomFilter(float space, int numHash, int finalDepth, const char *dataLoc);
 void GetActionsFromStdin(std::vector<RubiksAction> &acts);
+void TestDiskBitFileIO(const char *prefix);
+void CompareBloomFilters(uint64_t numItems, int bitsPerItem, int numHash);
+void TestAtomicArrays(int numThreads);
+void BuildPDBInParallel(const char *pdbType, int factor, const char *compression, int numThreads, const char *outFile);
+void TestHCostCache(const char *cornerPDB, int walkLength, int cacheBits);
 
 int MyCLHandler(char *argument[], int maxNumArgs)
 {
@@ -317,6 +332,31 @@ int MyCLHandler(char *argument[], int maxNumArgs)
 		GetBloomStats(strtoull(argument[1], 0, 10), strtol(argument[2], 0, 10), argument[3]);
 		exit(0);
 	}
+	else if (strcmp(argument[0], "-compareBloom") == 0 && maxNumArgs > 3)
+	{
+		CompareBloomFilters(strtoull(argument[1], 0, 10), atoi(argument[2]), atoi(argument[3]));
+		exit(0);
+	}
+	else if (strcmp(argument[0], "-testAtomicArrays") == 0 && maxNumArgs > 1)
+	{
+		TestAtomicArrays(atoi(argument[1]));
+		exit(0);
+	}
+	else if (strcmp(argument[0], "-buildPDB") == 0 && maxNumArgs > 5)
+	{
+		BuildPDBInParallel(argument[1], atoi(argument[2]), argument[3], atoi(argument[4]), argument[5]);
+		exit(0);
+	}
+	else if (strcmp(argument[0], "-testHCostCache") == 0 && maxNumArgs > 3)
+	{
+		TestHCostCache(argument[1], atoi(argument[2]), atoi(argument[3]));
+		exit(0);
+	}
+	else if (strcmp(argument[0], "-testDiskIO") == 0 && maxNumArgs > 1)
+	{
+		TestDiskBitFileIO(argument[1]);
+		exit(0);
+	}
 	//	strncpy(gDefaultMap, argument[1], 1024);
 	return 2;
 }
@@ -483,7 +523,7 @@ void Compress(const char *pdbType, const char *theFile, const char *compressType
 		totalSize = (totalSize+ratio-1)/ratio;
 		b.Resize(totalSize);
 		
-		DiskBitFile f(theFile);
+		DiskBitFile f(theFile, true);
 
 		uint64_t avgReg = 0;
 		uint64_t avgComp = 0;
@@ -563,7 +603,7 @@ void Compress(const char *pdbType, const char *theFile, const char *compressType
 		totalSize = (totalSize+ratio-1)/ratio;
 		b.Resize(totalSize);
 		
-		DiskBitFile f(theFile);
+		DiskBitFile f(theFile, true);
 		
 		uint64_t avgReg = 0;
 		uint64_t avgComp = 0;
@@ -643,7 +683,7 @@ void Compress(const char *pdbType, const char *theFile, const char *compressType
 		totalSize = (totalSize+ratio-1)/ratio;
 		b.Resize(totalSize);
 		
-		DiskBitFile f(theFile);
+		DiskBitFile f(theFile, true);
 
 		uint64_t avgReg = 0;
 		uint64_t avgComp = 0;
@@ -750,7 +790,7 @@ void ManyCompression()
 	}
 	//b.Resize(totalSize);
 	
-	DiskBitFile f("/data/cc/rubik/res/RC");
+	DiskBitFile f("/data/cc/rubik/res/RC", true);
 
 	
 	printf("Performing min compression\n"); fflush(stdout);
@@ -817,7 +857,7 @@ void LoadCornerPDB()
 		totalSize += buckets[x].theSize;
 	b.Resize(totalSize);
 	//mem = new uint8_t[totalSize];
-	DiskBitFile f("/home/sturtevant/sturtevant/code/cc/rubik/RC");
+	DiskBitFile f("/home/sturtevant/sturtevant/code/cc/rubik/RC", true);
 	
 	int64_t index = 0;
 	for (unsigned int x = 0; x < data.size(); x++)
@@ -851,7 +891,7 @@ void LoadEdgePDB(uint64_t sizeLimit)
 
 	b.Resize((totalSize+sizeLimit-1)/sizeLimit);
 	//DiskBitFile f("/data/cc/rubik/final/RC");
-	DiskBitFile f("/store/rubik/RC");
+	DiskBitFile f("/store/rubik/RC", true);
 	int64_t index = 0;
 	for (unsigned int x = 0; x < data.size(); x++)
 	{
@@ -889,7 +929,7 @@ void LoadEdgePDBOLD(uint64_t sizeLimit)
 		totalSize = sizeLimit;
 	//mem = new uint8_t[totalSize];
 	b.Resize(totalSize);
-	DiskBitFile f("/data/cc/rubik/final/RC");
+	DiskBitFile f("/data/cc/rubik/final/RC", true);
 	//DiskBitFile f("/store/rubik/RC");
 	int64_t index = 0;
 	for (unsigned int x = 0; x < data.size(); x++)
@@ -1782,7 +1822,7 @@ void MeasurePDBCompression(int itemsCompressed)
 	int64_t totalSize = 0;
 
 	//DiskBitFile f("/data/cc/rubik/final/RC");
-	DiskBitFile f("/store/rubik/RC");
+	DiskBitFile f("/store/rubik/RC", true);
 	int64_t index = 0;
 	int64_t records[20];
 	int64_t averageFirst[20];
@@ -1880,7 +1920,7 @@ void ExtractStatesAtDepth(const char *theFile)
 	InitTwoPieceData<RubikEdge, RubikEdgeState>(data, maxBuckSize);
 	InitBucketSize<RubikEdge, RubikEdgeState>(buckets, maxBuckSize);
 	
-	DiskBitFile f(theFile);
+	DiskBitFile f(theFile, true);
 	
 	uint64_t entry = 0;
 	for (int x = 0; x < 10; x++)
@@ -2185,3 +2225,400 @@ void GetSuperFlip(RubiksState &start)
 		c.ApplyAction(start, act);
 	}
 }
+
+/**
+ * Times a pass that reads and rewrites every depth in a set of bucket files,
+ * as the disk-based PDB builds do, with synchronous and then asynchronous
+ * I/O, and checks the depths each pass leaves.
+ */
+void TestDiskBitFileIO(const char *prefix)
+{
+	const int numBuckets = 8;
+	const int64_t bucketSize = 1ll<<27;
+	std::vector<bucketData> buckets(numBuckets);
+	for (int x = 0; x < numBuckets; x++)
+		buckets[x].theSize = bucketSize;
+	{
+		DiskBitFile f(prefix);
+		f.Init(buckets);
+	}
+
+	for (int pass = 1; pass <= 2; pass++)
+	{
+		bool async = (pass == 2);
+		Timer t;
+		t.StartTimer();
+		{
+			DiskBitFile f(prefix, async);
+			for (int x = 0; x < numBuckets; x++)
+			{
+				for (int64_t y = 0; y < bucketSize; y++)
+				{
+					int val = f.ReadFileDepth(x, y);
+					// stands in for the work done on each state
+					uint64_t h = y;
+					for (int z = 0; z < 4; z++)
+						h = (h^(h>>29))*0xBF58476D1CE4E5B9ull;
+					f.WriteFileDepth(x, y, (val+h)&0xF);
+				}
+			}
+			f.WriteFileDepth(-1, 0, 0);
+			t.EndTimer();
+			printf("%s: %1.2fs; ", async?"Asynchronous":"Synchronous", t.GetElapsedTime());
+			f.PrintIOStats();
+		}
+
+		// every depth started at 0xF and has had h added once per pass
+		DiskBitFile f(prefix);
+		int64_t errors = 0;
+		for (int x = 0; x < numBuckets; x++)
+		{
+			for (int64_t y = 0; y < bucketSize; y++)
+			{
+				uint64_t h = y;
+				for (int z = 0; z < 4; z++)
+					h = (h^(h>>29))*0xBF58476D1CE4E5B9ull;
+				if (f.ReadFileDepth(x, y) != (int)((0xF+pass*h)&0xF))
+					errors++;
+			}
+		}
+		if (errors != 0)
+			printf("Error: %lld depths are wrong after pass %d\n", (long long)errors, pass);
+	}
+}
+
+/**
+ * Compares BloomFilter and MinBloomFilter with the blocked filters, each
+ * with the same power of two number of bits: the false positive rates, and
+ * the time to insert items and to look them up, one at a time and, for the
+ * blocked filters, in batches.
+ */
+void CompareBloomFilters(uint64_t numItems, int bitsPerItem, int numHash)
+{
+	const int batchSize = 1024;
+	uint64_t filterBits = 1;
+	while (filterBits < numItems*bitsPerItem)
+		filterBits *= 2;
+	printf("%llu items, %llu bits (%1.2f per item), %d hashes\n", (unsigned long long)numItems, (unsigned long long)filterBits, (double)filterBits/numItems, numHash);
+
+	std::mt19937_64 r(1234);
+	std::vector<uint64_t> items(numItems), others(numItems);
+	std::vector<int> depths(numItems);
+	for (uint64_t x = 0; x < numItems; x++)
+	{
+		items[x] = r();
+		others[x] = r();
+		depths[x] = r()%14;
+	}
+	bool batchFound[batchSize];
+	int batchDepths[batchSize];
+	Timer t;
+
+	{
+		BloomFilter b(filterBits, numHash, false);
+		t.StartTimer();
+		for (uint64_t x = 0; x < numItems; x++)
+			b.Insert(items[x]);
+		double insertTime = t.EndTimer();
+		t.StartTimer();
+		uint64_t hits = 0, falsePositives = 0;
+		for (uint64_t x = 0; x < numItems; x++)
+		{
+			hits += b.Contains(items[x]);
+			falsePositives += b.Contains(others[x]);
+		}
+		double lookupTime = t.EndTimer();
+		printf("BloomFilter: insert %1.3fs, lookup %1.3fs; %llu of %llu found, %1.4f%% false positives\n",
+			   insertTime, lookupTime, (unsigned long long)hits, (unsigned long long)numItems, 100.0*falsePositives/numItems);
+	}
+	{
+		BlockedBloomFilter b(filterBits, numHash);
+		t.StartTimer();
+		for (uint64_t x = 0; x < numItems; x++)
+			b.Insert(items[x]);
+		double insertTime = t.EndTimer();
+		t.StartTimer();
+		uint64_t hits = 0, falsePositives = 0;
+		for (uint64_t x = 0; x < numItems; x++)
+		{
+			hits += b.Contains(items[x]);
+			falsePositives += b.Contains(others[x]);
+		}
+		double lookupTime = t.EndTimer();
+		t.StartTimer();
+		uint64_t batchHits = 0, batchFalsePositives = 0;
+		for (uint64_t x = 0; x < numItems; x += batchSize)
+		{
+			int count = std::min((uint64_t)batchSize, numItems-x);
+			b.Contains(&items[x], count, batchFound);
+			batchHits += std::count(batchFound, batchFound+count, true);
+			b.Contains(&others[x], count, batchFound);
+			batchFalsePositives += std::count(batchFound, batchFound+count, true);
+		}
+		double batchTime = t.EndTimer();
+		printf("BlockedBloomFilter: insert %1.3fs, lookup %1.3fs, batch %1.3fs; %llu of %llu found, %1.4f%% false positives\n",
+			   insertTime, lookupTime, batchTime, (unsigned long long)hits, (unsigned long long)numItems, 100.0*falsePositives/numItems);
+		if (batchHits != hits || batchFalsePositives != falsePositives)
+			printf("Error: batch lookups disagree with single lookups\n");
+	}
+
+	// the min filters have 4-bit entries, so they get a quarter as many
+	{
+		MinBloomFilter b(filterBits/4, numHash, false);
+		t.StartTimer();
+		for (uint64_t x = 0; x < numItems; x++)
+			b.Insert(items[x], depths[x]);
+		double insertTime = t.EndTimer();
+		t.StartTimer();
+		uint64_t wrong = 0, falsePositives = 0;
+		for (uint64_t x = 0; x < numItems; x++)
+		{
+			wrong += (b.Contains(items[x]) > depths[x]);
+			falsePositives += (b.Contains(others[x]) != 0xF);
+		}
+		double lookupTime = t.EndTimer();
+		printf("MinBloomFilter: insert %1.3fs, lookup %1.3fs; %llu overestimates, %1.4f%% false positives\n",
+			   insertTime, lookupTime, (unsigned long long)wrong, 100.0*falsePositives/numItems);
+	}
+	{
+		BlockedMinBloomFilter b(filterBits/4, numHash);
+		t.StartTimer();
+		for (uint64_t x = 0; x < numItems; x++)
+			b.Insert(items[x], depths[x]);
+		double insertTime = t.EndTimer();
+		t.StartTimer();
+		uint64_t wrong = 0, falsePositives = 0;
+		for (uint64_t x = 0; x < numItems; x++)
+		{
+			wrong += (b.Contains(items[x]) > depths[x]);
+			falsePositives += (b.Contains(others[x]) != 0xF);
+		}
+		double lookupTime = t.EndTimer();
+		t.StartTimer();
+		uint64_t batchWrong = 0, batchFalsePositives = 0;
+		for (uint64_t x = 0; x < numItems; x += batchSize)
+		{
+			int count = std::min((uint64_t)batchSize, numItems-x);
+			b.Contains(&items[x], count, batchDepths);
+			for (int y = 0; y < count; y++)
+				batchWrong += (batchDepths[y] > depths[x+y]);
+			b.Contains(&others[x], count, batchDepths);
+			batchFalsePositives += count-std::count(batchDepths, batchDepths+count, 0xF);
+		}
+		double batchTime = t.EndTimer();
+		printf("BlockedMinBloomFilter: insert %1.3fs, lookup %1.3fs, batch %1.3fs; %llu overestimates, %1.4f%% false positives\n",
+			   insertTime, lookupTime, batchTime, (unsigned long long)wrong, 100.0*falsePositives/numItems);
+		if (batchWrong != wrong || batchFalsePositives != falsePositives)
+			printf("Error: batch lookups disagree with single lookups\n");
+	}
+}
+
+const uint64_t kAtomicTestEntries = 1<<20;
+const uint64_t kAtomicTestBits = 1<<26;
+const uint64_t kAtomicTestUpdates = 1<<23;
+
+/**
+ * Lowers random entries of depths and sets random bits of bits, counting the
+ * bits it was first to set. Uses the atomic methods, or the plain ones
+ * under lock if it isn't null.
+ */
+void AtomicArrayWorker(int id, FourBitArray *depths, BitVector *bits, uint64_t *newlySet, std::mutex *lock)
+{
+	std::mt19937_64 r(id);
+	for (uint64_t x = 0; x < kAtomicTestUpdates; x++)
+	{
+		uint64_t v = r();
+		uint64_t entry = v%kAtomicTestEntries, bit = (v>>24)%kAtomicTestBits;
+		uint8_t depth = (v>>32)%15;
+		if (lock == 0)
+		{
+			depths->AtomicSetIfSmaller(entry, depth);
+			*newlySet += bits->AtomicSetTrue(bit);
+		}
+		else {
+			std::lock_guard<std::mutex> l(*lock);
+			if (depth < depths->Get(entry))
+				depths->Set(entry, depth);
+			*newlySet += !bits->Get(bit);
+			bits->SetTrue(bit);
+		}
+	}
+}
+
+/**
+ * Has numThreads threads update a shared FourBitArray and BitVector, first
+ * with the atomic methods and then with the plain ones under a lock, and
+ * checks that both give the same tables as one thread would.
+ */
+void TestAtomicArrays(int numThreads)
+{
+	std::mutex lock;
+	FourBitArray expectedDepths(kAtomicTestEntries);
+	expectedDepths.FillMax();
+	BitVector expectedBits(kAtomicTestBits);
+	for (int x = 0; x < numThreads; x++)
+	{
+		uint64_t ignore = 0;
+		AtomicArrayWorker(x, &expectedDepths, &expectedBits, &ignore, &lock);
+	}
+
+	for (int locked = 0; locked < 2; locked++)
+	{
+		FourBitArray depths(kAtomicTestEntries);
+		depths.FillMax();
+		BitVector bits(kAtomicTestBits);
+		std::vector<uint64_t> newlySet(numThreads);
+		std::vector<std::thread*> threads;
+		Timer t;
+		t.StartTimer();
+		for (int x = 0; x < numThreads; x++)
+			threads.push_back(new std::thread(AtomicArrayWorker, x, &depths, &bits, &newlySet[x], locked?&lock:0));
+		for (unsigned int x = 0; x < threads.size(); x++)
+		{
+			threads[x]->join();
+			delete threads[x];
+		}
+		t.EndTimer();
+
+		uint64_t wrong = 0, totalSet = 0;
+		for (uint64_t x = 0; x < kAtomicTestEntries; x++)
+			wrong += (depths.Get(x) != expectedDepths.Get(x));
+		for (uint64_t x = 0; x < kAtomicTestBits; x++)
+			wrong += (bits.Get(x) != expectedBits.Get(x));
+		for (int x = 0; x < numThreads; x++)
+			totalSet += newlySet[x];
+		printf("%s: %d threads, %llu updates in %1.3fs; %llu entries and bits wrong, %llu bits set by %llu calls\n",
+			   locked?"Locked":"Atomic", numThreads, (unsigned long long)(numThreads*kAtomicTestUpdates), t.GetElapsedTime(),
+			   (unsigned long long)wrong, (unsigned long long)expectedBits.GetNumSetBits(), (unsigned long long)totalSet);
+	}
+}
+
+template <class environment, class state>
+void BuildPDBInParallel(environment &env, uint64_t numStates, int factor, bool minCompression, int numThreads, const char *outFile)
+{
+	FourBitArray pdb;
+	state goal;
+	RubikPDBBuilder<environment, state> builder(&env, numStates, numThreads);
+	builder.Build(goal, pdb, factor, minCompression);
+	builder.PrintThreadStats();
+	const std::vector<uint64_t> &counts = builder.GetDepthCounts();
+	for (unsigned int x = 0; x < counts.size(); x++)
+		printf("%d\t%llu\n", x, (unsigned long long)counts[x]);
+	pdb.Write(outFile);
+	printf("Wrote %llu entries to '%s'\n", (unsigned long long)pdb.Size(), outFile);
+}
+
+void BuildPDBInParallel(const char *pdbType, int factor, const char *compression, int numThreads, const char *outFile)
+{
+	if (factor < 1 || numThreads < 1)
+	{
+		printf("Compression factor and number of threads must be at least 1\n");
+		return;
+	}
+	bool minCompression;
+	if (strcmp(compression, "min") == 0)
+		minCompression = true;
+	else if (strcmp(compression, "interleave") == 0)
+		minCompression = false;
+	else {
+		printf("Unknown compression type '%s'; use min or interleave\n", compression);
+		return;
+	}
+	if (strcmp(pdbType, "corner") == 0)
+	{
+		RubiksCorner cc;
+		BuildPDBInParallel<RubiksCorner, RubiksCornerState>(cc, cc.getMaxSinglePlayerRank(), factor, minCompression, numThreads, outFile);
+	}
+	else if (strcmp(pdbType, "edge7") == 0)
+	{
+		Rubik7Edge e7;
+		BuildPDBInParallel<Rubik7Edge, Rubik7EdgeState>(e7, e7.getMaxSinglePlayerRank(), factor, minCompression, numThreads, outFile);
+	}
+	else if (strcmp(pdbType, "edge") == 0)
+	{
+		RubikEdge e;
+		BuildPDBInParallel<RubikEdge, RubikEdgeState>(e, e.getMaxSinglePlayerRank(), factor, minCompression, numThreads, outFile);
+	}
+	else {
+		printf("Unknown pdb type '%s'; use corner, edge7 or edge\n", pdbType);
+	}
+}
+
+/**
+ * Checks that each symmetry maps the successors of random states to the
+ * successors of their image and keeps their corner PDB value, and then
+ * solves random walks with the corner PDB alone, with the HCost cache off,
+ * on, and on with symmetry.
+ */
+void TestHCostCache(const char *cornerPDB, int walkLength, int cacheBits)
+{
+	const RubikSymmetries &sym = RubikSymmetries::Get();
+	FourBitArray &corner = c.GetCornerPDB();
+	corner.Read(cornerPDB);
+	RubiksCorner rc;
+	uint64_t wrongMoves = 0, wrongValues = 0;
+	c.SetPruneSuccessors(false);
+	srandom(1234);
+	for (int x = 0; x < 1000; x++)
+	{
+		RubiksState start, image, next, nextImage;
+		for (int y = 0; y < 30; y++)
+			c.ApplyAction(start, random()%18);
+		for (int w = 0; w < kRubikSymmetries; w++)
+		{
+			sym.Apply(start, w, image);
+			if (corner.Get(rc.GetStateHash(image.corner)) != corner.Get(rc.GetStateHash(start.corner)))
+				wrongValues++;
+			for (int a = 0; a < 18; a++)
+			{
+				c.GetNextState(start, a, next);
+				sym.Apply(next, w, nextImage);
+				c.GetNextState(image, sym.GetAction(w, a), next);
+				if (!(next.corner == nextImage.corner && next.edge == nextImage.edge))
+					wrongMoves++;
+			}
+		}
+	}
+	printf("%llu successors and %llu corner PDB values wrong over 1000 states and %d symmetries\n",
+		   (unsigned long long)wrongMoves, (unsigned long long)wrongValues, kRubikSymmetries);
+
+	// a zero edge PDB of 2^30 entries, so that edge lookups cost what they do
+	// with a real PDB but the heuristic is the corner PDB's
+	FourBitArray &edge = c.GetEdgePDB();
+	RubikEdge re;
+	edge.Resize(1ull<<30);
+	for (uint64_t x = 0; x < edge.Size(); x++)
+		edge.Set(x, 0);
+	c.compressionFactor = (int)((re.getMaxSinglePlayerRank()+edge.Size()-1)/edge.Size());
+	c.minCompression = true;
+	c.bloomFilter = false;
+	c.minBloomFilter = false;
+	const char *names[3] = {"No cache", "Cache", "Symmetric cache"};
+	for (int type = 0; type < 3; type++)
+	{
+		if (type == 0)
+			c.SetHCostCache(0, false);
+		else
+			c.SetHCostCache(cacheBits, type == 2);
+		uint64_t nodes = 0;
+		Timer t;
+		t.StartTimer();
+		srandom(4321);
+		for (int x = 0; x < 10; x++)
+		{
+			RubiksState start, goal;
+			c.SetPruneSuccessors(false);
+			for (int y = 0; y < walkLength; y++)
+				c.ApplyAction(start, random()%18);
+			std::vector<RubiksAction> acts;
+			IDAStar<RubiksState, RubiksAction> ida;
+			c.SetPruneSuccessors(true);
+			ida.SetUseBDPathMax(true);
+			ida.GetPath(&c, start, goal, acts);
+			nodes += ida.GetNodesExpanded();
+		}
+		t.EndTimer();
+		printf("%s: %llu expanded in %1.2fs; %llu cache hits, %llu misses\n", names[type], (unsigned long long)nodes,
+			   t.GetElapsedTime(), (unsigned long long)c.GetHCostCacheHits(), (unsigned long long)c.GetHCostCacheMisses());
+	}
+}
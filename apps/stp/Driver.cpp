@@ -32,10 +32,27 @@
 #include "Plot2D.h"
 #include "RandomUnit.h"
 #include "MNPuzzle.h"
+#include "FixedMNPuzzle.h"
 #include "IDAStar.h"
+#include "TemplateAStar.h"
+#include "HDAStar.h"
+#include "ParallelIDAStar.h"
+#include "ExternalBFS.h"
 #include "Timer.h"
+#include <numeric>
 
 void CompareToMinCompression();
+void CompareOpenClosed();
+void CompareHDA(int maxThreads);
+void CompareParallelIDA(int maxThreads);
+void CompareInPlaceIDA();
+void CompareFixedState();
+void CompareRanking();
+void CompareMappedPDB(const char *dir);
+void ComparePDBBuild(int maxThreads, const char *dir);
+void CompareBatchHCost(const char *dir);
+void TestPackedPDBCopies(const char *dir);
+void RunExternalBFS(const char *dir, int threads);
 void CompareToSmallerPDB();
 
 void BuildSTP_PDB(unsigned long windowID, tKeyboardModifier , char);
@@ -90,6 +107,17 @@ void InstallHandlers()
 	InstallKeyboardHandler(BuildSTP_PDB, "Build STP PDBs", "Build PDBs for the STP", kNoModifier, 'a');
 
 	InstallCommandLineHandler(MyCLHandler, "-run", "-run", "Runs pre-set experiments.");
+	InstallCommandLineHandler(MyCLHandler, "-compareOpenClosed", "-compareOpenClosed", "Compare A* with heap and bucket open lists on random 15-puzzle instances.");
+	InstallCommandLineHandler(MyCLHandler, "-compareHDA", "-compareHDA [threads]", "Compare A* and HDA* with up to the given number of threads on random 15-puzzle instances.");
+	InstallCommandLineHandler(MyCLHandler, "-compareParallelIDA", "-compareParallelIDA [threads]", "Compare IDA* and parallel IDA* with up to the given number of threads on random 15-puzzle instances.");
+	InstallCommandLineHandler(MyCLHandler, "-compareRanking", "-compareRanking", "Time PDB ranking and unranking against the previous implementation.");
+	InstallCommandLineHandler(MyCLHandler, "-compareMappedPDB", "-compareMappedPDB [dir]", "Compare loading a 15-puzzle PDB (written to dir) by reading it and by mapping it.");
+	InstallCommandLineHandler(MyCLHandler, "-comparePDBBuild", "-comparePDBBuild [threads] [dir]", "Time building 15-puzzle PDBs (written to dir) with up to the given number of threads.");
+	InstallCommandLineHandler(MyCLHandler, "-compareFixedState", "-compareFixedState", "Compare MNPuzzle with the fixed-size FixedMNPuzzle<4, 4> on random 15-puzzle instances.");
+	InstallCommandLineHandler(MyCLHandler, "-testPackedPDBs", "-testPackedPDBs [dir]", "Check that building a second 4-bit or 2-bit PDB (written to dir) leaves the first unchanged.");
+	InstallCommandLineHandler(MyCLHandler, "-compareBatchHCost", "-compareBatchHCost [dir]", "Compare A* evaluating children one at a time and in prefetched batches, with 15-puzzle PDBs (written to dir).");
+	InstallCommandLineHandler(MyCLHandler, "-externalBFS", "-externalBFS [dir] [threads]", "Enumerate the 8-puzzle and the 4x3 sliding-tile puzzle with breadth-first search on disk (in dir).");
+	InstallCommandLineHandler(MyCLHandler, "-compareInPlaceIDA", "-compareInPlaceIDA", "Compare IDA* on copied successor states with in-place IDA* on random 15-puzzle instances.");
 	
 	InstallWindowHandler(MyWindowHandler);
 
@@ -169,6 +197,69 @@ void MyFrameHandler(unsigned long windowID, unsigned int viewport, void *)
 
 int MyCLHandler(char *argument[], int maxNumArgs)
 {
+	if (strcmp(argument[0], "-compareOpenClosed") == 0)
+	{
+		CompareOpenClosed();
+		exit(0);
+	}
+	if (strcmp(argument[0], "-compareParallelIDA") == 0)
+	{
+		if (maxNumArgs > 1)
+			CompareParallelIDA(atoi(argument[1]));
+		else
+			CompareParallelIDA(std::thread::hardware_concurrency());
+		exit(0);
+	}
+	if (strcmp(argument[0], "-compareRanking") == 0)
+	{
+		CompareRanking();
+		exit(0);
+	}
+	if (strcmp(argument[0], "-compareMappedPDB") == 0)
+	{
+		CompareMappedPDB((maxNumArgs > 1)?argument[1]:".");
+		exit(0);
+	}
+	if (strcmp(argument[0], "-comparePDBBuild") == 0)
+	{
+		ComparePDBBuild((maxNumArgs > 1)?atoi(argument[1]):std::thread::hardware_concurrency(),
+						(maxNumArgs > 2)?argument[2]:".");
+		exit(0);
+	}
+	if (strcmp(argument[0], "-testPackedPDBs") == 0)
+	{
+		TestPackedPDBCopies((maxNumArgs > 1)?argument[1]:".");
+		exit(0);
+	}
+	if (strcmp(argument[0], "-compareFixedState") == 0)
+	{
+		CompareFixedState();
+		exit(0);
+	}
+	if (strcmp(argument[0], "-compareBatchHCost") == 0)
+	{
+		CompareBatchHCost((maxNumArgs > 1)?argument[1]:".");
+		exit(0);
+	}
+	if (strcmp(argument[0], "-externalBFS") == 0)
+	{
+		RunExternalBFS((maxNumArgs > 1)?argument[1]:".",
+					   (maxNumArgs > 2)?atoi(argument[2]):std::thread::hardware_concurrency());
+		exit(0);
+	}
+	if (strcmp(argument[0], "-compareInPlaceIDA") == 0)
+	{
+		CompareInPlaceIDA();
+		exit(0);
+	}
+	if (strcmp(argument[0], "-compareHDA") == 0)
+	{
+		if (maxNumArgs > 1)
+			CompareHDA(atoi(argument[1]));
+		else
+			CompareHDA(std::thread::hardware_concurrency());
+		exit(0);
+	}
 	BuildSTP_PDB(0, kNoModifier, 'a');
 	exit(0);
 	return 2;
@@ -249,6 +340,770 @@ void GetSTPInstance(const MNPuzzle &ts, MNPuzzleState &theState, int which)
 	}
 }
 
+/**
+ * Random walk from the goal that never undoes the previous move, so the
+ * solution depth grows with the walk length.
+ */
+void GetRandomWalkSTPInstance(const MNPuzzle &mnp, MNPuzzleState &s, int which, int length)
+{
+	std::vector<slideDir> acts;
+	srandom(which);
+	s.Reset();
+	slideDir undo = kUp;
+	for (int y = 0; y < length; y++)
+	{
+		mnp.GetActions(s, acts);
+		slideDir a;
+		do {
+			a = acts[random()%acts.size()];
+		} while (y > 0 && a == undo);
+		mnp.ApplyAction(s, a);
+		undo = a;
+		mnp.InvertAction(undo);
+	}
+}
+
+template <class openList>
+void TimeOpenClosed(const char *name)
+{
+	MNPuzzle mnp(4, 4);
+	MNPuzzleState s(4, 4), g(4, 4);
+	TemplateAStar<MNPuzzleState, slideDir, MNPuzzle, openList> astar;
+	std::vector<MNPuzzleState> path;
+	uint64_t nodes = 0, length = 0;
+	Timer t;
+	t.StartTimer();
+	for (int x = 1; x <= 50; x++)
+	{
+		GetRandomWalkSTPInstance(mnp, s, x, 40);
+		astar.GetPath(&mnp, s, g, path);
+		nodes += astar.GetNodesExpanded();
+		length += path.size();
+	}
+	t.EndTimer();
+	printf("%-12s %llu nodes expanded, total length %llu, %1.3fs (%1.0f nodes/sec)\n", name,
+		   (unsigned long long)nodes, (unsigned long long)length, t.GetElapsedTime(), nodes/t.GetElapsedTime());
+}
+
+void CompareOpenClosed()
+{
+	TimeOpenClosed<AStarOpenClosed<MNPuzzleState, AStarCompare<MNPuzzleState> > >("heap");
+	TimeOpenClosed<BucketOpenClosed<MNPuzzleState, AStarCompare<MNPuzzleState> > >("bucket");
+	TimeOpenClosed<BucketOpenClosed<MNPuzzleState, AStarCompare<MNPuzzleState>, AStarOpenClosedData<MNPuzzleState>, FlatIndexTable> >("bucket/flat");
+}
+
+/**
+ * Solves the same random-walk instances with TemplateAStar and with HDA*
+ * using 1..maxThreads threads, reporting time and speedup over A*.
+ */
+void CompareHDA(int maxThreads)
+{
+	MNPuzzle mnp(4, 4);
+	MNPuzzleState s(4, 4), g(4, 4);
+	std::vector<MNPuzzleState> path;
+	const int numInstances = 20;
+	std::vector<double> cost(numInstances);
+	TemplateAStar<MNPuzzleState, slideDir, MNPuzzle> astar;
+	uint64_t nodes = 0;
+	Timer t;
+	t.StartTimer();
+	for (int x = 0; x < numInstances; x++)
+	{
+		GetRandomWalkSTPInstance(mnp, s, x+1, 40);
+		astar.GetPath(&mnp, s, g, path);
+		nodes += astar.GetNodesExpanded();
+		cost[x] = mnp.GetPathLength(path);
+	}
+	double astarTime = t.EndTimer();
+	printf("%-12s %llu nodes expanded, %1.3fs\n", "A*", (unsigned long long)nodes, astarTime);
+
+	HDAStar<MNPuzzleState, slideDir, MNPuzzle> hda;
+	for (int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		hda.SetNumThreads(threads);
+		nodes = 0;
+		t.StartTimer();
+		for (int x = 0; x < numInstances; x++)
+		{
+			GetRandomWalkSTPInstance(mnp, s, x+1, 40);
+			hda.GetPath(&mnp, s, g, path);
+			nodes += hda.GetNodesExpanded();
+			if (!fequal(mnp.GetPathLength(path), cost[x]))
+				printf("Error: instance %d cost %1.0f, A* found %1.0f\n", x, mnp.GetPathLength(path), cost[x]);
+		}
+		double hdaTime = t.EndTimer();
+		printf("%-12s %llu nodes expanded, %1.3fs, speedup %1.2f\n", hda.GetName(), (unsigned long long)nodes, hdaTime, astarTime/hdaTime);
+	}
+}
+
+/**
+ * Solves random-walk instances with IDA* and with parallel IDA* using
+ * 1..maxThreads threads. All iterations but the last must expand the same
+ * number of nodes as IDA*.
+ */
+void CompareParallelIDA(int maxThreads)
+{
+	MNPuzzle mnp(4, 4);
+	MNPuzzleState s(4, 4), g(4, 4);
+	std::vector<slideDir> path;
+	const int numInstances = 10;
+	std::vector<std::vector<uint64_t> > iterationNodes(numInstances);
+	std::vector<size_t> length(numInstances);
+
+	ParallelIDAStar<MNPuzzleState, slideDir, MNPuzzle> ida;
+	Timer t;
+	double serialTime = 0;
+	for (int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		ida.SetNumThreads(threads);
+		uint64_t nodes = 0;
+		t.StartTimer();
+		for (int x = 0; x < numInstances; x++)
+		{
+			GetRandomWalkSTPInstance(mnp, s, x+1, 60);
+			ida.GetPath(&mnp, s, g, path);
+			nodes += ida.GetNodesExpanded();
+			const std::vector<uint64_t> &counts = ida.GetIterationNodesExpanded();
+			if (threads == 1)
+			{
+				iterationNodes[x] = counts;
+				length[x] = path.size();
+				continue;
+			}
+			if (path.size() != length[x] || counts.size() != iterationNodes[x].size())
+				printf("Error: instance %d solution or iterations differ\n", x);
+			for (unsigned int y = 0; y+1 < counts.size() && y+1 < iterationNodes[x].size(); y++)
+				if (counts[y] != iterationNodes[x][y])
+					printf("Error: instance %d iteration %d expanded %llu, serial %llu\n", x, y,
+						   (unsigned long long)counts[y], (unsigned long long)iterationNodes[x][y]);
+		}
+		double elapsed = t.EndTimer();
+		if (threads == 1)
+			serialTime = elapsed;
+		printf("%d thread(s): %llu nodes expanded, %1.3fs, speedup %1.2f\n", threads, (unsigned long long)nodes, elapsed, serialTime/elapsed);
+	}
+
+	IDAStar<MNPuzzleState, slideDir> serial;
+	uint64_t nodes = 0;
+	t.StartTimer();
+	for (int x = 0; x < numInstances; x++)
+	{
+		GetRandomWalkSTPInstance(mnp, s, x+1, 60);
+		serial.GetPath(&mnp, s, g, path);
+		nodes += serial.GetNodesExpanded();
+	}
+	printf("IDA*: %llu nodes expanded, %1.3fs\n", (unsigned long long)nodes, t.EndTimer());
+}
+
+/**
+ * Solve the same random-walk instances with IDA* returning a state path,
+ * once on copied successor states and once in place with ApplyAction/UndoAction.
+ */
+void CompareInPlaceIDA()
+{
+	MNPuzzle mnp(4, 4);
+	MNPuzzleState s(4, 4), g(4, 4);
+	std::vector<MNPuzzleState> path;
+	const int numInstances = 10;
+	std::vector<size_t> length(numInstances);
+
+	for (int inPlace = 0; inPlace < 2; inPlace++)
+	{
+		IDAStar<MNPuzzleState, slideDir> ida;
+		ida.SetUseInPlaceSearch(inPlace);
+		uint64_t nodes = 0;
+		Timer t;
+		t.StartTimer();
+		for (int x = 0; x < numInstances; x++)
+		{
+			GetRandomWalkSTPInstance(mnp, s, x+1, 60);
+			ida.GetPath(&mnp, s, g, path);
+			nodes += ida.GetNodesExpanded();
+			if (inPlace == 0)
+				length[x] = path.size();
+			else if (path.size() != length[x] || !(path.back() == g))
+				printf("Error: instance %d solution differs\n", x);
+		}
+		double elapsed = t.EndTimer();
+		printf("%-9s %llu nodes expanded, %1.3fs (%1.0f nodes/sec)\n", inPlace?"in place":"copied",
+			   (unsigned long long)nodes, elapsed, nodes/elapsed);
+	}
+}
+
+/**
+ * Check that FixedMNPuzzle<4, 4> ranks states like MNPuzzle, then time A*
+ * and in-place IDA* on both with the same random-walk instances.
+ */
+void CompareFixedState()
+{
+	typedef FixedMNPuzzleState<4, 4> FixedState;
+	MNPuzzle mnp(4, 4);
+	FixedMNPuzzle<4, 4> fixed;
+	MNPuzzleState s(4, 4), g(4, 4);
+	FixedState fg(g);
+	printf("sizeof(MNPuzzleState) = %d (plus %d on the heap); sizeof(FixedMNPuzzleState<4, 4>) = %d\n",
+		   (int)sizeof(MNPuzzleState), (int)(16*sizeof(int)), (int)sizeof(FixedState));
+
+	std::vector<int> pattern = {0, 1, 2, 3, 4, 5, 6, 7};
+	// builds the ranking caches
+	mnp.Get_PDB_Size(g, pattern.size());
+	fixed.Get_PDB_Size(fg, pattern.size());
+	for (int x = 0; x < 1000; x++)
+	{
+		GetRandomWalkSTPInstance(mnp, s, x+1, 100);
+		FixedState fs(s), back;
+		fixed.GetStateFromHash(back, fixed.GetStateHash(fs));
+		if (mnp.GetStateHash(s) != fixed.GetStateHash(fs) ||
+			mnp.GetPDBHash(s, pattern) != fixed.GetPDBHash(fs, pattern) ||
+			!(back == fs) || back.blank != fs.blank)
+			printf("Error: instance %d ranks differ\n", x);
+	}
+
+	std::vector<size_t> length(50);
+	{
+		TemplateAStar<MNPuzzleState, slideDir, MNPuzzle> astar;
+		std::vector<MNPuzzleState> path;
+		uint64_t nodes = 0;
+		Timer t;
+		t.StartTimer();
+		for (int x = 0; x < 50; x++)
+		{
+			GetRandomWalkSTPInstance(mnp, s, x+1, 40);
+			astar.GetPath(&mnp, s, g, path);
+			nodes += astar.GetNodesExpanded();
+			length[x] = path.size();
+		}
+		t.EndTimer();
+		printf("A*  MNPuzzle         %llu nodes expanded, %1.3fs (%1.0f nodes/sec)\n", (unsigned long long)nodes,
+			   t.GetElapsedTime(), nodes/t.GetElapsedTime());
+	}
+	{
+		TemplateAStar<FixedState, slideDir, FixedMNPuzzle<4, 4> > astar;
+		std::vector<FixedState> path;
+		uint64_t nodes = 0;
+		Timer t;
+		t.StartTimer();
+		for (int x = 0; x < 50; x++)
+		{
+			GetRandomWalkSTPInstance(mnp, s, x+1, 40);
+			astar.GetPath(&fixed, FixedState(s), fg, path);
+			nodes += astar.GetNodesExpanded();
+			if (path.size() != length[x])
+				printf("Error: instance %d solution differs\n", x);
+		}
+		t.EndTimer();
+		printf("A*  FixedMNPuzzle    %llu nodes expanded, %1.3fs (%1.0f nodes/sec)\n", (unsigned long long)nodes,
+			   t.GetElapsedTime(), nodes/t.GetElapsedTime());
+	}
+
+	{
+		IDAStar<MNPuzzleState, slideDir> ida;
+		ida.SetUseInPlaceSearch(true);
+		std::vector<MNPuzzleState> path;
+		uint64_t nodes = 0;
+		Timer t;
+		t.StartTimer();
+		for (int x = 0; x < 10; x++)
+		{
+			GetRandomWalkSTPInstance(mnp, s, x+1, 60);
+			ida.GetPath(&mnp, s, g, path);
+			nodes += ida.GetNodesExpanded();
+			length[x] = path.size();
+		}
+		t.EndTimer();
+		printf("IDA* MNPuzzle        %llu nodes expanded, %1.3fs (%1.0f nodes/sec)\n", (unsigned long long)nodes,
+			   t.GetElapsedTime(), nodes/t.GetElapsedTime());
+	}
+	{
+		IDAStar<FixedState, slideDir> ida;
+		ida.SetUseInPlaceSearch(true);
+		std::vector<FixedState> path;
+		uint64_t nodes = 0;
+		Timer t;
+		t.StartTimer();
+		for (int x = 0; x < 10; x++)
+		{
+			GetRandomWalkSTPInstance(mnp, s, x+1, 60);
+			ida.GetPath(&fixed, FixedState(s), fg, path);
+			nodes += ida.GetNodesExpanded();
+			if (path.size() != length[x])
+				printf("Error: instance %d solution differs\n", x);
+		}
+		t.EndTimer();
+		printf("IDA* FixedMNPuzzle   %llu nodes expanded, %1.3fs (%1.0f nodes/sec)\n", (unsigned long long)nodes,
+			   t.GetElapsedTime(), nodes/t.GetElapsedTime());
+	}
+}
+
+/**
+ * The ranking used by PermutationPuzzleEnvironment::GetPDBHash() before it
+ * used PermutationRanking.h, kept here as a reference. mult[x] is n-1-x
+ * upper n-k, as read from the nUpperk() cache.
+ */
+static uint64_t ReferenceRank(const MNPuzzleState &s, const std::vector<int> &distinct,
+							  const std::vector<uint64_t> &mult, std::vector<int> &locs, std::vector<int> &dual)
+{
+	locs.resize(distinct.size());
+	dual.resize(s.puzzle.size());
+	for (unsigned int x = 0; x < s.puzzle.size(); x++)
+		if (s.puzzle[x] != -1)
+			dual[s.puzzle[x]] = x;
+	for (unsigned int x = 0; x < distinct.size(); x++)
+		locs[x] = dual[distinct[x]];
+	uint64_t hashVal = 0;
+	for (unsigned int x = 0; x < locs.size(); x++)
+	{
+		hashVal += locs[x]*mult[x];
+		for (unsigned y = x; y < locs.size(); y++)
+			if (locs[y] > locs[x])
+				locs[y]--;
+	}
+	return hashVal;
+}
+
+/** The matching reference unranking */
+static void ReferenceUnrank(uint64_t hashVal, MNPuzzleState &s, int count, const std::vector<int> &pattern, std::vector<int> &dual)
+{
+	int patternSize = pattern.size();
+	dual.resize(patternSize);
+	int numEntriesLeft = count-patternSize+1;
+	for (int x = patternSize-1; x >= 0; x--)
+	{
+		dual[x] = hashVal%numEntriesLeft;
+		hashVal /= numEntriesLeft;
+		numEntriesLeft++;
+		for (int y = x+1; y < patternSize; y++)
+			if (dual[y] >= dual[x])
+				dual[y]++;
+	}
+	s.puzzle.resize(count);
+	std::fill(s.puzzle.begin(), s.puzzle.end(), -1);
+	for (int x = 0; x < patternSize; x++)
+	{
+		s.puzzle[dual[x]] = pattern[x];
+		if (pattern[x] == 0)
+			s.blank = dual[x];
+	}
+}
+
+/**
+ * Time ranking and unranking of 15-puzzle states for a 7-tile PDB against
+ * the reference implementation, checking that the results agree.
+ */
+void CompareRanking()
+{
+	MNPuzzle mnp(4, 4);
+	MNPuzzleState s(4, 4), g(4, 4);
+	std::vector<int> pattern = {0, 1, 2, 3, 4, 5, 6, 7};
+	mnp.Get_PDB_Size(g, pattern.size());
+	const int n = 16, k = pattern.size();
+	std::vector<uint64_t> mult(k);
+	for (int x = 0; x < k; x++)
+	{
+		mult[x] = 1;
+		for (int i = n-1-x; i > n-k; i--)
+			mult[x] *= i;
+	}
+
+	// small enough to stay in cache, so that the ranking itself is timed
+	const int numStates = 1<<14;
+	std::vector<MNPuzzleState> states(numStates, g);
+	for (int x = 0; x < numStates; x++)
+		GetRandomWalkSTPInstance(mnp, states[x], x, 200);
+	std::vector<uint64_t> expected(numStates), hashes(numStates);
+	std::vector<int> locs, dual;
+	Timer t;
+	const int reps = 500;
+
+	t.StartTimer();
+	for (int r = 0; r < reps; r++)
+		for (int x = 0; x < numStates; x++)
+			expected[x] = ReferenceRank(states[x], pattern, mult, locs, dual);
+	double base = t.EndTimer();
+	printf("rank   reference  %1.3fs (%1.1f ns/state)\n", base, base*1e9/reps/numStates);
+
+	t.StartTimer();
+	for (int r = 0; r < reps; r++)
+		for (int x = 0; x < numStates; x++)
+			hashes[x] = mnp.GetPDBHash(states[x], pattern);
+	double elapsed = t.EndTimer();
+	printf("rank   GetPDBHash %1.3fs (%1.1f ns/state) speedup %1.2f\n", elapsed, elapsed*1e9/reps/numStates, base/elapsed);
+	if (hashes != expected)
+		printf("Error: GetPDBHash differs from the reference\n");
+
+	t.StartTimer();
+	for (int r = 0; r < reps; r++)
+		mnp.GetPDBHashes(&states[0], numStates, pattern, &hashes[0]);
+	elapsed = t.EndTimer();
+	printf("rank   batch      %1.3fs (%1.1f ns/state) speedup %1.2f\n", elapsed, elapsed*1e9/reps/numStates, base/elapsed);
+	if (hashes != expected)
+		printf("Error: GetPDBHashes differs from the reference\n");
+
+	// a sample of the ranks, spread over the whole PDB
+	uint64_t count = mnp.Get_PDB_Size(g, pattern.size());
+	const uint64_t step = 101;
+	uint64_t check = 0;
+	t.StartTimer();
+	for (uint64_t x = 0; x < count; x += step)
+	{
+		ReferenceUnrank(x, s, n, pattern, dual);
+		check += dual[k-1];
+	}
+	base = t.EndTimer();
+	printf("unrank reference  %1.3fs (%1.1f ns/state)\n", base, base*1e9/(count/step));
+
+	uint64_t check2 = 0;
+	bool roundTrip = true;
+	t.StartTimer();
+	for (uint64_t x = 0; x < count; x += step)
+	{
+		mnp.GetStateFromPDBHash(x, s, n, pattern, dual);
+		check2 += dual[k-1];
+	}
+	elapsed = t.EndTimer();
+	printf("unrank GetStateFromPDBHash %1.3fs (%1.1f ns/state) speedup %1.2f\n", elapsed, elapsed*1e9/(count/step), base/elapsed);
+	for (uint64_t x = 0; x < count; x += 997)
+	{
+		mnp.GetStateFromPDBHash(x, s, n, pattern, dual);
+		if (mnp.GetPDBHash(s, pattern) != x)
+			roundTrip = false;
+	}
+	if (check != check2 || !roundTrip)
+		printf("Error: unranking differs from the reference\n");
+}
+
+/**
+ * Build a 15-puzzle PDB and save it both in the old format, which is read
+ * into memory, and with a header, which is mapped. Compares the load times
+ * and checks that lookups agree.
+ */
+void CompareMappedPDB(const char *dir)
+{
+	MNPuzzle mnp(4, 4);
+	MNPuzzleState s(4, 4), g(4, 4);
+	std::vector<int> pattern = {0, 1, 2, 3, 4, 5};
+	std::string mappedName = std::string(dir)+"/STP_0-5.pdb";
+	std::string oldName = std::string(dir)+"/STP_0-5-old.pdb";
+	{
+		MNPuzzle builder(4, 4);
+		MNPuzzleState start(g);
+		builder.Build_Regular_PDB(start, pattern, mappedName.c_str());
+		// the format used before PDB files had headers
+		FILE *f = fopen(oldName.c_str(), "w");
+		int num = pattern.size();
+		fwrite(&num, sizeof(num), 1, f);
+		fwrite(&pattern[0], sizeof(pattern[0]), pattern.size(), f);
+		fwrite(builder.PDB[0].begin(), 1, builder.PDB[0].size(), f);
+		fclose(f);
+	}
+
+	MNPuzzle readEnv(4, 4), mappedEnv(4, 4);
+	Timer t;
+	t.StartTimer();
+	readEnv.Load_Regular_PDB(oldName.c_str(), g, false);
+	printf("read   %1.4fs (%llu entries)\n", t.EndTimer(), (unsigned long long)readEnv.PDB[0].size());
+	t.StartTimer();
+	mappedEnv.Load_Regular_PDB(mappedName.c_str(), g, false);
+	printf("mapped %1.4fs (%llu entries)\n", t.EndTimer(), (unsigned long long)mappedEnv.PDB[0].size());
+	if (!mappedEnv.PDB[0].IsMapped())
+		printf("Error: PDB was not mapped\n");
+
+	t.StartTimer();
+	bool checked = mappedEnv.Check_PDB_File(mappedName.c_str());
+	printf("checksum %1.4fs\n", t.EndTimer());
+	if (!checked)
+		printf("Error: PDB checksum doesn't match\n");
+
+	for (int x = 0; x < 100000; x++)
+	{
+		GetRandomWalkSTPInstance(mnp, s, x, 200);
+		if (readEnv.PDB_Lookup(s) != mappedEnv.PDB_Lookup(s))
+			printf("Error: instance %d lookups differ\n", x);
+	}
+
+	// a file cut short must be rejected rather than mapped past its end
+	std::string shortName = std::string(dir)+"/STP_0-5-short.pdb";
+	{
+		PDBFileHeader header;
+		ReadPDBFileHeader(mappedName.c_str(), header);
+		WritePDBFile(shortName.c_str(), header, mappedEnv.PDB[0].begin(), mappedEnv.PDB[0].size()/2);
+		// restore the full entry count over the one WritePDBFile() stored
+		header.numEntries = mappedEnv.PDB[0].size();
+		FILE *f = fopen(shortName.c_str(), "r+");
+		fwrite(&header, sizeof(header), 1, f);
+		fclose(f);
+	}
+	if (mappedEnv.Check_PDB_File(shortName.c_str()))
+		printf("Error: truncated PDB was accepted\n");
+}
+
+/**
+ * Check Build_PDB against the serial Build_Regular_PDB on a small 15-puzzle
+ * PDB, and backward sweeps against forward ones on a weighted PDB, then time it on a larger one with 1 up to maxThreads threads, with
+ * and without backward sweeps.
+ */
+void ComparePDBBuild(int maxThreads, const char *dir)
+{
+	MNPuzzleState g(4, 4);
+	std::string name = std::string(dir)+"/STP_build.pdb";
+	{
+		std::vector<int> pattern = {0, 1, 2, 3, 4, 5};
+		MNPuzzle reference(4, 4), forward(4, 4), backward(4, 4);
+		MNPuzzleState start(g);
+		reference.Build_Regular_PDB(start, pattern, name.c_str());
+		start = g;
+		forward.SetBackwardPDBSweeps(false);
+		forward.Build_PDB(start, pattern, name.c_str(), maxThreads, false);
+		start = g;
+		backward.Build_PDB(start, pattern, name.c_str(), maxThreads, false);
+		if (!std::equal(reference.PDB[0].begin(), reference.PDB[0].end(), forward.PDB[0].begin()) ||
+			!std::equal(reference.PDB[0].begin(), reference.PDB[0].end(), backward.PDB[0].begin()))
+			printf("Error: Build_PDB differs from Build_Regular_PDB\n");
+	}
+	{
+		// weighted moves cost more or less depending on their direction,
+		// which backward sweeps must get the same way as forward ones; the
+		// pattern is small so that weighted costs fit in 8-bit entries
+		std::vector<int> pattern = {0, 1, 2, 3};
+		MNPuzzle forward(4, 4), backward(4, 4);
+		forward.SetWeighted(true);
+		backward.SetWeighted(true);
+		MNPuzzleState start(g);
+		forward.SetBackwardPDBSweeps(false);
+		forward.Build_PDB(start, pattern, name.c_str(), maxThreads, false);
+		start = g;
+		backward.Build_PDB(start, pattern, name.c_str(), maxThreads, false);
+		if (!std::equal(forward.PDB[0].begin(), forward.PDB[0].end(), backward.PDB[0].begin()))
+			printf("Error: weighted Build_PDB differs with backward sweeps\n");
+	}
+
+	std::vector<int> pattern = {0, 1, 2, 3, 4, 5, 6};
+	std::vector<int> threadCounts;
+	for (int threads = 1; threads < maxThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(maxThreads);
+	std::vector<std::string> results;
+	std::vector<uint64_t> checksums;
+	for (int backward = 0; backward < 2; backward++)
+	{
+		for (int threads : threadCounts)
+		{
+			MNPuzzle mnp(4, 4);
+			MNPuzzleState start(g);
+			mnp.SetBackwardPDBSweeps(backward);
+			Timer t;
+			t.StartTimer();
+			mnp.Build_PDB(start, pattern, name.c_str(), threads, false);
+			char line[255];
+			sprintf(line, "%s %2d threads %1.2fs", backward?"backward":"forward ", threads, t.EndTimer());
+			results.push_back(line);
+			checksums.push_back(PDBChecksum(mnp.PDB[0].begin(), mnp.PDB[0].size()));
+		}
+	}
+	for (unsigned int x = 0; x < results.size(); x++)
+		printf("%s\n", results[x].c_str());
+	for (unsigned int x = 1; x < checksums.size(); x++)
+		if (checksums[x] != checksums[0])
+			printf("Error: PDB %d differs\n", x);
+}
+
+/**
+ * Builds two packed PDBs into one environment and checks that growing the
+ * list of PDBs for the second leaves the size and entries of the first as
+ * they were.
+ */
+void TestPackedPDBCopies(const char *dir)
+{
+	MNPuzzleState g(4, 4);
+	std::string name = std::string(dir)+"/STP_packed.pdb";
+	std::vector<int> first = {0, 1, 2, 3, 4}, second = {0, 5, 6, 7, 8};
+	int errors = 0;
+	for (int entryBits = 4; entryBits >= 2; entryBits -= 2)
+	{
+		MNPuzzle mnp(4, 4);
+		MNPuzzleState start(g);
+		mnp.Build_PDB(start, first, name.c_str(), 1, false, entryBits);
+		uint64_t size = mnp.PDB[0].size();
+		std::vector<uint8_t> entries(mnp.PDB[0].begin(), mnp.PDB[0].end());
+		start = g;
+		mnp.Build_PDB(start, second, name.c_str(), 1, false, entryBits);
+		if (mnp.PDB[0].size() != size || mnp.PDB[0].EntryBits() != entryBits ||
+			!std::equal(entries.begin(), entries.end(), mnp.PDB[0].begin()))
+		{
+			printf("Error: %d-bit PDB has %llu entries after a second build; expected %llu\n", entryBits,
+				   (unsigned long long)mnp.PDB[0].size(), (unsigned long long)size);
+			errors++;
+		}
+		// a copy of the list must keep them too
+		MNPuzzle copy(mnp);
+		if (copy.PDB[0].size() != size || copy.PDB[1].size() != mnp.PDB[1].size())
+		{
+			printf("Error: copied %d-bit PDBs have the wrong size\n", entryBits);
+			errors++;
+		}
+	}
+	printf("%d errors\n", errors);
+}
+
+/**
+ * Forwards HCost() to another heuristic, hiding its BatchHCost(), so that
+ * states are evaluated one at a time.
+ */
+template <class state>
+class SingleStateHeuristic : public Heuristic<state> {
+public:
+	SingleStateHeuristic(Heuristic<state> *h) :h(h) {}
+	double HCost(const state &a, const state &b) { return h->HCost(a, b); }
+private:
+	Heuristic<state> *h;
+};
+
+/**
+ * Runs A* on random-walk 15-puzzle instances with two 8-item PDBs (about
+ * 1GB), getting the h-costs of each node's children one at a time and then
+ * in batches whose PDB entries are prefetched. The PDBs are built in dir
+ * the first time.
+ */
+void CompareBatchHCost(const char *dir)
+{
+	typedef FixedMNPuzzleState<4, 4> FixedState;
+	MNPuzzle mnp(4, 4);
+	FixedMNPuzzle<4, 4> fixed;
+	MNPuzzleState s(4, 4), g(4, 4);
+	FixedState fg(g);
+	std::vector<std::vector<int> > patterns = {{0, 1, 2, 3, 4, 5, 6, 7}, {0, 8, 9, 10, 11, 12, 13, 14}};
+	for (unsigned int x = 0; x < patterns.size(); x++)
+	{
+		char name[255];
+		sprintf(name, "%s/STP_batch_%d.pdb", dir, x);
+		PDBFileHeader header;
+		if (!ReadPDBFileHeader(name, header))
+		{
+			FixedMNPuzzle<4, 4> builder;
+			FixedState start(fg);
+			builder.Build_PDB(start, patterns[x], name, std::thread::hardware_concurrency(), false);
+		}
+		fixed.Load_Regular_PDB(name, fg, false);
+	}
+	
+	std::vector<FixedState> instances;
+	for (int x = 0; x < 100; x++)
+	{
+		GetRandomWalkSTPInstance(mnp, s, x+1, 80);
+		instances.push_back(FixedState(s));
+	}
+	// touch every entry, so that both runs find the PDBs in memory
+	uint64_t sum = 0;
+	for (unsigned int x = 0; x < fixed.PDB.size(); x++)
+		sum = std::accumulate(fixed.PDB[x].begin(), fixed.PDB[x].end(), sum);
+	printf("Loaded %d PDBs (sum %llu)\n", (int)fixed.PDB.size(), (unsigned long long)sum);
+	
+	// h-costs alone, for random states in groups the size of a node's children
+	{
+		srandom(1);
+		std::vector<FixedState> states(1<<20);
+		for (unsigned int x = 0; x < states.size(); x++)
+			fixed.GetStateFromHash(states[x], ((uint64_t)random()<<31 | random())%20922789888000ull);
+		std::vector<double> single(states.size()), batched(states.size());
+		Timer t;
+		t.StartTimer();
+		for (unsigned int x = 0; x < states.size(); x++)
+			single[x] = fixed.HCost(states[x], fg);
+		printf("HCost      %1.3fs\n", t.EndTimer());
+		t.StartTimer();
+		for (unsigned int x = 0; x < states.size(); x += 4)
+			fixed.BatchHCost(&states[x], 4, fg, &batched[x]);
+		printf("BatchHCost %1.3fs\n", t.EndTimer());
+		if (single != batched)
+			printf("Error: batched h-costs differ\n");
+	}
+	
+	std::vector<size_t> length(instances.size());
+	SingleStateHeuristic<FixedState> single(&fixed);
+	for (int batch = 0; batch < 2; batch++)
+	{
+		TemplateAStar<FixedState, slideDir, FixedMNPuzzle<4, 4> > astar;
+		if (!batch)
+			astar.SetHeuristic(&single);
+		std::vector<FixedState> path;
+		uint64_t nodes = 0;
+		Timer t;
+		t.StartTimer();
+		for (unsigned int x = 0; x < instances.size(); x++)
+		{
+			astar.GetPath(&fixed, instances[x], fg, path);
+			nodes += astar.GetNodesExpanded();
+			if (!batch)
+				length[x] = path.size();
+			else if (path.size() != length[x])
+				printf("Error: instance %d solution differs\n", x);
+		}
+		t.EndTimer();
+		printf("%-8s %llu nodes expanded, %1.3fs (%1.0f nodes/sec)\n", batch?"batched":"single", (unsigned long long)nodes,
+			   t.GetElapsedTime(), nodes/t.GetElapsedTime());
+	}
+}
+
+/**
+ * Enumerates the reachable states of the 3x3 and 4x3 puzzles with
+ * ExternalBFS, checking the number of states (half of all permutations) and
+ * the depth of the deepest layer. The 3x3 puzzle is searched both as a
+ * FixedMNPuzzle and as an MNPuzzle, whose states get their size from the
+ * start state.
+ */
+void RunExternalBFS(const char *dir, int threads)
+{
+	{
+		FixedMNPuzzle<3, 3> mnp;
+		FixedMNPuzzleState<3, 3> goal;
+		ExternalBFS<FixedMNPuzzleState<3, 3>, slideDir, FixedMNPuzzle<3, 3> > bfs(dir, 64, threads);
+		Timer t;
+		t.StartTimer();
+		bfs.DoBFS(&mnp, goal);
+		uint64_t total = 0;
+		for (int x = 0; x <= bfs.GetDepth(); x++)
+			total += bfs.GetLayerSize(x);
+		printf("3x3: %llu states, deepest at %d, %1.2fs\n", (unsigned long long)total, bfs.GetDepth()-1, t.EndTimer());
+		if (total != 181440 || bfs.GetDepth()-1 != 31)
+			printf("Error: expected 181440 states, deepest at 31\n");
+
+		// stop part way, and continue from the checkpoint with a new search
+		ExternalBFS<FixedMNPuzzleState<3, 3>, slideDir, FixedMNPuzzle<3, 3> > first(dir, 64, threads), second(dir, 64, threads);
+		first.InitializeSearch(&mnp, goal);
+		for (int x = 0; x < 15; x++)
+			first.DoOneLayer();
+		if (!second.Resume(&mnp, goal))
+			printf("Error: no checkpoint to resume from\n");
+		while (second.DoOneLayer())
+		{}
+		for (int x = 0; x <= bfs.GetDepth(); x++)
+			if (second.GetLayerSize(x) != bfs.GetLayerSize(x))
+				printf("Error: resumed search differs at depth %d\n", x);
+
+		MNPuzzle sized(3, 3);
+		MNPuzzleState sizedGoal(3, 3);
+		ExternalBFS<MNPuzzleState, slideDir, MNPuzzle> sizedBFS(dir, 64, threads);
+		sizedBFS.DoBFS(&sized, sizedGoal);
+		for (int x = 0; x <= bfs.GetDepth(); x++)
+			if (sizedBFS.GetLayerSize(x) != bfs.GetLayerSize(x))
+				printf("Error: MNPuzzle search differs at depth %d\n", x);
+	}
+	{
+		FixedMNPuzzle<4, 3> mnp;
+		FixedMNPuzzleState<4, 3> goal;
+		ExternalBFS<FixedMNPuzzleState<4, 3>, slideDir, FixedMNPuzzle<4, 3> > bfs(dir, 512, threads);
+		Timer t;
+		t.StartTimer();
+		bfs.DoBFS(&mnp, goal);
+		uint64_t total = 0;
+		for (int x = 0; x <= bfs.GetDepth(); x++)
+			total += bfs.GetLayerSize(x);
+		printf("4x3: %llu states, deepest at %d, %1.2fs\n", (unsigned long long)total, bfs.GetDepth()-1, t.EndTimer());
+		if (total != 239500800)
+			printf("Error: expected 239500800 states\n");
+	}
+}
+
 void BuildSTP_PDB(unsigned long windowID, tKeyboardModifier , char)
 {
 //	MNPuzzle mnp(4, 4);
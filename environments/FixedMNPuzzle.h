@@ -0,0 +1,251 @@
+/*
+ *  FixedMNPuzzle.h
+ *  hog2
+ *
+ *  Sliding-tile puzzle whose dimensions are template parameters, so that
+ *  states are fixed-size and copy without allocating.
+ *
+ */
+
+#ifndef FIXEDMNPUZZLE_H
+#define FIXEDMNPUZZLE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <iostream>
+#include "MNPuzzle.h"
+#include "PermutationArray.h"
+
+template <int width, int height>
+class FixedMNPuzzleState {
+public:
+	FixedMNPuzzleState() :blank(0) {}
+	/** Convert from a MNPuzzleState of the same size */
+	explicit FixedMNPuzzleState(const MNPuzzleState &s)
+	:blank(s.blank), puzzle(s.puzzle)
+	{ assert(s.width == width && s.height == height); }
+	void Reset()
+	{
+		puzzle.Reset();
+		blank = 0;
+	}
+	uint8_t blank;
+	PermutationArray<width*height> puzzle;
+};
+
+template <int width, int height>
+static std::ostream& operator <<(std::ostream & out, const FixedMNPuzzleState<width, height> &loc)
+{
+	out << "(" << width << "x" << height << ")";
+	for (unsigned int x = 0; x < loc.puzzle.size(); x++)
+		out << loc.puzzle[x] << " ";
+	return out;
+}
+
+template <int width, int height>
+static bool operator==(const FixedMNPuzzleState<width, height> &l1, const FixedMNPuzzleState<width, height> &l2)
+{
+	return l1.puzzle == l2.puzzle;
+}
+
+/**
+ * The sliding-tile puzzle on FixedMNPuzzleState. Moves, operator order and
+ * the heuristic (maximum of any loaded PDBs and Manhattan distance) match
+ * MNPuzzle with unit costs, so searches expand the same nodes in the same
+ * order.
+ */
+template <int width, int height>
+class FixedMNPuzzle : public PermutationPuzzleEnvironment<FixedMNPuzzleState<width, height>, slideDir> {
+public:
+	typedef FixedMNPuzzleState<width, height> state;
+	FixedMNPuzzle();
+	void GetSuccessors(const state &s, std::vector<state> &neighbors) const;
+	int GetNumSuccessors(const state &s) const { return numOperators[s.blank]; }
+	template <class visitor>
+	void ForEachSuccessor(const state &s, visitor &v) const;
+	void GetActions(const state &s, std::vector<slideDir> &actions) const;
+	void ApplyAction(state &s, slideDir a) const;
+	bool InvertAction(slideDir &a) const;
+
+	double HCost(const state &s1, const state &s2);
+	double HCost(const state &s1)
+	{ return PermutationPuzzleEnvironment<state, slideDir>::HCost(s1); }
+	void BatchHCost(const state *states, int count, const state &goal, double *hcosts);
+	double GCost(const state &, const state &) { return 1; }
+	double GCost(const state &, const slideDir &) { return 1; }
+	bool GoalTest(const state &s, const state &goal) { return s == goal; }
+	uint64_t GetActionHash(slideDir act) const { return act; }
+
+	void GetStateFromPDBHash(uint64_t hash, state &s, int count,
+							 const std::vector<int> &pattern, std::vector<int> &dual);
+	void GetStateFromHash(state &s, uint64_t hash);
+	bool State_Check(const state &s) { return s.blank < width*height && s.puzzle[s.blank] == 0; }
+	/** Same as MNPuzzle, which ranks states the same way */
+	std::string GetPDBDomain() const
+	{ return "STP "+std::to_string(width)+"x"+std::to_string(height); }
+
+	void OpenGLDraw() const {}
+	void OpenGLDraw(const state &) const {}
+	void OpenGLDraw(const state &, const slideDir &) const {}
+private:
+	int Manhattan(const state &s1, const state &s2) const;
+	static const int numTiles = width*height;
+	slideDir operators[numTiles][4];
+	uint8_t numOperators[numTiles];
+};
+
+template <int width, int height>
+struct UsesSuccessorVisitor<FixedMNPuzzle<width, height> > {
+	static const bool value = true;
+};
+
+template <int width, int height>
+FixedMNPuzzle<width, height>::FixedMNPuzzle()
+{
+	// same default order as MNPuzzle
+	std::vector<slideDir> order = MNPuzzle::Get_Op_Order_From_Hash(15);
+	for (int blank = 0; blank < numTiles; blank++)
+	{
+		numOperators[blank] = 0;
+		for (unsigned int x = 0; x < order.size(); x++)
+		{
+			if ((order[x] == kUp && blank >= width) ||
+				(order[x] == kLeft && blank%width > 0) ||
+				(order[x] == kRight && blank%width < width-1) ||
+				(order[x] == kDown && blank < numTiles-width))
+				operators[blank][numOperators[blank]++] = order[x];
+		}
+	}
+}
+
+template <int width, int height>
+void FixedMNPuzzle<width, height>::GetSuccessors(const state &s, std::vector<state> &neighbors) const
+{
+	neighbors.resize(0);
+	SuccessorAppender<state> appender(neighbors);
+	ForEachSuccessor(s, appender);
+}
+
+/**
+ * Calls v on each successor, in the order used by GetSuccessors().
+ */
+template <int width, int height>
+template <class visitor>
+void FixedMNPuzzle<width, height>::ForEachSuccessor(const state &s, visitor &v) const
+{
+	state child(s);
+	for (int x = 0; x < numOperators[s.blank]; x++)
+	{
+		slideDir a = operators[s.blank][x];
+		ApplyAction(child, a);
+		v(child);
+		InvertAction(a);
+		ApplyAction(child, a);
+	}
+}
+
+template <int width, int height>
+void FixedMNPuzzle<width, height>::GetActions(const state &s, std::vector<slideDir> &actions) const
+{
+	actions.resize(0);
+	for (int x = 0; x < numOperators[s.blank]; x++)
+		actions.push_back(operators[s.blank][x]);
+}
+
+/**
+ * Moves the blank; like MNPuzzle, the tiles are swapped so that abstract
+ * states (with -1 entries, possibly in the blank position) stay consistent.
+ */
+template <int width, int height>
+void FixedMNPuzzle<width, height>::ApplyAction(state &s, slideDir a) const
+{
+	int next;
+	switch (a)
+	{
+		case kUp: if (s.blank < width) return; next = s.blank-width; break;
+		case kDown: if (s.blank >= numTiles-width) return; next = s.blank+width; break;
+		case kRight: if (s.blank%width == width-1) return; next = s.blank+1; break;
+		case kLeft: if (s.blank%width == 0) return; next = s.blank-1; break;
+		default: return;
+	}
+	int8_t tmp = s.puzzle[s.blank];
+	s.puzzle[s.blank] = s.puzzle[next];
+	s.puzzle[next] = tmp;
+	s.blank = next;
+}
+
+template <int width, int height>
+bool FixedMNPuzzle<width, height>::InvertAction(slideDir &a) const
+{
+	switch (a)
+	{
+		case kLeft: a = kRight; break;
+		case kUp: a = kDown; break;
+		case kDown: a = kUp; break;
+		case kRight: a = kLeft; break;
+	}
+	return true;
+}
+
+template <int width, int height>
+double FixedMNPuzzle<width, height>::HCost(const state &s1, const state &s2)
+{
+	double hval = 0;
+	if (this->PDB.size() != 0)
+		hval = this->PDB_Lookup(s1);
+	return std::max(hval, (double)Manhattan(s1, s2));
+}
+
+/**
+ * Same as HCost() for each state, with the PDB entries of all the states
+ * prefetched before any is read.
+ */
+template <int width, int height>
+void FixedMNPuzzle<width, height>::BatchHCost(const state *states, int count, const state &goal, double *hcosts)
+{
+	if (this->PDB.size() != 0)
+		this->PDB_Lookup(states, count, hcosts);
+	else
+		std::fill(hcosts, hcosts+count, 0.0);
+	for (int x = 0; x < count; x++)
+		hcosts[x] = std::max(hcosts[x], (double)Manhattan(states[x], goal));
+}
+
+template <int width, int height>
+int FixedMNPuzzle<width, height>::Manhattan(const state &s1, const state &s2) const
+{
+	int goalLoc[numTiles];
+	for (int x = 0; x < numTiles; x++)
+		if (s2.puzzle[x] >= 0)
+			goalLoc[s2.puzzle[x]] = x;
+	int manhattan = 0;
+	for (int x = 0; x < numTiles; x++)
+	{
+		int tile = s1.puzzle[x];
+		if (tile <= 0)
+			continue;
+		manhattan += abs(goalLoc[tile]%width - x%width) + abs(goalLoc[tile]/width - x/width);
+	}
+	return manhattan;
+}
+
+template <int width, int height>
+void FixedMNPuzzle<width, height>::GetStateFromPDBHash(uint64_t hash, state &s, int count,
+													   const std::vector<int> &pattern, std::vector<int> &dual)
+{
+	PermutationPuzzleEnvironment<state, slideDir>::GetStateFromPDBHash(hash, s, count, pattern, dual);
+	for (unsigned int x = 0; x < dual.size(); x++)
+		if (pattern[x] == 0)
+			s.blank = dual[x];
+}
+
+template <int width, int height>
+void FixedMNPuzzle<width, height>::GetStateFromHash(state &s, uint64_t hash)
+{
+	PermutationPuzzleEnvironment<state, slideDir>::GetStateFromHash(s, hash);
+	for (int x = 0; x < numTiles; x++)
+		if (s.puzzle[x] == 0)
+			s.blank = x;
+}
+
+#endif
@@ -0,0 +1,178 @@
+/*
+ *  FixedPancakePuzzle.h
+ *  hog2
+ *
+ *  Pancake puzzle whose size is a template parameter, so that states are
+ *  fixed-size and copy without allocating.
+ *
+ */
+
+#ifndef FIXEDPANCAKEPUZZLE_H
+#define FIXEDPANCAKEPUZZLE_H
+
+#include <stdint.h>
+#include <iostream>
+#include "PancakePuzzle.h"
+#include "PermutationArray.h"
+
+template <int N>
+class FixedPancakePuzzleState {
+public:
+	FixedPancakePuzzleState() {}
+	/** Convert from a PancakePuzzleState of the same size */
+	explicit FixedPancakePuzzleState(const PancakePuzzleState &s)
+	:puzzle(s.puzzle) {}
+	void Reset() { puzzle.Reset(); }
+	PermutationArray<N> puzzle;
+};
+
+template <int N>
+static std::ostream& operator <<(std::ostream & out, const FixedPancakePuzzleState<N> &loc)
+{
+	for (unsigned int x = 0; x < loc.puzzle.size(); x++)
+		out << loc.puzzle[x] << " ";
+	return out;
+}
+
+template <int N>
+static bool operator==(const FixedPancakePuzzleState<N> &l1, const FixedPancakePuzzleState<N> &l2)
+{
+	return l1.puzzle == l2.puzzle;
+}
+
+/**
+ * The pancake puzzle on FixedPancakePuzzleState. Actions and their default
+ * order (N down to 2) match PancakePuzzle; the heuristic is the maximum of
+ * any loaded PDBs and the gap heuristic.
+ */
+template <int N>
+class FixedPancakePuzzle : public PermutationPuzzleEnvironment<FixedPancakePuzzleState<N>, PancakePuzzleAction> {
+public:
+	typedef FixedPancakePuzzleState<N> state;
+	FixedPancakePuzzle() {}
+	void GetSuccessors(const state &s, std::vector<state> &neighbors) const;
+	int GetNumSuccessors(const state &) const { return N-1; }
+	template <class visitor>
+	void ForEachSuccessor(const state &s, visitor &v) const;
+	void GetActions(const state &s, std::vector<PancakePuzzleAction> &actions) const;
+	void ApplyAction(state &s, PancakePuzzleAction a) const;
+	bool InvertAction(PancakePuzzleAction &) const { return true; }
+
+	double HCost(const state &s1, const state &s2);
+	double HCost(const state &s1)
+	{ return PermutationPuzzleEnvironment<state, PancakePuzzleAction>::HCost(s1); }
+	void BatchHCost(const state *states, int count, const state &goal, double *hcosts);
+	double GCost(const state &, const state &) { return 1; }
+	double GCost(const state &, const PancakePuzzleAction &) { return 1; }
+	bool GoalTest(const state &s, const state &goal) { return s == goal; }
+	uint64_t GetActionHash(PancakePuzzleAction act) const { return act; }
+	bool State_Check(const state &) { return true; }
+	std::string GetPDBDomain() const { return "Pancake"; }
+
+	void OpenGLDraw() const {}
+	void OpenGLDraw(const state &) const {}
+	void OpenGLDraw(const state &, const PancakePuzzleAction &) const {}
+private:
+	int Gaps(const state &s1, const state &s2) const;
+};
+
+template <int N>
+struct UsesSuccessorVisitor<FixedPancakePuzzle<N> > {
+	static const bool value = true;
+};
+
+template <int N>
+void FixedPancakePuzzle<N>::GetSuccessors(const state &s, std::vector<state> &neighbors) const
+{
+	neighbors.resize(0);
+	SuccessorAppender<state> appender(neighbors);
+	ForEachSuccessor(s, appender);
+}
+
+/**
+ * Calls v on each successor, in the order used by GetSuccessors(). Every
+ * flip is its own inverse, so one copy of the state is flipped and restored.
+ */
+template <int N>
+template <class visitor>
+void FixedPancakePuzzle<N>::ForEachSuccessor(const state &s, visitor &v) const
+{
+	state child(s);
+	for (int x = N; x >= 2; x--)
+	{
+		ApplyAction(child, x);
+		v(child);
+		ApplyAction(child, x);
+	}
+}
+
+template <int N>
+void FixedPancakePuzzle<N>::GetActions(const state &, std::vector<PancakePuzzleAction> &actions) const
+{
+	actions.resize(0);
+	for (int x = N; x >= 2; x--)
+		actions.push_back(x);
+}
+
+/**
+ * Flips the top a pancakes.
+ */
+template <int N>
+void FixedPancakePuzzle<N>::ApplyAction(state &s, PancakePuzzleAction a) const
+{
+	assert(a > 1 && a <= N);
+	for (int upper = 0, lower = a-1; upper < lower; upper++, lower--)
+	{
+		int8_t tmp = s.puzzle[upper];
+		s.puzzle[upper] = s.puzzle[lower];
+		s.puzzle[lower] = tmp;
+	}
+}
+
+template <int N>
+double FixedPancakePuzzle<N>::HCost(const state &s1, const state &s2)
+{
+	double hval = 0;
+	if (this->PDB.size() != 0)
+		hval = this->PDB_Lookup(s1);
+	return std::max(hval, (double)Gaps(s1, s2));
+}
+
+/**
+ * Same as HCost() for each state, with the PDB entries of all the states
+ * prefetched before any is read.
+ */
+template <int N>
+void FixedPancakePuzzle<N>::BatchHCost(const state *states, int count, const state &goal, double *hcosts)
+{
+	if (this->PDB.size() != 0)
+		this->PDB_Lookup(states, count, hcosts);
+	else
+		std::fill(hcosts, hcosts+count, 0.0);
+	for (int x = 0; x < count; x++)
+		hcosts[x] = std::max(hcosts[x], (double)Gaps(states[x], goal));
+}
+
+/**
+ * The gap heuristic: the number of adjacent pancakes that aren't adjacent
+ * in s2, counting the plate below the last pancake.
+ */
+template <int N>
+int FixedPancakePuzzle<N>::Gaps(const state &s1, const state &s2) const
+{
+	int goalLoc[N];
+	for (int x = 0; x < N; x++)
+		goalLoc[s2.puzzle[x]] = x;
+	int gaps = 0;
+	for (int x = 0; x < N-1; x++)
+	{
+		int diff = goalLoc[s1.puzzle[x]]-goalLoc[s1.puzzle[x+1]];
+		if (diff > 1 || diff < -1)
+			gaps++;
+	}
+	if (goalLoc[s1.puzzle[N-1]] != N-1)
+		gaps++;
+	return gaps;
+}
+
+#endif
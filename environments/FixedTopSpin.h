@@ -0,0 +1,133 @@
+/*
+ *  FixedTopSpin.h
+ *  hog2
+ *
+ *  TopSpin whose size and turnstile width are template parameters, so that
+ *  states are fixed-size and copy without allocating.
+ *
+ */
+
+#ifndef FIXEDTOPSPIN_H
+#define FIXEDTOPSPIN_H
+
+#include <stdint.h>
+#include <iostream>
+#include "TopSpin.h"
+#include "PermutationArray.h"
+
+template <int N>
+class FixedTopSpinState {
+public:
+	FixedTopSpinState() {}
+	/** Convert from a TopSpinState of the same size */
+	explicit FixedTopSpinState(const TopSpinState &s)
+	:puzzle(s.puzzle) {}
+	void Reset() { puzzle.Reset(); }
+	PermutationArray<N> puzzle;
+};
+
+template <int N>
+static std::ostream& operator <<(std::ostream & out, const FixedTopSpinState<N> &loc)
+{
+	for (unsigned int x = 0; x < loc.puzzle.size(); x++)
+		out << loc.puzzle[x] << " ";
+	return out;
+}
+
+template <int N>
+static bool operator==(const FixedTopSpinState<N> &l1, const FixedTopSpinState<N> &l2)
+{
+	return l1.puzzle == l2.puzzle;
+}
+
+/**
+ * TopSpin on FixedTopSpinState with N tiles and a turnstile that reverses
+ * k tiles. Actions are the first tile of the turnstile, as in TopSpin;
+ * move pruning and weighted costs are not supported. The heuristic comes
+ * from the loaded PDBs.
+ */
+template <int N, int k = 4>
+class FixedTopSpin : public PermutationPuzzleEnvironment<FixedTopSpinState<N>, TopSpinAction> {
+public:
+	typedef FixedTopSpinState<N> state;
+	FixedTopSpin() {}
+	void GetSuccessors(const state &s, std::vector<state> &neighbors) const;
+	int GetNumSuccessors(const state &) const { return N; }
+	template <class visitor>
+	void ForEachSuccessor(const state &s, visitor &v) const;
+	void GetActions(const state &s, std::vector<TopSpinAction> &actions) const;
+	void ApplyAction(state &s, TopSpinAction a) const;
+	bool InvertAction(TopSpinAction &) const { return true; }
+
+	double HCost(const state &s1, const state &)
+	{ return PermutationPuzzleEnvironment<state, TopSpinAction>::HCost(s1); }
+	double HCost(const state &s1)
+	{ return PermutationPuzzleEnvironment<state, TopSpinAction>::HCost(s1); }
+	void BatchHCost(const state *states, int count, const state &, double *hcosts)
+	{ PermutationPuzzleEnvironment<state, TopSpinAction>::HCost(states, count, hcosts); }
+	double GCost(const state &, const state &) { return 1; }
+	double GCost(const state &, const TopSpinAction &) { return 1; }
+	bool GoalTest(const state &s, const state &goal) { return s == goal; }
+	uint64_t GetActionHash(TopSpinAction act) const { return act; }
+	bool State_Check(const state &) { return true; }
+	std::string GetPDBDomain() const { return "TopSpin "+std::to_string(k); }
+
+	void OpenGLDraw() const {}
+	void OpenGLDraw(const state &) const {}
+	void OpenGLDraw(const state &, const TopSpinAction &) const {}
+};
+
+template <int N, int k>
+struct UsesSuccessorVisitor<FixedTopSpin<N, k> > {
+	static const bool value = true;
+};
+
+template <int N, int k>
+void FixedTopSpin<N, k>::GetSuccessors(const state &s, std::vector<state> &neighbors) const
+{
+	neighbors.resize(0);
+	SuccessorAppender<state> appender(neighbors);
+	ForEachSuccessor(s, appender);
+}
+
+/**
+ * Calls v on each successor, in the order used by GetSuccessors(). Every
+ * turn is its own inverse, so one copy of the state is turned and restored.
+ */
+template <int N, int k>
+template <class visitor>
+void FixedTopSpin<N, k>::ForEachSuccessor(const state &s, visitor &v) const
+{
+	state child(s);
+	for (int x = 0; x < N; x++)
+	{
+		ApplyAction(child, x);
+		v(child);
+		ApplyAction(child, x);
+	}
+}
+
+template <int N, int k>
+void FixedTopSpin<N, k>::GetActions(const state &, std::vector<TopSpinAction> &actions) const
+{
+	actions.resize(0);
+	for (int x = 0; x < N; x++)
+		actions.push_back(x);
+}
+
+/**
+ * Reverses the k tiles starting at tile a, wrapping around the ring.
+ */
+template <int N, int k>
+void FixedTopSpin<N, k>::ApplyAction(state &s, TopSpinAction a) const
+{
+	for (int x = 0; x < k/2; x++)
+	{
+		int from = (a+x)%N, to = (a+k-1-x)%N;
+		int8_t tmp = s.puzzle[from];
+		s.puzzle[from] = s.puzzle[to];
+		s.puzzle[to] = tmp;
+	}
+}
+
+#endif
@@ -0,0 +1,265 @@
+//
+//  GridDifferentialHeuristic.cpp
+//  hog2
+//
+//  A differential heuristic for MapEnvironment built directly on the grid.
+//
+
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <queue>
+#include <functional>
+#include "GridDifferentialHeuristic.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+// the largest stored distance; 0xFFFF marks cells the pivot can't reach
+static const unsigned kMaxStoredDistance = 0xFFFE;
+static const uint16_t kUnreachable = 0xFFFF;
+
+GridDifferentialHeuristic::GridDifferentialHeuristic(MapEnvironment *e, int numPivots, int numThreads)
+:env(e), stride(0), scale(1), entries(0)
+{
+	Map *m = env->GetMap();
+	width = m->GetMapWidth();
+	height = m->GetMapHeight();
+	numThreads = std::max(1, numThreads);
+	uint64_t cells = uint64_t(width)*height;
+
+	open.resize(cells);
+	std::vector<xyLoc> succ;
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			env->GetSuccessors(xyLoc(x, y), succ);
+			open[uint64_t(y)*width+x] = (succ.size() > 0);
+		}
+	}
+	int64_t seed = FindLargestRegion();
+	if (seed == -1 || numPivots <= 0)
+		return;
+
+	// the first pivot is the cell farthest from a cell of the largest
+	// region; the rest of the map is never farther, so no pivots go there
+	std::vector<double> minDist;
+	BuildTable(xyLoc(seed%width, seed/width), &minDist);
+	std::vector<std::vector<double> > dist(numPivots);
+	while ((int)pivots.size() < numPivots)
+	{
+		int start = pivots.size();
+		int count = PlacePivots(std::min(numThreads, numPivots-start), minDist);
+		if (count == 0)
+			break;
+		std::vector<std::thread> threads;
+		for (int x = 0; x < count; x++)
+			threads.push_back(std::thread(&GridDifferentialHeuristic::BuildTable, this, pivots[start+x], &dist[start+x]));
+		for (int x = 0; x < count; x++)
+			threads[x].join();
+		if (start == 0)
+			minDist.assign(cells, DBL_MAX);
+		for (int x = start; x < start+count; x++)
+			for (uint64_t c = 0; c < cells; c++)
+				minDist[c] = std::min(minDist[c], dist[x][c]);
+	}
+	dist.resize(pivots.size());
+
+	double maxDist = 0;
+	for (unsigned int x = 0; x < dist.size(); x++)
+		for (uint64_t c = 0; c < cells; c++)
+			if (dist[x][c] != DBL_MAX)
+				maxDist = std::max(maxDist, dist[x][c]);
+	if (maxDist > 0)
+		scale = maxDist/kMaxStoredDistance;
+
+	stride = (pivots.size()+7)&~7;
+	// room to start the entries on a 64-byte line
+	table.assign(cells*stride+32, 0);
+	entries = (uint16_t *)(((uintptr_t)&table[0]+63)&~uintptr_t(63));
+	for (uint64_t c = 0; c < cells; c++)
+	{
+		for (unsigned int x = 0; x < dist.size(); x++)
+		{
+			if (dist[x][c] == DBL_MAX)
+				entries[c*stride+x] = kUnreachable;
+			else
+				entries[c*stride+x] = std::min(kMaxStoredDistance, (unsigned)floor(dist[x][c]/scale));
+		}
+	}
+}
+
+/**
+ * Fills dist with the distance from from to each cell, or DBL_MAX if it
+ * can't be reached, with Dijkstra's algorithm.
+ */
+void GridDifferentialHeuristic::BuildTable(xyLoc from, std::vector<double> *dist)
+{
+	typedef std::pair<double, uint64_t> entry;
+	std::priority_queue<entry, std::vector<entry>, std::greater<entry> > q;
+	std::vector<xyLoc> succ;
+	dist->assign(uint64_t(width)*height, DBL_MAX);
+	uint64_t start = uint64_t(from.y)*width+from.x;
+	(*dist)[start] = 0;
+	q.push(entry(0, start));
+	while (!q.empty())
+	{
+		entry next = q.top();
+		q.pop();
+		if (next.first > (*dist)[next.second])
+			continue;
+		xyLoc l(next.second%width, next.second/width);
+		env->GetSuccessors(l, succ);
+		for (unsigned int x = 0; x < succ.size(); x++)
+		{
+			uint64_t c = uint64_t(succ[x].y)*width+succ[x].x;
+			double d = next.first+env->GCost(l, succ[x]);
+			if (d < (*dist)[c])
+			{
+				(*dist)[c] = d;
+				q.push(entry(d, c));
+			}
+		}
+	}
+}
+
+/**
+ * Returns a cell of the largest set of open cells connected to each
+ * other, or -1 if there are no open cells.
+ */
+int64_t GridDifferentialHeuristic::FindLargestRegion() const
+{
+	std::vector<bool> seen(open.size());
+	std::vector<uint64_t> stack;
+	std::vector<xyLoc> succ;
+	int64_t best = -1;
+	uint64_t bestSize = 0;
+	for (uint64_t c = 0; c < open.size(); c++)
+	{
+		if (!open[c] || seen[c])
+			continue;
+		uint64_t size = 0;
+		seen[c] = true;
+		stack.push_back(c);
+		while (stack.size() > 0)
+		{
+			uint64_t next = stack.back();
+			stack.pop_back();
+			size++;
+			env->GetSuccessors(xyLoc(next%width, next/width), succ);
+			for (unsigned int x = 0; x < succ.size(); x++)
+			{
+				uint64_t s = uint64_t(succ[x].y)*width+succ[x].x;
+				if (!seen[s])
+				{
+					seen[s] = true;
+					stack.push_back(s);
+				}
+			}
+		}
+		if (size > bestSize)
+		{
+			best = c;
+			bestSize = size;
+		}
+	}
+	return best;
+}
+
+/**
+ * Adds up to count pivots, each the cell farthest from the cells placed
+ * before it: by minDist for those already built, and by octile distance
+ * for those placed in this call. Returns the number added.
+ */
+int GridDifferentialHeuristic::PlacePivots(int count, const std::vector<double> &minDist)
+{
+	std::vector<double> farthest(minDist);
+	double diagonal = env->GetDiagonalCost();
+	for (int x = 0; x < count; x++)
+	{
+		uint64_t best = 0;
+		double bestDist = 0;
+		for (uint64_t c = 0; c < farthest.size(); c++)
+		{
+			if (open[c] && farthest[c] > bestDist && farthest[c] != DBL_MAX)
+			{
+				best = c;
+				bestDist = farthest[c];
+			}
+		}
+		if (bestDist == 0)
+			return x;
+		int bx = best%width, by = best/width;
+		pivots.push_back(xyLoc(bx, by));
+		for (uint64_t c = 0; c < farthest.size(); c++)
+		{
+			double dx = abs(int(c%width)-bx), dy = abs(int(c/width)-by);
+			double octile = (dx > dy)?(dy*diagonal+dx-dy):(dx*diagonal+dy-dx);
+			farthest[c] = std::min(farthest[c], octile);
+		}
+	}
+	return count;
+}
+
+/** The max over the first lanes values of |a[x]-b[x]|; lanes is a multiple of 8 */
+unsigned GridDifferentialHeuristic::MaxDifference(const uint16_t *a, const uint16_t *b, int lanes)
+{
+#if defined(__SSE2__)
+	__m128i best = _mm_setzero_si128();
+	for (int x = 0; x < lanes; x += 8)
+	{
+		__m128i va = _mm_load_si128((const __m128i *)(a+x));
+		__m128i vb = _mm_load_si128((const __m128i *)(b+x));
+		__m128i diff = _mm_or_si128(_mm_subs_epu16(va, vb), _mm_subs_epu16(vb, va));
+		// SSE2 has no unsigned 16-bit max; max(x, y) is (x-y saturated)+y
+		best = _mm_add_epi16(_mm_subs_epu16(best, diff), diff);
+	}
+	best = _mm_add_epi16(_mm_subs_epu16(best, _mm_srli_si128(best, 8)), _mm_srli_si128(best, 8));
+	best = _mm_add_epi16(_mm_subs_epu16(best, _mm_srli_si128(best, 4)), _mm_srli_si128(best, 4));
+	best = _mm_add_epi16(_mm_subs_epu16(best, _mm_srli_si128(best, 2)), _mm_srli_si128(best, 2));
+	return (unsigned)_mm_extract_epi16(best, 0);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+	uint16x8_t best = vdupq_n_u16(0);
+	for (int x = 0; x < lanes; x += 8)
+		best = vmaxq_u16(best, vabdq_u16(vld1q_u16(a+x), vld1q_u16(b+x)));
+	return vmaxvq_u16(best);
+#else
+	unsigned best = 0;
+	for (int x = 0; x < lanes; x++)
+		best = std::max(best, (unsigned)abs(int(a[x])-int(b[x])));
+	return best;
+#endif
+}
+
+double GridDifferentialHeuristic::GetDifferentialHCost(const xyLoc &a, const xyLoc &b) const
+{
+	if (stride == 0 || a.x >= width || a.y >= height || b.x >= width || b.y >= height)
+		return 0;
+	unsigned diff = MaxDifference(GetEntry(a), GetEntry(b), stride);
+	// each distance was rounded down by less than one step
+	return (diff > 0)?(diff-1)*scale:0;
+}
+
+double GridDifferentialHeuristic::HCost(const xyLoc &a, const xyLoc &b)
+{
+	return std::max(env->HCost(a, b), GetDifferentialHCost(a, b));
+}
+
+/**
+ * Prefetches the entries of all the states before reading any of them.
+ */
+void GridDifferentialHeuristic::BatchHCost(const xyLoc *states, int count, const xyLoc &goal, double *hcosts)
+{
+	if (stride != 0)
+	{
+		for (int x = 0; x < count; x++)
+			if (states[x].x < width && states[x].y < height)
+				__builtin_prefetch(GetEntry(states[x]));
+	}
+	for (int x = 0; x < count; x++)
+		hcosts[x] = HCost(states[x], goal);
+}
@@ -0,0 +1,72 @@
+//
+//  GridDifferentialHeuristic.h
+//  hog2
+//
+//  A differential heuristic for MapEnvironment built directly on the grid.
+//
+
+#ifndef GRIDDIFFERENTIALHEURISTIC_H
+#define GRIDDIFFERENTIALHEURISTIC_H
+
+#include <stdint.h>
+#include <vector>
+#include <thread>
+#include "Map2DEnvironment.h"
+
+/**
+ * The differential heuristic: the true distance from each of k pivots to
+ * every cell, and h(a, b) = max over the pivots p of |d(p, a)-d(p, b)|,
+ * maximized with the octile heuristic of the environment. Use it with
+ * TemplateAStar::SetHeuristic().
+ *
+ * Unlike GraphDistanceHeuristic, it needs no Graph of the map. Distances
+ * are quantized to 16 bits and stored cell-major, with the k values of a
+ * cell next to each other and padded to a multiple of 8, so a lookup reads
+ * one cache line for up to 32 pivots and the max is taken 8 pivots at a
+ * time with SSE2 or NEON.
+ *
+ * Distances are rounded down, and one step is taken off the result, so
+ * the heuristic is admissible; it can be inconsistent by less than one
+ * step along an edge, so A* should reopen nodes if paths must be optimal.
+ *
+ * Pivots are placed farthest-first in the largest connected region of the
+ * map; elsewhere only the octile heuristic is used. The tables are built in rounds of one
+ * pivot per thread: the first pivot of a round is the cell farthest from
+ * the existing pivots, and the rest are spread out using the octile
+ * distance to the pivots chosen earlier in the round.
+ */
+class GridDifferentialHeuristic : public Heuristic<xyLoc> {
+public:
+	GridDifferentialHeuristic(MapEnvironment *env, int numPivots,
+							  int numThreads = std::thread::hardware_concurrency());
+	double HCost(const xyLoc &a, const xyLoc &b);
+	void BatchHCost(const xyLoc *states, int count, const xyLoc &goal, double *hcosts);
+	/** The heuristic from the pivots alone, without the octile heuristic */
+	double GetDifferentialHCost(const xyLoc &a, const xyLoc &b) const;
+	int GetNumPivots() const { return pivots.size(); }
+	const xyLoc &GetPivot(int which) const { return pivots[which]; }
+	/** The size of one step of the stored distances */
+	double GetScale() const { return scale; }
+	uint64_t GetMemoryUsage() const { return table.size()*sizeof(uint16_t); }
+private:
+	void BuildTable(xyLoc from, std::vector<double> *dist);
+	int PlacePivots(int count, const std::vector<double> &minDist);
+	int64_t FindLargestRegion() const;
+	const uint16_t *GetEntry(const xyLoc &l) const
+	{ return entries+(uint64_t(l.y)*width+l.x)*stride; }
+	static unsigned MaxDifference(const uint16_t *a, const uint16_t *b, int lanes);
+
+	MapEnvironment *env;
+	int width, height;
+	// cells that have successors; pivots are placed only on these
+	std::vector<bool> open;
+	std::vector<xyLoc> pivots;
+	// values per cell: the number of pivots padded to a multiple of 8
+	int stride;
+	double scale;
+	std::vector<uint16_t> table;
+	// the first entry of table, aligned to a cache line
+	uint16_t *entries;
+};
+
+#endif
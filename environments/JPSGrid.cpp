@@ -0,0 +1,301 @@
+//
+//  JPSGrid.cpp
+//  hog2
+//
+//  Jump point search on octile maps, and JPS+ with precomputed jump
+//  distances.
+//
+
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <algorithm>
+#include "JPSGrid.h"
+
+namespace CanonicalGrid {
+
+	// directions in the order successors are generated, and in the JPS+ table
+	static const tDirection kJPSDirections[8] = {kN, kW, kS, kE, kNW, kNE, kSW, kSE};
+
+	static int GetDX(tDirection dir) { return (dir&kE)?1:((dir&kW)?-1:0); }
+	static int GetDY(tDirection dir) { return (dir&kS)?1:((dir&kN)?-1:0); }
+
+	/**
+	 * Scans row y of g from x in direction dir (1 or -1) for a cell with a
+	 * forced neighbor or for (gx, gy). Returns the distance to it, or minus
+	 * the number of open cells before the scan reaches a wall.
+	 */
+	static int JumpRow(const MapBitGrid &g, int x, int y, int dir, int gx, int gy)
+	{
+		int goalDist = (gy == y)?(gx-x)*dir:-1;
+		for (int start = x; ; start += 64*dir)
+		{
+			uint64_t open, forced;
+			int i;
+			if (dir > 0)
+			{
+				// bit i is cell start+1+i; the cells beside the previous cell are one bit lower
+				open = g.GetWord(start+1, y);
+				forced = (~g.GetWord(start, y-1)&g.GetWord(start+1, y-1))|(~g.GetWord(start, y+1)&g.GetWord(start+1, y+1));
+				uint64_t stop = ~open|forced;
+				if (stop == 0)
+					continue;
+				i = __builtin_ctzll(stop);
+				open = (open>>i)&1;
+			}
+			else {
+				// bit 63-i is cell start-1-i; the cells beside the previous cell are one bit higher
+				open = g.GetWord(start-64, y);
+				forced = (~g.GetWord(start-63, y-1)&g.GetWord(start-64, y-1))|(~g.GetWord(start-63, y+1)&g.GetWord(start-64, y+1));
+				uint64_t stop = ~open|forced;
+				if (stop == 0)
+					continue;
+				i = __builtin_clzll(stop);
+				open = (open>>(63-i))&1;
+			}
+			int dist = (start-x)*dir+1+i;
+			int run = open?dist:dist-1;
+			if (goalDist > 0 && goalDist <= run)
+				return goalDist;
+			return open?dist:-run;
+		}
+	}
+
+	JPSGrid::JPSGrid(Map *m)
+	:CanonicalGrid(m), goalX(-1), goalY(-1)
+	{
+		rows.Build(m);
+		columns.Build(m, kGround, true);
+	}
+
+	int JPSGrid::JumpStraight(int x, int y, tDirection dir, int gx, int gy) const
+	{
+		switch (dir)
+		{
+			case kE: return JumpRow(rows, x, y, 1, gx, gy);
+			case kW: return JumpRow(rows, x, y, -1, gx, gy);
+			case kS: return JumpRow(columns, y, x, 1, gy, gx);
+			case kN: return JumpRow(columns, y, x, -1, gy, gx);
+			default: assert(false); return 0;
+		}
+	}
+
+	int JPSGrid::JumpDiagonal(int x, int y, tDirection dir, int gx, int gy) const
+	{
+		int dx = GetDX(dir), dy = GetDY(dir);
+		for (int dist = 1; ; dist++)
+		{
+			if (!rows.Get(x+dx, y) || !rows.Get(x, y+dy) || !rows.Get(x+dx, y+dy))
+				return -(dist-1);
+			x += dx;
+			y += dy;
+			if (x == gx && y == gy)
+				return dist;
+			if (JumpRow(rows, x, y, dx, gx, gy) > 0 || JumpRow(columns, y, x, dy, gy, gx) > 0)
+				return dist;
+		}
+	}
+
+	xyLoc JPSGrid::GetStraightJumpPoint(const xyLoc &loc, tDirection dir, int dist) const
+	{
+		int dx = GetDX(dir), dy = GetDY(dir);
+		int x = loc.x+dist*dx, y = loc.y+dist*dy;
+		int parent = dir;
+		// the forced neighbors are beside the jump point where the previous cell is blocked
+		if (dx != 0)
+		{
+			if (!rows.Get(x-dx, y-1) && rows.Get(x, y-1))
+				parent |= kN;
+			if (!rows.Get(x-dx, y+1) && rows.Get(x, y+1))
+				parent |= kS;
+		}
+		else {
+			if (!rows.Get(x-1, y-dy) && rows.Get(x-1, y))
+				parent |= kW;
+			if (!rows.Get(x+1, y-dy) && rows.Get(x+1, y))
+				parent |= kE;
+		}
+		return xyLoc(x, y, tDirection(parent));
+	}
+
+	void JPSGrid::GetSuccessors(const xyLoc &loc, std::vector<xyLoc> &neighbors) const
+	{
+		assert(goalX != -1);
+		neighbors.resize(0);
+		for (int x = 0; x < 4; x++)
+		{
+			tDirection dir = kJPSDirections[x];
+			if ((loc.parent&dir) == 0)
+				continue;
+			int dist = JumpStraight(loc.x, loc.y, dir, goalX, goalY);
+			if (dist > 0)
+				neighbors.push_back(GetStraightJumpPoint(loc, dir, dist));
+		}
+		for (int x = 4; x < 8; x++)
+		{
+			tDirection dir = kJPSDirections[x];
+			if ((loc.parent&dir) != dir)
+				continue;
+			int dist = JumpDiagonal(loc.x, loc.y, dir, goalX, goalY);
+			if (dist > 0)
+				neighbors.push_back(xyLoc(loc.x+dist*GetDX(dir), loc.y+dist*GetDY(dir), dir));
+		}
+	}
+
+	double JPSGrid::GCost(const xyLoc &l1, const xyLoc &l2)
+	{
+		int dx = abs(l1.x-l2.x), dy = abs(l1.y-l2.y);
+		return std::min(dx, dy)*DIAGONAL_COST+abs(dx-dy);
+	}
+
+	void JPSGrid::GetFullPath(const std::vector<xyLoc> &jumpPath, std::vector<xyLoc> &path) const
+	{
+		path.resize(0);
+		for (unsigned int x = 0; x < jumpPath.size(); x++)
+		{
+			xyLoc next = jumpPath[x];
+			if (path.size() > 0)
+			{
+				xyLoc curr = path.back();
+				int dx = (next.x > curr.x)?1:((next.x < curr.x)?-1:0);
+				int dy = (next.y > curr.y)?1:((next.y < curr.y)?-1:0);
+				while (curr != next)
+				{
+					curr.x += dx;
+					curr.y += dy;
+					if (curr != next)
+						path.push_back(curr);
+				}
+			}
+			path.push_back(next);
+		}
+	}
+
+	JPSPlusGrid::JPSPlusGrid(Map *m, const char *jumpFile)
+	:JPSGrid(m), loaded(false)
+	{
+		assert(m->GetMapWidth() < 32768 && m->GetMapHeight() < 32768);
+		if (jumpFile != 0 && Load(jumpFile))
+		{
+			loaded = true;
+			return;
+		}
+		BuildJumpDistances();
+		if (jumpFile != 0 && !Save(jumpFile))
+			printf("Unable to save jump distances to '%s'\n", jumpFile);
+	}
+
+	void JPSPlusGrid::BuildJumpDistances()
+	{
+		int width = rows.GetWidth(), height = rows.GetHeight();
+		distances.assign(uint64_t(width)*height*8, 0);
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				if (!rows.Get(x, y))
+					continue;
+				int16_t *entry = &distances[(uint64_t(y)*width+x)*8];
+				for (int d = 0; d < 4; d++)
+					entry[d] = JumpStraight(x, y, kJPSDirections[d], -1, -1);
+				for (int d = 4; d < 8; d++)
+					entry[d] = JumpDiagonal(x, y, kJPSDirections[d], -1, -1);
+			}
+		}
+	}
+
+	void JPSPlusGrid::GetSuccessors(const xyLoc &loc, std::vector<xyLoc> &neighbors) const
+	{
+		assert(goalX != -1);
+		neighbors.resize(0);
+		// distance to the goal along each axis, in the direction of the moves
+		int goalDX = goalX-loc.x, goalDY = goalY-loc.y;
+		for (int x = 0; x < 4; x++)
+		{
+			tDirection dir = kJPSDirections[x];
+			if ((loc.parent&dir) == 0)
+				continue;
+			int dist = GetDistance(loc.x, loc.y, x);
+			int dx = GetDX(dir), dy = GetDY(dir);
+			int goalDist = (dx != 0)?((goalDY == 0)?goalDX*dx:-1):((goalDX == 0)?goalDY*dy:-1);
+			if (goalDist > 0 && goalDist <= abs(dist))
+				neighbors.push_back(xyLoc(goalX, goalY, dir));
+			else if (dist > 0)
+				neighbors.push_back(GetStraightJumpPoint(loc, dir, dist));
+		}
+		for (int x = 4; x < 8; x++)
+		{
+			tDirection dir = kJPSDirections[x];
+			if ((loc.parent&dir) != dir)
+				continue;
+			int dist = GetDistance(loc.x, loc.y, x);
+			int dx = GetDX(dir), dy = GetDY(dir);
+			// stop where the diagonal reaches the goal's row or column, so a
+			// straight jump from there can find the goal
+			int steps = std::min(goalDX*dx, goalDY*dy);
+			if (steps > 0 && steps <= abs(dist))
+				neighbors.push_back(xyLoc(loc.x+steps*dx, loc.y+steps*dy, dir));
+			else if (dist > 0)
+				neighbors.push_back(xyLoc(loc.x+dist*dx, loc.y+dist*dy, dir));
+		}
+	}
+
+	uint64_t JPSPlusGrid::GetGridHash() const
+	{
+		// FNV-1a over the words of the rows
+		uint64_t hash = 0xCBF29CE484222325ull;
+		for (int y = 0; y < rows.GetHeight(); y++)
+		{
+			for (int x = 0; x < rows.GetWidth(); x += 64)
+			{
+				uint64_t word = rows.GetWord(x, y);
+				for (int b = 0; b < 8; b++)
+				{
+					hash ^= (word>>(8*b))&0xFF;
+					hash *= 0x100000001B3ull;
+				}
+			}
+		}
+		return hash;
+	}
+
+	static const char kJPSPlusMagic[4] = {'J', 'P', 'S', '+'};
+	static const uint32_t kJPSPlusVersion = 1;
+
+	bool JPSPlusGrid::Save(const char *fname) const
+	{
+		FILE *f = fopen(fname, "w");
+		if (f == 0)
+			return false;
+		uint32_t header[3] = {kJPSPlusVersion, (uint32_t)rows.GetWidth(), (uint32_t)rows.GetHeight()};
+		uint64_t hash = GetGridHash();
+		bool result = (fwrite(kJPSPlusMagic, sizeof(kJPSPlusMagic), 1, f) == 1 &&
+					   fwrite(header, sizeof(header), 1, f) == 1 &&
+					   fwrite(&hash, sizeof(hash), 1, f) == 1 &&
+					   fwrite(&distances[0], sizeof(int16_t), distances.size(), f) == distances.size());
+		if (fclose(f) != 0)
+			result = false;
+		return result;
+	}
+
+	bool JPSPlusGrid::Load(const char *fname)
+	{
+		FILE *f = fopen(fname, "r");
+		if (f == 0)
+			return false;
+		char magic[4];
+		uint32_t header[3];
+		uint64_t hash;
+		bool result = (fread(magic, sizeof(magic), 1, f) == 1 && memcmp(magic, kJPSPlusMagic, sizeof(magic)) == 0 &&
+					   fread(header, sizeof(header), 1, f) == 1 && header[0] == kJPSPlusVersion &&
+					   header[1] == (uint32_t)rows.GetWidth() && header[2] == (uint32_t)rows.GetHeight() &&
+					   fread(&hash, sizeof(hash), 1, f) == 1 && hash == GetGridHash());
+		if (result)
+		{
+			distances.resize(uint64_t(rows.GetWidth())*rows.GetHeight()*8);
+			result = (fread(&distances[0], sizeof(int16_t), distances.size(), f) == distances.size());
+		}
+		fclose(f);
+		return result;
+	}
+}
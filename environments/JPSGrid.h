@@ -0,0 +1,92 @@
+//
+//  JPSGrid.h
+//  hog2
+//
+//  Jump point search on octile maps, and JPS+ with precomputed jump
+//  distances.
+//
+
+#ifndef JPSGRID_H
+#define JPSGRID_H
+
+#include <stdint.h>
+#include <vector>
+#include "CanonicalGrid.h"
+#include "MapBitGrid.h"
+
+namespace CanonicalGrid {
+
+	/**
+	 * Jump point search as an environment for TemplateAStar. States are the
+	 * CanonicalGrid states, whose parent bits give the directions to search
+	 * from a state, and the successors of a state are the jump points found
+	 * by jumping in those directions instead of its neighbors: the first
+	 * cell in each direction where the canonical ordering of CanonicalGrid
+	 * branches. A straight jump stops at a cell with a forced neighbor (the
+	 * cell beside the previous one is blocked but the cell beside it is
+	 * open); a diagonal jump stops at a cell from which a straight jump finds
+	 * a jump point. Both stop at the goal, so the goal must be given to
+	 * StoreGoal() before searching. Costs between jump points are octile
+	 * distances; GetFullPath() fills in the cells between them.
+	 *
+	 * Rows are scanned 64 cells at a time in a MapBitGrid, and columns in a
+	 * transposed MapBitGrid. Like CanonicalGrid, only 8-connected maps where
+	 * the open cells are kGround are supported.
+	 */
+	class JPSGrid : public CanonicalGrid {
+	public:
+		JPSGrid(Map *m);
+		virtual void GetSuccessors(const xyLoc &nodeID, std::vector<xyLoc> &neighbors) const;
+		using CanonicalGrid::GCost;
+		double GCost(const xyLoc &node1, const xyLoc &node2);
+		void StoreGoal(xyLoc &s) { goalX = s.x; goalY = s.y; }
+		void ClearGoal() { goalX = goalY = -1; }
+		bool IsGoalStored() { return goalX != -1; }
+		/** Fills path with every cell of the path between the jump points */
+		void GetFullPath(const std::vector<xyLoc> &jumpPath, std::vector<xyLoc> &path) const;
+	protected:
+		/**
+		 * Distance to the jump point in a straight direction, or minus the
+		 * number of open cells before a wall; (gx, gy) is the goal.
+		 */
+		int JumpStraight(int x, int y, tDirection dir, int gx, int gy) const;
+		/** As JumpStraight(), but diagonally */
+		int JumpDiagonal(int x, int y, tDirection dir, int gx, int gy) const;
+		/** The jump point dist cells away in a straight direction, with its parent bits */
+		xyLoc GetStraightJumpPoint(const xyLoc &loc, tDirection dir, int dist) const;
+		MapBitGrid rows, columns;
+		int goalX, goalY;
+	};
+
+	/**
+	 * JPS+: jump point search with the result of jumping from each cell in
+	 * each direction computed ahead of time, so that generating a successor
+	 * is a table lookup rather than a scan. Each entry is the distance to the
+	 * jump point, or minus the distance to a wall, computed without a goal;
+	 * the goal is found at search time when it lies within a jump. The table
+	 * takes 16 bytes per cell and can be saved to a file kept with the map.
+	 */
+	class JPSPlusGrid : public JPSGrid {
+	public:
+		/**
+		 * Loads the jump distances from jumpFile if it matches the map, or
+		 * computes them and, if jumpFile isn't null, saves them there.
+		 */
+		JPSPlusGrid(Map *m, const char *jumpFile = 0);
+		virtual void GetSuccessors(const xyLoc &nodeID, std::vector<xyLoc> &neighbors) const;
+		void BuildJumpDistances();
+		bool Save(const char *fname) const;
+		/** Returns false if the file is missing or was built for a different map */
+		bool Load(const char *fname);
+		/** True if the distances were loaded from the file given to the constructor */
+		bool LoadedFromFile() const { return loaded; }
+	private:
+		uint64_t GetGridHash() const;
+		int GetDistance(int x, int y, int dir) const
+		{ return distances[(uint64_t(y)*rows.GetWidth()+x)*8+dir]; }
+		std::vector<int16_t> distances;
+		bool loaded;
+	};
+}
+
+#endif
@@ -279,12 +279,8 @@ void MNPuzzle::GetSuccessors(const MNPuzzleState &stateID,
                              std::vector<MNPuzzleState> &neighbors) const
 {
 	neighbors.resize(0);
-	
-	for (unsigned int i = 0; i < operators[stateID.blank].size(); i++)
-	{
-		neighbors.push_back(stateID);
-		ApplyAction(neighbors.back(), operators[stateID.blank][i]);
-	}
+	SuccessorAppender<MNPuzzleState> append(neighbors);
+	ForEachSuccessor(stateID, append);
 }
 
 void MNPuzzle::GetActions(const MNPuzzleState &stateID, std::vector<slideDir> &actions) const
@@ -507,6 +503,18 @@ double MNPuzzle::HCost(const MNPuzzleState &state1, const MNPuzzleState &state2)
 	return hval;
 }
 
+/**
+ * With a stored goal, evaluates the lookup tree for all the states with
+ * their PDB entries prefetched; otherwise calls HCost() for each state.
+ */
+void MNPuzzle::BatchHCost(const MNPuzzleState *states, int count, const MNPuzzleState &goal, double *hcosts)
+{
+	if (goal_stored)
+		PermutationPuzzleEnvironment<MNPuzzleState, slideDir>::HCost(states, count, hcosts);
+	else
+		SearchEnvironment<MNPuzzleState, slideDir>::BatchHCost(states, count, goal, hcosts);
+}
+
 double MNPuzzle::DefaultH(const MNPuzzleState &state) const
 {
 	double man_dist = 0;
@@ -591,26 +599,9 @@ void MNPuzzle::GetStateFromPDBHash(uint64_t hash, MNPuzzleState &s,
 								   int count, const std::vector<int> &pattern,
 								   std::vector<int> &dual)
 {
-	uint64_t hashVal = hash;
-	dual.resize(pattern.size());
-	
-	int numEntriesLeft = count-pattern.size()+1;
-	for (int x = pattern.size()-1; x >= 0; x--)
-	{
-		dual[x] = hashVal%numEntriesLeft;
-		hashVal /= numEntriesLeft;
-		numEntriesLeft++;
-		for (int y = x+1; y < pattern.size(); y++)
-		{
-			if (dual[y] >= dual[x])
-				dual[y]++;
-		}
-	}
-	s.puzzle.resize(count);
-	std::fill(s.puzzle.begin(), s.puzzle.end(), -1);
+	PermutationPuzzleEnvironment<MNPuzzleState, slideDir>::GetStateFromPDBHash(hash, s, count, pattern, dual);
 	for (int x = 0; x < dual.size(); x++)
 	{
-		s.puzzle[dual[x]] = pattern[x];
 		if (pattern[x] == 0)
 			s.blank = dual[x];
 	}
@@ -94,6 +94,9 @@ public:
 	void SetWeighted(bool w) { weighted = w; }
 	bool GetWeighted() const { return weighted; }
 	void GetSuccessors(const MNPuzzleState &stateID, std::vector<MNPuzzleState> &neighbors) const;
+	int GetNumSuccessors(const MNPuzzleState &stateID) const { return operators[stateID.blank].size(); }
+	template <class visitor>
+	void ForEachSuccessor(const MNPuzzleState &stateID, visitor &v) const;
 	void GetActions(const MNPuzzleState &stateID, std::vector<slideDir> &actions) const;
 	slideDir GetAction(const MNPuzzleState &s1, const MNPuzzleState &s2) const;
 	void ApplyAction(MNPuzzleState &s, slideDir a) const;
@@ -104,6 +107,7 @@ public:
 	double HCost(const MNPuzzleState &state1, const MNPuzzleState &state2);
 	double HCost(const MNPuzzleState &state1)
 	{ return PermutationPuzzleEnvironment<MNPuzzleState, slideDir>::HCost(state1); }
+	void BatchHCost(const MNPuzzleState *states, int count, const MNPuzzleState &goal, double *hcosts);
 	double DefaultH(const MNPuzzleState &s) const;
 
 	double GCost(const MNPuzzleState &state1, const MNPuzzleState &state2);
@@ -135,6 +139,8 @@ public:
 	}
 
 	virtual const std::string GetName();
+	std::string GetPDBDomain() const
+	{ return "STP "+std::to_string(width)+"x"+std::to_string(height); }
 
 	void ClearGoal(); // clears the current stored information of the goal
 
@@ -221,6 +227,30 @@ private:
 	std::vector<std::vector<int> > hDist;
 };
 
+template <>
+struct UsesSuccessorVisitor<MNPuzzle> {
+	static const bool value = true;
+};
+
+/**
+ * Calls v on each successor, in the order used by GetSuccessors(). The
+ * successors are made by moving a single copy of the state back and forth.
+ */
+template <class visitor>
+void MNPuzzle::ForEachSuccessor(const MNPuzzleState &stateID, visitor &v) const
+{
+	MNPuzzleState child(stateID);
+	const std::vector<slideDir> &ops = operators[stateID.blank];
+	for (unsigned int i = 0; i < ops.size(); i++)
+	{
+		ApplyAction(child, ops[i]);
+		v(child);
+		slideDir undo = ops[i];
+		InvertAction(undo);
+		ApplyAction(child, undo);
+	}
+}
+
 class GraphPuzzleDistanceHeuristic : public GraphDistanceHeuristic {
 public:
 	GraphPuzzleDistanceHeuristic(MNPuzzle &mnp, Graph *graph, int count);
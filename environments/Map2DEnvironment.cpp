@@ -20,6 +20,8 @@ MapEnvironment::MapEnvironment(Map *_m, bool useOccupancy)
 		oi = 0;
 	h = 0;
 	fourConnected = false;
+	useBitGrid = true;
+	UpdateBitGrid();
 }
 
 MapEnvironment::MapEnvironment(MapEnvironment *me)
@@ -31,6 +33,8 @@ MapEnvironment::MapEnvironment(MapEnvironment *me)
 	else oi = 0;
 	DIAGONAL_COST = me->DIAGONAL_COST;
 	fourConnected = me->fourConnected;
+	useBitGrid = me->useBitGrid;
+	UpdateBitGrid();
 }
 
 MapEnvironment::~MapEnvironment()
@@ -39,6 +43,14 @@ MapEnvironment::~MapEnvironment()
 	delete oi;
 }
 
+void MapEnvironment::UpdateBitGrid()
+{
+	if (useBitGrid && map->GetMapType() == kOctile)
+		bitGrid.Build(map);
+	else
+		bitGrid = MapBitGrid();
+}
+
 GraphHeuristic *MapEnvironment::GetGraphHeuristic()
 {
 	return h;
@@ -52,34 +64,15 @@ void MapEnvironment::SetGraphHeuristic(GraphHeuristic *gh)
 void MapEnvironment::GetSuccessors(const xyLoc &loc, std::vector<xyLoc> &neighbors) const
 {
 	neighbors.resize(0);
-	bool up=false, down=false;
-	// 
-	if ((map->CanStep(loc.x, loc.y, loc.x, loc.y+1)))
-	{
-		down = true;
-		neighbors.push_back(xyLoc(loc.x, loc.y+1));
-	}
-	if ((map->CanStep(loc.x, loc.y, loc.x, loc.y-1)))
-	{
-		up = true;
-		neighbors.push_back(xyLoc(loc.x, loc.y-1));
-	}
-	if ((map->CanStep(loc.x, loc.y, loc.x-1, loc.y)))
-	{
-		if (!fourConnected && (up && (map->CanStep(loc.x, loc.y, loc.x-1, loc.y-1))))
-			neighbors.push_back(xyLoc(loc.x-1, loc.y-1));
-		if (!fourConnected && (down && (map->CanStep(loc.x, loc.y, loc.x-1, loc.y+1))))
-			neighbors.push_back(xyLoc(loc.x-1, loc.y+1));
-		neighbors.push_back(xyLoc(loc.x-1, loc.y));
-	}
-	if ((map->CanStep(loc.x, loc.y, loc.x+1, loc.y)))
-	{
-		if (!fourConnected && (up && (map->CanStep(loc.x, loc.y, loc.x+1, loc.y-1))))
-			neighbors.push_back(xyLoc(loc.x+1, loc.y-1));
-		if (!fourConnected && (down && (map->CanStep(loc.x, loc.y, loc.x+1, loc.y+1))))
-			neighbors.push_back(xyLoc(loc.x+1, loc.y+1));
-		neighbors.push_back(xyLoc(loc.x+1, loc.y));
-	}
+	SuccessorAppender<xyLoc> append(neighbors);
+	ForEachSuccessor(loc, append);
+}
+
+int MapEnvironment::GetNumSuccessors(const xyLoc &loc) const
+{
+	SuccessorCounter count;
+	ForEachSuccessor(loc, count);
+	return count.count;
 }
 
 bool MapEnvironment::GetNextSuccessor(const xyLoc &currOpenNode, const xyLoc &goal,
@@ -347,6 +340,17 @@ bool MapEnvironment::GetNext8Successor(const xyLoc &currOpenNode, const xyLoc &g
 
 void MapEnvironment::GetActions(const xyLoc &loc, std::vector<tDirection> &actions) const
 {
+	unsigned moves;
+	if (GetBitGridMoves(loc, moves))
+	{
+		static const tDirection dirs[8] = {kS, kN, kNW, kSW, kW, kNE, kSE, kE};
+		while (moves)
+		{
+			actions.push_back(dirs[__builtin_ctz(moves)]);
+			moves &= moves-1;
+		}
+		return;
+	}
 	bool up=false, down=false;
 	if ((map->CanStep(loc.x, loc.y, loc.x, loc.y+1)))
 	{
@@ -14,6 +14,7 @@
 #include <stdlib.h>
 #include <iostream>
 #include "Map.h"
+#include "MapBitGrid.h"
 #include "MapAbstraction.h"
 #include "SearchEnvironment.h"
 #include "UnitSimulation.h"
@@ -93,6 +94,9 @@ public:
 	void SetGraphHeuristic(GraphHeuristic *h);
 	GraphHeuristic *GetGraphHeuristic();
 	virtual void GetSuccessors(const xyLoc &nodeID, std::vector<xyLoc> &neighbors) const;
+	virtual int GetNumSuccessors(const xyLoc &nodeID) const;
+	template <class visitor>
+	void ForEachSuccessor(const xyLoc &loc, visitor &v) const;
 	bool GetNextSuccessor(const xyLoc &currOpenNode, const xyLoc &goal, xyLoc &next, double &currHCost, uint64_t &special, bool &validMove);
 	bool GetNext4Successor(const xyLoc &currOpenNode, const xyLoc &goal, xyLoc &next, double &currHCost, uint64_t &special, bool &validMove);
 	bool GetNext8Successor(const xyLoc &currOpenNode, const xyLoc &goal, xyLoc &next, double &currHCost, uint64_t &special, bool &validMove);
@@ -141,16 +145,101 @@ public:
 	bool EightConnected() { return !fourConnected; }
 	void SetFourConnected() { fourConnected = true; }
 	void SetEightConnected() { fourConnected = false; }
+	/** Whether successors on octile maps come from a MapBitGrid rather than Map::CanStep() */
+	void SetUseBitGrid(bool use) { useBitGrid = use; UpdateBitGrid(); }
+	bool GetUseBitGrid() const { return useBitGrid; }
+	/**
+	 * Rebuilds the bit grid from the map. Call it after changing the map;
+	 * until then successors come from Map::CanStep().
+	 */
+	void UpdateBitGrid();
 	//virtual BaseMapOccupancyInterface* GetOccupancyInterface(){std::cout<<"Mapenv\n";return oi;}
 	//virtual xyLoc GetNextState(xyLoc &s, tDirection dir);
 protected:
+	bool GetBitGridMoves(const xyLoc &loc, unsigned &moves) const;
 	GraphHeuristic *h;
 	Map *map;
 	BaseMapOccupancyInterface *oi;
 	double DIAGONAL_COST;
 	bool fourConnected;
+	bool useBitGrid;
+	// only built by UpdateBitGrid(), so searches in many threads can share it
+	MapBitGrid bitGrid;
 };
 
+/**
+ * Sets moves to the legal moves from loc (tMapBitGridMove bits). Returns
+ * false if the bit grid doesn't apply: the map isn't octile, the map has
+ * changed since the grid was built, or loc isn't ground, the class the
+ * grid is built for.
+ */
+inline bool MapEnvironment::GetBitGridMoves(const xyLoc &loc, unsigned &moves) const
+{
+	if (!useBitGrid || !bitGrid.IsCurrent(map))
+		return false;
+	if (loc.x >= bitGrid.GetWidth() || loc.y >= bitGrid.GetHeight())
+		return false;
+	unsigned block = bitGrid.GetNeighborhood(loc.x, loc.y);
+	if ((block&0x10) == 0)
+		return false;
+	moves = MapBitGrid::GetMoves(block, fourConnected);
+	return true;
+}
+
+template <>
+struct UsesSuccessorVisitor<MapEnvironment> {
+	static const bool value = true;
+};
+
+/**
+ * Calls v on each successor, in the order used by GetSuccessors().
+ */
+template <class visitor>
+void MapEnvironment::ForEachSuccessor(const xyLoc &loc, visitor &v) const
+{
+	unsigned moves;
+	if (GetBitGridMoves(loc, moves))
+	{
+		// offsets of the moves, in the order of their bits
+		static const int dx[8] = {0, 0, -1, -1, -1, 1, 1, 1};
+		static const int dy[8] = {1, -1, -1, 1, 0, -1, 1, 0};
+		while (moves)
+		{
+			int which = __builtin_ctz(moves);
+			moves &= moves-1;
+			v(xyLoc(loc.x+dx[which], loc.y+dy[which]));
+		}
+		return;
+	}
+	bool up=false, down=false;
+	if ((map->CanStep(loc.x, loc.y, loc.x, loc.y+1)))
+	{
+		down = true;
+		v(xyLoc(loc.x, loc.y+1));
+	}
+	if ((map->CanStep(loc.x, loc.y, loc.x, loc.y-1)))
+	{
+		up = true;
+		v(xyLoc(loc.x, loc.y-1));
+	}
+	if ((map->CanStep(loc.x, loc.y, loc.x-1, loc.y)))
+	{
+		if (!fourConnected && (up && (map->CanStep(loc.x, loc.y, loc.x-1, loc.y-1))))
+			v(xyLoc(loc.x-1, loc.y-1));
+		if (!fourConnected && (down && (map->CanStep(loc.x, loc.y, loc.x-1, loc.y+1))))
+			v(xyLoc(loc.x-1, loc.y+1));
+		v(xyLoc(loc.x-1, loc.y));
+	}
+	if ((map->CanStep(loc.x, loc.y, loc.x+1, loc.y)))
+	{
+		if (!fourConnected && (up && (map->CanStep(loc.x, loc.y, loc.x+1, loc.y-1))))
+			v(xyLoc(loc.x+1, loc.y-1));
+		if (!fourConnected && (down && (map->CanStep(loc.x, loc.y, loc.x+1, loc.y+1))))
+			v(xyLoc(loc.x+1, loc.y+1));
+		v(xyLoc(loc.x+1, loc.y));
+	}
+}
+
 class AbsMapEnvironment : public MapEnvironment
 {
 public:
@@ -0,0 +1,303 @@
+/*
+ *  PDBFile.h
+ *  hog2
+ *
+ *  On-disk format for permutation PDBs, and storage for PDB entries that
+ *  are either held in memory or mapped read-only from such a file.
+ *
+ */
+
+#ifndef PDBFILE_H
+#define PDBFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <sys/stat.h>
+#include <vector>
+#include <string>
+#include <memory>
+#include <algorithm>
+#include "MMapUtil.h"
+#include "PermutationRanking.h"
+
+const char kPDBFileMagic[8] = {'h', 'o', 'g', '2', 'p', 'd', 'b', 0};
+const uint32_t kPDBFileVersion = 1;
+/** Entries start on a page boundary, so that the mapped entries are page aligned */
+const uint32_t kPDBFileHeaderBytes = 4096;
+
+/**
+ * Header at the start of a PDB file. The entries follow at headerBytes.
+ * Values are stored in the byte order of the machine that wrote the file.
+ */
+struct PDBFileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerBytes;
+	/** Name of the domain, from PermutationPuzzleEnvironment::GetPDBDomain() */
+	char domain[32];
+	uint32_t puzzleSize;
+	uint32_t patternSize;
+	int32_t pattern[kMaxRankedItems];
+	/** PDBTreeNodeType of the leaf that reads the entries; kLeafNode if uncompressed */
+	uint32_t compression;
+	/** 8, 4 or 2; see PDBEntries */
+	uint32_t entryBits;
+	uint64_t numEntries;
+	/** 64-bit FNV-1a hash of the bytes holding the entries */
+	uint64_t checksum;
+};
+
+static_assert(sizeof(PDBFileHeader) <= kPDBFileHeaderBytes, "PDB file header doesn't fit before the entries");
+
+/**
+ * 64-bit FNV-1a hash of count bytes, used as the checksum of PDB entries.
+ */
+inline uint64_t PDBChecksum(const uint8_t *data, uint64_t count)
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for (uint64_t x = 0; x < count; x++)
+	{
+		hash ^= data[x];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+/**
+ * Reads the header of a PDB file. Returns false if the file can't be opened
+ * or doesn't start with a PDB header, as with PDBs written before the
+ * header was added.
+ */
+inline bool ReadPDBFileHeader(const char *fname, PDBFileHeader &header)
+{
+	FILE *f = fopen(fname, "r");
+	if (f == 0)
+		return false;
+	bool result = (fread(&header, sizeof(header), 1, f) == 1 &&
+				   memcmp(header.magic, kPDBFileMagic, sizeof(kPDBFileMagic)) == 0);
+	fclose(f);
+	return result;
+}
+
+/**
+ * True if the file is long enough to hold the entries its header describes,
+ * so a file cut short is not mapped and then read past its end.
+ */
+inline bool PDBFileHasEntries(const char *fname, const PDBFileHeader &header)
+{
+	struct stat sb;
+	if (stat(fname, &sb) != 0)
+		return false;
+	return uint64_t(sb.st_size) >= header.headerBytes+(header.numEntries*header.entryBits+7)/8;
+}
+
+/**
+ * Writes numEntries entries of header.entryBits bits each to a PDB file with
+ * the given header, whose magic, version, headerBytes, numEntries and
+ * checksum are filled in. Returns false if the file can't be written.
+ */
+inline bool WritePDBFile(const char *fname, PDBFileHeader &header, const uint8_t *entries, uint64_t numEntries)
+{
+	uint64_t count = (numEntries*header.entryBits+7)/8;
+	memcpy(header.magic, kPDBFileMagic, sizeof(kPDBFileMagic));
+	header.version = kPDBFileVersion;
+	header.headerBytes = kPDBFileHeaderBytes;
+	header.numEntries = numEntries;
+	header.checksum = PDBChecksum(entries, count);
+
+	FILE *f = fopen(fname, "w");
+	if (f == 0)
+		return false;
+	std::vector<uint8_t> block(kPDBFileHeaderBytes);
+	memcpy(&block[0], &header, sizeof(header));
+	bool result = (fwrite(&block[0], 1, block.size(), f) == block.size() &&
+				   fwrite(entries, 1, count, f) == count);
+	if (fclose(f) != 0)
+		result = false;
+	return result;
+}
+
+/**
+ * The entries of one PDB. They are either held in memory, or mapped
+ * read-only from a PDB file, in which case all processes using the file
+ * share one copy in the page cache. Reading works the same either way.
+ * Mapped entries can't be written; anything that changes them must call
+ * MakeWritable() first, which copies them into memory. resize() and swap()
+ * do this themselves.
+ *
+ * Entries are 8, 4 or 2 bits wide. Get() reads any width; operator[],
+ * resize() and swap() are for 8-bit entries only. 4-bit entries hold
+ * values up to 15, with larger values stored as 15. 2-bit entries hold
+ * the value mod 3, as in Breyer and Korf's 1.6-bit PDBs, and 3 for an
+ * entry that hasn't been reached. Searches use the value mod 3 as a lower
+ * bound; the value itself can be recovered from the values of neighboring
+ * entries, see PermutationPuzzleEnvironment::GetMod3PDBValue().
+ */
+class PDBEntries {
+public:
+	PDBEntries() :data(0), count(0), bits(8) {}
+	PDBEntries(const std::vector<uint8_t> &v) :entries(v), bits(8) { Sync(); }
+	PDBEntries(const PDBEntries &e) :entries(e.entries), mapping(e.mapping), data(e.data), count(e.count), bits(e.bits)
+	{ if (!mapping) Repoint(); }
+	PDBEntries(PDBEntries &&e) noexcept
+	:entries(std::move(e.entries)), mapping(std::move(e.mapping)), data(e.data), count(e.count), bits(e.bits)
+	{ if (!mapping) Repoint(); e.Clear(); }
+	PDBEntries &operator=(const PDBEntries &e)
+	{
+		if (this == &e)
+			return *this;
+		entries = e.entries;
+		mapping = e.mapping;
+		data = e.data;
+		count = e.count;
+		bits = e.bits;
+		if (!mapping)
+			Repoint();
+		return *this;
+	}
+	PDBEntries &operator=(PDBEntries &&e) noexcept
+	{
+		if (this == &e)
+			return *this;
+		entries = std::move(e.entries);
+		mapping = std::move(e.mapping);
+		data = e.data;
+		count = e.count;
+		bits = e.bits;
+		if (!mapping)
+			Repoint();
+		e.Clear();
+		return *this;
+	}
+
+	/** Number of entries */
+	uint64_t size() const { return count; }
+	int EntryBits() const { return bits; }
+	/** Number of bytes holding the entries */
+	uint64_t Bytes() const { return (count*bits+7)/8; }
+	uint8_t Get(uint64_t which) const
+	{
+		switch (bits)
+		{
+			case 4: return (data[which>>1]>>((which&1)*4))&0xF;
+			case 2: return (data[which>>2]>>((which&3)*2))&0x3;
+			default: return data[which];
+		}
+	}
+	/** Start loading the cache line holding an entry, ahead of Get() */
+	void Prefetch(uint64_t which) const { __builtin_prefetch(data+((which*bits)>>3)); }
+	uint8_t &operator[](uint64_t which) { assert(bits == 8); return data[which]; }
+	uint8_t operator[](uint64_t which) const { assert(bits == 8); return data[which]; }
+	/** The bytes holding the entries */
+	const uint8_t *begin() const { return data; }
+	const uint8_t *end() const { return data+Bytes(); }
+
+	void resize(uint64_t newCount)
+	{
+		assert(bits == 8);
+		MakeWritable();
+		entries.resize(newCount);
+		Sync();
+	}
+	void swap(std::vector<uint8_t> &v)
+	{
+		assert(bits == 8);
+		MakeWritable();
+		entries.swap(v);
+		Sync();
+	}
+	/**
+	 * Take count packed entries of the given width, stored as by Get(),
+	 * from v, which is left empty.
+	 */
+	void SetPacked(std::vector<uint8_t> &v, uint64_t numEntries, int entryBits)
+	{
+		assert(entryBits == 8 || entryBits == 4 || entryBits == 2);
+		assert(v.size() == (numEntries*entryBits+7)/8);
+		mapping.reset();
+		entries.clear();
+		entries.swap(v);
+		bits = entryBits;
+		data = entries.size() ? &entries[0] : 0;
+		count = numEntries;
+	}
+	/**
+	 * Repack 8-bit entries into 4-bit entries (larger values become 15) or
+	 * 2-bit entries (the value mod 3; 255 marks entries never reached).
+	 */
+	void Pack(int entryBits)
+	{
+		assert(bits == 8);
+		std::vector<uint8_t> packed((count*entryBits+7)/8);
+		for (uint64_t x = 0; x < count; x++)
+		{
+			uint8_t value = data[x];
+			if (entryBits == 4)
+				packed[x>>1] |= std::min(value, (uint8_t)15)<<((x&1)*4);
+			else if (entryBits == 2)
+				packed[x>>2] |= ((value == 255)?3:(value%3))<<((x&3)*2);
+		}
+		SetPacked(packed, count, entryBits);
+	}
+
+	bool IsMapped() const { return mapping != 0; }
+	/** Copy mapped entries into memory so that they can be changed */
+	void MakeWritable()
+	{
+		if (!mapping)
+			return;
+		entries.assign(data, data+Bytes());
+		mapping.reset();
+		data = entries.size() ? &entries[0] : 0;
+	}
+	/** Map numEntries entries of the given width which start offset bytes into fname */
+	void Map(const char *fname, uint64_t offset, uint64_t numEntries, int entryBits = 8)
+	{
+		bits = entryBits;
+		count = numEntries;
+		mapping.reset(new Mapping(fname, offset+Bytes()));
+		entries.clear();
+		entries.shrink_to_fit();
+		data = mapping->memory+offset;
+	}
+private:
+	/** Unmaps the file once the last PDBEntries using it is gone */
+	struct Mapping {
+		Mapping(const char *fname, uint64_t mapBytes)
+		:bytes(mapBytes) { memory = GetMMAP(fname, bytes, fd, false, true); }
+		~Mapping() { CloseMMap(memory, bytes, fd); }
+		uint8_t *memory;
+		uint64_t bytes;
+		int fd;
+	};
+	/** Point at 8-bit entries held in entries */
+	void Sync()
+	{
+		Repoint();
+		count = entries.size();
+	}
+	/** Point at the entries held in entries, of any width, keeping count */
+	void Repoint()
+	{
+		data = entries.size() ? &entries[0] : 0;
+	}
+	/** Leave no entries, as after a move */
+	void Clear()
+	{
+		entries.clear();
+		mapping.reset();
+		data = 0;
+		count = 0;
+		bits = 8;
+	}
+
+	std::vector<uint8_t> entries;
+	std::shared_ptr<Mapping> mapping;
+	uint8_t *data;
+	uint64_t count;
+	int bits;
+};
+
+#endif
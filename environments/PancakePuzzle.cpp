@@ -68,13 +68,8 @@ void PancakePuzzle::GetSuccessors(const PancakePuzzleState &parent,
                              std::vector<PancakePuzzleState> &children) const
 {
 	children.resize(0);
-
-	// all operators are applicable in all states
-	for (unsigned i = 0; i < operators.size(); i++)
-	{
-		children.push_back(parent); // adds a copy of the state to the stack
-		ApplyAction(children.back(), operators[i]);
-	}
+	SuccessorAppender<PancakePuzzleState> append(children);
+	ForEachSuccessor(parent, append);
 }
 
 void PancakePuzzle::GetActions(const PancakePuzzleState &, std::vector<PancakePuzzleAction> &actions) const
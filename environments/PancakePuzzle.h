@@ -50,6 +50,9 @@ public:
 
 	~PancakePuzzle();
 	void GetSuccessors(const PancakePuzzleState &state, std::vector<PancakePuzzleState> &neighbors) const;
+	int GetNumSuccessors(const PancakePuzzleState &) const { return operators.size(); }
+	template <class visitor>
+	void ForEachSuccessor(const PancakePuzzleState &state, visitor &v) const;
 	void GetActions(const PancakePuzzleState &state, std::vector<unsigned> &actions) const;
 	PancakePuzzleAction GetAction(const PancakePuzzleState &s1, const PancakePuzzleState &s2) const;
 	void ApplyAction(PancakePuzzleState &s, PancakePuzzleAction a) const;
@@ -71,6 +74,7 @@ public:
 	void StoreGoal(PancakePuzzleState &); // stores the locations for the given goal state
 
 	virtual const std::string GetName();
+	std::string GetPDBDomain() const { return "Pancake"; }
 	std::vector<PancakePuzzleAction> Get_Op_Order(){return operators;}
 
 	/** Returns stored goal state if it is stored.**/
@@ -136,5 +140,26 @@ private:
 	unsigned size;
 };
 
+template <>
+struct UsesSuccessorVisitor<PancakePuzzle> {
+	static const bool value = true;
+};
+
+/**
+ * Calls v on each successor, in the order used by GetSuccessors(). Every
+ * flip is its own inverse, so one copy of the state is flipped and restored.
+ */
+template <class visitor>
+void PancakePuzzle::ForEachSuccessor(const PancakePuzzleState &state, visitor &v) const
+{
+	PancakePuzzleState child(state);
+	for (unsigned i = 0; i < operators.size(); i++)
+	{
+		ApplyAction(child, operators[i]);
+		v(child);
+		ApplyAction(child, operators[i]);
+	}
+}
+
 //typedef UnitSimulation<PancakePuzzleState, unsigned, Pancake> PancakeSimulation;
 #endif
@@ -0,0 +1,62 @@
+/*
+ *  PermutationArray.h
+ *  hog2
+ *
+ *  A permutation of N items stored inline, for states whose size is known
+ *  at compile time.
+ *
+ */
+
+#ifndef PERMUTATIONARRAY_H
+#define PERMUTATIONARRAY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <assert.h>
+#include <string.h>
+#include <vector>
+
+/**
+ * Drop-in replacement for the std::vector<int> puzzle member that
+ * PermutationPuzzleEnvironment expects: it has size(), operator[], begin(),
+ * end() and a no-op resize(), and converts to and from std::vector<int>.
+ * Entries are signed bytes so that the -1 used for abstracted items in
+ * PDBs can be stored; the array is trivially copyable and copying it never
+ * allocates.
+ */
+template <int N>
+class PermutationArray {
+public:
+	PermutationArray() { Reset(); }
+	PermutationArray(const std::vector<int> &v) { *this = v; }
+	void Reset()
+	{
+		for (int x = 0; x < N; x++)
+			entries[x] = x;
+	}
+	size_t size() const { return N; }
+	/** The size is fixed; only present so that generic code can call it. */
+	void resize(size_t count) { assert(count == N); }
+	int8_t &operator[](size_t which) { return entries[which]; }
+	int operator[](size_t which) const { return entries[which]; }
+	int8_t *begin() { return entries; }
+	int8_t *end() { return entries+N; }
+	const int8_t *begin() const { return entries; }
+	const int8_t *end() const { return entries+N; }
+
+	operator std::vector<int>() const { return std::vector<int>(begin(), end()); }
+	PermutationArray &operator=(const std::vector<int> &v)
+	{
+		assert(v.size() == N);
+		for (int x = 0; x < N; x++)
+			entries[x] = v[x];
+		return *this;
+	}
+	bool operator==(const PermutationArray &a) const { return memcmp(entries, a.entries, N) == 0; }
+	bool operator!=(const PermutationArray &a) const { return !(*this == a); }
+private:
+	static_assert(N > 0 && N <= 127, "PermutationArray entries are stored as int8_t");
+	int8_t entries[N];
+};
+
+#endif
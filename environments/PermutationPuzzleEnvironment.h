@@ -9,8 +9,12 @@
 #include "Timer.h"
 #include <thread>
 #include <deque>
+#include <atomic>
 #include "SharedQueue.h"
+#include "Barrier.h"
 #include "RangeCompression.h"
+#include "PermutationRanking.h"
+#include "PDBFile.h"
 
 #ifndef PERMPUZZ_H
 #define PERMPUZZ_H
@@ -32,7 +36,8 @@ enum PDBTreeNodeType {
 	kLeafModCompress,
 	kLeafValueCompress,
 	kLeafDivPlusDeltaCompress, // two lookups with the same index, one is div, one is delta
-	kLeafDefaultHeuristic
+	kLeafDefaultHeuristic,
+	kLeafMod3Compress // 2-bit entries holding the value mod 3, used as a lower bound
 };
 
 struct PDBTreeNode
@@ -45,16 +50,21 @@ struct PDBTreeNode
 
 const uint64_t kDone = -1;
 
+/** States whose PDB entries are prefetched together by the batch lookups */
+const int kHCostBatchSize = 16;
+
 /**
  Note, assumes that state has a public vector<int> called puzzle in which the
- permutation is held.
+ permutation is held. Any container with the same size(), operator[],
+ resize(), begin() and end() can be used instead, such as the fixed-size
+ PermutationArray.
  **/
 template <class state, class action>
 class PermutationPuzzleEnvironment : public SearchEnvironment<state, action>
 {
 public:
 	PermutationPuzzleEnvironment()
-	:maxItem(0), minPattern(100), additive(false) {}
+	:maxItem(0), minPattern(100), additive(false), backwardPDBSweeps(true) {}
 
 	void Min_Compress_PDB(int whichPDB, int factor, bool print_histogram);
 	void Fractional_Compress_PDB(int whichPDB, uint64_t count, bool print_histogram);
@@ -67,15 +77,25 @@ public:
 	void Delta_Compress_PDB(state goal, int whichPDB, bool print_histogram);
 
 	void Build_PDB(state &start, const std::vector<int> &distinct,
-				   const char *pdb_filename, int numThreads, bool additive);
+				   const char *pdb_filename, int numThreads, bool additive, int entryBits = 8);
+	/** Whether Build_PDB() may fill in the deep levels of non-additive PDBs backwards */
+	void SetBackwardPDBSweeps(bool use) { backwardPDBSweeps = use; }
 	void Build_Regular_PDB(state &start, const std::vector<int> &distinct, const char *pdb_filename);
 	void Build_Additive_PDB(state &start, const std::vector<int> &distinct, const char *pdb_filename, bool blank);
 	void Load_Regular_PDB(const char *fname, state &goal, bool print_histogram);
+	void Save_PDB(int which, const state &goal, const char *fname, PDBTreeNodeType compression = kLeafNode);
+	bool Check_PDB_File(const char *fname);
+	/** Name of the domain, stored in PDB files and checked when they are loaded */
+	virtual std::string GetPDBDomain() const { return "Permutation"; }
 	void Load_Additive_PDB(const state &goal, const char *pdb_filename);
 	void ClearPDBs()
 	{       PDB.resize(0); PDB_distincts.resize(0); lookups.resize(0); }
 	double PDB_Lookup(const state &s);
+	void PDB_Lookup(const state *states, int count, double *values);
+	/** The value of s in a 2-bit PDB; slow, for checking and unpacking PDBs */
+	double GetMod3PDBValue(int which, const state &s);
 	double HCost(const state &s);
+	void HCost(const state *states, int count, double *hcosts);
 	virtual double AdditiveGCost(const state &s, const action &d)
 	{ assert(!"Additive Gost used but not defined for this class\n"); }
 	
@@ -86,12 +106,14 @@ public:
 						const std::vector<int> &distinct,
 						std::vector<int> &locs,
 						std::vector<int> &dual) const;
+	void GetPDBHashes(const state *states, int count,
+					  const std::vector<int> &distinct, uint64_t *hashes) const;
 	
 	void GetStateFromPDBHash(uint64_t hash, state &s, int count,
 							 const std::vector<int> &pattern);
-	void GetStateFromPDBHash(uint64_t hash, state &s, int count,
-							 const std::vector<int> &pattern,
-							 std::vector<int> &dual);
+	virtual void GetStateFromPDBHash(uint64_t hash, state &s, int count,
+									 const std::vector<int> &pattern,
+									 std::vector<int> &dual);
 	void GetStateFromHash(state &s, uint64_t hash);
 	uint64_t GetStateHash(const state &s) const;
 	void PrintPDBHistogram(int which) const;
@@ -105,20 +127,54 @@ public:
 	
 
 private:
-	void DeltaWorker(std::vector<uint8_t> *array,
+	void DeltaWorker(PDBEntries *array,
 					 std::vector<int> *distinct,
 					 int puzzleSize,
 					 uint64_t start, uint64_t end);
-	void ThreadWorker(int depth, int totalTiles,
-					  std::vector<uint8_t> *DB,
-					  //std::vector<uint8_t> *coarseOpen,
-					  const std::vector<int> *distinct,
-					  SharedQueue<std::pair<uint64_t, uint64_t> > *work,
-					  SharedQueue<uint64_t> *results,
-					  std::mutex *lock,
-					  bool additive);
+	/** State shared by the threads of Build_PDB() */
+	struct PDBBuildData {
+		PDBBuildData(int numThreads)
+		:levelStart(numThreads+1), levelEnd(numThreads+1) {}
+		std::vector<uint8_t> DB;
+		uint64_t numEntries;
+		// one bit per entry, set once its value is lowered until it is expanded
+		std::vector<uint64_t> pending;
+		// for backward sweeps, one bit per entry that isn't yet finished
+		std::vector<uint64_t> open;
+		const std::vector<int> *distinct;
+		const state *start;
+		bool additive;
+		// 8, or 4 or 2 for packed PDBs, where DB holds 2-bit values mod 3
+		int entryBits;
+		// 4-bit values of packed PDBs, written as entries are finished
+		std::vector<uint8_t> values;
+		// set by Build_PDB() between levels
+		int depth;
+		bool backward, done;
+		// set by the threads when an action with no cost is seen
+		std::atomic<bool> zeroCostActions;
+		std::atomic<uint64_t> nextChunk;
+		// totals from the threads for the level
+		std::atomic<uint64_t> expanded;
+		std::atomic<int64_t> pendingChange;
+		Barrier levelStart, levelEnd;
+	};
+	void PDBBuildWorker(PDBBuildData *data);
+	void ForwardPDBSweep(PDBBuildData *data, uint64_t firstWord, uint64_t lastWord,
+						 state &s, state &t, std::vector<action> &acts, std::vector<int> &dual,
+						 uint64_t &expanded, int64_t &pendingChange);
+	void BackwardPDBSweep(PDBBuildData *data, uint64_t firstWord, uint64_t lastWord,
+						  state &s, state &t, std::vector<action> &acts, std::vector<int> &dual,
+						  uint64_t &expanded, int64_t &pendingChange);
+	void PackedPDBSweep(PDBBuildData *data, uint64_t firstWord, uint64_t lastWord,
+						state &s, state &t, std::vector<action> &acts, std::vector<int> &dual,
+						uint64_t &expanded, int64_t &pendingChange);
 	double HCost(const state &s, int treeNode,
 				 std::vector<int> &c1, std::vector<int> &c2);
+	double HCostFromRanks(const state &s, int treeNode, int which);
+	static bool IsRankedLeaf(PDBTreeNodeType t);
+	uint64_t LeafEntry(int treeNode, uint64_t index) const;
+	double LeafValue(int treeNode, uint64_t index, const state &s);
 	virtual double DefaultH(const state &s) { return 0; }
 	uint64_t Factorial(int val) const;
 	void buildCaches() const;
@@ -138,11 +194,16 @@ public:
 	bool Validate_Problems(std::vector<state> &puzzles);
 	
 	bool additive;
+	bool backwardPDBSweeps;
 	int maxItem, minPattern;
 	// holds a set of Pattern Databases which can be maxed over later
-	std::vector<std::vector<uint8_t> > PDB;
+	std::vector<PDBEntries> PDB;
 	// holds the set of distinct items used to build the associated PDB (and therefore needed for hashing)
 	std::vector<std::vector<int> > PDB_distincts;
+private:
+	// ranks of a batch of states, kHCostBatchSize per PDB or lookup tree node
+	std::vector<uint64_t> batchRanks;
+public:
 	std::vector<PDBTreeNode> lookups;
 	mutable std::vector<std::vector<uint64_t> > factorialCache;
 };
@@ -216,6 +277,7 @@ void PermutationPuzzleEnvironment<state, action>::Mod_Compress_PDB(int whichPDB,
 template <class state, class action>
 void PermutationPuzzleEnvironment<state, action>::Value_Compress_PDB(int whichPDB, int maxValue, bool print_histogram)
 {
+	PDB[whichPDB].MakeWritable();
 	for (uint64_t x = 0; x < PDB[whichPDB].size(); x++)
 		if (PDB[whichPDB][x] > maxValue)
 			PDB[whichPDB][x] = maxValue;
@@ -227,6 +289,7 @@ void PermutationPuzzleEnvironment<state, action>::Value_Compress_PDB(int whichPD
 template <class state, class action>
 void PermutationPuzzleEnvironment<state, action>::Value_Range_Compress_PDB(int whichPDB, int numBits, bool print_histogram)
 {
+	PDB[whichPDB].MakeWritable();
 	std::vector<uint64_t> dist;
 	std::vector<int> cutoffs;
 	GetPDBHistogram(whichPDB, dist);
@@ -257,6 +320,7 @@ void PermutationPuzzleEnvironment<state, action>::Value_Range_Compress_PDB(int w
 template <class state, class action>
 void PermutationPuzzleEnvironment<state, action>::Value_Compress_PDB(int whichPDB, std::vector<int> cutoffs, bool print_histogram)
 {
+	PDB[whichPDB].MakeWritable();
 
 	for (uint64_t x = 0; x < PDB[whichPDB].size(); x++)
 	{
@@ -280,6 +344,7 @@ void PermutationPuzzleEnvironment<state, action>::Delta_Compress_PDB(state goal,
 {
 	Timer t;
 	t.StartTimer();
+	PDB[whichPDB].MakeWritable();
 	uint64_t COUNT = PDB[whichPDB].size();
 	if (1) // use threads
 	{
@@ -321,7 +386,7 @@ void PermutationPuzzleEnvironment<state, action>::Delta_Compress_PDB(state goal,
 }
 
 template <class state, class action>
-void PermutationPuzzleEnvironment<state, action>::DeltaWorker(std::vector<uint8_t> *array,
+void PermutationPuzzleEnvironment<state, action>::DeltaWorker(PDBEntries *array,
 															  std::vector<int> *distinct,
 															  int puzzleSize,
 															  uint64_t start, uint64_t end)
@@ -345,144 +410,107 @@ void PermutationPuzzleEnvironment<state, action>::DeltaWorker(std::vector<uint8_
 #pragma mark Implementation - Buildling PDBs
 #pragma mark -
 
-const int coarseSize = 1024;
+/** Number of 64-bit words of the pending bitmap handed to a thread at a time */
+const uint64_t kPDBChunkWords = 256;
 
-template <class state, class action>
-void PermutationPuzzleEnvironment<state, action>::ThreadWorker(int depth, int totalTiles,
-															   std::vector<uint8_t> *DB,
-															   //std::vector<uint8_t> *coarseOpen,
-															   const std::vector<int> *distinct,
-															   SharedQueue<std::pair<uint64_t, uint64_t> > *work,
-															   SharedQueue<uint64_t> *results,
-															   std::mutex *lock,
-															   bool additive)
+/**
+ Lowers *entry to value if it is smaller, returning true if it was changed.
+ **/
+inline bool LowerPDBEntry(uint8_t *entry, uint8_t value)
 {
-	std::pair<uint64_t, uint64_t> p;
-	std::vector<uint64_t> additiveQueue;
-	std::vector<int> cache1;
-	std::vector<int> cache2;
-	uint64_t start, end;
-	std::vector<action> acts;
-	state s, t;
-	uint64_t count = 0;
-	
-	struct writeInfo {
-		uint64_t rank;
-		int newGCost;
-	};
-	std::vector<writeInfo> cache;
-	while (true)
+	uint8_t old = __atomic_load_n(entry, __ATOMIC_RELAXED);
+	while (value < old)
 	{
-		if (work->Remove(p) == false)
-		{
-			std::this_thread::sleep_for(std::chrono::microseconds(10));
-			continue;
-		}
-		if (p.first == p.second)
-		{
-			break;
-		}
-		start = p.first;
-		end = p.second;
-		//int nextDepth = 255;
-		for (uint64_t x = start; x < end; x++)
-		{
-			int stateDepth = (*DB)[x];
-			if (stateDepth == depth)
-			{
-				count++;
-				GetStateFromPDBHash(x, s, totalTiles, *distinct, cache1);
-				//std::cout << "Expanding[r][" << stateDepth << "]: " << s << std::endl;
-				this->GetActions(s, acts);
-				for (int y = 0; y < acts.size(); y++)
-				{
-					this->GetNextState(s, acts[y], t);
-					assert(this->InvertAction(acts[y]) == true);
-					//virtual bool InvertAction(action &a) const = 0;
-					
-					uint64_t nextRank = GetPDBHash(t, *distinct, cache1, cache2);
-					int newCost = stateDepth+(additive?this->AdditiveGCost(t, acts[y]):this->GCost(t, acts[y]));
-					cache.push_back({nextRank, newCost});
-				}
-			}
-		}
-		do {
-			// write out everything
-			lock->lock();
-			for (auto d : cache)
-			{
-				if (d.newGCost < (*DB)[d.rank]) // shorter path
-				{
-					(*DB)[d.rank] = d.newGCost;
-					if (d.newGCost == depth) // 0-cost action; will expand immediately
-					{
-						additiveQueue.push_back(d.rank);
-					}
-				}
-			}
-			lock->unlock();
-			cache.resize(0);
-			
-			while (additiveQueue.size() > 0)
-			{
-				uint64_t x = additiveQueue.back();
-				additiveQueue.pop_back();
-				int stateDepth = (*DB)[x];
-				assert(stateDepth == depth);
-				
-				count++;
-				GetStateFromPDBHash(x, s, totalTiles, *distinct, cache1);
-				//std::cout << "Expanding[a][" << stateDepth << "]: " << s << std::endl;
-				this->GetActions(s, acts);
-				for (int y = 0; y < acts.size(); y++)
-				{
-					this->GetNextState(s, acts[y], t);
-					assert(this->InvertAction(acts[y]) == true);
-					//virtual bool InvertAction(action &a) const = 0;
-					
-					uint64_t nextRank = GetPDBHash(t, *distinct, cache1, cache2);
-					int newCost = stateDepth+(additive?this->AdditiveGCost(t, acts[y]):this->GCost(t, acts[y]));
-					cache.push_back({nextRank, newCost});
-				}
-			}
-			
-		} while (cache.size() != 0);
+		if (__atomic_compare_exchange_n(entry, &old, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			return true;
 	}
-	results->Add(count);
+	return false;
+}
+
+/**
+ Sets the bit for entry in bitmap, returning true if it wasn't already set.
+ **/
+inline bool SetPDBBit(uint64_t *bitmap, uint64_t entry)
+{
+	uint64_t bit = 1ull<<(entry&63);
+	return (__atomic_fetch_or(&bitmap[entry>>6], bit, __ATOMIC_RELAXED)&bit) == 0;
 }
 
+/**
+ Sets an entry of a 2-bit array to value if it is still 3 (not reached),
+ returning true if it was changed.
+ **/
+inline bool ClaimPackedPDBEntry(uint8_t *mods, uint64_t entry, uint8_t value)
+{
+	uint8_t *byte = &mods[entry>>2];
+	int shift = (entry&3)*2;
+	uint8_t old = __atomic_load_n(byte, __ATOMIC_RELAXED);
+	while (((old>>shift)&3) == 3)
+	{
+		uint8_t next = (old&~(3<<shift))|(value<<shift);
+		if (__atomic_compare_exchange_n(byte, &old, next, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			return true;
+	}
+	return false;
+}
 
+/**
+ Builds a PDB breadth-first (by cost) over the ranks of the abstract states.
+ Each level expands the entries whose value is the current depth. These
+ are found in a bitmap of the entries that were lowered but not expanded,
+ so only a word per 64 entries is read to skip the rest.
+ 
+ numThreads threads are started once and kept for the whole build; they
+ take chunks of the bitmap with an atomic counter, lower children with an
+ atomic compare-and-set on their entries, and wait at a barrier between
+ levels. No locks are taken while entries are written.
+ 
+ Once most of the unfinished entries are in the frontier, non-additive PDBs
+ switch to backward sweeps (unless disabled with SetBackwardPDBSweeps()):
+ each unfinished entry looks for a neighbor at the current depth instead,
+ which stops at the first neighbor found with unit costs. This assumes
+ every action can be inverted and costs no less than 1; costs need not be
+ the same in both directions. Backward sweeps are not used once a 0-cost
+ action has been seen.
+ 
+ With entryBits of 4 or 2 the PDB is built directly in packed form (see
+ PDBEntries), for unit-cost, non-additive PDBs. The search keeps only the
+ depth mod 3 of each entry, in 2 bits, which is the finished PDB for 2-bit
+ entries; for 4-bit entries the depth of each entry is also written to a
+ 4-bit array when it is finished. With the pending bitmap this takes 3 or
+ 7 bits per entry instead of 9.
+ **/
 template <class state, class action>
 void PermutationPuzzleEnvironment<state, action>::Build_PDB(state &start, const std::vector<int> &distinct,
-															const char *pdb_filename, int numThreads, bool additive)
+															const char *pdb_filename, int numThreads, bool additive, int entryBits)
 {
-	SharedQueue<std::pair<uint64_t, uint64_t> > workQueue;
-	SharedQueue<uint64_t> resultQueue;
-	std::mutex lock;
-	
 	maxItem = max(maxItem,start.puzzle.size());
 	minPattern = min(minPattern, distinct.size());
 	buildCaches();
 	
 	uint64_t COUNT = nUpperk(start.puzzle.size(), start.puzzle.size() - distinct.size());
-	std::vector<uint8_t> DB(COUNT);
-	
-	std::fill(DB.begin(), DB.end(), 255);
-	
-	// with weights we have to store the lowest weight stored to make sure
-	// we don't skip regions
-	std::vector<uint8_t> coarseOpen((COUNT+coarseSize-1)/coarseSize);
-	std::fill(coarseOpen.begin(), coarseOpen.end(), 255);
+	PDBBuildData data(numThreads);
+	data.entryBits = entryBits;
+	data.numEntries = COUNT;
+	if (entryBits == 8)
+	{
+		data.DB.resize(COUNT);
+		std::fill(data.DB.begin(), data.DB.end(), 255);
+	}
+	else {
+		assert((entryBits == 4 || entryBits == 2) && !additive);
+		data.DB.resize((COUNT+3)/4);
+		std::fill(data.DB.begin(), data.DB.end(), 255);
+		if (entryBits == 4)
+			data.values.resize((COUNT+1)/2);
+	}
+	data.pending.resize((COUNT+63)/64);
 	
-	uint64_t entries = 0;
 	std::cout << "Num Entries: " << COUNT << std::endl;
 	std::cout << "Goal State: " << start << std::endl;
 	std::cout << "State Hash of Goal: " << GetStateHash(start) << std::endl;
 	std::cout << "PDB Hash of Goal: " << GetPDBHash(start, distinct) << std::endl;
 	
-	std::deque<state> q_curr, q_next;
-	std::vector<state> children;
-	
 	for (unsigned i = 0; i < start.puzzle.size(); i++)
 	{
 		bool is_distinct = false;
@@ -505,107 +533,308 @@ void PermutationPuzzleEnvironment<state, action>::Build_PDB(state &start, const
 	std::cout << "Abstract PDB Hash of Goal: " << GetPDBHash(start, distinct) << std::endl;
 	Timer t;
 	t.StartTimer();
-	//	q_curr.push_back(start);
-	DB[GetPDBHash(start, distinct)] = 0;
-	coarseOpen[GetPDBHash(start, distinct)/coarseSize] = 0;
-	int depth = 0;
-	uint64_t newEntries;
+	uint64_t goalRank = GetPDBHash(start, distinct);
+	if (entryBits == 8)
+		data.DB[goalRank] = 0;
+	else
+		ClaimPackedPDBEntry(&data.DB[0], goalRank, 0);
+	SetPDBBit(&data.pending[0], goalRank);
+	int64_t pending = 1;
+	uint64_t entries = 0;
+	
+	data.distinct = &distinct;
+	data.start = &start;
+	data.additive = additive;
+	data.done = false;
+	data.zeroCostActions = false;
 	std::vector<std::thread*> threads(numThreads);
 	printf("Creating %d threads\n", numThreads);
-	do {
-		newEntries = 0;
+	for (int x = 0; x < numThreads; x++)
+		threads[x] = new std::thread(&PermutationPuzzleEnvironment<state, action>::PDBBuildWorker, this, &data);
+	
+	data.backward = false;
+	for (int depth = 0; pending > 0; depth++)
+	{
+		assert(depth < 255);
 		Timer s;
 		s.StartTimer();
-		for (int x = 0; x < numThreads; x++)
+		data.depth = depth;
+		// with unit costs all pending entries are in the frontier
+		if (!data.backward && backwardPDBSweeps && !additive && !data.zeroCostActions &&
+			(uint64_t)pending > (COUNT-entries)/2)
 		{
-			threads[x] = new std::thread(&PermutationPuzzleEnvironment<state, action>::ThreadWorker, this,
-										 depth, start.puzzle.size(), &DB,// &coarseOpen,
-										 &distinct,
-										 &workQueue, &resultQueue, &lock, additive);
+			data.backward = true;
+			// packed entries that aren't finished are found from their values
+			if (entryBits == 8)
+			{
+				data.open.resize(data.pending.size());
+				for (uint64_t x = 0; x < COUNT; x++)
+					if (data.DB[x] >= depth)
+						data.open[x>>6] |= 1ull<<(x&63);
+			}
 		}
+		data.nextChunk = 0;
+		data.expanded = 0;
+		data.pendingChange = 0;
+		data.levelStart.Wait();
+		data.levelEnd.Wait();
 		
-		for (uint64_t x = 0; x < COUNT; x+=coarseSize)
+		uint64_t newEntries = data.expanded;
+		pending += data.pendingChange;
+		entries += newEntries;
+		printf("Depth %d complete%s; %1.2fs elapsed. %llu new states seen; %llu of %llu total\n",
+			   depth, data.backward?" (backward)":"", s.EndTimer(), (unsigned long long)newEntries, (unsigned long long)entries, (unsigned long long)COUNT);
+	}
+	data.done = true;
+	data.levelStart.Wait();
+	for (int x = 0; x < numThreads; x++)
+	{
+		threads[x]->join();
+		delete threads[x];
+		threads[x] = 0;
+	}
+	
+	printf("%1.2fs elapsed\n", t.EndTimer());
+	if (entries != COUNT)
+	{
+		printf("Entries: %llu; count: %llu\n", entries, COUNT);
+		assert(entries == COUNT);
+	}
+	
+	PDB.resize(PDB.size()+1); // increase the number of regular PDBs being stored
+	if (entryBits == 8)
+		PDB.back().swap(data.DB);
+	else if (entryBits == 4)
+		PDB.back().SetPacked(data.values, COUNT, 4);
+	else
+		PDB.back().SetPacked(data.DB, COUNT, 2);
+	PDB_distincts.push_back(distinct); // stores distinct
+	Save_PDB(PDB.size()-1, start, pdb_filename);
+	PrintPDBHistogram(PDB.size()-1);
+}
+
+template <class state, class action>
+void PermutationPuzzleEnvironment<state, action>::PDBBuildWorker(PDBBuildData *data)
+{
+	// copies of the goal, so that states have the right size and dimensions
+	state s = *data->start, t = *data->start;
+	std::vector<action> acts;
+	std::vector<int> dual;
+	uint64_t numWords = data->pending.size();
+	while (true)
+	{
+		data->levelStart.Wait();
+		if (data->done)
+			break;
+		uint64_t expanded = 0;
+		int64_t pendingChange = 0;
+		while (true)
+		{
+			uint64_t firstWord = kPDBChunkWords*data->nextChunk.fetch_add(1);
+			if (firstWord >= numWords)
+				break;
+			uint64_t lastWord = min(numWords, firstWord+kPDBChunkWords);
+			if (data->entryBits != 8)
+				PackedPDBSweep(data, firstWord, lastWord, s, t, acts, dual, expanded, pendingChange);
+			else if (data->backward)
+				BackwardPDBSweep(data, firstWord, lastWord, s, t, acts, dual, expanded, pendingChange);
+			else
+				ForwardPDBSweep(data, firstWord, lastWord, s, t, acts, dual, expanded, pendingChange);
+		}
+		data->expanded += expanded;
+		data->pendingChange += pendingChange;
+		data->levelEnd.Wait();
+	}
+}
+
+/**
+ Expands the pending entries at the current depth in the given words of the
+ bitmap. Children reached with a 0-cost action are at the same depth, so
+ they are expanded immediately rather than marked pending.
+ **/
+template <class state, class action>
+void PermutationPuzzleEnvironment<state, action>::ForwardPDBSweep(PDBBuildData *data, uint64_t firstWord, uint64_t lastWord,
+																  state &s, state &t, std::vector<action> &acts, std::vector<int> &dual,
+																  uint64_t &expanded, int64_t &pendingChange)
+{
+	uint8_t *DB = &data->DB[0];
+	uint64_t *pending = &data->pending[0];
+	const std::vector<int> &distinct = *data->distinct;
+	const int depth = data->depth;
+	std::vector<uint64_t> sameDepth;
+	for (uint64_t w = firstWord; w < lastWord; w++)
+	{
+		// bits set during this level are for deeper entries, so a copy will do
+		uint64_t bits = __atomic_load_n(&pending[w], __ATOMIC_RELAXED);
+		while (bits != 0)
 		{
-			bool submit = false;
-			for (uint64_t t = x; t < min(COUNT, x+coarseSize); t++)
+			uint64_t rank = w*64+__builtin_ctzll(bits);
+			bits &= bits-1;
+			if (__atomic_load_n(&DB[rank], __ATOMIC_RELAXED) != depth)
+				continue;
+			__atomic_fetch_and(&pending[w], ~(1ull<<(rank&63)), __ATOMIC_RELAXED);
+			pendingChange--;
+			sameDepth.push_back(rank);
+			while (sameDepth.size() > 0)
 			{
-				if (DB[t] == depth)
+				uint64_t next = sameDepth.back();
+				sameDepth.pop_back();
+				expanded++;
+				GetStateFromPDBHash(next, s, s.puzzle.size(), distinct, dual);
+				this->GetActions(s, acts);
+				for (unsigned int y = 0; y < acts.size(); y++)
 				{
-					submit = true;
-					//newEntries++;
+					this->GetNextState(s, acts[y], t);
+					action inverse = acts[y];
+					this->InvertAction(inverse);
+					int newCost = depth+(data->additive?this->AdditiveGCost(t, inverse):this->GCost(t, inverse));
+					assert(newCost >= depth && newCost < 255);
+					uint64_t nextRank = GetPDBHash(t, distinct);
+					if (LowerPDBEntry(&DB[nextRank], newCost))
+					{
+						if (newCost == depth)
+						{
+							data->zeroCostActions.store(true, std::memory_order_relaxed);
+							sameDepth.push_back(nextRank);
+						}
+						else if (SetPDBBit(pending, nextRank))
+							pendingChange++;
+					}
 				}
 			}
-			if (submit)
-			{
-				while (workQueue.size() > 10*numThreads)
-				{ std::this_thread::sleep_for(std::chrono::microseconds(10)); }
-				workQueue.Add({x, min(COUNT, x+coarseSize)});
-			}
-		}
-		for (int x = 0; x < numThreads; x++)
-		{
-			workQueue.Add({0,0});
 		}
-		for (int x = 0; x < numThreads; x++)
+	}
+}
+
+/**
+ Finishes the current depth for the open entries in the given words of the
+ bitmap: entries at the depth are closed, and deeper entries are lowered
+ from any neighbor at the depth. Only this thread writes these entries and
+ their words of the bitmaps, and the entries at the depth it reads don't
+ change.
+ **/
+template <class state, class action>
+void PermutationPuzzleEnvironment<state, action>::BackwardPDBSweep(PDBBuildData *data, uint64_t firstWord, uint64_t lastWord,
+																   state &s, state &t, std::vector<action> &acts, std::vector<int> &dual,
+																   uint64_t &expanded, int64_t &pendingChange)
+{
+	uint8_t *DB = &data->DB[0];
+	uint64_t *pending = &data->pending[0];
+	const std::vector<int> &distinct = *data->distinct;
+	const int depth = data->depth;
+	for (uint64_t w = firstWord; w < lastWord; w++)
+	{
+		uint64_t bits = data->open[w];
+		while (bits != 0)
 		{
-			threads[x]->join();
-			delete threads[x];
-			threads[x] = 0;
+			uint64_t rank = w*64+__builtin_ctzll(bits);
+			bits &= bits-1;
+			int value = __atomic_load_n(&DB[rank], __ATOMIC_RELAXED);
+			if (value == depth)
+			{
+				data->open[w] &= ~(1ull<<(rank&63));
+				__atomic_fetch_and(&pending[w], ~(1ull<<(rank&63)), __ATOMIC_RELAXED);
+				pendingChange--;
+				expanded++;
+				continue;
+			}
+			int best = value;
+			GetStateFromPDBHash(rank, s, s.puzzle.size(), distinct, dual);
+			this->GetActions(s, acts);
+			for (unsigned int y = 0; y < acts.size() && best > depth+1; y++)
+			{
+				this->GetNextState(s, acts[y], t);
+				if (__atomic_load_n(&DB[GetPDBHash(t, distinct)], __ATOMIC_RELAXED) != depth)
+					continue;
+				// entries are costs to the goal, so s is lowered by the cost of
+				// the action from s to the neighbor, which may differ from the
+				// cost of the action back
+				int cost = this->GCost(s, acts[y]);
+				assert(cost > 0);
+				best = min(best, depth+cost);
+			}
+			if (best < value)
+			{
+				assert(best < 255);
+				__atomic_store_n(&DB[rank], (uint8_t)best, __ATOMIC_RELAXED);
+				if (SetPDBBit(pending, rank))
+					pendingChange++;
+			}
 		}
-		// read out node counts
-		while (true)
+	}
+}
+
+/**
+ Sweep of Build_PDB() for packed PDBs. The pending entries are those at the
+ current depth; they are finished and, going forward, their unreached
+ children are set to the next depth. Going backward, each unreached entry
+ instead looks for a neighbor at the current depth. With unit costs the
+ value mod 3 is enough to tell entries at the current depth from the next
+ one, as no entry reached earlier is pending.
+ **/
+template <class state, class action>
+void PermutationPuzzleEnvironment<state, action>::PackedPDBSweep(PDBBuildData *data, uint64_t firstWord, uint64_t lastWord,
+																 state &s, state &t, std::vector<action> &acts, std::vector<int> &dual,
+																 uint64_t &expanded, int64_t &pendingChange)
+{
+	uint8_t *mods = &data->DB[0];
+	uint8_t *values = (data->entryBits == 4)?&data->values[0]:0;
+	uint64_t *pending = &data->pending[0];
+	const std::vector<int> &distinct = *data->distinct;
+	const int depth = data->depth;
+	const uint8_t depthMod = depth%3, nextMod = (depth+1)%3;
+	const uint8_t value = min(depth, 15);
+	for (uint64_t w = firstWord; w < lastWord; w++)
+	{
+		// entries at the current depth
+		uint64_t bits = __atomic_load_n(&pending[w], __ATOMIC_RELAXED);
+		while (bits != 0)
 		{
-			uint64_t val;
-			if (resultQueue.Remove(val))
+			uint64_t rank = w*64+__builtin_ctzll(bits);
+			bits &= bits-1;
+			if (((__atomic_load_n(&mods[rank>>2], __ATOMIC_RELAXED)>>((rank&3)*2))&3) != depthMod)
+				continue;
+			__atomic_fetch_and(&pending[w], ~(1ull<<(rank&63)), __ATOMIC_RELAXED);
+			pendingChange--;
+			expanded++;
+			if (values)
+				__atomic_fetch_or(&values[rank>>1], (uint8_t)(value<<((rank&1)*4)), __ATOMIC_RELAXED);
+			if (data->backward)
+				continue;
+			GetStateFromPDBHash(rank, s, s.puzzle.size(), distinct, dual);
+			this->GetActions(s, acts);
+			for (unsigned int y = 0; y < acts.size(); y++)
 			{
-				//newEntries+=val;
-			}
-			else {
-				break;
+				this->GetNextState(s, acts[y], t);
+				uint64_t nextRank = GetPDBHash(t, distinct);
+				if (ClaimPackedPDBEntry(mods, nextRank, nextMod) && SetPDBBit(pending, nextRank))
+					pendingChange++;
 			}
 		}
-		
-		newEntries = 0;
-		for (uint64_t x = 0; x < COUNT; x++)
+		if (!data->backward)
+			continue;
+		// unreached entries; only this thread writes the entries of this word
+		for (uint64_t rank = w*64; rank < min(w*64+64, data->numEntries); rank++)
 		{
-			if (DB[x] == depth)
+			if (((mods[rank>>2]>>((rank&3)*2))&3) != 3)
+				continue;
+			GetStateFromPDBHash(rank, s, s.puzzle.size(), distinct, dual);
+			this->GetActions(s, acts);
+			for (unsigned int y = 0; y < acts.size(); y++)
 			{
-				newEntries++;
+				this->GetNextState(s, acts[y], t);
+				uint64_t nextRank = GetPDBHash(t, distinct);
+				if (((__atomic_load_n(&mods[nextRank>>2], __ATOMIC_RELAXED)>>((nextRank&3)*2))&3) != depthMod)
+					continue;
+				ClaimPackedPDBEntry(mods, rank, nextMod);
+				SetPDBBit(pending, rank);
+				pendingChange++;
+				break;
 			}
 		}
-		entries += newEntries;
-		printf("Depth %d complete; %1.2fs elapsed. %llu new states seen; %llu of %llu total\n",
-			   depth, s.EndTimer(), newEntries, entries, COUNT);
-		depth++;
-		//		depth = coarseOpen[0];
-		//		for (int x = 1; x < coarseOpen.size(); x++)
-		//			depth = min(depth, coarseOpen[x]);
-		//		if (depth == 255) // no new entries!
-		//			break;
-	} while (entries != COUNT);
-	
-	printf("%1.2fs elapsed\n", t.EndTimer());
-	if (entries != COUNT)
-	{
-		printf("Entries: %llu; count: %llu\n", entries, COUNT);
-		assert(entries == COUNT);
 	}
-	
-	//TODO fix the output of PDBs
-	FILE *f = fopen(pdb_filename, "w");
-	int num = distinct.size();
-	assert(fwrite(&num, sizeof(num), 1, f) == 1);
-	assert(fwrite(&distinct[0], sizeof(distinct[0]), distinct.size(), f) == distinct.size());
-	assert(fwrite(&DB[0], sizeof(uint8_t), COUNT, f) == COUNT);
-	fclose(f);
-	
-	PDB.push_back(DB); // increase the number of regular PDBs being stored
-	PDB_distincts.push_back(distinct); // stores distinct
-	PrintPDBHistogram(PDB.size()-1);
 }
 
-
-
 template <class state, class action>
 void PermutationPuzzleEnvironment<state, action>::Build_Regular_PDB(state &start, const std::vector<int> &distinct, const char *pdb_filename)
 {
@@ -698,30 +927,13 @@ void PermutationPuzzleEnvironment<state, action>::Build_Regular_PDB(state &start
 		assert(entries == COUNT);
 	}
 	
-	//TODO fix the output of PDBs
-	FILE *f = fopen(pdb_filename, "w");
-	int num = distinct.size();
-	assert(fwrite(&num, sizeof(num), 1, f) == 1);
-	assert(fwrite(&distinct[0], sizeof(distinct[0]), distinct.size(), f) == distinct.size());
-	assert(fwrite(&DB[0], sizeof(uint8_t), COUNT, f) == COUNT);
-	//fprintf(f, "%ld\n", distinct.size()); // first element is the number of distinct pieces
-	//	for (unsigned i = 0; i < distinct.size(); i++)
-	//	{
-	//		fprintf(f, "%d\n", distinct[i]); //first few lines are these distinct elements
-	//	}
-	//	for (unsigned i = 0; i < COUNT; i++)
-	//	{
-	//		fprintf(f, "%d\n", DB[i]);
-	//	}
-	
-	fclose(f);
+	PDB.push_back(DB); // increase the number of regular PDBs being stored
+	PDB_distincts.push_back(distinct); // stores distinct
+	Save_PDB(PDB.size()-1, start, pdb_filename);
 	
 	printf("Wrote %lld entries to '%s'\n", entries, pdb_filename);
 	for (int x = 0; x < depths.size(); x++)
 		printf("%d %lld\n", x, depths[x]);
-	
-	PDB.push_back(DB); // increase the number of regular PDBs being stored
-	PDB_distincts.push_back(distinct); // stores distinct
 }
 
 // The distinct states should not include blanks
@@ -877,14 +1089,61 @@ void PermutationPuzzleEnvironment<state, action>::Build_Additive_PDB(state &star
 #pragma mark Implementation - Loading PDBs
 #pragma mark -
 
+/**
+ Loads a PDB. Files written by Save_PDB() are mapped read-only, so that
+ processes using the same PDB share one copy of it and loading doesn't read
+ the entries; files in the older format (the pattern size, pattern and
+ entries with no header) are read into memory.
+ **/
 template <class state, class action>
 void PermutationPuzzleEnvironment<state, action>::Load_Regular_PDB(const char *fname, state &goal, bool print_histogram)
 {
 	//additive = false;
-	PDB.resize(PDB.size()+1); // increase the number of regular PDBs being stored
 	printf("Loading PDB '%s'\n", fname);
 	std::vector<int> distinct;
 	
+	PDBFileHeader header;
+	if (ReadPDBFileHeader(fname, header))
+	{
+		if (header.version != kPDBFileVersion ||
+			(header.entryBits != 8 && header.entryBits != 4 && header.entryBits != 2))
+		{
+			printf("Error; PDB '%s' has version %u with %u-bit entries; expected version %u with 8, 4 or 2-bit entries\n",
+				   fname, header.version, header.entryBits, kPDBFileVersion);
+			exit(0);
+		}
+		if (GetPDBDomain() != header.domain || header.puzzleSize != goal.puzzle.size())
+		{
+			printf("Error; PDB '%s' is for %s with %u items, not %s with %lu items\n", fname,
+				   header.domain, header.puzzleSize, GetPDBDomain().c_str(), goal.puzzle.size());
+			exit(0);
+		}
+		distinct.assign(header.pattern, header.pattern+header.patternSize);
+		
+		maxItem = max(maxItem,goal.puzzle.size());
+		minPattern = min(minPattern, distinct.size());
+		buildCaches();
+		
+		uint64_t COUNT = nUpperk(goal.puzzle.size(), goal.puzzle.size() - distinct.size());
+		if (header.compression == kLeafNode && header.numEntries != COUNT)
+		{
+			printf("Error; PDB '%s' has %llu entries instead of %llu\n", fname, (unsigned long long)header.numEntries, (unsigned long long)COUNT);
+			exit(0);
+		}
+		if (!PDBFileHasEntries(fname, header))
+		{
+			printf("Error; PDB '%s' is too short to hold its %llu entries\n", fname, (unsigned long long)header.numEntries);
+			exit(0);
+		}
+		PDB.resize(PDB.size()+1); // increase the number of regular PDBs being stored
+		PDB.back().Map(fname, header.headerBytes, header.numEntries, header.entryBits);
+		PDB_distincts.push_back(distinct); // stores distinct
+		
+		if (print_histogram)
+			PrintPDBHistogram(PDB.size()-1);
+		return;
+	}
+	
 	FILE *f;
 	f = fopen(fname, "r");
 	if (f == 0)
@@ -903,22 +1162,67 @@ void PermutationPuzzleEnvironment<state, action>::Load_Regular_PDB(const char *f
 	buildCaches();
 	
 	uint64_t COUNT = nUpperk(goal.puzzle.size(), goal.puzzle.size() - distinct.size());
-	PDB.back().resize(COUNT);
+	std::vector<uint8_t> DB(COUNT);
 	
 	size_t index;
-	if ((index = fread(&PDB.back()[0], sizeof(uint8_t), COUNT, f)) != COUNT)
+	if ((index = fread(&DB[0], sizeof(uint8_t), COUNT, f)) != COUNT)
 	{
 		printf("Error; did not correctly read %lu entries from PDB (%lu instead)\n", COUNT, index);
 		exit(0);
 	}
 	fclose(f);
 	
+	PDB.resize(PDB.size()+1); // increase the number of regular PDBs being stored
+	PDB.back().swap(DB);
 	PDB_distincts.push_back(distinct); // stores distinct
 	
 	if (print_histogram)
 		PrintPDBHistogram(PDB.size()-1);
 }
 
+/**
+ Writes a PDB to a file that Load_Regular_PDB() can map. compression records
+ how the entries were compressed; only uncompressed PDBs are checked for
+ having the full number of entries when they are loaded.
+ **/
+template <class state, class action>
+void PermutationPuzzleEnvironment<state, action>::Save_PDB(int which, const state &goal, const char *fname,
+														   PDBTreeNodeType compression)
+{
+	PDBFileHeader header;
+	memset(&header, 0, sizeof(header));
+	strncpy(header.domain, GetPDBDomain().c_str(), sizeof(header.domain)-1);
+	header.puzzleSize = goal.puzzle.size();
+	header.patternSize = PDB_distincts[which].size();
+	assert(header.patternSize <= kMaxRankedItems);
+	for (unsigned int x = 0; x < header.patternSize; x++)
+		header.pattern[x] = PDB_distincts[which][x];
+	header.compression = compression;
+	header.entryBits = PDB[which].EntryBits();
+	if (!WritePDBFile(fname, header, PDB[which].begin(), PDB[which].size()))
+	{
+		printf("Error; failed to write PDB '%s'\n", fname);
+		exit(0);
+	}
+}
+
+/**
+ Reads a whole PDB file written by Save_PDB() and compares the entries with
+ the checksum in its header. This reads every entry, so it isn't done when
+ PDBs are loaded.
+ **/
+template <class state, class action>
+bool PermutationPuzzleEnvironment<state, action>::Check_PDB_File(const char *fname)
+{
+	PDBFileHeader header;
+	if (!ReadPDBFileHeader(fname, header) || header.version != kPDBFileVersion ||
+		!PDBFileHasEntries(fname, header))
+		return false;
+	PDBEntries entries;
+	entries.Map(fname, header.headerBytes, header.numEntries, header.entryBits);
+	return PDBChecksum(entries.begin(), entries.Bytes()) == header.checksum;
+}
+
 
 template <class state, class action>
 void PermutationPuzzleEnvironment<state, action>::Load_Additive_PDB(const state &goal, const char *pdb_filename)
@@ -993,7 +1297,8 @@ double PermutationPuzzleEnvironment<state, action>::PDB_Lookup(const state &s)
 		{
 			uint64_t index = GetPDBHash(s, PDB_distincts[x]);
 			//histogram[PDB[x][index]]++;
-			val = std::max(val, (double)PDB[x][index]);
+			// for 2-bit PDBs this is the value mod 3, a lower bound on it
+			val = std::max(val, (double)PDB[x].Get(index));
 		}
 		return val;
 	}
@@ -1004,7 +1309,7 @@ double PermutationPuzzleEnvironment<state, action>::PDB_Lookup(const state &s)
 		{
 			uint64_t index = GetPDBHash(s, PDB_distincts[x]);
 			//histogram[PDB[x][index]]++;
-			tmp = PDB[x][index];
+			tmp = PDB[x].Get(index);
 			if (tmp > 4) tmp = 4;
 			val += (double)tmp;
 		}
@@ -1012,6 +1317,37 @@ double PermutationPuzzleEnvironment<state, action>::PDB_Lookup(const state &s)
 	}
 }
 
+/**
+ Sets values[x] to PDB_Lookup(states[x]) for count states. The states are
+ ranked in batches and all their entries prefetched before any is read, so
+ that the cache misses overlap instead of being taken one at a time.
+ **/
+template <class state, class action>
+void PermutationPuzzleEnvironment<state, action>::PDB_Lookup(const state *states, int count, double *values)
+{
+	batchRanks.resize(PDB.size()*kHCostBatchSize);
+	for (int first = 0; first < count; first += kHCostBatchSize)
+	{
+		int batch = min(count-first, kHCostBatchSize);
+		for (unsigned int x = 0; x < PDB.size(); x++)
+		{
+			uint64_t *ranks = &batchRanks[x*kHCostBatchSize];
+			GetPDBHashes(states+first, batch, PDB_distincts[x], ranks);
+			for (int y = 0; y < batch; y++)
+				PDB[x].Prefetch(ranks[y]);
+		}
+		for (int y = 0; y < batch; y++)
+		{
+			double val = 0;
+			for (unsigned int x = 0; x < PDB.size(); x++)
+			{
+				val = std::max(val, (double)PDB[x].Get(batchRanks[x*kHCostBatchSize+y]));
+			}
+			values[first+y] = val;
+		}
+	}
+}
+
 template <class state, class action>
 double PermutationPuzzleEnvironment<state, action>::HCost(const state &s)
 {
@@ -1021,6 +1357,42 @@ double PermutationPuzzleEnvironment<state, action>::HCost(const state &s)
 	return HCost(s, 0, c1, c2);
 }
 
+/**
+ Sets hcosts[x] to HCost(states[x]) for count states. Like the batch
+ PDB_Lookup(), each leaf of the lookup tree ranks a batch of states and
+ prefetches their entries before the tree is evaluated for any of them.
+ **/
+template <class state, class action>
+void PermutationPuzzleEnvironment<state, action>::HCost(const state *states, int count, double *hcosts)
+{
+	if (lookups.size() == 0)
+	{
+		for (int x = 0; x < count; x++)
+			hcosts[x] = 0;
+		return;
+	}
+	batchRanks.resize(lookups.size()*kHCostBatchSize);
+	for (int first = 0; first < count; first += kHCostBatchSize)
+	{
+		int batch = min(count-first, kHCostBatchSize);
+		for (unsigned int x = 0; x < lookups.size(); x++)
+		{
+			if (!IsRankedLeaf(lookups[x].t))
+				continue;
+			uint64_t *ranks = &batchRanks[x*kHCostBatchSize];
+			GetPDBHashes(states+first, batch, PDB_distincts[lookups[x].PDBID], ranks);
+			for (int y = 0; y < batch; y++)
+			{
+				uint64_t entry = LeafEntry(x, ranks[y]);
+				if (entry != kDone)
+					PDB[lookups[x].PDBID].Prefetch(entry);
+			}
+		}
+		for (int y = 0; y < batch; y++)
+			hcosts[first+y] = HCostFromRanks(states[first+y], 0, y);
+	}
+}
+
 template <class state, class action>
 double PermutationPuzzleEnvironment<state, action>::HCost(const state &s, int treeNode,
 														  std::vector<int> &c1, std::vector<int> &c2)
@@ -1042,58 +1414,180 @@ double PermutationPuzzleEnvironment<state, action>::HCost(const state &s, int tr
 				hval += HCost(s, lookups[treeNode].firstChildID+x, c1, c2);
 			}
 		} break;
+		default:
+		{
+			uint64_t index = 0;
+			if (IsRankedLeaf(lookups[treeNode].t))
+				index = GetPDBHash(s, PDB_distincts[lookups[treeNode].PDBID], c1, c2);
+			hval = LeafValue(treeNode, index, s);
+		} break;
+	}
+	return hval;
+}
+
+/**
+ Evaluates the lookup tree for state which of the current batch of HCost(),
+ whose ranks are in batchRanks.
+ **/
+template <class state, class action>
+double PermutationPuzzleEnvironment<state, action>::HCostFromRanks(const state &s, int treeNode, int which)
+{
+	double hval = 0;
+	switch (lookups[treeNode].t)
+	{
+		case kMaxNode:
+		{
+			for (int x = 0; x < lookups[treeNode].numChildren; x++)
+				hval = max(hval, HCostFromRanks(s, lookups[treeNode].firstChildID+x, which));
+		} break;
+		case kAddNode:
+		{
+			for (int x = 0; x < lookups[treeNode].numChildren; x++)
+				hval += HCostFromRanks(s, lookups[treeNode].firstChildID+x, which);
+		} break;
+		default:
+		{
+			uint64_t index = 0;
+			if (IsRankedLeaf(lookups[treeNode].t))
+				index = batchRanks[treeNode*kHCostBatchSize+which];
+			hval = LeafValue(treeNode, index, s);
+		} break;
+	}
+	return hval;
+}
+
+/**
+ Whether a leaf of the lookup tree reads its PDB at the rank of the state.
+ **/
+template <class state, class action>
+bool PermutationPuzzleEnvironment<state, action>::IsRankedLeaf(PDBTreeNodeType t)
+{
+	return !(t == kMaxNode || t == kAddNode || t == kLeafDefaultHeuristic);
+}
+
+/**
+ The entry that a ranked leaf reads for a state with the given rank, or
+ kDone if it reads none.
+ **/
+template <class state, class action>
+uint64_t PermutationPuzzleEnvironment<state, action>::LeafEntry(int treeNode, uint64_t index) const
+{
+	const PDBTreeNode &node = lookups[treeNode];
+	switch (node.t)
+	{
+		case kLeafFractionalCompress:
+			return (index < PDB[node.PDBID].size())?index:kDone;
+		case kLeafFractionalModCompress:
+			return (0 == index%node.numChildren)?index/node.numChildren:kDone;
+		case kLeafModCompress:
+			return index%PDB[node.PDBID].size();
+		case kLeafMinCompress:
+		case kLeafDivPlusDeltaCompress:
+			return index/node.numChildren;
+		default:
+			return index;
+	}
+}
+
+/**
+ The value of a leaf of the lookup tree for s, whose rank in the PDB of the
+ leaf is index if the leaf is ranked.
+ **/
+template <class state, class action>
+double PermutationPuzzleEnvironment<state, action>::LeafValue(int treeNode, uint64_t index, const state &s)
+{
+	double hval = 0;
+	switch (lookups[treeNode].t)
+	{
 		case kLeafNode:
 		{
-			uint64_t index = GetPDBHash(s, PDB_distincts[lookups[treeNode].PDBID], c1, c2);
-			hval = PDB[lookups[treeNode].PDBID][index];
+			hval = PDB[lookups[treeNode].PDBID].Get(index);
 		} break;
 		case kLeafFractionalCompress:
 		{
-			uint64_t index = GetPDBHash(s, PDB_distincts[lookups[treeNode].PDBID], c1, c2);
 			if (index < PDB[lookups[treeNode].PDBID].size())
-				hval = PDB[lookups[treeNode].PDBID][index];
+				hval = PDB[lookups[treeNode].PDBID].Get(index);
 			else
 				hval = 0;
 		} break;
 		case kLeafFractionalModCompress: // num children is the compression factor
 		{
-			uint64_t index = GetPDBHash(s, PDB_distincts[lookups[treeNode].PDBID], c1, c2);
 			if (0 == index%lookups[treeNode].numChildren)
-				hval = PDB[lookups[treeNode].PDBID][index/lookups[treeNode].numChildren];
+				hval = PDB[lookups[treeNode].PDBID].Get(index/lookups[treeNode].numChildren);
 			else
 				hval = 0;
 		} break;
 		case kLeafModCompress:
 		{
-			uint64_t index = GetPDBHash(s, PDB_distincts[lookups[treeNode].PDBID], c1, c2);
-			hval = PDB[lookups[treeNode].PDBID][index%PDB[lookups[treeNode].PDBID].size()];
+			hval = PDB[lookups[treeNode].PDBID].Get(index%PDB[lookups[treeNode].PDBID].size());
 		} break;
 		case kLeafMinCompress:
 		{
-			uint64_t index = GetPDBHash(s, PDB_distincts[lookups[treeNode].PDBID], c1, c2)/lookups[treeNode].numChildren;
-			hval = PDB[lookups[treeNode].PDBID][index];
+			hval = PDB[lookups[treeNode].PDBID].Get(index/lookups[treeNode].numChildren);
 		} break;
 		case kLeafValueCompress:
 		{
-			uint64_t index = GetPDBHash(s, PDB_distincts[lookups[treeNode].PDBID], c1, c2);
-			hval = PDB[lookups[treeNode].PDBID][index];
+			hval = PDB[lookups[treeNode].PDBID].Get(index);
 			if (hval > lookups[treeNode].numChildren)
 				hval = lookups[treeNode].numChildren;
 		} break;
 		case kLeafDivPlusDeltaCompress:
 		{
-			uint64_t index = GetPDBHash(s, PDB_distincts[lookups[treeNode].PDBID], c1, c2);
-			hval = PDB[lookups[treeNode].PDBID][index/lookups[treeNode].numChildren];
-			hval += PDB[lookups[treeNode].firstChildID][index];
+			hval = PDB[lookups[treeNode].PDBID].Get(index/lookups[treeNode].numChildren);
+			hval += PDB[lookups[treeNode].firstChildID].Get(index);
 		}
 		case kLeafDefaultHeuristic:
 		{
 			hval = DefaultH(s);
 		} break;
+		case kLeafMod3Compress:
+		{
+			// the value mod 3; decoding the value itself takes a walk to the
+			// goal, see GetMod3PDBValue()
+			hval = PDB[lookups[treeNode].PDBID].Get(index);
+		} break;
+		default:
+			break;
 	}
 	return hval;
 }
 
+/**
+ Recovers the value of s in a 2-bit PDB, which only holds values mod 3.
+ With unit costs the neighbors of an abstract state at distance d are at
+ d-1, d or d+1, which differ mod 3, so stepping to the neighbor with value
+ d-1 mod 3 until there is none reaches the goal in d steps. This costs up
+ to d times the branching factor in lookups, so it is for tools that check
+ or unpack 2-bit PDBs; HCost() and PDB_Lookup() only use the value mod 3.
+ **/
+template <class state, class action>
+double PermutationPuzzleEnvironment<state, action>::GetMod3PDBValue(int which, const state &s)
+{
+	const PDBEntries &entries = PDB[which];
+	const std::vector<int> &distinct = PDB_distincts[which];
+	assert(entries.EntryBits() == 2);
+	state curr(s), next(s);
+	std::vector<action> acts;
+	uint8_t mod = entries.Get(GetPDBHash(curr, distinct));
+	int value = 0;
+	while (true)
+	{
+		uint8_t closer = (mod+2)%3;
+		bool found = false;
+		this->GetActions(curr, acts);
+		for (unsigned int x = 0; x < acts.size() && !found; x++)
+		{
+			this->GetNextState(curr, acts[x], next);
+			found = (entries.Get(GetPDBHash(next, distinct)) == closer);
+		}
+		if (!found)
+			return value;
+		curr = next;
+		mod = closer;
+		value++;
+	}
+}
+
 #pragma mark -
 #pragma mark Implementation - Utilities
 #pragma mark -
@@ -1171,9 +1665,20 @@ template <class state, class action>
 uint64_t PermutationPuzzleEnvironment<state, action>::GetPDBHash(const state &s,
 																 const std::vector<int> &distinct) const
 {
-	static std::vector<int> locs;
-	static std::vector<int> dual;
-	return GetPDBHash(s, distinct, locs, dual);
+	return RankPattern(s.puzzle, s.puzzle.size(), &distinct[0], distinct.size());
+}
+
+/**
+ Computes the Hash Values of count states using the given set of distinct items.
+ Faster than hashing the states one at a time.
+ **/
+template <class state, class action>
+void PermutationPuzzleEnvironment<state, action>::GetPDBHashes(const state *states, int count,
+															   const std::vector<int> &distinct, uint64_t *hashes) const
+{
+	if (count == 0)
+		return;
+	RankPatterns(states, count, states[0].puzzle.size(), &distinct[0], distinct.size(), hashes);
 }
 
 /**
@@ -1191,84 +1696,44 @@ uint64_t PermutationPuzzleEnvironment<state, action>::Get_PDB_Size(state &start,
 // TODO Change to Myrvold and Ruskey ranking function
 /**
  Returns the Hash Value of the given state using the given set of distinct items
- This version is thread safe -- caches are passed in
+ This version is thread safe. The caches are no longer needed; the
+ signature is kept for existing callers.
  **/
 template <class state, class action>
 uint64_t PermutationPuzzleEnvironment<state, action>::GetPDBHash(const state &s,
 																 const std::vector<int> &distinct,
-																 std::vector<int> &locs,
-																 std::vector<int> &dual) const
+																 std::vector<int> &,
+																 std::vector<int> &) const
 {
-	locs.resize(distinct.size()); // vector for distinct item locations
-	dual.resize(s.puzzle.size()); // vector for distinct item locations
-	
-	// find item locations
-	for (unsigned int x = 0; x < s.puzzle.size(); x++)
-	{
-		if (s.puzzle[x] != -1)
-			dual[s.puzzle[x]] = x;
-	}
-	for (int x = 0; x < distinct.size(); x++)
-	{
-		locs[x] = dual[distinct[x]];
-	}
-	
-	uint64_t hashVal = 0;
-	int numEntriesLeft = s.puzzle.size();
-	
-	for (unsigned int x = 0; x < locs.size(); x++)
-	{
-		hashVal += locs[x]*nUpperk(numEntriesLeft-1, s.puzzle.size()-distinct.size());
-		numEntriesLeft--;
-		
-		// decrement locations of remaining items
-		for (unsigned y = x; y < locs.size(); y++)
-		{
-			if (locs[y] > locs[x])
-				locs[y]--;
-		}
-	}
-	return hashVal;
+	return RankPattern(s.puzzle, s.puzzle.size(), &distinct[0], distinct.size());
 }
 
 /**
  Returns the state from the hash value given the pattern and number of items in the puzzle
- This function is not thread safe.
  **/
 template <class state, class action>
 void PermutationPuzzleEnvironment<state, action>::GetStateFromPDBHash(uint64_t hash, state &s, int count,
 																	  const std::vector<int> &pattern)
 {
-	static std::vector<int> dual;
-	GetStateFromPDBHash(hash, s, count, pattern, dual);
+	int locs[kMaxRankedItems];
+	UnrankPattern(hash, count, pattern.size(), locs);
+	s.puzzle.resize(count);
+	std::fill(s.puzzle.begin(), s.puzzle.end(), -1);
+	for (unsigned int x = 0; x < pattern.size(); x++)
+		s.puzzle[locs[x]] = pattern[x];
 }
 
 /**
  Returns the state from the hash value given the pattern and number of items in the puzzle
- This function needs a vector which it shouldn't re-create at every time step. As such, we
- require the user to pass one in. (This enables concurrency; although better solutions exist.)
+ The locations of the pattern items are returned in dual.
  **/
 template <class state, class action>
 void PermutationPuzzleEnvironment<state, action>::GetStateFromPDBHash(uint64_t hash, state &s, int count,
 																	  const std::vector<int> &pattern,
 																	  std::vector<int> &dual)
 {
-	uint64_t hashVal = hash;
-	///*static*/ std::vector<int> dual;
 	dual.resize(pattern.size());
-	
-	int numEntriesLeft = count-pattern.size()+1;
-	for (int x = pattern.size()-1; x >= 0; x--)
-	{
-		dual[x] = hashVal%numEntriesLeft;
-		hashVal /= numEntriesLeft;
-		numEntriesLeft++;
-		for (int y = x+1; y < pattern.size(); y++)
-		{
-			if (dual[y] >= dual[x])
-				dual[y]++;
-		}
-	}
+	UnrankPattern(hash, count, pattern.size(), &dual[0]);
 	s.puzzle.resize(count);
 	std::fill(s.puzzle.begin(), s.puzzle.end(), -1);
 	for (int x = 0; x < dual.size(); x++)
@@ -1278,29 +1743,28 @@ void PermutationPuzzleEnvironment<state, action>::GetStateFromPDBHash(uint64_t h
 template <class state, class action>
 void PermutationPuzzleEnvironment<state, action>::GetStateFromHash(state &s, uint64_t hash)
 {
-	std::vector<int> puzzle = s.puzzle;
+	// every entry is written before it is read, so this works in place
 	uint64_t hashVal = hash;
 	
 	int numEntriesLeft = 1;
 	for (int x = s.puzzle.size()-1; x >= 0; x--)
 	{
-		puzzle[x] = hashVal%numEntriesLeft;
+		s.puzzle[x] = hashVal%numEntriesLeft;
 		hashVal /= numEntriesLeft;
 		numEntriesLeft++;
 		for (int y = x+1; y < (int) s.puzzle.size(); y++)
 		{
-			if (puzzle[y] >= puzzle[x])
-				puzzle[y]++;
+			if (s.puzzle[y] >= s.puzzle[x])
+				s.puzzle[y]++;
 		}
 	}
-	
-	s.puzzle = puzzle;
 }
 
 template <class state, class action>
 uint64_t PermutationPuzzleEnvironment<state, action>::GetStateHash(const state &s) const
 {
-	std::vector<int> puzzle = s.puzzle;
+	// a copy of the same type, so that fixed-size states don't allocate
+	auto puzzle = s.puzzle;
 	uint64_t hashVal = 0;
 	int numEntriesLeft = s.puzzle.size();
 	for (unsigned int x = 0; x < s.puzzle.size(); x++)
@@ -1328,8 +1792,8 @@ void PermutationPuzzleEnvironment<state, action>::PrintPDBHistogram(int which) c
 	// performs histogram count
 	for (uint64_t x = 0; x < PDB[which].size(); x++)
 	{
-		values[(PDB[which][x])]++;
-		maxval = max(maxval, PDB[which][x]);
+		values[PDB[which].Get(x)]++;
+		maxval = max(maxval, PDB[which].Get(x));
 	}
 	// outputs histogram of heuristic value counts
 	for (uint64_t x = 0; x <= maxval; x++)
@@ -1352,8 +1816,8 @@ void PermutationPuzzleEnvironment<state, action>::GetPDBHistogram(int which, std
 	// performs histogram count
 	for (uint64_t x = 0; x < PDB[which].size(); x++)
 	{
-		values[(PDB[which][x])]++;
-		maxval = max(maxval, PDB[which][x]);
+		values[PDB[which].Get(x)]++;
+		maxval = max(maxval, PDB[which].Get(x));
 	}
 	values.resize(maxval+1);
 }
@@ -0,0 +1,132 @@
+/*
+ *  PermutationRanking.h
+ *  hog2
+ *
+ *  Ranking and unranking of partial permutations (the locations of a
+ *  pattern of items), as used to index PDBs.
+ *
+ */
+
+#ifndef PERMUTATIONRANKING_H
+#define PERMUTATIONRANKING_H
+
+#include <stdint.h>
+#include <assert.h>
+
+/** Largest puzzle the ranking functions handle; locations are kept in a 64-bit mask */
+const int kMaxRankedItems = 64;
+
+/**
+ * Without hardware popcount (-mpopcnt) the compiler builtin is a library
+ * call, which is slower than the bit-twiddling version.
+ */
+inline int PopCount64(uint64_t x)
+{
+#if defined(__POPCNT__)
+	return __builtin_popcountll(x);
+#else
+	x = x-((x>>1)&0x5555555555555555ull);
+	x = (x&0x3333333333333333ull)+((x>>2)&0x3333333333333333ull);
+	x = (x+(x>>4))&0x0F0F0F0F0F0F0F0Full;
+	return (int)((x*0x0101010101010101ull)>>56);
+#endif
+}
+
+/**
+ * Rank of the locations of the k pattern items in a puzzle of n entries.
+ * The result is the same as PermutationPuzzleEnvironment::GetPDBHash(): the
+ * location of each item, less the number of earlier items before it, taken
+ * as a mixed-radix number with radix n, n-1, ... n-k+1. The earlier items
+ * are found with a mask and a popcount instead of rescanning them, and the
+ * number is built with Horner's rule, so no tables or buffers are needed.
+ *
+ * puzzle may be any indexable container of items; entries of -1 are
+ * ignored. Each pattern item must be in the puzzle.
+ */
+template <class container>
+inline uint64_t RankPattern(const container &puzzle, int n, const int *pattern, int k)
+{
+	assert(n <= kMaxRankedItems);
+	int8_t dual[kMaxRankedItems];
+	for (int x = 0; x < n; x++)
+		if (puzzle[x] >= 0)
+			dual[puzzle[x]] = x;
+	uint64_t used = 0;
+	uint64_t hashVal = 0;
+	for (int x = 0; x < k; x++)
+	{
+		int loc = dual[pattern[x]];
+		uint64_t bit = 1ull<<loc;
+		hashVal = hashVal*(n-x)+(loc-PopCount64(used&(bit-1)));
+		used |= bit;
+	}
+	return hashVal;
+}
+
+/**
+ * Rank count states at once. The states are ranked four at a time in
+ * lockstep, so that the independent chains of each rank overlap.
+ */
+template <class state>
+inline void RankPatterns(const state *states, int count, int n, const int *pattern, int k, uint64_t *hashes)
+{
+	assert(n <= kMaxRankedItems);
+	int x = 0;
+	for (; x+4 <= count; x += 4)
+	{
+		int8_t dual[4][kMaxRankedItems];
+		for (int i = 0; i < n; i++)
+		{
+			for (int s = 0; s < 4; s++)
+				if (states[x+s].puzzle[i] >= 0)
+					dual[s][states[x+s].puzzle[i]] = i;
+		}
+		uint64_t used[4] = {0, 0, 0, 0};
+		uint64_t hashVal[4] = {0, 0, 0, 0};
+		for (int i = 0; i < k; i++)
+		{
+			for (int s = 0; s < 4; s++)
+			{
+				int loc = dual[s][pattern[i]];
+				uint64_t bit = 1ull<<loc;
+				hashVal[s] = hashVal[s]*(n-i)+(loc-PopCount64(used[s]&(bit-1)));
+				used[s] |= bit;
+			}
+		}
+		for (int s = 0; s < 4; s++)
+			hashes[x+s] = hashVal[s];
+	}
+	for (; x < count; x++)
+		hashes[x] = RankPattern(states[x].puzzle, n, pattern, k);
+}
+
+/**
+ * Inverse of RankPattern(): writes the location of each of the k pattern
+ * items into locs.
+ */
+inline void UnrankPattern(uint64_t hash, int n, int k, int *locs)
+{
+	assert(n <= kMaxRankedItems);
+	int x = k-1;
+	// 64-bit division is several times slower, and most PDBs have fewer
+	// than 2^32 entries
+	for (; x >= 0 && (hash>>32) != 0; x--)
+	{
+		locs[x] = hash%(n-x);
+		hash /= (n-x);
+	}
+	uint32_t smallHash = (uint32_t)hash;
+	for (; x >= 0; x--)
+	{
+		locs[x] = smallHash%(n-x);
+		smallHash /= (n-x);
+	}
+	// each digit counts the locations not used by earlier items; the
+	// comparisons are added rather than branched on, since they are
+	// unpredictable
+	for (x = k-2; x >= 0; x--)
+		for (int y = x+1; y < k; y++)
+			locs[y] += (locs[y] >= locs[x]);
+}
+
+#endif
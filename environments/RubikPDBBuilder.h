@@ -0,0 +1,212 @@
+//
+//  RubikPDBBuilder.h
+//  hog2
+//
+//  Builds the corner and edge PDBs of Rubik's cube in memory with many
+//  threads, writing them directly in compressed form.
+//
+
+#ifndef RUBIKPDBBUILDER_H
+#define RUBIKPDBBUILDER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <assert.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "FourBitArray.h"
+#include "BitVector.h"
+#include "Barrier.h"
+#include "Timer.h"
+
+/** Number of 64-bit words of the frontier handed to a thread at a time */
+const uint64_t kRubikPDBChunkWords = 256;
+
+/**
+ * Breadth-first builder for the PDBs of the Rubik's cube abstractions
+ * (RubiksCorner, RubikEdge, Rubik7Edge), whose states are ranked by
+ * GetStateHash() and GetStateFromHash(). Each level, the threads take
+ * chunks of the frontier bitmap with an atomic counter, expand those
+ * states, and claim children in a shared BitVector of the states seen with
+ * BitVector::AtomicSetTrue(); they wait at a barrier between levels.
+ *
+ * The depth of each state is written into the PDB as soon as it is found,
+ * already compressed by compressionFactor as RubiksCube::HCost() reads it:
+ * with min compression entry i is the smallest depth of states
+ * [i*factor, (i+1)*factor), and with interleave compression it is the depth
+ * of state i*factor. Depths are found in increasing order, so the first
+ * depth written to a min-compressed entry is its smallest. The search
+ * needs 3 bits per state as well as the PDB, so the full 12-edge PDB can
+ * only be built with that much memory.
+ */
+template <class environment, class state, class action = int>
+class RubikPDBBuilder {
+public:
+	RubikPDBBuilder(environment *env, uint64_t numStates, int numThreads = 1)
+	:env(env), numStates(numStates), numThreads(numThreads), levelStart(numThreads+1), levelEnd(numThreads+1) {}
+	/** Builds the PDB of distances to goal into pdb, which is resized and filled */
+	void Build(const state &goal, FourBitArray &pdb, int compressionFactor, bool minCompression);
+	/** Number of states at each depth of the last build */
+	const std::vector<uint64_t> &GetDepthCounts() const { return depthCounts; }
+	void PrintThreadStats() const;
+private:
+	void Worker(int id);
+	void ExpandChunk(uint64_t firstWord, uint64_t lastWord, state &s, state &child,
+					 const std::vector<action> &acts, uint64_t &expanded);
+
+	environment *env;
+	uint64_t numStates;
+	int numThreads;
+	Barrier levelStart, levelEnd;
+
+	// shared by the threads during a build
+	FourBitArray *pdb;
+	int factor;
+	bool minCompression;
+	BitVector *seen;
+	std::vector<uint64_t> frontier, next;
+	int depth;
+	bool done;
+	std::atomic<uint64_t> nextChunk;
+	std::atomic<uint64_t> newStates;
+
+	std::vector<uint64_t> depthCounts;
+	// for each thread, the states it expanded and the seconds spent expanding them
+	std::vector<uint64_t> threadExpanded;
+	std::vector<double> threadTime;
+};
+
+template <class environment, class state, class action>
+void RubikPDBBuilder<environment, state, action>::Build(const state &goal, FourBitArray &thePDB, int compressionFactor, bool minComp)
+{
+	assert(compressionFactor >= 1);
+	pdb = &thePDB;
+	factor = compressionFactor;
+	minCompression = minComp;
+	pdb->Resize((numStates+factor-1)/factor);
+	pdb->FillMax();
+	BitVector seenStates(numStates);
+	seen = &seenStates;
+	frontier.assign((numStates+63)/64, 0);
+	next.assign((numStates+63)/64, 0);
+	depthCounts.resize(0);
+	threadExpanded.assign(numThreads, 0);
+	threadTime.assign(numThreads, 0);
+
+	uint64_t goalRank = env->GetStateHash(goal);
+	seen->SetTrue(goalRank);
+	frontier[goalRank>>6] |= 1ull<<(goalRank&63);
+	if (minCompression || 0 == goalRank%factor)
+		pdb->Set(goalRank/factor, 0);
+	depthCounts.push_back(1);
+	uint64_t total = 1;
+
+	Timer t;
+	t.StartTimer();
+	done = false;
+	std::vector<std::thread*> threads(numThreads);
+	for (int x = 0; x < numThreads; x++)
+		threads[x] = new std::thread(&RubikPDBBuilder<environment, state, action>::Worker, this, x);
+	for (depth = 0; depthCounts.back() > 0; depth++)
+	{
+		assert(depth < 14);
+		Timer s;
+		s.StartTimer();
+		nextChunk = 0;
+		newStates = 0;
+		levelStart.Wait();
+		levelEnd.Wait();
+		frontier.swap(next);
+		std::fill(next.begin(), next.end(), 0);
+		depthCounts.push_back(newStates);
+		total += newStates;
+		printf("Depth %d complete; %1.2fs elapsed. %llu new states seen; %llu of %llu total\n",
+			   depth+1, s.EndTimer(), (unsigned long long)newStates, (unsigned long long)total, (unsigned long long)numStates);
+	}
+	depthCounts.pop_back();
+	done = true;
+	levelStart.Wait();
+	for (int x = 0; x < numThreads; x++)
+	{
+		threads[x]->join();
+		delete threads[x];
+	}
+	seen = 0;
+	printf("%1.2fs elapsed\n", t.EndTimer());
+	if (total != numStates)
+		printf("Error: %llu of %llu states were reached\n", (unsigned long long)total, (unsigned long long)numStates);
+}
+
+template <class environment, class state, class action>
+void RubikPDBBuilder<environment, state, action>::Worker(int id)
+{
+	state s, child;
+	std::vector<action> acts;
+	env->GetActions(s, acts);
+	uint64_t numWords = frontier.size();
+	while (true)
+	{
+		levelStart.Wait();
+		if (done)
+			break;
+		Timer t;
+		t.StartTimer();
+		while (true)
+		{
+			uint64_t firstWord = kRubikPDBChunkWords*nextChunk.fetch_add(1);
+			if (firstWord >= numWords)
+				break;
+			ExpandChunk(firstWord, std::min(numWords, firstWord+kRubikPDBChunkWords), s, child, acts, threadExpanded[id]);
+		}
+		threadTime[id] += t.EndTimer();
+		levelEnd.Wait();
+	}
+}
+
+/**
+ * Expands the frontier states in the given words, adding the children not
+ * yet seen to the next frontier and writing their depth into the PDB.
+ */
+template <class environment, class state, class action>
+void RubikPDBBuilder<environment, state, action>::ExpandChunk(uint64_t firstWord, uint64_t lastWord, state &s, state &child,
+															 const std::vector<action> &acts, uint64_t &expanded)
+{
+	uint64_t found = 0;
+	for (uint64_t w = firstWord; w < lastWord; w++)
+	{
+		uint64_t bits = frontier[w];
+		while (bits)
+		{
+			uint64_t rank = (w<<6)+__builtin_ctzll(bits);
+			bits &= bits-1;
+			env->GetStateFromHash(rank, s);
+			expanded++;
+			for (unsigned int a = 0; a < acts.size(); a++)
+			{
+				child = s;
+				env->ApplyAction(child, acts[a]);
+				uint64_t childRank = env->GetStateHash(child);
+				if (!seen->AtomicSetTrue(childRank))
+					continue;
+				found++;
+				__atomic_fetch_or(&next[childRank>>6], 1ull<<(childRank&63), __ATOMIC_RELAXED);
+				if (minCompression)
+					pdb->AtomicSetIfSmaller(childRank/factor, depth+1);
+				else if (0 == childRank%factor)
+					pdb->AtomicSet(childRank/factor, depth+1);
+			}
+		}
+	}
+	newStates += found;
+}
+
+template <class environment, class state, class action>
+void RubikPDBBuilder<environment, state, action>::PrintThreadStats() const
+{
+	for (int x = 0; x < numThreads; x++)
+		printf("Thread %d: %llu states expanded in %1.2fs (%1.0f states/s)\n", x, (unsigned long long)threadExpanded[x],
+			   threadTime[x], threadTime[x] > 0 ? threadExpanded[x]/threadTime[x] : 0.0);
+}
+
+#endif
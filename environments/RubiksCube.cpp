@@ -10,6 +10,7 @@
 #include <cassert>
 #include <cstdio>
 #include <algorithm>
+#include <atomic>
 
 void RubiksCube::GetSuccessors(const RubiksState &nodeID, std::vector<RubiksState> &neighbors) const
 {
@@ -149,16 +150,111 @@ bool RubiksCube::InvertAction(RubiksAction &a) const
 	return false;
 }
 
+/** Each thread's HCost cache. Entries hold the id of the cube settings they were found with. */
+static thread_local std::vector<RubikHCostCacheEntry> hCostCache;
+static std::atomic<uint32_t> nextHCostCacheID(1);
+
+void RubiksCube::SetHCostCache(int bits, bool useSymmetry)
+{
+	assert(bits >= 0 && bits < 40);
+	hCostCacheBits = bits;
+	hCostCacheSymmetry = useSymmetry;
+	ClearHCostCache();
+}
+
+void RubiksCube::ClearHCostCache()
+{
+	hCostCacheID = nextHCostCacheID++;
+	hCostCacheHits.store(0);
+	hCostCacheMisses.store(0);
+}
+
+/**
+ * Returns the cache entry for node, setting corner and edge to the packed
+ * state that the entry must hold to be a hit.
+ */
+RubikHCostCacheEntry &RubiksCube::GetHCostCacheEntry(const RubiksState &node, uint64_t &corner, uint64_t &edge) const
+{
+	if (hCostCache.size() != (1ull<<hCostCacheBits))
+		hCostCache.assign(1ull<<hCostCacheBits, RubikHCostCacheEntry());
+	if (hCostCacheSymmetry)
+	{
+		RubikSymmetries::Get().GetCanonicalState(node, corner, edge);
+	}
+	else {
+		corner = node.corner.state;
+		edge = node.edge.state;
+	}
+	uint64_t hash = (corner^(edge*0x9E3779B97F4A7C15ull))*0xC4CEB9FE1A85EC53ull;
+	return hCostCache[hash>>(64-hCostCacheBits)];
+}
+
+/**
+ * A value found with parentHCost may only be a bound on the heuristic; the
+ * cache keeps it, and returns it for later parents with a smaller value.
+ * That is not always the value the uncached lookup would give: the Bloom
+ * filter tests made for one parent value can answer differently from those
+ * made for another, and with symmetry the 7-edge PDBs give different values
+ * for symmetric states. Every value returned is still admissible, but node
+ * counts can differ from a search without the cache.
+ */
 double RubiksCube::HCost(const RubiksState &node1, const RubiksState &node2, double parentHCost)
+{
+	bool exact;
+	if (hCostCacheBits == 0)
+		return GetPDBHCost(node1, node2, parentHCost, exact);
+	uint64_t corner, edge;
+	RubikHCostCacheEntry &entry = GetHCostCacheEntry(node1, corner, edge);
+	if (entry.cacheID == hCostCacheID && entry.corner == corner && entry.edge == edge &&
+		(entry.exact || entry.value > parentHCost))
+	{
+		hCostCacheHits.fetch_add(1, std::memory_order_relaxed);
+		return entry.value;
+	}
+	hCostCacheMisses.fetch_add(1, std::memory_order_relaxed);
+	double val = GetPDBHCost(node1, node2, parentHCost, exact);
+	entry.corner = corner;
+	entry.edge = edge;
+	entry.cacheID = hCostCacheID;
+	entry.value = val;
+	entry.exact = exact;
+	return val;
+}
+
+/** Heuristic value between two arbitrary nodes. **/
+double RubiksCube::HCost(const RubiksState &node1, const RubiksState &node2)
+{
+	if (hCostCacheBits == 0)
+		return GetPDBHCost(node1, node2);
+	uint64_t corner, edge;
+	RubikHCostCacheEntry &entry = GetHCostCacheEntry(node1, corner, edge);
+	if (entry.cacheID == hCostCacheID && entry.corner == corner && entry.edge == edge && entry.exact)
+	{
+		hCostCacheHits.fetch_add(1, std::memory_order_relaxed);
+		return entry.value;
+	}
+	hCostCacheMisses.fetch_add(1, std::memory_order_relaxed);
+	double val = GetPDBHCost(node1, node2);
+	entry.corner = corner;
+	entry.edge = edge;
+	entry.cacheID = hCostCacheID;
+	entry.value = val;
+	entry.exact = true;
+	return val;
+}
+
+double RubiksCube::GetPDBHCost(const RubiksState &node1, const RubiksState &node2, double parentHCost, bool &exact)
 {
 	//return HCost(node1, node2);
 	double val = 0;
+	exact = true;
 	
 	// corner PDB
 	uint64_t hash = c.GetStateHash(node1.corner);
 	val = cornerPDB.Get(hash);
 	if (val > parentHCost)
 	{
+		exact = false;
 		return val;
 	}
 	
@@ -185,6 +281,7 @@ double RubiksCube::HCost(const RubiksState &node1, const RubiksState &node2, dou
 		{
 			if (parentHCost >= 10)
 			{
+				exact = false;
 				if (depth9->Contains(hash))
 				{
 					val = max(val, 9);
@@ -201,6 +298,7 @@ double RubiksCube::HCost(const RubiksState &node1, const RubiksState &node2, dou
 			}	
 			else if (parentHCost == 9)
 			{
+				exact = false;
 				if (depth8->Contains(hash))
 				{
 					val = max(val, 8);
@@ -285,8 +383,7 @@ double RubiksCube::HCost(const RubiksState &node1, const RubiksState &node2, dou
 	return val;
 }
 
-/** Heuristic value between two arbitrary nodes. **/
-double RubiksCube::HCost(const RubiksState &node1, const RubiksState &node2)
+double RubiksCube::GetPDBHCost(const RubiksState &node1, const RubiksState &node2)
 {
 	double val = 0;
 
@@ -405,6 +502,223 @@ bool RubiksCube::GoalTest(const RubiksState &node)
 	return false;
 }
 
+/** Sets facelet 3*loc+k to the facelet of the cube in loc that is at position k */
+static void GetCornerFacelets(const RubiksCornerState &s, int *facelets)
+{
+	for (int x = 0; x < 24; x++)
+		facelets[x] = s.GetFaceInLoc(x);
+}
+
+/** Sets facelet 2*loc+k to the facelet of the cube in loc that is at position k */
+static void GetEdgeFacelets(const RubikEdgeState &s, int *facelets)
+{
+	for (int x = 0; x < 12; x++)
+	{
+		int cube = s.GetCubeInLoc(x);
+		int flip = s.GetCubeOrientation(cube)?1:0;
+		facelets[2*x] = 2*cube+flip;
+		facelets[2*x+1] = 2*cube+1-flip;
+	}
+}
+
+/**
+ * Finds a permutation p of the 24 facelets with
+ * p(moves[a][x]) == moves[image[a]][p(x)] for every action a and facelet x,
+ * which keeps the facelets of each cube together. moves[a] holds the
+ * facelets after action a is applied to the goal.
+ */
+static bool FindFaceletMap(const int moves[18][24], const RubiksAction *image, int facesPerCube, int *p)
+{
+	for (int first = 0; first < 24; first++)
+	{
+		int queue[24];
+		int head = 0, tail = 0;
+		for (int x = 0; x < 24; x++)
+			p[x] = -1;
+		p[0] = first;
+		queue[tail++] = 0;
+		bool valid = true;
+		while (valid && head < tail)
+		{
+			int x = queue[head++];
+			for (int a = 0; a < 18 && valid; a++)
+			{
+				int from = moves[a][x];
+				int to = moves[image[a]][p[x]];
+				if (p[from] == -1)
+				{
+					p[from] = to;
+					queue[tail++] = from;
+				}
+				else if (p[from] != to)
+					valid = false;
+			}
+		}
+		if (!valid || tail != 24)
+			continue;
+		bool used[24] = {false};
+		for (int x = 0; x < 24; x++)
+		{
+			if (used[p[x]] || p[x]/facesPerCube != p[x-x%facesPerCube]/facesPerCube)
+				valid = false;
+			used[p[x]] = true;
+		}
+		if (valid)
+			return true;
+	}
+	return false;
+}
+
+const RubikSymmetries &RubikSymmetries::Get()
+{
+	static RubikSymmetries symmetries;
+	return symmetries;
+}
+
+/**
+ * Each symmetry permutes the six faces, and for each face keeps or reverses
+ * the direction of its quarter turns; actions don't turn every face the same
+ * way, so the direction is chosen per face. All 46080 such action maps are
+ * tried, and the 48 for which both the corner and edge facelet maps exist
+ * are kept, starting with the identity. This takes about 0.1s, once.
+ */
+RubikSymmetries::RubikSymmetries()
+{
+	RubiksCorner c;
+	RubikEdge e;
+	int cornerMoves[18][24], edgeMoves[18][24];
+	for (int a = 0; a < 18; a++)
+	{
+		RubiksCornerState cs;
+		RubikEdgeState es;
+		c.ApplyAction(cs, a);
+		e.ApplyAction(es, a);
+		GetCornerFacelets(cs, cornerMoves[a]);
+		GetEdgeFacelets(es, edgeMoves[a]);
+	}
+	int faces[6] = {0, 1, 2, 3, 4, 5};
+	int count = 0;
+	do {
+		for (int reverse = 0; reverse < 64; reverse++)
+		{
+			RubiksAction image[18];
+			for (int a = 0; a < 18; a++)
+				image[a] = faces[a/3]*3+((((reverse>>(a/3))&1) && a%3 != 2)?1-a%3:a%3);
+			int cornerMap[24], edgeMap[24];
+			if (!FindFaceletMap(cornerMoves, image, 3, cornerMap) || !FindFaceletMap(edgeMoves, image, 2, edgeMap))
+				continue;
+			assert(count < kRubikSymmetries);
+			for (int x = 0; x < 24; x++)
+			{
+				cornerFace[count][x] = cornerMap[x];
+				edgeFace[count][x] = edgeMap[x];
+			}
+			for (int x = 0; x < 8; x++)
+			{
+				cornerLoc[count][x] = cornerMap[3*x];
+				cornerSource[count][cornerMap[3*x]/3] = x;
+				cornerCube[count][x] = cornerMap[3*x]/3;
+			}
+			for (int x = 0; x < 12; x++)
+				edgeLoc[count][x] = edgeMap[2*x];
+			for (int a = 0; a < 18; a++)
+				actionMap[count][a] = image[a];
+			count++;
+		}
+	} while (std::next_permutation(faces, faces+6));
+	assert(count == kRubikSymmetries);
+}
+
+/** The state is built directly, as in RubiksCornerState::Rotate(), as this is called 48 times per lookup */
+void RubikSymmetries::ApplyCorner(const RubiksCornerState &s, int which, RubiksCornerState &result) const
+{
+	uint64_t state = 0;
+	for (int loc = 0; loc < 8; loc++)
+	{
+		int cube = (s.state>>(16+4*loc))&0xF;
+		int face = cornerFace[which][cube*3+(3-((s.state>>(2*cube))&0x3))%3];
+		int newLoc = cornerLoc[which][loc];
+		state |= uint64_t(face/3)<<(16+4*(newLoc/3));
+		state |= uint64_t((3+newLoc%3-face%3)%3)<<(2*(face/3));
+	}
+	result.state = state;
+}
+
+void RubikSymmetries::ApplyEdge(const RubikEdgeState &s, int which, RubikEdgeState &result) const
+{
+	uint64_t state = 0;
+	for (int loc = 0; loc < 12; loc++)
+	{
+		int cube = (s.state>>(12+4*loc))&0xF;
+		int face = edgeFace[which][cube*2+((s.state>>cube)&0x1)];
+		int newLoc = edgeLoc[which][loc];
+		state |= uint64_t(face/2)<<(12+4*(newLoc/2));
+		state |= uint64_t((newLoc^face)&1)<<(face/2);
+	}
+	result.state = state;
+}
+
+void RubikSymmetries::Apply(const RubiksState &s, int which, RubiksState &result) const
+{
+	ApplyCorner(s.corner, which, result.corner);
+	ApplyEdge(s.edge, which, result.edge);
+}
+
+/**
+ * The cubes in locations 7 down to 0 are the most significant bits of a
+ * corner state, so the image's cube in each location is found for all the
+ * symmetries still tied, and the rest are dropped, which usually leaves one
+ * symmetry after two locations.
+ */
+void RubikSymmetries::GetCanonicalState(const RubiksState &s, uint64_t &corner, uint64_t &edge) const
+{
+	int tied[kRubikSymmetries];
+	int numTied = kRubikSymmetries;
+	int cubes[8];
+	for (int x = 0; x < kRubikSymmetries; x++)
+		tied[x] = x;
+	for (int x = 0; x < 8; x++)
+		cubes[x] = s.corner.GetCubeInLoc(x);
+	for (int loc = 7; loc >= 0 && numTied > 1; loc--)
+	{
+		// the minimum is found first so that the filter has no branches
+		int image[kRubikSymmetries];
+		int best = 8, kept = 0;
+		for (int x = 0; x < numTied; x++)
+		{
+			image[x] = cornerCube[tied[x]][cubes[cornerSource[tied[x]][loc]]];
+			best = std::min(best, image[x]);
+		}
+		for (int x = 0; x < numTied; x++)
+		{
+			tied[kept] = tied[x];
+			kept += (image[x] == best);
+		}
+		numTied = kept;
+	}
+	RubiksCornerState cs;
+	RubikEdgeState es;
+	int numBest = 0;
+	corner = ~0ull;
+	for (int x = 0; x < numTied; x++)
+	{
+		ApplyCorner(s.corner, tied[x], cs);
+		if (cs.state < corner)
+		{
+			corner = cs.state;
+			numBest = 0;
+		}
+		if (cs.state == corner)
+			tied[numBest++] = tied[x];
+	}
+	edge = ~0ull;
+	for (int x = 0; x < numBest; x++)
+	{
+		ApplyEdge(s.edge, tied[x], es);
+		edge = std::min(edge, es.state);
+	}
+}
+
 uint64_t RubiksCube::GetStateHash(const RubiksState &node) const
 {
 	uint64_t hash = c.GetStateHash(node.corner);
@@ -11,6 +11,7 @@
 
 #include <iostream>
 #include <stdint.h>
+#include <atomic>
 #include <unordered_map>
 #include <vector>
 #include "RubiksCubeCorners.h"
@@ -49,6 +50,53 @@ static bool operator==(const RubiksState &l1, const RubiksState &l2)
 
 typedef int RubiksAction;
 
+/** Symmetries of the cube, counting reflections */
+const int kRubikSymmetries = 48;
+
+/**
+ * The symmetries of the cube as maps on states. A symmetry relabels the
+ * faces, so it maps each action to an action and each state to a state at
+ * the same distance from the goal. Each symmetry is stored as a
+ * permutation of the 24 corner and the 24 edge facelets, which is applied
+ * to both the locations and the cubes of a state. The permutations are
+ * found when the tables are built, as the facelet maps that turn every
+ * move of some face into a move of another face; this only relies on
+ * ApplyAction().
+ */
+class RubikSymmetries {
+public:
+	/** The tables, built the first time they are needed */
+	static const RubikSymmetries &Get();
+	/** Sets result to the image of s under symmetry which; the 7-edge state is not mapped */
+	void Apply(const RubiksState &s, int which, RubiksState &result) const;
+	/** The action that symmetry which maps a to */
+	RubiksAction GetAction(int which, RubiksAction a) const { return actionMap[which][a]; }
+	/**
+	 * Sets corner and edge to the packed state of the symmetric image of s
+	 * with the smallest corner and then edge state. Edges are only mapped
+	 * for the images that tie on the corners.
+	 */
+	void GetCanonicalState(const RubiksState &s, uint64_t &corner, uint64_t &edge) const;
+private:
+	RubikSymmetries();
+	void ApplyCorner(const RubiksCornerState &s, int which, RubiksCornerState &result) const;
+	void ApplyEdge(const RubikEdgeState &s, int which, RubikEdgeState &result) const;
+	// image of the first facelet of each location, and of each facelet of each cube
+	uint8_t cornerLoc[kRubikSymmetries][8], cornerFace[kRubikSymmetries][24];
+	// the location that is mapped to each location, and the image of each cube
+	uint8_t cornerSource[kRubikSymmetries][8], cornerCube[kRubikSymmetries][8];
+	uint8_t edgeLoc[kRubikSymmetries][12], edgeFace[kRubikSymmetries][24];
+	RubiksAction actionMap[kRubikSymmetries][18];
+};
+
+/** One entry of the HCost cache of a thread */
+struct RubikHCostCacheEntry {
+	uint64_t corner, edge;
+	uint32_t cacheID;
+	uint8_t value;
+	bool exact;
+};
+
 //class RubikCornerMove {
 //public:
 //	RubiksCornersAction act;
@@ -76,6 +124,11 @@ public:
 		cornDist.resize(16);
 		depth8 = 0;
 		depth9 = 0;
+		hCostCacheBits = 0;
+		hCostCacheID = 0;
+		hCostCacheSymmetry = false;
+		hCostCacheHits.store(0);
+		hCostCacheMisses.store(0);
 		//		for (int x = 0; x < 18; x++)
 //		{
 //			moves[x].act = x;
@@ -100,6 +153,18 @@ public:
 	virtual double HCost(const RubiksState &node1, const RubiksState &node2);
 	virtual double HCost(const RubiksState &node1, const RubiksState &node2, double parentHCost);
 	int Edge12PDBDist(const RubiksState &s);
+	/**
+	 * Caches HCost values in a direct-mapped table of 2^bits entries per
+	 * thread; 0 turns the cache off. With useSymmetry the entries are keyed
+	 * by the canonical symmetric state, so symmetric states share a value,
+	 * which is admissible for all of them but need not be what the PDBs give
+	 * for each one.
+	 * The PDBs must be loaded first, or ClearHCostCache() called after.
+	 */
+	void SetHCostCache(int bits, bool useSymmetry);
+	void ClearHCostCache();
+	uint64_t GetHCostCacheHits() const { return hCostCacheHits.load(); }
+	uint64_t GetHCostCacheMisses() const { return hCostCacheMisses.load(); }
 	
 	/** Heuristic value between node and the stored goal. Asserts that the
 	 goal is stored **/
@@ -146,6 +211,9 @@ public:
 	BloomFilter *depth8, *depth9;
 	MinBloomFilter *minBloom;
 private:
+	double GetPDBHCost(const RubiksState &node1, const RubiksState &node2);
+	double GetPDBHCost(const RubiksState &node1, const RubiksState &node2, double parentHCost, bool &exact);
+	RubikHCostCacheEntry &GetHCostCacheEntry(const RubiksState &node, uint64_t &corner, uint64_t &edge) const;
 	void OpenGLDrawCube(int cube) const;
 	void SetFaceColor(int face) const;
 	mutable std::vector<RubiksAction> history;
@@ -165,6 +233,11 @@ private:
 	std::vector<bucketData> buckets;
 
 	bool pruneSuccessors;
+	int hCostCacheBits;
+	uint32_t hCostCacheID;
+	bool hCostCacheSymmetry;
+	// shared by the threads of a parallel search
+	std::atomic<uint64_t> hCostCacheHits, hCostCacheMisses;
 };
 
 
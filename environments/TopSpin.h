@@ -78,6 +78,8 @@ public:
 	OccupancyInterface<TopSpinState, TopSpinAction> *GetOccupancyInfo() { return 0; }
 	double HCost(const TopSpinState &state1, const TopSpinState &state2);
 //	double HCost(const TopSpinState &state1);
+	void BatchHCost(const TopSpinState *states, int count, const TopSpinState &, double *hcosts)
+	{ PermutationPuzzleEnvironment<TopSpinState, TopSpinAction>::HCost(states, count, hcosts); }
 
 	double GCost(const TopSpinState &state1, const TopSpinState &state2);
 	double GCost(const TopSpinState &, const TopSpinAction &);
@@ -100,6 +102,7 @@ public:
 	}
 
 	virtual const std::string GetName();
+	std::string GetPDBDomain() const { return "TopSpin "+std::to_string(swapDiameter); }
 
 	void ClearGoal() { } // clears the current stored information of the goal
 
@@ -0,0 +1,471 @@
+/*
+ *  ExternalBFS.h
+ *  hog2
+ *
+ *  Breadth-first search that keeps its layers on disk, for enumerating
+ *  state spaces that are larger than memory.
+ *
+ */
+
+#ifndef EXTERNALBFS_H
+#define EXTERNALBFS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <assert.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "SearchEnvironment.h"
+#include "Timer.h"
+
+/** Ranks each thread buffers per bucket before appending them to the bucket's file */
+const int kExternalBFSWriteBuffer = 1<<13;
+/** Ranks read from a file at a time */
+const int kExternalBFSReadBuffer = 1<<16;
+
+/**
+ * How ExternalBFS converts between states and 64-bit ranks. By default the
+ * environment's GetStateHash() and GetStateFromHash(state &, uint64_t) are
+ * used, which must be a perfect ranking of the state space; specialize this
+ * for environments with other ranking functions. Unrank() is given a copy
+ * of the start state, so that states whose size is part of the object,
+ * such as MNPuzzleState, are unranked into a state of the right size.
+ */
+template <class environment, class state>
+struct ExternalBFSRanking {
+	static uint64_t Rank(environment *env, const state &s)
+	{ return env->GetStateHash(s); }
+	static void Unrank(environment *env, uint64_t rank, state &s)
+	{ env->GetStateFromHash(s, rank); }
+};
+
+/**
+ * Breadth-first frontier search with its layers on disk. States are stored
+ * as ranks, split into buckets by rank%numBuckets; each bucket of a layer
+ * is a file of the ranks in it, sorted, divided by numBuckets. Each layer is
+ * built in two phases, each spread over the buckets by numThreads threads:
+ *
+ * 1. The buckets of the last layer are expanded, and the ranks of the
+ *    children appended, through large per-thread buffers, to unsorted files
+ *    for the buckets of the next layer.
+ * 2. Each bucket of the next layer is read into memory, sorted, and its
+ *    duplicates removed, along with states in the same bucket of the last
+ *    two layers, which are merged in as they are read. The result is
+ *    written as the sorted bucket file.
+ *
+ * Only the last two layers are checked for duplicates, which assumes every
+ * action can be inverted, and only one bucket of one layer must fit in
+ * memory. A checkpoint is written after each layer, so that a search can be
+ * continued with Resume() after it is stopped. The environment must allow
+ * its ranking and successor functions to be called from several threads.
+ */
+template <class state, class action, class environment>
+class ExternalBFS {
+public:
+	ExternalBFS(const char *directory, int numBuckets = 512, int numThreads = 1);
+	/** Start a search from the given state, removing the files of any earlier search */
+	void InitializeSearch(environment *env, const state &from);
+	/**
+	 * Continue the search from the checkpoint in the directory; returns
+	 * false if there isn't one. from is any state of the search, such as
+	 * its start, and is copied to unrank into.
+	 */
+	bool Resume(environment *env, const state &from);
+	/** Build the next layer; returns false once it is empty */
+	bool DoOneLayer();
+	/** Search from the given state until every state has been found */
+	void DoBFS(environment *env, const state &from);
+
+	/** Depth of the last complete layer */
+	int GetDepth() const { return depth; }
+	uint64_t GetLayerSize(int which) const { return layerSizes[which]; }
+	uint64_t GetNodesExpanded() const { return nodesExpanded; }
+	/** Keep every layer on disk, rather than only the last two */
+	void SetKeepLayers(bool keep) { keepLayers = keep; }
+	std::string GetFileName(int layer, int bucket, bool unsorted = false) const;
+private:
+	class ChildWriter;
+	void ExpandWorker();
+	void DetectWorker(std::atomic<uint64_t> *total);
+	void FlushBuffer(int bucket, std::vector<uint64_t> &buffer);
+	uint64_t DetectBucket(int bucket, std::vector<uint64_t> &ranks, std::vector<uint64_t> &buffer);
+	void RemoveLayer(int layer, int buckets);
+	bool ReadCheckpoint(int &buckets, std::vector<uint64_t> &sizes) const;
+	void WriteCheckpoint() const;
+	std::string GetCheckpointName() const;
+
+	std::string directory;
+	int numBuckets, numThreads;
+	environment *env;
+	// copied by each thread to unrank into
+	state start;
+	int depth;
+	std::vector<uint64_t> layerSizes;
+	uint64_t nodesExpanded;
+	bool keepLayers;
+
+	std::atomic<int> nextBucket;
+	std::atomic<uint64_t> expanded;
+	// files for the unsorted buckets of the next layer, and their locks
+	std::vector<int> unsortedFiles;
+	std::vector<std::mutex> bucketLocks;
+};
+
+/** Reads up to count ranks, returning the number read */
+inline size_t ReadRanks(int fd, uint64_t *ranks, size_t count)
+{
+	size_t bytes = 0;
+	while (bytes < count*sizeof(uint64_t))
+	{
+		ssize_t result = read(fd, (char*)ranks+bytes, count*sizeof(uint64_t)-bytes);
+		if (result <= 0)
+			break;
+		bytes += result;
+	}
+	return bytes/sizeof(uint64_t);
+}
+
+/** Writes count ranks, exiting if they can't be written */
+inline void WriteRanks(int fd, const uint64_t *ranks, size_t count)
+{
+	size_t bytes = 0;
+	while (bytes < count*sizeof(uint64_t))
+	{
+		ssize_t result = write(fd, (const char*)ranks+bytes, count*sizeof(uint64_t)-bytes);
+		if (result <= 0)
+		{
+			perror("ExternalBFS: write failed");
+			exit(1);
+		}
+		bytes += result;
+	}
+}
+
+/** Called with each child of an expanded state; buffers its rank for its bucket */
+template <class state, class action, class environment>
+class ExternalBFS<state, action, environment>::ChildWriter {
+public:
+	ChildWriter(ExternalBFS *search)
+	:search(search), buffers(search->numBuckets) {}
+	~ChildWriter()
+	{
+		for (int x = 0; x < search->numBuckets; x++)
+			search->FlushBuffer(x, buffers[x]);
+	}
+	void operator()(const state &child)
+	{
+		uint64_t rank = ExternalBFSRanking<environment, state>::Rank(search->env, child);
+		std::vector<uint64_t> &buffer = buffers[rank%search->numBuckets];
+		buffer.push_back(rank/search->numBuckets);
+		if (buffer.size() >= kExternalBFSWriteBuffer)
+			search->FlushBuffer(rank%search->numBuckets, buffer);
+	}
+private:
+	ExternalBFS *search;
+	std::vector<std::vector<uint64_t> > buffers;
+};
+
+template <class state, class action, class environment>
+ExternalBFS<state, action, environment>::ExternalBFS(const char *directory, int numBuckets, int numThreads)
+:directory(directory), numBuckets(numBuckets), numThreads(numThreads), env(0), depth(0),
+nodesExpanded(0), keepLayers(false), bucketLocks(numBuckets)
+{
+	assert(numBuckets > 0 && numThreads > 0);
+}
+
+template <class state, class action, class environment>
+std::string ExternalBFS<state, action, environment>::GetFileName(int layer, int bucket, bool unsorted) const
+{
+	char name[64];
+	sprintf(name, "/bfs-d%d-b%d.%s", layer, bucket, unsorted?"raw":"dat");
+	return directory+name;
+}
+
+template <class state, class action, class environment>
+std::string ExternalBFS<state, action, environment>::GetCheckpointName() const
+{
+	return directory+"/bfs-checkpoint.txt";
+}
+
+template <class state, class action, class environment>
+void ExternalBFS<state, action, environment>::InitializeSearch(environment *e, const state &from)
+{
+	// remove the files of an earlier search in the same directory
+	int buckets;
+	std::vector<uint64_t> sizes;
+	if (ReadCheckpoint(buckets, sizes))
+	{
+		for (unsigned int x = 0; x <= sizes.size(); x++)
+			RemoveLayer(x, buckets);
+		remove(GetCheckpointName().c_str());
+	}
+	env = e;
+	start = from;
+	depth = 0;
+	nodesExpanded = 0;
+	uint64_t rank = ExternalBFSRanking<environment, state>::Rank(env, from);
+	uint64_t value = rank/numBuckets;
+	int fd = open(GetFileName(0, rank%numBuckets).c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		perror("ExternalBFS: can't create the first layer");
+		exit(1);
+	}
+	WriteRanks(fd, &value, 1);
+	close(fd);
+	layerSizes.assign(1, 1);
+	WriteCheckpoint();
+}
+
+/**
+ Reads the checkpoint, and removes any files of the layer that was being
+ built when the search stopped.
+ **/
+template <class state, class action, class environment>
+bool ExternalBFS<state, action, environment>::Resume(environment *e, const state &from)
+{
+	int buckets;
+	std::vector<uint64_t> sizes;
+	if (!ReadCheckpoint(buckets, sizes))
+		return false;
+	if (buckets != numBuckets)
+	{
+		printf("ExternalBFS: checkpoint '%s' is for %d buckets, not %d\n", GetCheckpointName().c_str(), buckets, numBuckets);
+		return false;
+	}
+	env = e;
+	start = from;
+	layerSizes.swap(sizes);
+	depth = layerSizes.size()-1;
+	nodesExpanded = 0;
+	for (int x = 0; x < depth; x++)
+		nodesExpanded += layerSizes[x];
+	RemoveLayer(depth+1, numBuckets);
+	return true;
+}
+
+/** Reads the number of buckets and the size of each complete layer from the checkpoint */
+template <class state, class action, class environment>
+bool ExternalBFS<state, action, environment>::ReadCheckpoint(int &buckets, std::vector<uint64_t> &sizes) const
+{
+	FILE *f = fopen(GetCheckpointName().c_str(), "r");
+	if (f == 0)
+		return false;
+	int layers;
+	bool valid = (fscanf(f, "buckets %d layers %d", &buckets, &layers) == 2 && buckets > 0 && layers > 0);
+	sizes.resize(valid?layers:0);
+	for (int x = 0; valid && x < layers; x++)
+	{
+		unsigned long long size;
+		valid = (fscanf(f, "%llu", &size) == 1);
+		sizes[x] = size;
+	}
+	fclose(f);
+	return valid;
+}
+
+template <class state, class action, class environment>
+void ExternalBFS<state, action, environment>::WriteCheckpoint() const
+{
+	// written to another file first, so that a checkpoint is never partly written
+	std::string name = GetCheckpointName(), temp = name+".tmp";
+	FILE *f = fopen(temp.c_str(), "w");
+	if (f == 0)
+	{
+		perror("ExternalBFS: can't write checkpoint");
+		exit(1);
+	}
+	fprintf(f, "buckets %d layers %d\n", numBuckets, (int)layerSizes.size());
+	for (unsigned int x = 0; x < layerSizes.size(); x++)
+		fprintf(f, "%llu\n", (unsigned long long)layerSizes[x]);
+	fclose(f);
+	rename(temp.c_str(), name.c_str());
+}
+
+template <class state, class action, class environment>
+void ExternalBFS<state, action, environment>::RemoveLayer(int layer, int buckets)
+{
+	for (int x = 0; x < buckets; x++)
+	{
+		remove(GetFileName(layer, x).c_str());
+		remove(GetFileName(layer, x, true).c_str());
+	}
+}
+
+template <class state, class action, class environment>
+void ExternalBFS<state, action, environment>::DoBFS(environment *e, const state &from)
+{
+	InitializeSearch(e, from);
+	while (DoOneLayer())
+	{}
+}
+
+template <class state, class action, class environment>
+bool ExternalBFS<state, action, environment>::DoOneLayer()
+{
+	if (layerSizes[depth] == 0)
+		return false;
+	Timer t;
+	t.StartTimer();
+	unsortedFiles.resize(numBuckets);
+	for (int x = 0; x < numBuckets; x++)
+	{
+		unsortedFiles[x] = open(GetFileName(depth+1, x, true).c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_APPEND, 0644);
+		if (unsortedFiles[x] < 0)
+		{
+			perror("ExternalBFS: can't create bucket file");
+			exit(1);
+		}
+	}
+	std::vector<std::thread> threads;
+	nextBucket = 0;
+	expanded = 0;
+	for (int x = 0; x < numThreads; x++)
+		threads.push_back(std::thread(&ExternalBFS::ExpandWorker, this));
+	for (auto &thread : threads)
+		thread.join();
+	for (int x = 0; x < numBuckets; x++)
+		close(unsortedFiles[x]);
+	nodesExpanded += expanded;
+	double expandTime = t.EndTimer();
+
+	t.StartTimer();
+	threads.clear();
+	nextBucket = 0;
+	std::atomic<uint64_t> total(0);
+	for (int x = 0; x < numThreads; x++)
+		threads.push_back(std::thread(&ExternalBFS::DetectWorker, this, &total));
+	for (auto &thread : threads)
+		thread.join();
+	depth++;
+	layerSizes.push_back(total);
+	WriteCheckpoint();
+	// the next layer is only checked against the last two
+	if (!keepLayers)
+		RemoveLayer(depth-2, numBuckets);
+	printf("Depth %d: %llu states; %1.2fs expanding, %1.2fs removing duplicates\n", depth,
+		   (unsigned long long)layerSizes[depth], expandTime, t.EndTimer());
+	return layerSizes[depth] > 0;
+}
+
+template <class state, class action, class environment>
+void ExternalBFS<state, action, environment>::ExpandWorker()
+{
+	ChildWriter writer(this);
+	std::vector<uint64_t> values(kExternalBFSReadBuffer);
+	std::vector<state> scratch;
+	state s(start);
+	uint64_t count = 0;
+	for (int bucket = nextBucket++; bucket < numBuckets; bucket = nextBucket++)
+	{
+		int fd = open(GetFileName(depth, bucket).c_str(), O_RDONLY);
+		if (fd < 0)
+			continue;
+		size_t numRead;
+		while ((numRead = ReadRanks(fd, &values[0], values.size())) > 0)
+		{
+			for (size_t x = 0; x < numRead; x++)
+			{
+				ExternalBFSRanking<environment, state>::Unrank(env, values[x]*numBuckets+bucket, s);
+				ForEachSuccessor(env, s, scratch, writer);
+			}
+			count += numRead;
+		}
+		close(fd);
+	}
+	expanded += count;
+}
+
+template <class state, class action, class environment>
+void ExternalBFS<state, action, environment>::FlushBuffer(int bucket, std::vector<uint64_t> &buffer)
+{
+	if (buffer.size() == 0)
+		return;
+	{
+		std::lock_guard<std::mutex> l(bucketLocks[bucket]);
+		WriteRanks(unsortedFiles[bucket], &buffer[0], buffer.size());
+	}
+	buffer.clear();
+}
+
+template <class state, class action, class environment>
+void ExternalBFS<state, action, environment>::DetectWorker(std::atomic<uint64_t> *total)
+{
+	std::vector<uint64_t> ranks, buffer(kExternalBFSReadBuffer);
+	uint64_t count = 0;
+	for (int bucket = nextBucket++; bucket < numBuckets; bucket = nextBucket++)
+		count += DetectBucket(bucket, ranks, buffer);
+	*total += count;
+}
+
+/**
+ Sorts a bucket of the new layer, removes its duplicates and the states in
+ the same bucket of the previous two layers, and writes it out.
+ **/
+template <class state, class action, class environment>
+uint64_t ExternalBFS<state, action, environment>::DetectBucket(int bucket, std::vector<uint64_t> &ranks,
+															   std::vector<uint64_t> &buffer)
+{
+	std::string unsortedName = GetFileName(depth+1, bucket, true);
+	int fd = open(unsortedName.c_str(), O_RDONLY);
+	struct stat info;
+	if (fd < 0 || fstat(fd, &info) != 0)
+	{
+		perror("ExternalBFS: can't read bucket file");
+		exit(1);
+	}
+	ranks.resize(info.st_size/sizeof(uint64_t));
+	if (ReadRanks(fd, ranks.data(), ranks.size()) != ranks.size())
+	{
+		perror("ExternalBFS: can't read bucket file");
+		exit(1);
+	}
+	close(fd);
+	remove(unsortedName.c_str());
+	std::sort(ranks.begin(), ranks.end());
+	ranks.erase(std::unique(ranks.begin(), ranks.end()), ranks.end());
+
+	for (int layer = depth; layer >= 0 && layer >= depth-1; layer--)
+	{
+		fd = open(GetFileName(layer, bucket).c_str(), O_RDONLY);
+		if (fd < 0)
+			continue;
+		// both are sorted, so the states to keep are compacted as the file is merged in
+		size_t in = 0, out = 0, numRead;
+		while ((numRead = ReadRanks(fd, &buffer[0], buffer.size())) > 0)
+		{
+			for (size_t x = 0; x < numRead && in < ranks.size(); x++)
+			{
+				while (in < ranks.size() && ranks[in] < buffer[x])
+					ranks[out++] = ranks[in++];
+				if (in < ranks.size() && ranks[in] == buffer[x])
+					in++;
+			}
+		}
+		close(fd);
+		while (in < ranks.size())
+			ranks[out++] = ranks[in++];
+		ranks.resize(out);
+	}
+
+	fd = open(GetFileName(depth+1, bucket).c_str(), O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	if (fd < 0)
+	{
+		perror("ExternalBFS: can't create bucket file");
+		exit(1);
+	}
+	if (ranks.size() > 0)
+		WriteRanks(fd, ranks.data(), ranks.size());
+	close(fd);
+	return ranks.size();
+}
+
+#endif
@@ -0,0 +1,405 @@
+/**
+ * @file HDAStar.h
+ * @package hog2
+ * @brief Hash-distributed parallel A*
+ * SearchEnvironment
+ *
+ * This file is part of HOG2.
+ * HOG : http://www.cs.ualberta.ca/~nathanst/hog.html
+ * HOG2: http://code.google.com/p/hog2/
+ *
+ * HOG2 is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * HOG2 is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with HOG2; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ */
+
+#ifndef HDAStar_H
+#define HDAStar_H
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include "float.h"
+#include "FPUtil.h"
+#include "AStarOpenClosed.h"
+#include "TemplateAStar.h"
+#include "GenericSearchAlgorithm.h"
+
+/**
+ * Hash-distributed A* (HDA*). Every state is owned by one worker thread,
+ * chosen from GetStateHash(). Each worker keeps its own open/closed list
+ * and expands its own nodes; children owned by another worker are buffered
+ * and sent to that worker's queue in batches.
+ *
+ * Workers expand in best-first order locally, not globally, so a node can
+ * be expanded before its optimal g-cost is known. Such nodes are reopened
+ * when a cheaper path arrives. The first solution found is an upper bound;
+ * the search ends when no worker has an open node with f below the bound
+ * and no messages are in flight, at which point the bound is optimal when
+ * the heuristic is admissible.
+ *
+ * The environment (GetSuccessors, GCost, HCost, GetStateHash) and any
+ * heuristic passed to SetHeuristic() are called from all workers
+ * concurrently and must be safe to use that way.
+ *
+ * In each worker's list parentID holds the hash of the parent state rather
+ * than an element id, since the parent may be owned by another worker.
+ */
+template <class state, class action, class environment, class openList = AStarOpenClosed<state, AStarCompare<state> > >
+class HDAStar : public GenericSearchAlgorithm<state,action,environment> {
+	static_assert(sizeof(std::declval<typename openList::dataType>().parentID) >= sizeof(uint64_t),
+				  "HDAStar stores parent hashes in parentID, so the node record needs 64-bit parent ids");
+public:
+	HDAStar();
+	virtual ~HDAStar();
+	void GetPath(environment *env, const state& from, const state& to, std::vector<state> &thePath);
+	void GetPath(environment *, const state& , const state& , std::vector<action> & ) { assert(false); };
+	virtual const char *GetName();
+
+	/** Number of worker threads used by the next search; defaults to the number of cores */
+	void SetNumThreads(int count) { assert(count > 0); numThreads = count; }
+	int GetNumThreads() const { return numThreads; }
+	/** Number of children buffered for another worker before they are sent */
+	void SetBatchSize(size_t size) { assert(size > 0); batchSize = size; }
+	void SetHeuristic(Heuristic<state> *h) { theHeuristic = h; }
+
+	/** Cost of the path found by the last search, or DBL_MAX if there is none */
+	double GetSolutionCost() const { return solutionCost; }
+	uint64_t GetNodesExpanded() const;
+	uint64_t GetNodesTouched() const;
+	void LogFinalStats(StatCollection *) {}
+private:
+	struct message {
+		state s;
+		uint64_t hash;
+		double g;
+		uint64_t parent;
+	};
+	struct worker {
+		openList list;
+		std::mutex queueLock;
+		std::vector<message> incoming;
+		std::vector<std::vector<message> > outgoing;
+		std::vector<state> neighbors;
+		uint64_t nodesExpanded, nodesTouched;
+	};
+	inline int Owner(uint64_t hash) const
+	{ return (int)(((hash*0x9E3779B97F4A7C15ull)>>32)%numThreads); }
+	double GetHCost(const state &s)
+	{ return theHeuristic ? theHeuristic->HCost(s, goal) : env->HCost(s, goal); }
+	void Worker(int which);
+	bool Expand(int which);
+	void Insert(int which, const state &s, uint64_t hash, double g, uint64_t parent);
+	void Send(int from, int to);
+	void ExtractPath(std::vector<state> &thePath);
+
+	std::vector<worker *> workers;
+	int numThreads;
+	size_t batchSize;
+	environment *env;
+	Heuristic<state> *theHeuristic;
+	state goal;
+
+	std::atomic<double> solutionCost;
+	std::mutex solutionLock;
+	// messages sent but not yet fully processed by their receiver
+	std::atomic<int64_t> inFlight;
+	std::atomic<int> idleCount;
+};
+
+// nodes a worker expands between checks of its message queue
+const int kHDAExpansionsPerRound = 32;
+
+template <class state, class action, class environment, class openList>
+HDAStar<state, action, environment, openList>::HDAStar()
+:numThreads(std::max(1u, std::thread::hardware_concurrency())), batchSize(64), env(0), theHeuristic(0)
+{
+	solutionCost = DBL_MAX;
+}
+
+template <class state, class action, class environment, class openList>
+HDAStar<state, action, environment, openList>::~HDAStar()
+{
+	for (unsigned int x = 0; x < workers.size(); x++)
+		delete workers[x];
+}
+
+template <class state, class action, class environment, class openList>
+const char *HDAStar<state, action, environment, openList>::GetName()
+{
+	static char name[32];
+	sprintf(name, "HDAStar[%d]", numThreads);
+	return name;
+}
+
+template <class state, class action, class environment, class openList>
+uint64_t HDAStar<state, action, environment, openList>::GetNodesExpanded() const
+{
+	uint64_t total = 0;
+	for (unsigned int x = 0; x < workers.size(); x++)
+		total += workers[x]->nodesExpanded;
+	return total;
+}
+
+template <class state, class action, class environment, class openList>
+uint64_t HDAStar<state, action, environment, openList>::GetNodesTouched() const
+{
+	uint64_t total = 0;
+	for (unsigned int x = 0; x < workers.size(); x++)
+		total += workers[x]->nodesTouched;
+	return total;
+}
+
+/**
+ * Perform a parallel A* search between two states.
+ *
+ * @param _env The search environment
+ * @param from The start state
+ * @param to The goal state
+ * @param thePath A vector of states which will contain an optimal path
+ * between from and to when the function returns, if one exists.
+ */
+template <class state, class action, class environment, class openList>
+void HDAStar<state, action, environment, openList>::GetPath(environment *_env, const state& from, const state& to, std::vector<state> &thePath)
+{
+	env = _env;
+	goal = to;
+	thePath.resize(0);
+	while ((int)workers.size() > numThreads)
+	{
+		delete workers.back();
+		workers.pop_back();
+	}
+	while ((int)workers.size() < numThreads)
+		workers.push_back(new worker);
+	for (int x = 0; x < numThreads; x++)
+	{
+		workers[x]->list.Reset();
+		workers[x]->incoming.resize(0);
+		workers[x]->outgoing.resize(numThreads);
+		workers[x]->nodesExpanded = workers[x]->nodesTouched = 0;
+	}
+	solutionCost = DBL_MAX;
+	inFlight = 0;
+	idleCount = 0;
+
+	uint64_t startHash = env->GetStateHash(from);
+	Insert(Owner(startHash), from, startHash, 0, startHash);
+
+	std::vector<std::thread *> threads(numThreads);
+	for (int x = 0; x < numThreads; x++)
+		threads[x] = new std::thread(&HDAStar<state, action, environment, openList>::Worker, this, x);
+	for (int x = 0; x < numThreads; x++)
+	{
+		threads[x]->join();
+		delete threads[x];
+		threads[x] = 0;
+	}
+
+	if (solutionCost != DBL_MAX)
+		ExtractPath(thePath);
+}
+
+/**
+ * Main loop of a worker: take incoming messages, expand a few nodes, send
+ * buffered children. A worker with nothing below the solution bound goes
+ * idle; the search is done when every worker is idle and no messages are
+ * in flight. A worker only subtracts the messages it received from
+ * inFlight once it is idle again and has sent everything it generated
+ * from them, so inFlight can't reach 0 while any of that work is pending.
+ */
+template <class state, class action, class environment, class openList>
+void HDAStar<state, action, environment, openList>::Worker(int which)
+{
+	worker &w = *workers[which];
+	std::vector<message> received;
+	int64_t pending = 0;
+	bool idle = false;
+	while (true)
+	{
+		w.queueLock.lock();
+		received.swap(w.incoming);
+		w.queueLock.unlock();
+		if (received.size() > 0)
+		{
+			if (idle)
+			{
+				idle = false;
+				idleCount--;
+			}
+			pending += received.size();
+			for (unsigned int x = 0; x < received.size(); x++)
+				Insert(which, received[x].s, received[x].hash, received[x].g, received[x].parent);
+			received.resize(0);
+		}
+
+		bool expanded = false;
+		for (int x = 0; x < kHDAExpansionsPerRound; x++)
+		{
+			if (!Expand(which))
+				break;
+			expanded = true;
+		}
+		for (int x = 0; x < numThreads; x++)
+		{
+			if (w.outgoing[x].size() > 0)
+				Send(which, x);
+		}
+		if (expanded)
+			continue;
+
+		if (pending > 0)
+		{
+			inFlight -= pending;
+			pending = 0;
+		}
+		if (!idle)
+		{
+			idle = true;
+			idleCount++;
+		}
+		if (idleCount == numThreads && inFlight == 0)
+			break;
+		std::this_thread::yield();
+	}
+}
+
+/**
+ * Expand the best node of a worker. Returns false if the worker has no
+ * open node that could lead to a better solution.
+ */
+template <class state, class action, class environment, class openList>
+bool HDAStar<state, action, environment, openList>::Expand(int which)
+{
+	worker &w = *workers[which];
+	if (w.list.OpenSize() == 0)
+		return false;
+	uint64_t next = w.list.Peek();
+	if (!fless(w.list.Lookat(next).g+w.list.Lookat(next).h, solutionCost))
+		return false;
+	w.list.Close();
+	w.nodesExpanded++;
+	// copies, since local children can reallocate the list
+	state s = w.list.Lookat(next).data;
+	double g = w.list.Lookat(next).g;
+	if (s == goal)
+		return true;
+	uint64_t hash = env->GetStateHash(s);
+	env->GetSuccessors(s, w.neighbors);
+	for (unsigned int x = 0; x < w.neighbors.size(); x++)
+	{
+		double childG = g+env->GCost(s, w.neighbors[x]);
+		uint64_t childHash = env->GetStateHash(w.neighbors[x]);
+		int owner = Owner(childHash);
+		if (owner == which)
+		{
+			Insert(which, w.neighbors[x], childHash, childG, hash);
+			continue;
+		}
+		message m;
+		m.s = w.neighbors[x];
+		m.hash = childHash;
+		m.g = childG;
+		m.parent = hash;
+		w.outgoing[owner].push_back(m);
+		if (w.outgoing[owner].size() >= batchSize)
+			Send(which, owner);
+	}
+	return true;
+}
+
+/**
+ * Add a state (with its hash) reached with cost g to the list of the worker that owns it,
+ * reopening it if this is a cheaper path to a closed state.
+ */
+template <class state, class action, class environment, class openList>
+void HDAStar<state, action, environment, openList>::Insert(int which, const state &s, uint64_t hash, double g, uint64_t parent)
+{
+	worker &w = *workers[which];
+	w.nodesTouched++;
+	uint64_t objKey;
+	switch (w.list.Lookup(hash, objKey))
+	{
+		case kNotFound:
+		{
+			double h = GetHCost(s);
+			if (!fless(g+h, solutionCost))
+				return;
+			w.list.AddOpenNode(s, hash, g, h, parent);
+			break;
+		}
+		case kOpenList:
+			if (!fless(g, w.list.Lookup(objKey).g))
+				return;
+			w.list.Lookup(objKey).g = g;
+			w.list.Lookup(objKey).parentID = parent;
+			w.list.KeyChanged(objKey);
+			break;
+		case kClosedList:
+			if (!fless(g, w.list.Lookup(objKey).g))
+				return;
+			w.list.Lookup(objKey).g = g;
+			w.list.Lookup(objKey).parentID = parent;
+			w.list.Reopen(objKey);
+			break;
+	}
+	if (s == goal)
+	{
+		std::lock_guard<std::mutex> l(solutionLock);
+		if (fless(g, solutionCost))
+			solutionCost = g;
+	}
+}
+
+/**
+ * Move the buffered children for one worker to its queue.
+ */
+template <class state, class action, class environment, class openList>
+void HDAStar<state, action, environment, openList>::Send(int from, int to)
+{
+	std::vector<message> &out = workers[from]->outgoing[to];
+	// counted before they are visible, so inFlight never misses them
+	inFlight += out.size();
+	workers[to]->queueLock.lock();
+	workers[to]->incoming.insert(workers[to]->incoming.end(), out.begin(), out.end());
+	workers[to]->queueLock.unlock();
+	out.resize(0);
+}
+
+/**
+ * Follow the parent hashes back from the goal, looking each state up in
+ * the list of the worker that owns it.
+ */
+template <class state, class action, class environment, class openList>
+void HDAStar<state, action, environment, openList>::ExtractPath(std::vector<state> &thePath)
+{
+	uint64_t hash = env->GetStateHash(goal);
+	while (true)
+	{
+		openList &list = workers[Owner(hash)]->list;
+		uint64_t objKey;
+		dataLocation loc = list.Lookup(hash, objKey);
+		assert(loc != kNotFound);
+		thePath.push_back(list.Lookat(objKey).data);
+		if (list.Lookat(objKey).parentID == hash)
+			break;
+		hash = list.Lookat(objKey).parentID;
+	}
+	std::reverse(thePath.begin(), thePath.end());
+}
+
+#endif
@@ -13,6 +13,7 @@
 #include <iostream>
 #include "SearchEnvironment.h"
 #include <ext/hash_map>
+#include <deque>
 #include "FPUtil.h"
 #include "vectorCache.h"
 
@@ -22,7 +23,7 @@ typedef __gnu_cxx::hash_map<uint64_t, double> NodeHashTable;
 template <class state, class action>
 class IDAStar {
 public:
-	IDAStar() { useHashTable = usePathMax = false; }
+	IDAStar() { useHashTable = usePathMax = useInPlace = false; }
 	virtual ~IDAStar() {}
 	void GetPath(SearchEnvironment<state, action> *env, state from, state to,
 							 std::vector<state> &thePath);
@@ -33,13 +34,21 @@ public:
 	uint64_t GetNodesTouched() { return nodesTouched; }
 	void ResetNodeCount() { nodesExpanded = nodesTouched = 0; }
 	void SetUseBDPathMax(bool val) { usePathMax = val; }
+	/**
+	 * When set, the state-path GetPath() searches with ApplyAction/UndoAction
+	 * on a single state, the same as the action-path GetPath(), and converts
+	 * the solution to states afterwards. Requires GetActions, ApplyAction and
+	 * UndoAction; off by default because some environments only implement
+	 * GetSuccessors.
+	 */
+	void SetUseInPlaceSearch(bool val) { useInPlace = val; }
 private:
 	unsigned long long nodesExpanded, nodesTouched;
 	
 	double DoIteration(SearchEnvironment<state, action> *env,
-					   state parent, state currState,
+					   const state &parent, const state &currState,
 					   std::vector<state> &thePath, double bound, double g,
-					   double maxH);
+					   double maxH, double parentH);
 	double DoIteration(SearchEnvironment<state, action> *env,
 					   action forbiddenAction, state &currState,
 					   std::vector<action> &thePath, double bound, double g,
@@ -51,7 +60,12 @@ private:
 	NodeHashTable nodeTable;
 	bool usePathMax;
 	bool useHashTable;
-	vectorCache<action> actCache;
+	bool useInPlace;
+	// actions generated at each depth of the in-place search, reused across
+	// nodes and iterations; a deque so that growing it doesn't move the
+	// vectors in use further up the tree
+	std::deque<std::vector<action> > actionsAtDepth;
+	vectorCache<state> stateCache;
 };
 
 template <class state, class action>
@@ -59,17 +73,31 @@ void IDAStar<state, action>::GetPath(SearchEnvironment<state, action> *env,
 									 state from, state to,
 									 std::vector<state> &thePath)
 {
+	if (useInPlace)
+	{
+		std::vector<action> actionPath;
+		GetPath(env, from, to, actionPath);
+		thePath.resize(0);
+		thePath.push_back(from);
+		for (unsigned int x = 0; x < actionPath.size(); x++)
+		{
+			env->ApplyAction(from, actionPath[x]);
+			thePath.push_back(from);
+		}
+		return;
+	}
 	nextBound = 0;
 	nodesExpanded = nodesTouched = 0;
 	thePath.resize(0);
-	UpdateNextBound(0, env->HCost(from, to));
+	double rootH = env->HCost(from, to);
+	UpdateNextBound(0, rootH);
 	goal = to;
 	thePath.push_back(from);
 	while (true) //thePath.size() == 0)
 	{
 		nodeTable.clear();
 		printf("Starting iteration with bound %f\n", nextBound);
-		if (DoIteration(env, from, from, thePath, nextBound, 0, 0) == 0)
+		if (DoIteration(env, from, from, thePath, nextBound, 0, 0, rootH) == 0)
 			break;
 	}
 }
@@ -102,12 +130,13 @@ void IDAStar<state, action>::GetPath(SearchEnvironment<state, action> *env,
 
 template <class state, class action>
 double IDAStar<state, action>::DoIteration(SearchEnvironment<state, action> *env,
-										   state parent, state currState,
+										   const state &parent, const state &currState,
 										   std::vector<state> &thePath, double bound, double g,
-										   double maxH)
+										   double maxH, double parentH)
 {
 	nodesExpanded++;
-	double h = env->HCost(currState, goal);
+	double h = env->HCost(currState, goal, parentH);
+	parentH = h;
 	
 	// path max
 	if (usePathMax && fless(h, maxH))
@@ -121,7 +150,7 @@ double IDAStar<state, action>::DoIteration(SearchEnvironment<state, action> *env
 	if (env->GoalTest(currState, goal))
 		return 0;
 		
-	std::vector<state> neighbors;
+	std::vector<state> &neighbors = *stateCache.getItem();
 	env->GetSuccessors(currState, neighbors);
 	nodesTouched += neighbors.size();
 	
@@ -132,9 +161,12 @@ double IDAStar<state, action>::DoIteration(SearchEnvironment<state, action> *env
 		thePath.push_back(neighbors[x]);
 		double edgeCost = env->GCost(currState, neighbors[x]);
 		double childH = DoIteration(env, currState, neighbors[x], thePath, bound,
-																g+edgeCost, maxH - edgeCost);
+																g+edgeCost, maxH - edgeCost, parentH);
 		if (env->GoalTest(thePath.back(), goal))
+		{
+			stateCache.returnItem(&neighbors);
 			return 0;
+		}
 		thePath.pop_back();
 		// pathmax
 		if (usePathMax && fgreater(childH-edgeCost, h))
@@ -144,10 +176,12 @@ double IDAStar<state, action>::DoIteration(SearchEnvironment<state, action> *env
 			if (fgreater(g+h, bound))
 			{
 				UpdateNextBound(bound, g+h);
+				stateCache.returnItem(&neighbors);
 				return h;
 			}
 		}
 	}
+	stateCache.returnItem(&neighbors);
 	return h;
 }
 
@@ -173,10 +207,12 @@ double IDAStar<state, action>::DoIteration(SearchEnvironment<state, action> *env
 	if (env->GoalTest(currState, goal))
 		return -1; // found goal
 	
-	std::vector<action> &actions = *actCache.getItem();
+	int depth = thePath.size();
+	if ((int)actionsAtDepth.size() <= depth)
+		actionsAtDepth.resize(depth+1);
+	std::vector<action> &actions = actionsAtDepth[depth];
 	env->GetActions(currState, actions);
 	nodesTouched += actions.size();
-	int depth = thePath.size();
 	
 	for (unsigned int x = 0; x < actions.size(); x++)
 	{
@@ -193,10 +229,7 @@ double IDAStar<state, action>::DoIteration(SearchEnvironment<state, action> *env
 									g+edgeCost, maxH - edgeCost, parentH);
 		env->UndoAction(currState, actions[x]);
 		if (fequal(childH, -1)) // found goal
-		{
-			actCache.returnItem(&actions);
 			return -1;
-		}
 
 		thePath.pop_back();
 
@@ -208,12 +241,10 @@ double IDAStar<state, action>::DoIteration(SearchEnvironment<state, action> *env
 			if (fgreater(g+h, bound))
 			{
 				UpdateNextBound(bound, g+h);
-				actCache.returnItem(&actions);
 				return h;
 			}
 		}
 	}
-	actCache.returnItem(&actions);
 	return h;
 }
 
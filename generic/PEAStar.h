@@ -61,8 +61,11 @@ struct PEAStarCompare {
 
 /**
  * A templated version of A*, based on HOG genericAStar
+ *
+ * As in TemplateAStar the open/closed list is a template parameter, so
+ * BucketOpenClosed can be used for integer-cost domains.
  */
-template <class state, class action, class environment>
+template <class state, class action, class environment, class openList = AStarOpenClosed<state, PEAStarCompare<state> > >
 class PEAStar : public GenericSearchAlgorithm<state,action,environment> {
 public:
 	PEAStar() { ResetNodeCount(); env = 0; stopAfterGoal = true; weight=1; reopenNodes = false; }
@@ -71,8 +74,7 @@ public:
 	
 	void GetPath(environment *, const state& , const state& , std::vector<action> & ) { assert(false); };
 	
-	AStarOpenClosed<state, PEAStarCompare<state> > openClosedList;
-	//BucketOpenClosed<state, PEAStarCompare<state> > openClosedList;
+	openList openClosedList;
 	state goal, start;
 	
 	bool InitializeSearch(environment *env, const state& from, const state& to, std::vector<state> &thePath);
@@ -142,8 +144,8 @@ private:
  * @return The name of the algorithm
  */
 
-template <class state, class action, class environment>
-const char *PEAStar<state,action,environment>::GetName()
+template <class state, class action, class environment, class openList>
+const char *PEAStar<state, action, environment, openList>::GetName()
 {
 	static char name[32];
 	sprintf(name, "PEAStar[]");
@@ -161,8 +163,8 @@ const char *PEAStar<state,action,environment>::GetName()
  * @param thePath A vector of states which will contain an optimal path 
  * between from and to when the function returns, if one exists. 
  */
-template <class state, class action, class environment>
-void PEAStar<state,action,environment>::GetPath(environment *_env, const state& from, const state& to, std::vector<state> &thePath)
+template <class state, class action, class environment, class openList>
+void PEAStar<state, action, environment, openList>::GetPath(environment *_env, const state& from, const state& to, std::vector<state> &thePath)
 {
 	//discardcount=0;
   	if (!InitializeSearch(_env, from, to, thePath))
@@ -182,8 +184,8 @@ void PEAStar<state,action,environment>::GetPath(environment *_env, const state&
  * @param to The goal state
  * @return TRUE if initialization was successful, FALSE otherwise
  */
-template <class state, class action, class environment>
-bool PEAStar<state,action,environment>::InitializeSearch(environment *_env, const state& from, const state& to, std::vector<state> &thePath)
+template <class state, class action, class environment, class openList>
+bool PEAStar<state, action, environment, openList>::InitializeSearch(environment *_env, const state& from, const state& to, std::vector<state> &thePath)
 {
 	theHeuristic = _env;
 	thePath.resize(0);
@@ -216,8 +218,8 @@ bool PEAStar<state,action,environment>::InitializeSearch(environment *_env, cons
  * @author Nathan Sturtevant
  * @date 01/06/08
  */
-template <class state, class action, class environment>
-void PEAStar<state,action,environment>::AddAdditionalStartState(state& newState)
+template <class state, class action, class environment, class openList>
+void PEAStar<state, action, environment, openList>::AddAdditionalStartState(state& newState)
 {
 	openClosedList.AddOpenNode(newState, env->GetStateHash(newState), 0, weight*theHeuristic->HCost(start, goal));
 }
@@ -227,8 +229,8 @@ void PEAStar<state,action,environment>::AddAdditionalStartState(state& newState)
  * @author Nathan Sturtevant
  * @date 09/25/10
  */
-template <class state, class action, class environment>
-void PEAStar<state,action,environment>::AddAdditionalStartState(state& newState, double cost)
+template <class state, class action, class environment, class openList>
+void PEAStar<state, action, environment, openList>::AddAdditionalStartState(state& newState, double cost)
 {
 	openClosedList.AddOpenNode(newState, env->GetStateHash(newState), cost, weight*theHeuristic->HCost(start, goal));
 }
@@ -243,8 +245,8 @@ void PEAStar<state,action,environment>::AddAdditionalStartState(state& newState,
  * @return TRUE if there is no path or if we have found the goal, FALSE
  * otherwise
  */
-template <class state, class action, class environment>
-bool PEAStar<state,action,environment>::DoSingleSearchStep(std::vector<state> &thePath)
+template <class state, class action, class environment, class openList>
+bool PEAStar<state, action, environment, openList>::DoSingleSearchStep(std::vector<state> &thePath)
 {
 	if (openClosedList.OpenSize() == 0)
 	{
@@ -353,8 +355,8 @@ bool PEAStar<state,action,environment>::DoSingleSearchStep(std::vector<state> &t
  * 
  * @return The first state in the open list. 
  */
-template <class state, class action, class environment>
-state PEAStar<state, action,environment>::CheckNextNode()
+template <class state, class action, class environment, class openList>
+state PEAStar<state, action, environment, openList>::CheckNextNode()
 {
 	uint64_t key = openClosedList.Peek();
 	return openClosedList.Lookup(key).data;
@@ -371,8 +373,8 @@ state PEAStar<state, action,environment>::CheckNextNode()
  * @param goalNode the goal state
  * @param thePath will contain the path from goalNode to the start state
  */
-template <class state, class action,class environment>
-void PEAStar<state, action,environment>::ExtractPathToStartFromID(uint64_t node,
+template <class state, class action, class environment, class openList>
+void PEAStar<state, action, environment, openList>::ExtractPathToStartFromID(uint64_t node,
 																	 std::vector<state> &thePath)
 {
 	do {
@@ -388,8 +390,8 @@ void PEAStar<state, action,environment>::ExtractPathToStartFromID(uint64_t node,
  * @author Nathan Sturtevant
  * @date 03/22/06
  */
-template <class state, class action, class environment>
-void PEAStar<state, action,environment>::PrintStats()
+template <class state, class action, class environment, class openList>
+void PEAStar<state, action, environment, openList>::PrintStats()
 {
 	printf("%u items in closed list\n", (unsigned int)openClosedList.ClosedSize());
 	printf("%u items in open queue\n", (unsigned int)openClosedList.OpenSize());
@@ -402,8 +404,8 @@ void PEAStar<state, action,environment>::PrintStats()
  * 
  * @return The combined number of elements in the closed list and open queue
  */
-template <class state, class action, class environment>
-int PEAStar<state, action,environment>::GetMemoryUsage()
+template <class state, class action, class environment, class openList>
+int PEAStar<state, action, environment, openList>::GetMemoryUsage()
 {
 	return openClosedList.size();
 }
@@ -418,8 +420,8 @@ int PEAStar<state, action,environment>::GetMemoryUsage()
  * @return success Whether we found the value or not
  * more states
  */
-template <class state, class action, class environment>
-bool PEAStar<state, action,environment>::GetClosedListGCost(const state &val, double &gCost) const
+template <class state, class action, class environment, class openList>
+bool PEAStar<state, action, environment, openList>::GetClosedListGCost(const state &val, double &gCost) const
 {
 	uint64_t theID;
 	dataLocation loc = openClosedList.Lookup(env->GetStateHash(val), theID);
@@ -437,8 +439,8 @@ bool PEAStar<state, action,environment>::GetClosedListGCost(const state &val, do
  * @date 03/12/09
  * 
  */
-template <class state, class action, class environment>
-void PEAStar<state, action,environment>::OpenGLDraw() const
+template <class state, class action, class environment, class openList>
+void PEAStar<state, action, environment, openList>::OpenGLDraw() const
 {
 	double transparency = 1.0;
 	if (openClosedList.size() == 0)
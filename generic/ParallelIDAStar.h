@@ -0,0 +1,358 @@
+/*
+ *  ParallelIDAStar.h
+ *  hog2
+ *
+ *  IDA* that splits each iteration into independent subtrees and searches
+ *  them with a pool of threads.
+ *
+ */
+
+#ifndef PARALLELIDASTAR_H
+#define PARALLELIDASTAR_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "float.h"
+#include "FPUtil.h"
+
+/**
+ * Parallel IDA*. In each iteration the top of the tree is searched
+ * serially down to the split depth; the nodes at that depth become work
+ * items which are dealt round-robin to per-thread queues. A thread takes
+ * items from the front of its own queue and, once that is empty, steals
+ * from the back of the others.
+ *
+ * Every node is visited exactly as in IDA* with the parent-move pruning of
+ * IDAStar's action-based search (no BPMX), so the nodes expanded in each
+ * iteration that doesn't find the goal are identical to serial IDA*. The
+ * last iteration stops all threads as soon as one finds a solution, so its
+ * count depends on timing; it also includes the whole top of the tree,
+ * which serial IDA* only partly visits before reaching the goal.
+ *
+ * The environment is shared by all threads; GetActions, ApplyAction,
+ * UndoAction, InvertAction, GCost, HCost and GoalTest must be safe to call
+ * concurrently.
+ */
+template <class state, class action, class environment>
+class ParallelIDAStar {
+public:
+	ParallelIDAStar();
+	virtual ~ParallelIDAStar();
+	void GetPath(environment *env, const state &from, const state &to, std::vector<action> &thePath);
+
+	/** Number of threads used by the next search; defaults to the number of cores */
+	void SetNumThreads(int count) { assert(count > 0); numThreads = count; }
+	int GetNumThreads() const { return numThreads; }
+	/** Depth of the serially searched top of the tree. Deeper gives more, smaller work items. */
+	void SetSplitDepth(int depth) { assert(depth >= 0); splitDepth = depth; }
+	int GetSplitDepth() const { return splitDepth; }
+
+	uint64_t GetNodesExpanded() const { return nodesExpanded; }
+	uint64_t GetNodesTouched() const { return nodesTouched; }
+	void ResetNodeCount() { nodesExpanded = nodesTouched = 0; }
+	/** Bound and nodes expanded for each iteration of the last search */
+	const std::vector<double> &GetIterationBounds() const { return iterationBounds; }
+	const std::vector<uint64_t> &GetIterationNodesExpanded() const { return iterationNodes; }
+private:
+	struct workItem {
+		state s;
+		double g;
+		std::vector<action> path;
+	};
+	struct worker {
+		std::mutex lock;
+		std::deque<workItem> work;
+		// actions at each depth below the work item, reused between items;
+		// a deque so that growing it doesn't move the vectors in use
+		std::deque<std::vector<action> > actions;
+		std::vector<action> path;
+		uint64_t nodesExpanded, nodesTouched;
+		double nextBound;
+	};
+	bool GenerateWork(state &currState, double g, std::vector<action> &path, double bound);
+	bool GetWork(int which, workItem &item);
+	void Worker(int which, double bound);
+	bool DoIteration(worker &w, state &currState, double g, double bound, bool haveForbidden, action forbiddenAction);
+	void UpdateNextBound(double fCost);
+
+	environment *env;
+	state goal;
+	int numThreads;
+	int splitDepth;
+	uint64_t nodesExpanded, nodesTouched;
+	std::vector<double> iterationBounds;
+	std::vector<uint64_t> iterationNodes;
+
+	std::vector<worker *> workers;
+	int nextWorker;
+	// nodes above the split depth in the current iteration
+	uint64_t topExpanded, topTouched;
+	std::atomic<double> nextBound;
+	std::atomic<bool> done;
+	std::mutex solutionLock;
+	std::vector<action> solution;
+};
+
+template <class state, class action, class environment>
+ParallelIDAStar<state, action, environment>::ParallelIDAStar()
+:env(0), numThreads(std::max(1u, std::thread::hardware_concurrency())), splitDepth(6)
+{
+	ResetNodeCount();
+}
+
+template <class state, class action, class environment>
+ParallelIDAStar<state, action, environment>::~ParallelIDAStar()
+{
+	for (unsigned int x = 0; x < workers.size(); x++)
+		delete workers[x];
+}
+
+template <class state, class action, class environment>
+void ParallelIDAStar<state, action, environment>::GetPath(environment *_env, const state &from, const state &to, std::vector<action> &thePath)
+{
+	env = _env;
+	goal = to;
+	nodesExpanded = nodesTouched = 0;
+	thePath.resize(0);
+	iterationBounds.resize(0);
+	iterationNodes.resize(0);
+	if (env->GoalTest(from, to))
+		return;
+
+	while ((int)workers.size() > numThreads)
+	{
+		delete workers.back();
+		workers.pop_back();
+	}
+	while ((int)workers.size() < numThreads)
+		workers.push_back(new worker);
+
+	double bound = env->HCost(from, to);
+	while (true)
+	{
+		printf("Starting iteration with bound %f; %llu expanded\n", bound, (unsigned long long)nodesExpanded);
+		fflush(stdout);
+		nextBound = DBL_MAX;
+		done = false;
+		solution.resize(0);
+		topExpanded = topTouched = 0;
+		nextWorker = 0;
+		for (int x = 0; x < numThreads; x++)
+		{
+			workers[x]->work.clear();
+			workers[x]->nodesExpanded = workers[x]->nodesTouched = 0;
+		}
+
+		state s = from;
+		std::vector<action> path;
+		if (GenerateWork(s, 0, path, bound))
+		{
+			done = true;
+			solution = path;
+		}
+		else {
+			std::vector<std::thread *> threads(numThreads);
+			for (int x = 0; x < numThreads; x++)
+				threads[x] = new std::thread(&ParallelIDAStar<state, action, environment>::Worker, this, x, bound);
+			for (int x = 0; x < numThreads; x++)
+			{
+				threads[x]->join();
+				delete threads[x];
+				threads[x] = 0;
+			}
+		}
+
+		uint64_t iterationExpanded = topExpanded;
+		nodesTouched += topTouched;
+		for (int x = 0; x < numThreads; x++)
+		{
+			iterationExpanded += workers[x]->nodesExpanded;
+			nodesTouched += workers[x]->nodesTouched;
+		}
+		nodesExpanded += iterationExpanded;
+		iterationBounds.push_back(bound);
+		iterationNodes.push_back(iterationExpanded);
+
+		if (done)
+		{
+			thePath = solution;
+			return;
+		}
+		// nothing was cut off, so there is no path
+		if (nextBound == DBL_MAX)
+			return;
+		bound = nextBound;
+	}
+}
+
+/**
+ * Serially search the top of the tree, queueing the nodes at the split
+ * depth as work items. Returns true if the goal is found above the split
+ * depth, in which case path holds the solution.
+ */
+template <class state, class action, class environment>
+bool ParallelIDAStar<state, action, environment>::GenerateWork(state &currState, double g, std::vector<action> &path, double bound)
+{
+	if ((int)path.size() == splitDepth)
+	{
+		workItem item;
+		item.s = currState;
+		item.g = g;
+		item.path = path;
+		workers[nextWorker]->work.push_back(item);
+		nextWorker = (nextWorker+1)%numThreads;
+		return false;
+	}
+	topExpanded++;
+	double h = env->HCost(currState, goal);
+	if (fgreater(g+h, bound))
+	{
+		UpdateNextBound(g+h);
+		return false;
+	}
+	if (env->GoalTest(currState, goal))
+		return true;
+
+	std::vector<action> actions;
+	env->GetActions(currState, actions);
+	topTouched += actions.size();
+	for (unsigned int x = 0; x < actions.size(); x++)
+	{
+		if (path.size() != 0)
+		{
+			action forbidden = path.back();
+			env->InvertAction(forbidden);
+			if (actions[x] == forbidden)
+				continue;
+		}
+		double edgeCost = env->GCost(currState, actions[x]);
+		path.push_back(actions[x]);
+		env->ApplyAction(currState, actions[x]);
+		bool found = GenerateWork(currState, g+edgeCost, path, bound);
+		env->UndoAction(currState, actions[x]);
+		if (found)
+			return true;
+		path.pop_back();
+	}
+	return false;
+}
+
+/**
+ * Take the next item from the front of our own queue, or steal one from
+ * the back of another thread's queue.
+ */
+template <class state, class action, class environment>
+bool ParallelIDAStar<state, action, environment>::GetWork(int which, workItem &item)
+{
+	for (int x = 0; x < numThreads; x++)
+	{
+		worker &victim = *workers[(which+x)%numThreads];
+		std::lock_guard<std::mutex> l(victim.lock);
+		if (victim.work.size() == 0)
+			continue;
+		if (x == 0)
+		{
+			item = victim.work.front();
+			victim.work.pop_front();
+		}
+		else {
+			item = victim.work.back();
+			victim.work.pop_back();
+		}
+		return true;
+	}
+	return false;
+}
+
+template <class state, class action, class environment>
+void ParallelIDAStar<state, action, environment>::Worker(int which, double bound)
+{
+	worker &w = *workers[which];
+	workItem item;
+	while (!done && GetWork(which, item))
+	{
+		w.nextBound = DBL_MAX;
+		w.path.resize(0);
+		bool haveForbidden = (item.path.size() > 0);
+		action forbidden = action();
+		if (haveForbidden)
+		{
+			forbidden = item.path.back();
+			env->InvertAction(forbidden);
+		}
+		if (DoIteration(w, item.s, item.g, bound, haveForbidden, forbidden))
+		{
+			std::lock_guard<std::mutex> l(solutionLock);
+			if (!done)
+			{
+				solution = item.path;
+				solution.insert(solution.end(), w.path.begin(), w.path.end());
+				done = true;
+			}
+		}
+		UpdateNextBound(w.nextBound);
+	}
+}
+
+/**
+ * Depth-first search below a work item. Returns true if the goal was found,
+ * leaving the actions to it in w.path.
+ */
+template <class state, class action, class environment>
+bool ParallelIDAStar<state, action, environment>::DoIteration(worker &w, state &currState, double g, double bound,
+															  bool haveForbidden, action forbiddenAction)
+{
+	if (done)
+		return false;
+	w.nodesExpanded++;
+	double h = env->HCost(currState, goal);
+	if (fgreater(g+h, bound))
+	{
+		if (g+h < w.nextBound)
+			w.nextBound = g+h;
+		return false;
+	}
+	if (env->GoalTest(currState, goal))
+		return true;
+
+	unsigned int depth = w.path.size();
+	if (w.actions.size() <= depth)
+		w.actions.resize(depth+1);
+	std::vector<action> &actions = w.actions[depth];
+	env->GetActions(currState, actions);
+	w.nodesTouched += actions.size();
+	for (unsigned int x = 0; x < actions.size(); x++)
+	{
+		if (haveForbidden && actions[x] == forbiddenAction)
+			continue;
+		double edgeCost = env->GCost(currState, actions[x]);
+		w.path.push_back(actions[x]);
+		env->ApplyAction(currState, actions[x]);
+		action a = actions[x];
+		env->InvertAction(a);
+		bool found = DoIteration(w, currState, g+edgeCost, bound, true, a);
+		env->UndoAction(currState, actions[x]);
+		if (found)
+			return true;
+		w.path.pop_back();
+	}
+	return false;
+}
+
+/**
+ * Lower the shared next bound to fCost if it is smaller.
+ */
+template <class state, class action, class environment>
+void ParallelIDAStar<state, action, environment>::UpdateNextBound(double fCost)
+{
+	double current = nextBound;
+	while (fCost < current && !nextBound.compare_exchange_weak(current, fCost))
+	{}
+}
+
+#endif
@@ -53,7 +53,8 @@ static double lastF = 0;
 
 template <class state>
 struct AStarCompare {
-	bool operator()(const AStarOpenClosedData<state> &i1, const AStarOpenClosedData<state> &i2) const
+	template <class data>
+	bool operator()(const data &i1, const data &i2) const
 	{
 		if (fequal(i1.g+i1.h, i2.g+i2.h))
 		{
@@ -65,8 +66,17 @@ struct AStarCompare {
 
 /**
  * A templated version of A*, based on HOG genericAStar
+ *
+ * The open/closed list is a template parameter. Any class with the
+ * AStarOpenClosed interface can be used, for instance one with a
+ * different index table:
+ * AStarOpenClosed<state, AStarCompare<state>, AStarOpenClosedData<state>, FlatIndexTable>
+ * or with the smaller node record:
+ * AStarOpenClosed<state, AStarCompare<state>, AStarOpenClosedCompactData<state> >
+ * or the bucket-based list for integer-cost domains:
+ * BucketOpenClosed<state, AStarCompare<state> >
  */
-template <class state, class action, class environment>
+template <class state, class action, class environment, class openList = AStarOpenClosed<state, AStarCompare<state> > >
 class TemplateAStar : public GenericSearchAlgorithm<state,action,environment> {
 public:
 	TemplateAStar() { ResetNodeCount(); env = 0; useBPMX = 0; radius = 4.0; stopAfterGoal = true; weight=1; useRadius=false; useOccupancyInfo=false; radEnv = 0; reopenNodes = false; theHeuristic = 0; }
@@ -75,8 +85,7 @@ public:
 	
 	void GetPath(environment *, const state& , const state& , std::vector<action> & ) { assert(false); };
 	
-	AStarOpenClosed<state, AStarCompare<state> > openClosedList;
-	//BucketOpenClosed<state, AStarCompare<state> > openClosedList;
+	openList openClosedList;
 	state goal, start;
 	
 	bool InitializeSearch(environment *env, const state& from, const state& to, std::vector<state> &thePath);
@@ -95,12 +104,16 @@ public:
 	uint64_t GetUniqueNodesExpanded() { return uniqueNodesExpanded; }
 	void ResetNodeCount() { nodesExpanded = nodesTouched = 0; uniqueNodesExpanded = 0; }
 	int GetMemoryUsage();
+	/** Bytes allocated by the open/closed list; GetMemoryUsage() counts nodes, as in the other searches */
+	size_t GetMemoryBytes() const;
+	/** Pre-size the open/closed list so that a search of this size doesn't reallocate */
+	void SetExpectedNodeCount(size_t count) { openClosedList.Reserve(count); }
 	
 	bool GetClosedListGCost(const state &val, double &gCost) const;
 	unsigned int GetNumOpenItems() { return openClosedList.OpenSize(); }
-	inline const AStarOpenClosedData<state> &GetOpenItem(unsigned int which) { return openClosedList.Lookat(openClosedList.GetOpenItem(which)); }
+	inline const typename openList::dataType &GetOpenItem(unsigned int which) { return openClosedList.Lookat(openClosedList.GetOpenItem(which)); }
 	inline const int GetNumItems() { return openClosedList.size(); }
-	inline const AStarOpenClosedData<state> &GetItem(unsigned int which) { return openClosedList.Lookat(which); }
+	inline const typename openList::dataType &GetItem(unsigned int which) { return openClosedList.Lookat(which); }
 	bool HaveExpandedState(const state &val)
 	{ uint64_t key; return openClosedList.Lookup(env->GetStateHash(val), key) != kNotFound; }
 	
@@ -138,7 +151,20 @@ private:
 //	void UpdateWeight(environment *env, state& currOpenNode, state& neighbor);
 //	void AddToOpenList(environment *env, state& currOpenNode, state& neighbor);
 	
-	std::vector<state> neighbors;
+	// called with each child as it is generated; see ForEachSuccessor()
+	struct ChildLoader {
+		ChildLoader(TemplateAStar *s, uint64_t n) :search(s), nodeid(n), bestH(0) {}
+		void operator()(const state &child) { search->LoadChild(nodeid, child, bestH); }
+		TemplateAStar *search;
+		uint64_t nodeid;
+		double bestH;
+	};
+	void LoadChild(uint64_t nodeid, const state &child, double &bestH);
+
+	std::vector<state> neighbors, successorScratch;
+	// children not yet seen, and their h-costs, evaluated together
+	std::vector<state> newNeighbors;
+	std::vector<double> newNeighborH;
 	std::vector<uint64_t> neighborID;
 	std::vector<double> edgeCosts;
 	std::vector<dataLocation> neighborLoc;
@@ -167,8 +193,8 @@ private:
  * @return The name of the algorithm
  */
 
-template <class state, class action, class environment>
-const char *TemplateAStar<state,action,environment>::GetName()
+template <class state, class action, class environment, class openList>
+const char *TemplateAStar<state, action, environment, openList>::GetName()
 {
 	static char name[32];
 	sprintf(name, "TemplateAStar[]");
@@ -186,8 +212,8 @@ const char *TemplateAStar<state,action,environment>::GetName()
  * @param thePath A vector of states which will contain an optimal path 
  * between from and to when the function returns, if one exists. 
  */
-template <class state, class action, class environment>
-void TemplateAStar<state,action,environment>::GetPath(environment *_env, const state& from, const state& to, std::vector<state> &thePath)
+template <class state, class action, class environment, class openList>
+void TemplateAStar<state, action, environment, openList>::GetPath(environment *_env, const state& from, const state& to, std::vector<state> &thePath)
 {
 	//discardcount=0;
   	if (!InitializeSearch(_env, from, to, thePath))
@@ -211,8 +237,8 @@ void TemplateAStar<state,action,environment>::GetPath(environment *_env, const s
  * @param to The goal state
  * @return TRUE if initialization was successful, FALSE otherwise
  */
-template <class state, class action, class environment>
-bool TemplateAStar<state,action,environment>::InitializeSearch(environment *_env, const state& from, const state& to, std::vector<state> &thePath)
+template <class state, class action, class environment, class openList>
+bool TemplateAStar<state, action, environment, openList>::InitializeSearch(environment *_env, const state& from, const state& to, std::vector<state> &thePath)
 {
 	lastF = 0;
 	
@@ -248,8 +274,8 @@ bool TemplateAStar<state,action,environment>::InitializeSearch(environment *_env
  * @author Nathan Sturtevant
  * @date 01/06/08
  */
-template <class state, class action, class environment>
-void TemplateAStar<state,action,environment>::AddAdditionalStartState(state& newState)
+template <class state, class action, class environment, class openList>
+void TemplateAStar<state, action, environment, openList>::AddAdditionalStartState(state& newState)
 {
 	openClosedList.AddOpenNode(newState, env->GetStateHash(newState), 0, weight*theHeuristic->HCost(start, goal));
 }
@@ -259,8 +285,8 @@ void TemplateAStar<state,action,environment>::AddAdditionalStartState(state& new
  * @author Nathan Sturtevant
  * @date 09/25/10
  */
-template <class state, class action, class environment>
-void TemplateAStar<state,action,environment>::AddAdditionalStartState(state& newState, double cost)
+template <class state, class action, class environment, class openList>
+void TemplateAStar<state, action, environment, openList>::AddAdditionalStartState(state& newState, double cost)
 {
 	openClosedList.AddOpenNode(newState, env->GetStateHash(newState), cost, weight*theHeuristic->HCost(start, goal));
 }
@@ -275,8 +301,8 @@ void TemplateAStar<state,action,environment>::AddAdditionalStartState(state& new
  * @return TRUE if there is no path or if we have found the goal, FALSE
  * otherwise
  */
-template <class state, class action, class environment>
-bool TemplateAStar<state,action,environment>::DoSingleSearchStep(std::vector<state> &thePath)
+template <class state, class action, class environment, class openList>
+bool TemplateAStar<state, action, environment, openList>::DoSingleSearchStep(std::vector<state> &thePath)
 {
 	if (openClosedList.OpenSize() == 0)
 	{
@@ -309,26 +335,32 @@ bool TemplateAStar<state,action,environment>::DoSingleSearchStep(std::vector<sta
 //	std::cout << "Expanding: " << openClosedList.Lookup(nodeid).data << " with f:";
 //	std::cout << openClosedList.Lookup(nodeid).g+openClosedList.Lookup(nodeid).h << std::endl;
 	
- 	env->GetSuccessors(openClosedList.Lookup(nodeid).data, neighbors);
-	double bestH = 0;
 	// 1. load all the children
-	for (unsigned int x = 0; x < neighbors.size(); x++)
+	ChildLoader loader(this, nodeid);
+	ForEachSuccessor(env, openClosedList.Lookup(nodeid).data, successorScratch, loader);
+	double bestH = loader.bestH;
+	
+	if (useBPMX) // propagate best child to parent
 	{
-		uint64_t theID;
-		neighborLoc.push_back(openClosedList.Lookup(env->GetStateHash(neighbors[x]), theID));
-		neighborID.push_back(theID);
-		edgeCosts.push_back(env->GCost(openClosedList.Lookup(nodeid).data, neighbors[x]));
-		if (useBPMX && (neighborLoc.back() != kNotFound))
-		{
-			// get best child h-cost
-			bestH = std::max(bestH, openClosedList.Lookup(theID).h-edgeCosts.back());
-		}
+		openClosedList.Lookup(nodeid).h = std::max((double)openClosedList.Lookup(nodeid).h, bestH); 
 	}
 	
-	if (useBPMX) // propagate best child to parent
+	// 2. get the h-costs of the new children in one batch
+	unsigned int numNew = 0;
+	for (unsigned int x = 0; x < neighbors.size(); x++)
 	{
-		openClosedList.Lookup(nodeid).h = std::max(openClosedList.Lookup(nodeid).h, bestH); 
+		if (neighborLoc[x] != kNotFound)
+			continue;
+		if (numNew < newNeighbors.size())
+			newNeighbors[numNew] = neighbors[x];
+		else
+			newNeighbors.push_back(neighbors[x]);
+		numNew++;
 	}
+	newNeighborH.resize(numNew);
+	if (numNew > 0)
+		theHeuristic->BatchHCost(&newNeighbors[0], numNew, goal, &newNeighborH[0]);
+	numNew = 0;
 	
 	// iterate again updating costs and writing out to memory
 	for (int x = 0; x < neighbors.size(); x++)
@@ -385,12 +417,14 @@ bool TemplateAStar<state,action,environment>::DoSingleSearchStep(std::vector<sta
 				{
 					if (fgreater(bestH-edgeCosts[x], openClosedList.Lookup(neighborID[x]).h))
 					{
-						openClosedList.Lookup(neighborID[x]).h = std::max(openClosedList.Lookup(neighborID[x]).h, bestH-edgeCosts[x]); 
+						openClosedList.Lookup(neighborID[x]).h = std::max((double)openClosedList.Lookup(neighborID[x]).h, bestH-edgeCosts[x]); 
 						openClosedList.KeyChanged(neighborID[x]);
 					}
 				}
 				break;
 			case kNotFound:
+			{
+				double h = newNeighborH[numNew++];
 				// node is occupied; just mark it closed
 				if (useRadius && useOccupancyInfo && env->GetOccupancyInfo() && radEnv && (radEnv->HCost(start, neighbors[x]) < radius) &&(env->GetOccupancyInfo()->GetStateOccupied(neighbors[x])) && ((!(radEnv->GoalTest(neighbors[x], goal)))))
 				{
@@ -398,7 +432,7 @@ bool TemplateAStar<state,action,environment>::DoSingleSearchStep(std::vector<sta
 					openClosedList.AddClosedNode(neighbors[x],
 												 env->GetStateHash(neighbors[x]),
 												 openClosedList.Lookup(nodeid).g+edgeCosts[x],
-												 std::max(theHeuristic->HCost(neighbors[x], goal), openClosedList.Lookup(nodeid).h-edgeCosts[x]),
+												 std::max(h, openClosedList.Lookup(nodeid).h-edgeCosts[x]),
 												 nodeid);
 				}
 				else { // add node to open list
@@ -411,14 +445,14 @@ bool TemplateAStar<state,action,environment>::DoSingleSearchStep(std::vector<sta
 						openClosedList.AddOpenNode(neighbors[x],
 												   env->GetStateHash(neighbors[x]),
 												   openClosedList.Lookup(nodeid).g+edgeCosts[x],
-												   std::max(weight*theHeuristic->HCost(neighbors[x], goal), openClosedList.Lookup(nodeid).h-edgeCosts[x]),
+												   std::max(weight*h, openClosedList.Lookup(nodeid).h-edgeCosts[x]),
 												   nodeid);
 					}
 					else {
 						openClosedList.AddOpenNode(neighbors[x],
 												   env->GetStateHash(neighbors[x]),
 												   openClosedList.Lookup(nodeid).g+edgeCosts[x],
-												   weight*theHeuristic->HCost(neighbors[x], goal),
+												   weight*h,
 												   nodeid);
 					}
 //					if (loc == -1)
@@ -427,12 +461,33 @@ bool TemplateAStar<state,action,environment>::DoSingleSearchStep(std::vector<sta
 //						x--;
 //					}
 				}
+			}
 		}
 	}
 		
 	return false;
 }
 
+/**
+ * Record a newly generated child of nodeid: where it is on the open/closed
+ * list, its id and the edge cost. With BPMX, also track the best h-cost
+ * that the children imply for the parent.
+ */
+template <class state, class action, class environment, class openList>
+void TemplateAStar<state, action, environment, openList>::LoadChild(uint64_t nodeid, const state &child, double &bestH)
+{
+	uint64_t theID;
+	neighbors.push_back(child);
+	neighborLoc.push_back(openClosedList.Lookup(env->GetStateHash(child), theID));
+	neighborID.push_back(theID);
+	edgeCosts.push_back(env->GCost(openClosedList.Lookup(nodeid).data, child));
+	if (useBPMX && (neighborLoc.back() != kNotFound))
+	{
+		// get best child h-cost
+		bestH = std::max(bestH, openClosedList.Lookup(theID).h-edgeCosts.back());
+	}
+}
+
 /**
  * Returns the next state on the open list (but doesn't pop it off the queue). 
  * @author Nathan Sturtevant
@@ -440,8 +495,8 @@ bool TemplateAStar<state,action,environment>::DoSingleSearchStep(std::vector<sta
  * 
  * @return The first state in the open list. 
  */
-template <class state, class action, class environment>
-state TemplateAStar<state, action,environment>::CheckNextNode()
+template <class state, class action, class environment, class openList>
+state TemplateAStar<state, action, environment, openList>::CheckNextNode()
 {
 	uint64_t key = openClosedList.Peek();
 	return openClosedList.Lookup(key).data;
@@ -456,8 +511,8 @@ state TemplateAStar<state, action,environment>::CheckNextNode()
  * 
  * @return The first state in the open list. 
  */
-template <class state, class action, class environment>
-void TemplateAStar<state, action,environment>::FullBPMX(uint64_t nodeID, int distance)
+template <class state, class action, class environment, class openList>
+void TemplateAStar<state, action, environment, openList>::FullBPMX(uint64_t nodeID, int distance)
 {
 	if (distance <= 0)
 		return;
@@ -507,8 +562,8 @@ void TemplateAStar<state, action,environment>::FullBPMX(uint64_t nodeID, int dis
  * @param goalNode the goal state
  * @param thePath will contain the path from goalNode to the start state
  */
-template <class state, class action,class environment>
-void TemplateAStar<state, action,environment>::ExtractPathToStartFromID(uint64_t node,
+template <class state, class action, class environment, class openList>
+void TemplateAStar<state, action, environment, openList>::ExtractPathToStartFromID(uint64_t node,
 																	 std::vector<state> &thePath)
 {
 	do {
@@ -524,8 +579,8 @@ void TemplateAStar<state, action,environment>::ExtractPathToStartFromID(uint64_t
  * @author Nathan Sturtevant
  * @date 03/22/06
  */
-template <class state, class action, class environment>
-void TemplateAStar<state, action,environment>::PrintStats()
+template <class state, class action, class environment, class openList>
+void TemplateAStar<state, action, environment, openList>::PrintStats()
 {
 	printf("%u items in closed list\n", (unsigned int)openClosedList.ClosedSize());
 	printf("%u items in open queue\n", (unsigned int)openClosedList.OpenSize());
@@ -538,12 +593,23 @@ void TemplateAStar<state, action,environment>::PrintStats()
  * 
  * @return The combined number of elements in the closed list and open queue
  */
-template <class state, class action, class environment>
-int TemplateAStar<state, action,environment>::GetMemoryUsage()
+template <class state, class action, class environment, class openList>
+int TemplateAStar<state, action, environment, openList>::GetMemoryUsage()
 {
 	return openClosedList.size();
 }
 
+/**
+ * The bytes allocated by the open/closed list, including node records, the
+ * open queue and the hash index. Divide by GetNumItems() for the cost per
+ * node.
+ */
+template <class state, class action, class environment, class openList>
+size_t TemplateAStar<state, action, environment, openList>::GetMemoryBytes() const
+{
+	return openClosedList.MemoryUsage();
+}
+
 /**
  * Get state from the closed list
  * @author Nathan Sturtevant
@@ -554,8 +620,8 @@ int TemplateAStar<state, action,environment>::GetMemoryUsage()
  * @return success Whether we found the value or not
  * more states
  */
-template <class state, class action, class environment>
-bool TemplateAStar<state, action,environment>::GetClosedListGCost(const state &val, double &gCost) const
+template <class state, class action, class environment, class openList>
+bool TemplateAStar<state, action, environment, openList>::GetClosedListGCost(const state &val, double &gCost) const
 {
 	uint64_t theID;
 	dataLocation loc = openClosedList.Lookup(env->GetStateHash(val), theID);
@@ -573,8 +639,8 @@ bool TemplateAStar<state, action,environment>::GetClosedListGCost(const state &v
  * @date 03/12/09
  * 
  */
-template <class state, class action, class environment>
-void TemplateAStar<state, action,environment>::OpenGLDraw() const
+template <class state, class action, class environment, class openList>
+void TemplateAStar<state, action, environment, openList>::OpenGLDraw() const
 {
 	double transparency = 1.0;
 	if (openClosedList.size() == 0)
@@ -596,7 +662,7 @@ void TemplateAStar<state, action,environment>::OpenGLDraw() const
 //	}
 	for (unsigned int x = 0; x < openClosedList.size(); x++)
 	{
-		const AStarOpenClosedData<state> &data = openClosedList.Lookat(x);
+		const typename openList::dataType &data = openClosedList.Lookat(x);
 		if (x == top)
 		{
 			env->SetColor(1.0, 1.0, 0.0, transparency);
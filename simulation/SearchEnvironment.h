@@ -12,6 +12,7 @@
 
 #include <stdint.h>
 #include <vector>
+#include <type_traits>
 //#include "ReservationProvider.h"
 #include <assert.h>
 #include "OccupancyInterface.h"
@@ -28,6 +29,16 @@ class Heuristic {
 public:
 	virtual ~Heuristic() {}
 	virtual double HCost(const state &a, const state &b) = 0;
+	/**
+	 * Sets hcosts[x] to HCost(states[x], goal) for count states, such as the
+	 * children of a node. Heuristics that look values up in large tables can
+	 * override this to start all the memory accesses before using any of them.
+	 */
+	virtual void BatchHCost(const state *states, int count, const state &goal, double *hcosts)
+	{
+		for (int x = 0; x < count; x++)
+			hcosts[x] = HCost(states[x], goal);
+	}
 };
 
 template <class state, class action>
@@ -150,4 +161,63 @@ void SearchEnvironment<state,action>::GLDrawPath(const std::vector<state> &path)
 	}
 }
 
+/**
+ * Successor enumeration without a vector. An environment can provide
+ *
+ *   template <class visitor> void ForEachSuccessor(const state &s, visitor &v) const
+ *
+ * which calls v(child) for each successor, in the same order as
+ * GetSuccessors(). Searches that are templated on the environment reach it
+ * through ForEachSuccessor() below. Because a subclass may override
+ * GetSuccessors() but would inherit the visitor, the visitor is only used
+ * for the exact types that specialize UsesSuccessorVisitor to true.
+ */
+template <class environment>
+struct UsesSuccessorVisitor {
+	static const bool value = false;
+};
+
+template <class environment, class state, class visitor>
+inline void ForEachSuccessor(environment *env, const state &s, std::vector<state> &, visitor &v, std::true_type)
+{
+	env->ForEachSuccessor(s, v);
+}
+
+template <class environment, class state, class visitor>
+inline void ForEachSuccessor(environment *env, const state &s, std::vector<state> &scratch, visitor &v, std::false_type)
+{
+	env->GetSuccessors(s, scratch);
+	for (unsigned int x = 0; x < scratch.size(); x++)
+		v(scratch[x]);
+}
+
+/**
+ * Calls v(child) for every successor of s: directly if the environment has
+ * a successor visitor, otherwise through GetSuccessors() into scratch.
+ */
+template <class environment, class state, class visitor>
+inline void ForEachSuccessor(environment *env, const state &s, std::vector<state> &scratch, visitor &v)
+{
+	ForEachSuccessor(env, s, scratch, v, std::integral_constant<bool, UsesSuccessorVisitor<environment>::value>());
+}
+
+/** Visitor that appends successors to a vector, for implementing GetSuccessors() with ForEachSuccessor() */
+template <class state>
+class SuccessorAppender {
+public:
+	SuccessorAppender(std::vector<state> &n) :neighbors(n) {}
+	void operator()(const state &s) { neighbors.push_back(s); }
+private:
+	std::vector<state> &neighbors;
+};
+
+/** Visitor that only counts successors */
+class SuccessorCounter {
+public:
+	SuccessorCounter() :count(0) {}
+	template <class state>
+	void operator()(const state &) { count++; }
+	int count;
+};
+
 #endif
@@ -0,0 +1,45 @@
+//
+//  Barrier.h
+//  hog2
+//
+//  A reusable barrier for a fixed group of threads.
+//
+
+#ifndef BARRIER_H
+#define BARRIER_H
+
+#include <mutex>
+#include <condition_variable>
+#include <assert.h>
+
+/**
+ * Threads calling Wait() block until count threads have called it; the
+ * barrier can then be used again by the same threads. Waiting threads
+ * sleep rather than spin.
+ */
+class Barrier {
+public:
+	Barrier(int count)
+	:count(count), waiting(0), generation(0) { assert(count > 0); }
+	void Wait()
+	{
+		std::unique_lock<std::mutex> l(lock);
+		unsigned int myGeneration = generation;
+		if (++waiting == count)
+		{
+			waiting = 0;
+			generation++;
+			done.notify_all();
+			return;
+		}
+		while (myGeneration == generation)
+			done.wait(l);
+	}
+private:
+	std::mutex lock;
+	std::condition_variable done;
+	int count, waiting;
+	unsigned int generation;
+};
+
+#endif
@@ -26,7 +26,11 @@
 #include "MMapUtil.h"
 
 /**
- * An efficient bit-wise vector implementation.
+ * An efficient bit-wise vector implementation. The Atomic methods may be
+ * called by many threads at once, including on bits in the same byte; the
+ * other methods must not be called while any thread is changing the vector.
+ * The atomic operations are relaxed, so threads must synchronize (e.g. at
+ * a barrier) before relying on each other's changes.
  */
 
 //typedef uint32_t storageElement;
@@ -50,6 +54,10 @@ public:
 	bool Get(uint64_t index) const;
 	void Set(uint64_t index, bool value);
 	void SetTrue(uint64_t index);
+	bool AtomicGet(uint64_t index) const;
+	void AtomicSet(uint64_t index, bool value);
+	/** Sets the bit, returning true if this call changed it */
+	bool AtomicSetTrue(uint64_t index);
 	void Save(const char *);
 	void Load(const char *);
 	bool Equals(BitVector *);
@@ -71,4 +79,24 @@ inline void BitVector::SetTrue(uint64_t index)
 	storage[index>>storageBitsPower] = storage[index>>storageBitsPower]|(1<<(index&storageMask));
 }
 
+inline bool BitVector::AtomicGet(uint64_t index) const
+{
+	return (__atomic_load_n(&storage[index>>storageBitsPower], __ATOMIC_RELAXED)>>(index&storageMask))&0x1;
+}
+
+inline void BitVector::AtomicSet(uint64_t index, bool value)
+{
+	storageElement bit = (storageElement)(1<<(index&storageMask));
+	if (value)
+		__atomic_fetch_or(&storage[index>>storageBitsPower], bit, __ATOMIC_RELAXED);
+	else
+		__atomic_fetch_and(&storage[index>>storageBitsPower], (storageElement)~bit, __ATOMIC_RELAXED);
+}
+
+inline bool BitVector::AtomicSetTrue(uint64_t index)
+{
+	storageElement bit = (storageElement)(1<<(index&storageMask));
+	return (__atomic_fetch_or(&storage[index>>storageBitsPower], bit, __ATOMIC_RELAXED)&bit) == 0;
+}
+
 #endif
@@ -0,0 +1,218 @@
+//
+//  BlockedBloom.cpp
+//  hog2
+//
+//  Bloom filters that keep every probe for an item in one cache line.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <algorithm>
+#include "BlockedBloom.h"
+
+/** Smallest power of two number of blocks with at least the given number of bytes */
+static uint64_t GetNumBlocks(uint64_t bytes)
+{
+	uint64_t blocks = 1;
+	while (blocks*kBloomBlockBytes < bytes)
+		blocks *= 2;
+	return blocks;
+}
+
+static void *AllocateBlocks(uint64_t numBlocks)
+{
+	void *mem = 0;
+	if (posix_memalign(&mem, kBloomBlockBytes, numBlocks*kBloomBlockBytes) != 0)
+	{
+		printf("Unable to allocate %llu bytes for Bloom filter; aborting\n", (unsigned long long)(numBlocks*kBloomBlockBytes));
+		exit(0);
+	}
+	return mem;
+}
+
+static bool SaveBlocks(const char *fname, const void *blocks, uint64_t numBlocks)
+{
+	FILE *f = fopen(fname, "w");
+	if (f == 0)
+		return false;
+	bool result = (fwrite(blocks, kBloomBlockBytes, numBlocks, f) == numBlocks);
+	if (fclose(f) != 0)
+		result = false;
+	return result;
+}
+
+static bool LoadBlocks(const char *fname, void *blocks, uint64_t numBlocks)
+{
+	FILE *f = fopen(fname, "r");
+	if (f == 0)
+		return false;
+	bool result = (fread(blocks, kBloomBlockBytes, numBlocks, f) == numBlocks);
+	fclose(f);
+	return result;
+}
+
+BlockedBloomFilter::BlockedBloomFilter(uint64_t filterSize, int numHash)
+:numHash(numHash)
+{
+	assert(numHash >= 1 && numHash <= kBloomMaxHash);
+	numBlocks = GetNumBlocks((filterSize+7)/8);
+	blocks = (uint64_t*)AllocateBlocks(numBlocks);
+	memset(blocks, 0, numBlocks*kBloomBlockBytes);
+}
+
+BlockedBloomFilter::~BlockedBloomFilter()
+{
+	free(blocks);
+	blocks = 0;
+}
+
+void BlockedBloomFilter::Analyze()
+{
+	uint64_t entries = GetStorage();
+	uint64_t setEntries = 0;
+	for (uint64_t x = 0; x < numBlocks*kBloomBlockBytes/8; x++)
+		setEntries += __builtin_popcountll(blocks[x]);
+	printf("%llu of %llu entries set. (%4.2f%%)\n", (unsigned long long)setEntries, (unsigned long long)entries, 100*double(setEntries)/double(entries));
+}
+
+void BlockedBloomFilter::Insert(uint64_t item)
+{
+	uint64_t mixed = BloomProbes::Mix(item);
+	uint32_t probes[kBloomMaxHash];
+	BloomProbes::GetProbes(mixed, 9, probes);
+	uint64_t *block = blocks+(mixed&(numBlocks-1))*(kBloomBlockBytes/8);
+	for (int x = 0; x < numHash; x++)
+		block[probes[x]>>6] |= 1ull<<(probes[x]&63);
+}
+
+bool BlockedBloomFilter::Test(const uint64_t *block, uint64_t mixed) const
+{
+	uint32_t probes[kBloomMaxHash];
+	BloomProbes::GetProbes(mixed, 9, probes);
+	bool result = true;
+	for (int x = 0; x < numHash; x++)
+		result &= (block[probes[x]>>6]>>(probes[x]&63))&1;
+	return result;
+}
+
+bool BlockedBloomFilter::Contains(uint64_t item) const
+{
+	uint64_t mixed = BloomProbes::Mix(item);
+	return Test(GetBlock(mixed), mixed);
+}
+
+void BlockedBloomFilter::Contains(const uint64_t *items, int count, bool *results) const
+{
+	uint64_t mixed[kBloomBatchSize];
+	for (int start = 0; start < count; start += kBloomBatchSize)
+	{
+		int batch = std::min(count-start, kBloomBatchSize);
+		for (int x = 0; x < batch; x++)
+		{
+			mixed[x] = BloomProbes::Mix(items[start+x]);
+			__builtin_prefetch(GetBlock(mixed[x]));
+		}
+		for (int x = 0; x < batch; x++)
+			results[start+x] = Test(GetBlock(mixed[x]), mixed[x]);
+	}
+}
+
+bool BlockedBloomFilter::Save(const char *fname) const
+{
+	return SaveBlocks(fname, blocks, numBlocks);
+}
+
+bool BlockedBloomFilter::Load(const char *fname)
+{
+	return LoadBlocks(fname, blocks, numBlocks);
+}
+
+BlockedMinBloomFilter::BlockedMinBloomFilter(uint64_t filterSize, int numHash)
+:numHash(numHash)
+{
+	assert(numHash >= 1 && numHash <= kBloomMaxHash);
+	numBlocks = GetNumBlocks((filterSize+1)/2);
+	blocks = (uint8_t*)AllocateBlocks(numBlocks);
+	memset(blocks, 0xFF, numBlocks*kBloomBlockBytes);
+}
+
+BlockedMinBloomFilter::~BlockedMinBloomFilter()
+{
+	free(blocks);
+	blocks = 0;
+}
+
+void BlockedMinBloomFilter::Analyze()
+{
+	uint64_t entries = GetStorage();
+	uint64_t setEntries = 0;
+	for (uint64_t x = 0; x < numBlocks*kBloomBlockBytes; x++)
+	{
+		if ((blocks[x]&0xF) != 0xF)
+			setEntries++;
+		if ((blocks[x]>>4) != 0xF)
+			setEntries++;
+	}
+	printf("%llu of %llu entries set. (%1.2f%%)\n", (unsigned long long)setEntries, (unsigned long long)entries, 100.0*double(setEntries)/double(entries));
+}
+
+void BlockedMinBloomFilter::Insert(uint64_t item, int depth)
+{
+	assert(depth >= 0 && depth < 0xF);
+	uint64_t mixed = BloomProbes::Mix(item);
+	uint32_t probes[kBloomMaxHash];
+	BloomProbes::GetProbes(mixed, 7, probes);
+	uint8_t *block = blocks+(mixed&(numBlocks-1))*kBloomBlockBytes;
+	for (int x = 0; x < numHash; x++)
+	{
+		uint8_t &entry = block[probes[x]>>1];
+		int shift = (probes[x]&1)*4;
+		int val = (entry>>shift)&0xF;
+		if (depth < val)
+			entry = (entry&~(0xF<<shift))|(depth<<shift);
+	}
+}
+
+int BlockedMinBloomFilter::Test(const uint8_t *block, uint64_t mixed) const
+{
+	uint32_t probes[kBloomMaxHash];
+	BloomProbes::GetProbes(mixed, 7, probes);
+	int max = 0;
+	for (int x = 0; x < numHash; x++)
+		max = std::max(max, (block[probes[x]>>1]>>((probes[x]&1)*4))&0xF);
+	return max;
+}
+
+int BlockedMinBloomFilter::Contains(uint64_t item) const
+{
+	uint64_t mixed = BloomProbes::Mix(item);
+	return Test(GetBlock(mixed), mixed);
+}
+
+void BlockedMinBloomFilter::Contains(const uint64_t *items, int count, int *depths) const
+{
+	uint64_t mixed[kBloomBatchSize];
+	for (int start = 0; start < count; start += kBloomBatchSize)
+	{
+		int batch = std::min(count-start, kBloomBatchSize);
+		for (int x = 0; x < batch; x++)
+		{
+			mixed[x] = BloomProbes::Mix(items[start+x]);
+			__builtin_prefetch(GetBlock(mixed[x]));
+		}
+		for (int x = 0; x < batch; x++)
+			depths[start+x] = Test(GetBlock(mixed[x]), mixed[x]);
+	}
+}
+
+bool BlockedMinBloomFilter::Save(const char *fname) const
+{
+	return SaveBlocks(fname, blocks, numBlocks);
+}
+
+bool BlockedMinBloomFilter::Load(const char *fname)
+{
+	return LoadBlocks(fname, blocks, numBlocks);
+}
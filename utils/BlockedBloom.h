@@ -0,0 +1,110 @@
+//
+//  BlockedBloom.h
+//  hog2
+//
+//  Bloom filters that keep every probe for an item in one cache line.
+//
+
+#ifndef BLOCKEDBLOOM_H
+#define BLOCKEDBLOOM_H
+
+#include <stdint.h>
+
+/** Each item's probes fall in one block, which is one cache line */
+const int kBloomBlockBytes = 64;
+/** Largest number of probes per item */
+const int kBloomMaxHash = 8;
+/** Items whose blocks are prefetched together by the batch lookups */
+const int kBloomBatchSize = 16;
+
+/**
+ * Computes the block and the probes within the block for an item. The item
+ * is mixed once; the low bits choose the block, and each probe multiplies
+ * the high 32 bits by its own odd constant and keeps the top bits, as in
+ * split block Bloom filters. The probes are computed for all
+ * kBloomMaxHash lanes at once with no branches, so that the loop is
+ * vectorized.
+ */
+class BloomProbes {
+public:
+	static uint64_t Mix(uint64_t item)
+	{
+		item ^= item>>33;
+		item *= 0xFF51AFD7ED558CCDull;
+		item ^= item>>33;
+		item *= 0xC4CEB9FE1A85EC53ull;
+		item ^= item>>33;
+		return item;
+	}
+	/** Sets the probes, each of probeBits bits, for a mixed item */
+	static void GetProbes(uint64_t mixed, int probeBits, uint32_t *probes)
+	{
+		static const uint32_t salt[kBloomMaxHash] = {0x47B6137Bu, 0x44974D91u, 0x8824AD5Bu, 0xA2B7289Du,
+			0x705495C7u, 0x2DF1424Bu, 0x9EFC4947u, 0x5C6BFB31u};
+		uint32_t seed = (uint32_t)(mixed>>32);
+		for (int x = 0; x < kBloomMaxHash; x++)
+			probes[x] = (seed*salt[x])>>(32-probeBits);
+	}
+};
+
+/**
+ * A Bloom filter made of 512-bit blocks. All of an item's probes are in
+ * the block chosen by its hash, so a lookup touches one cache line, where
+ * BloomFilter touches one per hash. The number of blocks is a power of
+ * two, so the block is found with a mask rather than a modulo. For the
+ * same number of bits the false positive rate is a little higher than
+ * BloomFilter's.
+ */
+class BlockedBloomFilter {
+public:
+	/** Uses at least filterSize bits and numHash probes per item, from 1 to kBloomMaxHash */
+	BlockedBloomFilter(uint64_t filterSize, int numHash);
+	~BlockedBloomFilter();
+	void Analyze();
+	void Insert(uint64_t item);
+	bool Contains(uint64_t item) const;
+	/** Contains() for count items; each group of blocks is prefetched before any is read */
+	void Contains(const uint64_t *items, int count, bool *results) const;
+	uint64_t GetStorage() const { return numBlocks*kBloomBlockBytes*8; }
+	int GetNumHash() const { return numHash; }
+	bool Save(const char *fname) const;
+	bool Load(const char *fname);
+private:
+	const uint64_t *GetBlock(uint64_t mixed) const
+	{ return blocks+(mixed&(numBlocks-1))*(kBloomBlockBytes/8); }
+	bool Test(const uint64_t *block, uint64_t mixed) const;
+	int numHash;
+	uint64_t numBlocks;
+	uint64_t *blocks;
+};
+
+/**
+ * A MinBloomFilter made of 64-byte blocks of 128 4-bit entries. As with
+ * MinBloomFilter, each entry holds the smallest depth inserted at it, 15
+ * if none, and an item's depth is the largest of its entries; all of an
+ * item's entries are in one block.
+ */
+class BlockedMinBloomFilter {
+public:
+	/** Uses at least filterSize entries and numHash probes per item, from 1 to kBloomMaxHash */
+	BlockedMinBloomFilter(uint64_t filterSize, int numHash);
+	~BlockedMinBloomFilter();
+	void Analyze();
+	void Insert(uint64_t item, int depth);
+	int Contains(uint64_t item) const;
+	/** Contains() for count items; each group of blocks is prefetched before any is read */
+	void Contains(const uint64_t *items, int count, int *depths) const;
+	uint64_t GetStorage() const { return numBlocks*kBloomBlockBytes*2; }
+	int GetNumHash() const { return numHash; }
+	bool Save(const char *fname) const;
+	bool Load(const char *fname);
+private:
+	const uint8_t *GetBlock(uint64_t mixed) const
+	{ return blocks+(mixed&(numBlocks-1))*kBloomBlockBytes; }
+	int Test(const uint8_t *block, uint64_t mixed) const;
+	int numHash;
+	uint64_t numBlocks;
+	uint8_t *blocks;
+};
+
+#endif
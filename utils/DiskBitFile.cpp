@@ -7,8 +7,11 @@
 //
 
 #include "DiskBitFile.h"
+#include <unistd.h>
+#include "Timer.h"
 
-DiskBitFile::DiskBitFile(const char *pre)
+DiskBitFile::DiskBitFile(const char *pre, bool async)
+:async(async)
 {
 //	subBucketBits = subSize;
 	strncpy(prefix, pre, 62);
@@ -23,6 +26,10 @@ DiskBitFile::DiskBitFile(const char *pre)
 	
 	bytesRead = 0;
 	bytesWritten = 0;
+	readAheadHits = 0;
+	readAheadMisses = 0;
+	ioWaitTime = 0;
+	ioTime = 0;
 
 
 	fileOpen = false;
@@ -30,19 +37,50 @@ DiskBitFile::DiskBitFile(const char *pre)
 	fileOffset = 0;
 	currBucket = -1;
 	currSubBucket = -1;
+
+	cacheBuffer = 0;
+	readAhead = 0;
+	chunkAhead = 0;
+	ioStop = false;
+	if (async)
+	{
+		cache = 0;
+		ioBuffers.resize(numAsyncBuffers);
+		ioThread = std::thread(&DiskBitFile::IOThread, this);
+	}
+	else {
+		syncCache.resize(cacheSize);
+		cache = &syncCache[0];
+	}
 }
 
 DiskBitFile::~DiskBitFile()
 {
 	CloseReadFile();
 	CloseReadWriteFile();
+	if (async)
+	{
+		// the thread finishes the queued requests before stopping
+		{
+			std::lock_guard<std::mutex> l(ioLock);
+			ioStop = true;
+		}
+		ioQueued.notify_all();
+		ioThread.join();
+	}
 }
 
 void DiskBitFile::CloseReadWriteFile()
 {
 	if (outputFile != 0)
 	{
-		fclose(outputFile);
+		FlushCache();
+		if (async)
+		{
+			ReleaseCache();
+			DiscardBuffer(readAhead);
+		}
+		CloseFile(outputFile);
 		//printf("Closing file\n");fflush(stdout);
 		outputFile = 0;
 	}
@@ -142,16 +180,7 @@ int DiskBitFile::ReadFileDepth(int bucket, int64_t offset)
 	if ((cacheOffset == -1) || // just read into memory
 		(offset-cacheOffset < 0)  || (offset-cacheOffset >= theCacheSize))
 	{
-		FlushCache();
-		
-		cacheOffset = offset&(~(cacheSize-1));
-		fseek(outputFile, cacheOffset-cacheFilePosition, SEEK_CUR);
-		//fseek(outputFile, cacheOffset, SEEK_SET);
-		cacheFilePosition += cacheOffset-cacheFilePosition;
-		theCacheSize = fread(cache, sizeof(uint8_t), cacheSize, outputFile);
-		chunksRead++;
-		cacheFilePosition += theCacheSize;
-		//printf("cacheOffset: %lld; cacheFilePosition: %lld\n", cacheOffset, cacheFilePosition);
+		LoadCache(offset&(~(cacheSize-1)));
 	}
 	return cache[offset-cacheOffset];
 	
@@ -160,16 +189,7 @@ int DiskBitFile::ReadFileDepth(int bucket, int64_t offset)
 	if ((cacheOffset == -1) || // just read into memory
 		(offset>>1)-cacheOffset < 0  || (offset>>1)-cacheOffset >= theCacheSize)
 	{
-		FlushCache();
-		
-		cacheOffset = (offset>>1)&(~(cacheSize-1));
-		fseek(outputFile, cacheOffset-cacheFilePosition, SEEK_CUR);
-		//fseek(outputFile, cacheOffset, SEEK_SET);
-		cacheFilePosition += cacheOffset-cacheFilePosition;
-		theCacheSize = fread(cache, sizeof(uint8_t), cacheSize, outputFile);
-		//chunksRead++;
-		bytesRead += cacheSize;
-		cacheFilePosition += theCacheSize;
+		LoadCache((offset>>1)&(~(cacheSize-1)));
 	}
 	return (cache[(offset>>1)-cacheOffset]>>(4*(offset%2)))&0xF;
 	
@@ -177,15 +197,7 @@ int DiskBitFile::ReadFileDepth(int bucket, int64_t offset)
 	if ((cacheOffset == -1) || // just read into memory
 		(offset>>2)-cacheOffset < 0  || (offset>>2)-cacheOffset >= theCacheSize)
 	{
-		FlushCache();
-		
-		cacheOffset = (offset>>2)&(~(cacheSize-1));
-		fseek(outputFile, cacheOffset-cacheFilePosition, SEEK_CUR);
-		//fseek(outputFile, cacheOffset, SEEK_SET);
-		cacheFilePosition += cacheOffset-cacheFilePosition;
-		theCacheSize = fread(cache, sizeof(uint8_t), cacheSize, outputFile);
-		chunksRead++;
-		cacheFilePosition += theCacheSize;
+		LoadCache((offset>>2)&(~(cacheSize-1)));
 	}
 	return (cache[(offset>>2)-cacheOffset]>>(2*(offset%4)))&0x3;
 	
@@ -198,7 +210,9 @@ void DiskBitFile::CloseReadFile()
 {
 	if (fileOpen)
 	{
-		fclose(chunkFile);
+		if (async)
+			DiscardBuffer(chunkAhead);
+		CloseFile(chunkFile);
 		chunkFile = 0;
 		//printf("Closing READ file\n");
 		fileOpen = false;
@@ -213,20 +227,12 @@ uint8_t *DiskBitFile::ReadChunk(int bucket, int64_t offset, int numEntries, uint
 	
 	if (bucket == -1)
 	{
-		if (fileOpen)
-		{
-			fclose(chunkFile);
-			//printf("Closing READ file\n");
-			fileOpen = false;
-		}
+		CloseReadFile();
 		return 0;
 	}
 	if (fileOpen && ((bucket != currBucket) || (subBucket != currSubBucket)))
 	{
-		fclose(chunkFile);
-		chunkFile = 0;
-		//printf("Closing READ file\n");
-		fileOpen = false;
+		CloseReadFile();
 	}
 	if (!fileOpen)
 	{
@@ -243,35 +249,293 @@ uint8_t *DiskBitFile::ReadChunk(int bucket, int64_t offset, int numEntries, uint
 		fileOpen = true;
 	}
 	
+	int alignedSize = (numEntries*BITS+7)/8;
+	//	uint8_t *data = GetMemoryChunk((openSize*BITS+7)/8); //new uint8_t[alignedSize];
+	assert(0 == offset%2);
+	if (async)
+	{
+		if (chunkAhead != 0 && chunkAhead->offset == offset*BITS/8 && chunkAhead->bytes == alignedSize)
+		{
+			readAheadHits++;
+		}
+		else {
+			readAheadMisses++;
+			DiscardBuffer(chunkAhead);
+			chunkAhead = GetFreeBuffer();
+			StartRead(chunkAhead, chunkFile, offset*BITS/8, alignedSize);
+		}
+		WaitForRead(chunkAhead);
+		memcpy(data, &chunkAhead->data[0], chunkAhead->result);
+		bytesRead += chunkAhead->result;
+		// chunks are usually read in order, so read the next one ahead
+		StartRead(chunkAhead, chunkFile, offset*BITS/8+alignedSize, alignedSize);
+		return data;
+	}
+
+	Timer t;
+	t.StartTimer();
 	fseek(chunkFile, offset*BITS/8-fileOffset, SEEK_CUR);
 	fileOffset+=offset*BITS/8-fileOffset;
 	//	fseek(f, offset*BITS/8, SEEK_SET);
 	
-	int alignedSize = (numEntries*BITS+7)/8;
-	//	uint8_t *data = GetMemoryChunk((openSize*BITS+7)/8); //new uint8_t[alignedSize];
-	assert(0 == offset%2);
 	fread(data, sizeof(uint8_t), alignedSize, chunkFile);
 	fileOffset += alignedSize;
 	bytesRead += alignedSize;
 	//chunksRead++;
+	t.EndTimer();
+	ioTime += t.GetElapsedTime();
+	ioWaitTime += t.GetElapsedTime();
 	return data;
 }
 
+/**
+ * Make the cacheSize block starting at newOffset bytes into the open file
+ * the cache, writing the old block first if it changed. In asynchronous
+ * mode the block has usually been read ahead already, and the block after
+ * it is read ahead in turn.
+ */
+void DiskBitFile::LoadCache(int64_t newOffset)
+{
+	FlushCache();
+	if (!async)
+	{
+		Timer t;
+		t.StartTimer();
+		cacheOffset = newOffset;
+		fseek(outputFile, cacheOffset-cacheFilePosition, SEEK_CUR);
+		//fseek(outputFile, cacheOffset, SEEK_SET);
+		cacheFilePosition += cacheOffset-cacheFilePosition;
+		theCacheSize = fread(cache, sizeof(uint8_t), cacheSize, outputFile);
+		bytesRead += theCacheSize;
+		cacheFilePosition += theCacheSize;
+		t.EndTimer();
+		ioTime += t.GetElapsedTime();
+		ioWaitTime += t.GetElapsedTime();
+		return;
+	}
+
+	ReleaseCache();
+	cacheOffset = newOffset;
+	if (readAhead != 0 && readAhead->file == outputFile && readAhead->offset == newOffset)
+	{
+		readAheadHits++;
+		cacheBuffer = readAhead;
+		readAhead = 0;
+	}
+	else {
+		readAheadMisses++;
+		DiscardBuffer(readAhead);
+		cacheBuffer = GetFreeBuffer();
+		StartRead(cacheBuffer, outputFile, newOffset, cacheSize);
+	}
+	WaitForRead(cacheBuffer);
+	cache = &cacheBuffer->data[0];
+	theCacheSize = cacheBuffer->result;
+	bytesRead += theCacheSize;
+	if (theCacheSize == cacheSize)
+	{
+		readAhead = GetFreeBuffer();
+		StartRead(readAhead, outputFile, newOffset+cacheSize, cacheSize);
+	}
+}
+
 void DiskBitFile::FlushCache()
 {
 	if (cacheChanged)
 	{
+		bytesWritten += theCacheSize;
+		cacheChanged = false;
+		if (async)
+		{
+			// the block is written behind; the next one gets a new buffer
+			cacheBuffer->file = outputFile;
+			cacheBuffer->offset = cacheOffset;
+			cacheBuffer->bytes = theCacheSize;
+			StartWrite(cacheBuffer);
+			cacheBuffer = 0;
+			cache = 0;
+			return;
+		}
+		Timer t;
+		t.StartTimer();
 		fseek(outputFile, cacheOffset-cacheFilePosition, SEEK_CUR);
 		//fseek(outputFile, cacheOffset, SEEK_SET);
 		cacheFilePosition += cacheOffset-cacheFilePosition;
 		fwrite(cache, sizeof(uint8_t), theCacheSize, outputFile);
-		bytesWritten += theCacheSize;
 		//chunksWritten++;
 		cacheFilePosition += theCacheSize;
-		cacheChanged = false;
+		t.EndTimer();
+		ioTime += t.GetElapsedTime();
+		ioWaitTime += t.GetElapsedTime();
+	}
+}
+
+/** Give the buffer holding an unchanged cache back to the pool */
+void DiskBitFile::ReleaseCache()
+{
+	if (cacheBuffer != 0)
+	{
+		std::lock_guard<std::mutex> l(ioLock);
+		cacheBuffer->state = kFree;
+		cacheBuffer = 0;
+		ioDone.notify_all();
+	}
+	cache = 0;
+}
+
+/** Close a file; in asynchronous mode, once the requests queued before it are done */
+void DiskBitFile::CloseFile(FILE *f)
+{
+	if (async)
+		Enqueue(0, f);
+	else
+		fclose(f);
+}
+
+void DiskBitFile::IOThread()
+{
+	std::unique_lock<std::mutex> l(ioLock);
+	while (true)
+	{
+		while (ioQueue.empty() && !ioStop)
+			ioQueued.wait(l);
+		if (ioQueue.empty())
+			return;
+		IORequest r = ioQueue.front();
+		ioQueue.pop_front();
+		bool write = (r.buffer != 0 && r.buffer->state == kWriting);
+		l.unlock();
+
+		Timer t;
+		t.StartTimer();
+		if (r.buffer == 0)
+		{
+			fclose(r.closeFile);
+		}
+		else if (write)
+		{
+			int64_t done = 0;
+			while (done < r.buffer->bytes)
+			{
+				ssize_t result = pwrite(fileno(r.buffer->file), &r.buffer->data[done], r.buffer->bytes-done, r.buffer->offset+done);
+				if (result <= 0) { printf("Error writing bucket file; aborting\n"); exit(0); }
+				done += result;
+			}
+		}
+		else {
+			int64_t done = 0;
+			while (done < r.buffer->bytes)
+			{
+				ssize_t result = pread(fileno(r.buffer->file), &r.buffer->data[done], r.buffer->bytes-done, r.buffer->offset+done);
+				if (result <= 0)
+					break;
+				done += result;
+			}
+			r.buffer->result = done;
+		}
+		t.EndTimer();
+
+		l.lock();
+		ioTime += t.GetElapsedTime();
+		if (r.buffer != 0)
+			r.buffer->state = (write || r.buffer->state == kDiscarded) ? kFree : kInUse;
+		ioDone.notify_all();
 	}
 }
 
+/** Wait for a buffer that isn't in use or being written */
+DiskBitFile::IOBuffer *DiskBitFile::GetFreeBuffer()
+{
+	std::unique_lock<std::mutex> l(ioLock);
+	Timer t;
+	t.StartTimer();
+	while (true)
+	{
+		for (unsigned int x = 0; x < ioBuffers.size(); x++)
+		{
+			if (ioBuffers[x].state == kFree)
+			{
+				ioBuffers[x].state = kInUse;
+				ioWaitTime += t.EndTimer();
+				return &ioBuffers[x];
+			}
+		}
+		ioDone.wait(l);
+	}
+}
+
+/** Queue a read of bytes bytes at offset in f into a buffer held by the caller */
+void DiskBitFile::StartRead(IOBuffer *b, FILE *f, int64_t offset, int64_t bytes)
+{
+	if ((int64_t)b->data.size() < bytes)
+		b->data.resize(bytes);
+	b->file = f;
+	b->offset = offset;
+	b->bytes = bytes;
+	b->result = 0;
+	{
+		std::lock_guard<std::mutex> l(ioLock);
+		b->state = kReading;
+	}
+	Enqueue(b, 0);
+}
+
+/** Queue a write of a buffer held by the caller, which no longer holds it */
+void DiskBitFile::StartWrite(IOBuffer *b)
+{
+	{
+		std::lock_guard<std::mutex> l(ioLock);
+		b->state = kWriting;
+	}
+	Enqueue(b, 0);
+}
+
+void DiskBitFile::WaitForRead(IOBuffer *b)
+{
+	std::unique_lock<std::mutex> l(ioLock);
+	if (b->state != kReading)
+		return;
+	Timer t;
+	t.StartTimer();
+	while (b->state == kReading)
+		ioDone.wait(l);
+	ioWaitTime += t.EndTimer();
+}
+
+/** Give a buffer back to the pool, without waiting if it is still being read */
+void DiskBitFile::DiscardBuffer(IOBuffer *&b)
+{
+	if (b == 0)
+		return;
+	std::lock_guard<std::mutex> l(ioLock);
+	b->state = (b->state == kReading) ? kDiscarded : kFree;
+	b = 0;
+	ioDone.notify_all();
+}
+
+void DiskBitFile::Enqueue(IOBuffer *b, FILE *closeFile)
+{
+	IORequest r = {b, closeFile};
+	{
+		std::lock_guard<std::mutex> l(ioLock);
+		ioQueue.push_back(r);
+	}
+	ioQueued.notify_one();
+}
+
+double DiskBitFile::GetIOTime()
+{
+	std::lock_guard<std::mutex> l(ioLock);
+	return ioTime;
+}
+
+void DiskBitFile::PrintIOStats()
+{
+	printf("%llu bytes read, %llu bytes written; %1.3fs of I/O, %1.3fs waiting on it; %llu reads ahead used, %llu missed\n",
+		   (unsigned long long)bytesRead, (unsigned long long)bytesWritten, GetIOTime(), ioWaitTime,
+		   (unsigned long long)readAheadHits, (unsigned long long)readAheadMisses);
+}
+
 void DiskBitFile::Init(const std::vector<bucketData> &buckets)
 {
 	int subBucket = 0;
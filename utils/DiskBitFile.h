@@ -16,14 +16,28 @@
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 //const int BITS = 4;
 #define BITS 4
 
+/**
+ * Reads and writes the depths of the states in the bucket files of a
+ * disk-based PDB. Depths are read and written through a cache of one
+ * cacheSize block of the file. In asynchronous mode, a background thread
+ * does the I/O: the block after the one being read is read ahead, as is
+ * the chunk after the one asked for by ReadChunk(), and changed blocks are
+ * written behind while the caller continues with the next block, so that
+ * sequential scans of the buckets overlap computation with the disk.
+ */
 class DiskBitFile
 {
 public:
-	DiskBitFile(const char *pre);
+	DiskBitFile(const char *pre, bool async = false);
 	~DiskBitFile();
 	void Init(const std::vector<bucketData> &buckets);
 	
@@ -37,8 +51,52 @@ public:
 
 	uint64_t GetBytesRead() const { return bytesRead; }
 	uint64_t GetBytesWritten() const { return bytesWritten; }
+	/** Reads that were already done, or in flight, when they were needed */
+	uint64_t GetReadAheadHits() const { return readAheadHits; }
+	uint64_t GetReadAheadMisses() const { return readAheadMisses; }
+	/** Seconds the caller spent waiting on disk I/O */
+	double GetIOWaitTime() const { return ioWaitTime; }
+	/** Seconds spent reading and writing, on the caller's thread or the I/O thread */
+	double GetIOTime();
+	void PrintIOStats();
 private:
+	/** A cacheSize block of a file being read or written by the I/O thread */
+	struct IOBuffer {
+		IOBuffer() :file(0), offset(-1), bytes(0), result(0), state(kFree) {}
+		std::vector<uint8_t> data;
+		FILE *file;
+		int64_t offset; // in the file [in bytes]
+		int64_t bytes;  // to write, or to read
+		int64_t result; // bytes actually read
+		int state;
+	};
+	enum {
+		kFree,    // unused
+		kInUse,   // held by the caller
+		kReading, // queued or being read; becomes kInUse
+		kWriting, // queued or being written; becomes kFree
+		kDiscarded // being read, but no longer needed; becomes kFree
+	};
+	/** A buffer to read or write, or a file to close once earlier requests are done */
+	struct IORequest {
+		IOBuffer *buffer;
+		FILE *closeFile;
+	};
+	const static int numAsyncBuffers = 6;
+
+	void LoadCache(int64_t newOffset);
 	void FlushCache();
+	void ReleaseCache();
+	void CloseFile(FILE *f);
+
+	void IOThread();
+	IOBuffer *GetFreeBuffer();
+	void StartRead(IOBuffer *b, FILE *f, int64_t offset, int64_t bytes);
+	void StartWrite(IOBuffer *b);
+	void WaitForRead(IOBuffer *b);
+	void DiscardBuffer(IOBuffer *&b);
+	void Enqueue(IOBuffer *b, FILE *closeFile);
+
 	const char *getBucketFileName(int bucket, int subBucket);
 
 	// data for reading and writing depths
@@ -59,9 +117,25 @@ private:
 	int64_t theCacheSize;      // valid bytes in the cache
 	int64_t cacheFilePosition; // current offset in file (bytes)
 	bool cacheChanged;
-	uint8_t cache[cacheSize];
+	uint8_t *cache;
+	std::vector<uint8_t> syncCache;
+
+	// asynchronous I/O
+	bool async;
+	std::vector<IOBuffer> ioBuffers;
+	IOBuffer *cacheBuffer; // holds cache
+	IOBuffer *readAhead;   // block after the cache
+	IOBuffer *chunkAhead;  // chunk after the last one read by ReadChunk()
+	std::deque<IORequest> ioQueue;
+	std::mutex ioLock;
+	std::condition_variable ioQueued, ioDone;
+	std::thread ioThread;
+	bool ioStop;
+	double ioTime;
 
 	uint64_t bytesRead, bytesWritten;
+	uint64_t readAheadHits, readAheadMisses;
+	double ioWaitTime;
 	char bucketFileName[255];
 	char prefix[64];
 };
@@ -10,6 +10,8 @@
 #include <string.h>
 #include "FourBitArray.h"
 #include <string.h>
+#include <assert.h>
+#include "MMapUtil.h"
 
 //	uint8_t *mem;
 //	uint64_t entries;
@@ -17,12 +19,23 @@
 FourBitArray::FourBitArray(uint64_t numEntries)
 {
 	mem = 0;
+	memmap = false;
 	Resize(numEntries);
 }
 
+FourBitArray::FourBitArray(uint64_t numEntries, const char *file, bool zero)
+{
+	entries = numEntries;
+	mem = GetMMAP(file, (entries+1)/2, fd, zero);
+	memmap = true;
+}
+
 FourBitArray::~FourBitArray()
 {
-	delete [] mem;
+	if (memmap)
+		CloseMMap(mem, (entries+1)/2, fd);
+	else
+		delete [] mem;
 }
 
 void FourBitArray::FillMax()
@@ -32,6 +45,7 @@ void FourBitArray::FillMax()
 
 void FourBitArray::Resize(uint64_t newMaxEntries)
 {
+	assert(!memmap);
 	entries = newMaxEntries; // 4 bit entries
 	newMaxEntries = (newMaxEntries+1)/2; // bytes
 	delete [] mem;
@@ -74,6 +88,11 @@ void FourBitArray::Write(const char *file)
 
 void FourBitArray::Read(const char *file)
 {
+	if (memmap)
+	{
+		printf("FourBitArray is memmapped; not loading\n");
+		return;
+	}
 	FILE *f = fopen(file, "r");
 	fscanf(f, "%llu\n", &entries);
 	Resize(entries);
@@ -12,22 +12,78 @@
 #include <iostream>
 #include <stdint.h>
 
-// simple four-bit array with no bounds checking
+/**
+ * Simple four-bit array with no bounds checking. The Atomic methods may be
+ * called by many threads at once, including on the two entries sharing a
+ * byte; the other methods must not be called while any thread is changing
+ * the array. The atomic operations are relaxed, so threads must
+ * synchronize (e.g. at a barrier) before relying on each other's changes.
+ */
 class FourBitArray
 {
 public:
 	FourBitArray(uint64_t numEntries = 0);
+	/** Entries mapped from a file, which is created with zeroed entries if zero is true; the array can't be resized */
+	FourBitArray(uint64_t numEntries, const char *file, bool zero);
 	~FourBitArray();
 	void FillMax();
 	void Resize(uint64_t newMaxEntries);
 	uint64_t Size() const;
 	uint8_t Get(uint64_t index) const;
 	void Set(uint64_t index, uint8_t val);
+	uint8_t AtomicGet(uint64_t index) const;
+	void AtomicSet(uint64_t index, uint8_t val);
+	/** Sets the entry to val if it is expected, returning true if it was */
+	bool AtomicCompareExchange(uint64_t index, uint8_t expected, uint8_t val);
+	/** Lowers the entry to val if val is smaller, returning true if it was lowered */
+	bool AtomicSetIfSmaller(uint64_t index, uint8_t val);
 	void Write(const char *);
 	void Read(const char *);
 private:
 	uint8_t *mem;
 	uint64_t entries;
+	bool memmap;
+	int fd;
 };
 
+inline uint8_t FourBitArray::AtomicGet(uint64_t index) const
+{
+	return (__atomic_load_n(&mem[index/2], __ATOMIC_RELAXED)>>((index&1)*4))&0xF;
+}
+
+inline void FourBitArray::AtomicSet(uint64_t index, uint8_t val)
+{
+	int shift = (index&1)*4;
+	uint8_t old = __atomic_load_n(&mem[index/2], __ATOMIC_RELAXED);
+	while (!__atomic_compare_exchange_n(&mem[index/2], &old, (uint8_t)((old&~(0xF<<shift))|(val<<shift)),
+										true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	{}
+}
+
+inline bool FourBitArray::AtomicCompareExchange(uint64_t index, uint8_t expected, uint8_t val)
+{
+	int shift = (index&1)*4;
+	uint8_t old = __atomic_load_n(&mem[index/2], __ATOMIC_RELAXED);
+	while (((old>>shift)&0xF) == expected)
+	{
+		if (__atomic_compare_exchange_n(&mem[index/2], &old, (uint8_t)((old&~(0xF<<shift))|(val<<shift)),
+										true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			return true;
+	}
+	return false;
+}
+
+inline bool FourBitArray::AtomicSetIfSmaller(uint64_t index, uint8_t val)
+{
+	int shift = (index&1)*4;
+	uint8_t old = __atomic_load_n(&mem[index/2], __ATOMIC_RELAXED);
+	while (val < ((old>>shift)&0xF))
+	{
+		if (__atomic_compare_exchange_n(&mem[index/2], &old, (uint8_t)((old&~(0xF<<shift))|(val<<shift)),
+										true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			return true;
+	}
+	return false;
+}
+
 #endif /* defined(__hog2_glut__FourBitArray__) */
@@ -24,7 +24,7 @@
 #define handle_error(msg) \
 do { perror(msg); exit(EXIT_FAILURE); } while (0)
 
-uint8_t *GetMMAP(const char *filename, uint64_t mapSize, int &fd, bool zero)
+uint8_t *GetMMAP(const char *filename, uint64_t mapSize, int &fd, bool zero, bool readOnly)
 {
 	uint8_t *memblock;
 	
@@ -41,6 +41,29 @@ uint8_t *GetMMAP(const char *filename, uint64_t mapSize, int &fd, bool zero)
 	//int fd;
 	struct stat sb;
 	
+	if (readOnly)
+	{
+		assert(!zero);
+		if ((fd = open(filename, O_RDONLY)) == -1)
+		{
+			handle_error("open");
+		}
+		fstat(fd, &sb);
+		// reading a mapping past the end of the file raises SIGBUS
+		if ((uint64_t)sb.st_size < mapSize)
+		{
+			fprintf(stderr, "'%s' has %llu bytes; %llu are needed\n", filename,
+					(unsigned long long)sb.st_size, (unsigned long long)mapSize);
+			exit(EXIT_FAILURE);
+		}
+		memblock = (uint8_t *)mmap(NULL, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+		if (memblock == MAP_FAILED)
+		{
+			handle_error("mmap");
+		}
+		return memblock;
+	}
+	
 	printf("Size of off_t is (%lu), uint64_t is (%lu)\n", sizeof(off_t), sizeof(uint64_t));
 	if (zero)
 	{
@@ -9,7 +9,13 @@
 #ifndef hog2_glut_MMapUtil_h
 #define hog2_glut_MMapUtil_h
 
-uint8_t *GetMMAP(const char *filename, uint64_t mapSizeBytes, int &fd, bool zero = false);
+/**
+ * Map a file into memory, or anonymous memory if filename is 0. zero creates
+ * (or truncates) the file with mapSizeBytes of zeros. A readOnly mapping is
+ * opened without write access, so that processes mapping the same file
+ * share its pages in the page cache; writing to it faults.
+ */
+uint8_t *GetMMAP(const char *filename, uint64_t mapSizeBytes, int &fd, bool zero = false, bool readOnly = false);
 void CloseMMap(uint8_t *mem, uint64_t mapSizeBytes, int fd);
 
 #endif
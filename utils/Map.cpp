@@ -19,11 +19,15 @@
 */ 
 
 #include <stack>
+#include <vector>
+#include <algorithm>
 #include "Map.h"
 #include "GLUtil.h"
 #include <cstdlib>
 #include <cstring>
 #include "BitMap.h"
+#include "MMapUtil.h"
+#include <sys/stat.h>
 
 GLuint wall = -1;
 
@@ -272,6 +276,11 @@ void Map::Load(const char *filename)
 		land = 0;
 	}
 	revision++;
+	if (loadBinary(filename))
+	{
+		strncpy(map_name, filename, 128);
+		return;
+	}
 	FILE *f = fopen(filename, "r");
 	if (f)
 	{
@@ -423,6 +432,125 @@ void Map::loadOctile(FILE *f, int high, int wide)
 	}
 }
 
+/**
+ * Binary octile maps: this header, then one bit per cell, row by row in
+ * 64-bit words, set for ground. If kMapBinaryTerrain is set, a 4-bit
+ * terrain code per cell follows, two cells per byte, low nibble first.
+ */
+struct MapBinaryHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t width, height;
+	uint32_t flags;
+	uint32_t unused;
+};
+
+static const char kMapBinaryMagic[4] = {'H', 'O', 'G', 'M'};
+static const uint32_t kMapBinaryVersion = 1;
+static const uint32_t kMapBinaryTerrain = 0x1;
+// the terrain of each 4-bit code; these are the terrains of octile files
+static const tTerrain kMapBinaryCodes[5] = {kOutOfBounds, kGround, kSwamp, kWater, kTrees};
+
+static uint64_t GetMapBinarySize(const MapBinaryHeader &h)
+{
+	uint64_t cells = uint64_t(h.width)*h.height;
+	uint64_t size = sizeof(MapBinaryHeader)+(cells+63)/64*8;
+	if (h.flags&kMapBinaryTerrain)
+		size += (cells+1)/2;
+	return size;
+}
+
+/**
+ * Loads a map saved by SaveBinary() by mapping the file into memory.
+ * Returns false, leaving the map alone, if the file isn't a binary map.
+ */
+bool Map::loadBinary(const char *filename)
+{
+	struct stat sb;
+	if (stat(filename, &sb) != 0 || sb.st_size < (off_t)sizeof(MapBinaryHeader))
+		return false;
+	int fd;
+	uint8_t *mem = GetMMAP(filename, sb.st_size, fd, false, true);
+	MapBinaryHeader h;
+	memcpy(&h, mem, sizeof(h));
+	if (memcmp(h.magic, kMapBinaryMagic, sizeof(h.magic)) != 0 || h.version != kMapBinaryVersion ||
+		GetMapBinarySize(h) != (uint64_t)sb.st_size)
+	{
+		CloseMMap(mem, sb.st_size, fd);
+		return false;
+	}
+	mapType = kOctile;
+	width = h.width;
+	height = h.height;
+	land = new Tile *[width];
+	for (int x = 0; x < width; x++)
+		land[x] = new Tile [height];
+	drawLand = true;
+	dList = 0;
+	updated = true;
+
+	const uint64_t *ground = (const uint64_t *)(mem+sizeof(MapBinaryHeader));
+	const uint8_t *codes = (const uint8_t *)(ground+(uint64_t(width)*height+63)/64);
+	for (int x = 0; x < width; x++)
+	{
+		for (int y = 0; y < height; y++)
+		{
+			uint64_t cell = uint64_t(y)*width+x;
+			tTerrain t;
+			if (h.flags&kMapBinaryTerrain)
+				t = kMapBinaryCodes[std::min((codes[cell>>1]>>((cell&1)*4))&0xF, 4)];
+			else
+				t = ((ground[cell>>6]>>(cell&63))&1)?kGround:kOutOfBounds;
+			land[x][y].tile1.type = t;
+			land[x][y].tile2.type = t;
+		}
+	}
+	CloseMMap(mem, sb.st_size, fd);
+	return true;
+}
+
+bool Map::SaveBinary(const char *filename)
+{
+	MapBinaryHeader h;
+	memcpy(h.magic, kMapBinaryMagic, sizeof(h.magic));
+	h.version = kMapBinaryVersion;
+	h.width = width;
+	h.height = height;
+	h.flags = 0;
+	h.unused = 0;
+	uint64_t cells = uint64_t(width)*height;
+	std::vector<uint64_t> ground((cells+63)/64);
+	std::vector<uint8_t> codes((cells+1)/2);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			if (land[x][y].split != kNoSplit)
+				return false;
+			tTerrain t = land[x][y].tile1.type;
+			int code = std::find(kMapBinaryCodes, kMapBinaryCodes+5, t)-kMapBinaryCodes;
+			if (code == 5)
+				return false;
+			uint64_t cell = uint64_t(y)*width+x;
+			if (t == kGround)
+				ground[cell>>6] |= 1ull<<(cell&63);
+			else if (t != kOutOfBounds)
+				h.flags |= kMapBinaryTerrain;
+			codes[cell>>1] |= code<<((cell&1)*4);
+		}
+	}
+	FILE *f = fopen(filename, "w");
+	if (f == 0)
+		return false;
+	bool result = (fwrite(&h, sizeof(h), 1, f) == 1 &&
+				   fwrite(&ground[0], sizeof(uint64_t), ground.size(), f) == ground.size());
+	if (result && (h.flags&kMapBinaryTerrain))
+		result = (fwrite(&codes[0], 1, codes.size(), f) == codes.size());
+	if (fclose(f) != 0)
+		result = false;
+	return result;
+}
+
 void Map::loadOctileCorner(FILE *f, int high, int wide)
 {
 	mapType = kOctileCorner;
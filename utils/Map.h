@@ -169,6 +169,12 @@ public:
 	void Save(std::stringstream &data);
 	void Save(const char *filename);
 	void Save(FILE *f);
+	/**
+	 * Saves an octile map in the binary format that Load() also reads.
+	 * Returns false for maps that format can't hold: split tiles, or terrain
+	 * that doesn't come from an octile file.
+	 */
+	bool SaveBinary(const char *filename);
 	Map *Clone() { return new Map(this); }
 	const char *GetMapName();
 	void Print(int scale = 1);
@@ -236,11 +242,13 @@ public:
 	
 	int GetNodeNum(int x, int y, tCorner c = kNone);
 	void SetNodeNum(int num, int x, int y, tCorner c = kNone);
-	int GetRevision() { return revision; }
+	int GetRevision() const { return revision; }
+	tMapType GetMapType() const { return mapType; }
 private:
 	void loadRaw(FILE *f, int height, int width);
 	void loadOctile(FILE *f, int height, int width);
 	void loadOctileCorner(FILE *f, int height, int width);
+	bool loadBinary(const char *filename);
 	void saveOctile(FILE *f);
 	void saveRaw(FILE *f);
 	bool tryLoadRollingStone(FILE *f);
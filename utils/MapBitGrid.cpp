@@ -0,0 +1,29 @@
+//
+//  MapBitGrid.cpp
+//  hog2
+//
+//  A packed grid of the cells of a Map that can be moved between.
+//
+
+#include "MapBitGrid.h"
+
+void MapBitGrid::Build(const Map *m, tTerrain terrain, bool transpose)
+{
+	map = m;
+	revision = m->GetRevision();
+	transposed = transpose;
+	width = (int)(transpose?m->GetMapHeight():m->GetMapWidth());
+	height = (int)(transpose?m->GetMapWidth():m->GetMapHeight());
+	// one empty cell on each side, and a spare word for reads that cross a word
+	rowWords = (width+2+63)/64+1;
+	bits.assign(uint64_t(rowWords)*(height+2), 0);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			long mx = transpose?y:x, my = transpose?x:y;
+			if ((m->GetTerrainType(mx, my)>>terrainBits) == (terrain>>terrainBits))
+				bits[uint64_t(y+1)*rowWords+((x+1)>>6)] |= 1ull<<((x+1)&63);
+		}
+	}
+}
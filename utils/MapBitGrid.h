@@ -0,0 +1,106 @@
+//
+//  MapBitGrid.h
+//  hog2
+//
+//  A packed grid of the cells of a Map that can be moved between.
+//
+
+#ifndef MAPBITGRID_H
+#define MAPBITGRID_H
+
+#include <stdint.h>
+#include <vector>
+#include "Map.h"
+
+/**
+ * Bits of the moves returned by MapBitGrid::GetMoves(), in the order that
+ * MapEnvironment generates successors.
+ */
+enum tMapBitGridMove {
+	kBitGridS = 0x1,
+	kBitGridN = 0x2,
+	kBitGridNW = 0x4,
+	kBitGridSW = 0x8,
+	kBitGridW = 0x10,
+	kBitGridNE = 0x20,
+	kBitGridSE = 0x40,
+	kBitGridE = 0x80,
+	kBitGridOrthogonal = kBitGridS|kBitGridN|kBitGridW|kBitGridE
+};
+
+/**
+ * One bit per cell of a Map, set for the cells whose terrain is in one
+ * class (the high bits of tTerrain). On octile maps Map::CanStep() allows a
+ * step between adjacent cells of the same class, so from a cell in the
+ * class the legal moves only depend on the 3x3 block of bits around it.
+ * Each row is padded with an empty cell on both sides and a spare word,
+ * and there is an empty row above and below the map, so the block is read
+ * from three rows with no bounds checks.
+ */
+class MapBitGrid {
+public:
+	MapBitGrid() :width(0), height(0), rowWords(0), map(0), revision(-1), transposed(false) {}
+	/**
+	 * Sets the bits of the cells of m whose terrain is in the class of
+	 * terrain. If transpose is set, bit (x, y) of the grid is cell (y, x) of
+	 * the map, so that columns of the map can be scanned as rows.
+	 */
+	void Build(const Map *m, tTerrain terrain = kGround, bool transpose = false);
+	/** True if the grid was built from m and m hasn't changed since */
+	bool IsCurrent(const Map *m) const { return map == m && revision == m->GetRevision(); }
+	bool IsTransposed() const { return transposed; }
+	bool Get(int x, int y) const
+	{ x++; y++; return (bits[uint64_t(y)*rowWords+(x>>6)]>>(x&63))&1; }
+	/**
+	 * Bit i is cell (x+i, y), for x from -64 to the width and y from -1 to
+	 * the height. Cells off the map are clear.
+	 */
+	uint64_t GetWord(int x, int y) const
+	{
+		if (x < -1)
+			return GetWord(-1, y)<<(-1-x);
+		x++; y++;
+		const uint64_t *row = &bits[uint64_t(y)*rowWords+(x>>6)];
+		int shift = x&63;
+		return (row[0]>>shift)|((row[1]<<1)<<(63-shift));
+	}
+	/**
+	 * Bits 0-8 are the cells (x-1, y-1) to (x+1, y+1), row by row; bit 4 is
+	 * (x, y). Cells off the map are clear.
+	 */
+	unsigned GetNeighborhood(int x, int y) const
+	{
+		// cells x-1 to x+1 are bits x to x+2 of padded rows y to y+2
+		const uint64_t *row = &bits[uint64_t(y)*rowWords+(x>>6)];
+		int shift = x&63;
+		unsigned result = 0;
+		for (int r = 0; r < 3; r++, row += rowWords)
+			result |= unsigned(((row[0]>>shift)|((row[1]<<1)<<(63-shift)))&0x7)<<(3*r);
+		return result;
+	}
+	/**
+	 * The legal moves (tMapBitGridMove bits) from the center of a 3x3 block
+	 * from GetNeighborhood(), whose center must be set. A diagonal move
+	 * needs both of the orthogonal moves beside it, as in MapEnvironment.
+	 */
+	static unsigned GetMoves(unsigned block, bool fourConnected)
+	{
+		unsigned n = (block>>1)&1, s = (block>>7)&1, w = (block>>3)&1, e = (block>>5)&1;
+		unsigned moves = s|(n<<1)|(w<<4)|(e<<7);
+		moves |= ((n&w&block)<<2)|((s&w&(block>>6))<<3)|((n&e&(block>>2))<<5)|((s&e&(block>>8))<<6);
+		return moves&(fourConnected?kBitGridOrthogonal:0xFF);
+	}
+	int GetWidth() const { return width; }
+	int GetHeight() const { return height; }
+	/** Bytes used by the grid */
+	uint64_t GetMemoryUsage() const { return bits.size()*sizeof(uint64_t); }
+private:
+	int width, height;
+	int rowWords;
+	std::vector<uint64_t> bits;
+	const Map *map;
+	int revision;
+	bool transposed;
+};
+
+#endif
@@ -7,11 +7,15 @@
  */
 
 #include <fstream>
+#include <algorithm>
 using std::ifstream;
 using std::ofstream;
 
 #include "ScenarioLoader.h"
+#include "MMapUtil.h"
 #include <assert.h>
+#include <stdio.h>
+#include <sys/stat.h>
 
 /** 
  * Loads the experiments from the scenario file. 
@@ -19,6 +23,8 @@ using std::ofstream;
 ScenarioLoader::ScenarioLoader(const char* fname)
 {
 	strncpy(scenName, fname, 1024);
+	if (LoadBinary(fname))
+		return;
   ifstream sfile(fname,std::ios::in);
   
   float ver;
@@ -44,13 +50,13 @@ ScenarioLoader::ScenarioLoader(const char* fname)
   if (ver==0.0){
     while(sfile>>bucket>>map>>xs>>ys>>xg>>yg>>dist) {
       Experiment exp(xs,ys,xg,yg,bucket,dist,map);
-      experiments.push_back(exp);
+      AddExperiment(exp);
     }
   }
   else if(ver==1.0){
     while(sfile>>bucket>>map>>sizeX>>sizeY>>xs>>ys>>xg>>yg>>dist){
       Experiment exp(xs,ys,xg,yg,sizeX,sizeY,bucket,dist,map);
-      experiments.push_back(exp);
+      AddExperiment(exp);
     }
   }
   else{
@@ -68,16 +74,155 @@ void ScenarioLoader::Save(const char *fname)
 	ofile<<"version "<<ver<<std::endl;
 	
 	
-	for (unsigned int x = 0; x < experiments.size(); x++)
+	for (unsigned int x = 0; x < startX.size(); x++)
 	{
-		ofile<<experiments[x].bucket<<"\t"<<experiments[x].map<<"\t"<<experiments[x].scaleX<<"\t";
-		ofile<<experiments[x].scaleY<<"\t"<<experiments[x].startx<<"\t"<<experiments[x].starty<<"\t";
-		ofile<<experiments[x].goalx<<"\t"<<experiments[x].goaly<<"\t"<<experiments[x].distance<<std::endl;
+		ofile<<bucket[x]<<"\t"<<mapNames[mapIndex[x]]<<"\t"<<scaleX[x]<<"\t";
+		ofile<<scaleY[x]<<"\t"<<startX[x]<<"\t"<<startY[x]<<"\t";
+		ofile<<goalX[x]<<"\t"<<goalY[x]<<"\t"<<distance[x]<<std::endl;
 	}
 }
 
 void ScenarioLoader::AddExperiment(Experiment which)
 {
-	experiments.push_back(which);
+	// scenarios are usually grouped by map, so check the last map first
+	uint32_t index = mapIndex.size()?mapIndex.back():0;
+	if (index >= mapNames.size() || mapNames[index] != which.map)
+	{
+		index = std::find(mapNames.begin(), mapNames.end(), which.map)-mapNames.begin();
+		if (index == mapNames.size())
+			mapNames.push_back(which.map);
+	}
+	mapIndex.push_back(index);
+	startX.push_back(which.startx);
+	startY.push_back(which.starty);
+	goalX.push_back(which.goalx);
+	goalY.push_back(which.goaly);
+	scaleX.push_back(which.scaleX);
+	scaleY.push_back(which.scaleY);
+	bucket.push_back(which.bucket);
+	distance.push_back(which.distance);
+}
+
+/*
+ * Binary scenarios: the magic and a header of version, number of
+ * experiments and number of maps, then each map name as its length and
+ * characters, padded to 8 bytes, then each field of the experiments as an
+ * array in the order below.
+ */
+static const char kScenarioBinaryMagic[4] = {'H', 'O', 'G', 'S'};
+static const uint32_t kScenarioBinaryVersion = 1;
+
+template <typename T>
+static bool WriteArray(FILE *f, const std::vector<T> &v)
+{
+	return v.size() == 0 || fwrite(&v[0], sizeof(T), v.size(), f) == v.size();
+}
+
+template <typename T>
+static const uint8_t *ReadArray(const uint8_t *data, const uint8_t *end, std::vector<T> &v, uint32_t count)
+{
+	if (data == 0 || uint64_t(end-data) < uint64_t(count)*sizeof(T))
+		return 0;
+	v.resize(count);
+	if (count > 0)
+		memcpy(&v[0], data, count*sizeof(T));
+	return data+count*sizeof(T);
+}
+
+bool ScenarioLoader::SaveBinary(const char *fname)
+{
+	FILE *f = fopen(fname, "w");
+	if (f == 0)
+		return false;
+	uint32_t header[3] = {kScenarioBinaryVersion, (uint32_t)startX.size(), (uint32_t)mapNames.size()};
+	bool result = (fwrite(kScenarioBinaryMagic, sizeof(kScenarioBinaryMagic), 1, f) == 1 &&
+				   fwrite(header, sizeof(header), 1, f) == 1);
+	uint64_t written = sizeof(kScenarioBinaryMagic)+sizeof(header);
+	for (unsigned int x = 0; result && x < mapNames.size(); x++)
+	{
+		uint32_t len = mapNames[x].size();
+		result = (fwrite(&len, sizeof(len), 1, f) == 1 &&
+				  fwrite(mapNames[x].c_str(), 1, len, f) == len);
+		written += sizeof(len)+len;
+	}
+	const char padding[8] = {0};
+	if (result && written%8 != 0)
+		result = (fwrite(padding, 1, 8-written%8, f) == 8-written%8);
+	result = result && WriteArray(f, mapIndex) && WriteArray(f, startX) && WriteArray(f, startY) &&
+		WriteArray(f, goalX) && WriteArray(f, goalY) && WriteArray(f, scaleX) && WriteArray(f, scaleY) &&
+		WriteArray(f, bucket) && WriteArray(f, distance);
+	if (fclose(f) != 0)
+		result = false;
+	return result;
 }
 
+/**
+ * Loads fname if it is a binary scenario; returns false, leaving the
+ * loader empty, if it isn't.
+ */
+bool ScenarioLoader::LoadBinary(const char *fname)
+{
+	struct stat st;
+	if (stat(fname, &st) != 0 || st.st_size < (off_t)(sizeof(kScenarioBinaryMagic)+3*sizeof(uint32_t)))
+		return false;
+	int fd;
+	size_t size = st.st_size;
+	uint8_t *mem = GetMMAP(fname, size, fd, false, true);
+	if (memcmp(mem, kScenarioBinaryMagic, sizeof(kScenarioBinaryMagic)) != 0)
+	{
+		CloseMMap(mem, size, fd);
+		return false;
+	}
+	const uint8_t *end = mem+size;
+	uint32_t header[3];
+	memcpy(header, mem+sizeof(kScenarioBinaryMagic), sizeof(header));
+	const uint8_t *data = mem+sizeof(kScenarioBinaryMagic)+sizeof(header);
+	bool result = (header[0] == kScenarioBinaryVersion);
+	uint32_t count = header[1];
+	for (uint32_t x = 0; result && x < header[2]; x++)
+	{
+		uint32_t len;
+		if (end-data < (ptrdiff_t)sizeof(len))
+			result = false;
+		else {
+			memcpy(&len, data, sizeof(len));
+			data += sizeof(len);
+			if (uint64_t(end-data) < len)
+				result = false;
+			else {
+				mapNames.push_back(string((const char *)data, len));
+				data += len;
+			}
+		}
+	}
+	if (result && (data-mem)%8 != 0)
+		data += 8-(data-mem)%8;
+	if (result && data <= end)
+	{
+		data = ReadArray(data, end, mapIndex, count);
+		data = ReadArray(data, end, startX, count);
+		data = ReadArray(data, end, startY, count);
+		data = ReadArray(data, end, goalX, count);
+		data = ReadArray(data, end, goalY, count);
+		data = ReadArray(data, end, scaleX, count);
+		data = ReadArray(data, end, scaleY, count);
+		data = ReadArray(data, end, bucket, count);
+		data = ReadArray(data, end, distance, count);
+		result = (data != 0);
+	}
+	else
+		result = false;
+	for (uint32_t x = 0; result && x < count; x++)
+		if (mapIndex[x] >= mapNames.size())
+			result = false;
+	CloseMMap(mem, size, fd);
+	if (!result)
+	{
+		printf("Invalid binary scenario '%s'\n", fname);
+		mapNames.clear(); mapIndex.clear();
+		startX.clear(); startY.clear(); goalX.clear(); goalY.clear();
+		scaleX.clear(); scaleY.clear(); bucket.clear(); distance.clear();
+	}
+	// a file with the magic is never parsed as text
+	return true;
+}
@@ -9,6 +9,7 @@
 #ifndef SCENARIOLOADER_H
 #define SCENARIOLOADER_H
 
+#include <stdint.h>
 #include <vector>
 #include <cstring>
 #include <string>
@@ -50,6 +51,9 @@ private:
 
 /** A class which loads and stores scenarios from files.  
  * Versions currently handled: 0.0 and 1.0 (includes scale). 
+ * Binary scenarios written by SaveBinary() are also loaded; the
+ * experiments are stored as arrays of each field, with each map name
+ * stored once, so loading a binary scenario is a few copies.
  */
 
 class ScenarioLoader{
@@ -57,14 +61,23 @@ public:
 	ScenarioLoader() { scenName[0] = 0; }
 	ScenarioLoader(const char *);
 	void Save(const char *);
-	int GetNumExperiments(){return experiments.size();}
+	/** Saves the experiments in the binary format; returns false on failure */
+	bool SaveBinary(const char *);
+	int GetNumExperiments(){return startX.size();}
 	const char *GetScenarioName() { return scenName; }
 	Experiment GetNthExperiment(int which)
-	{return experiments[which];}
+	{
+		return Experiment(startX[which], startY[which], goalX[which], goalY[which], scaleX[which], scaleY[which],
+						  bucket[which], distance[which], mapNames[mapIndex[which]]);
+	}
 	void AddExperiment(Experiment which);
 private:
+	bool LoadBinary(const char *);
 	char scenName[1024];
-	std::vector<Experiment> experiments;
+	std::vector<string> mapNames;
+	std::vector<uint32_t> mapIndex;
+	std::vector<int32_t> startX, startY, goalX, goalY, scaleX, scaleY, bucket;
+	std::vector<double> distance;
 };
 
 #endif